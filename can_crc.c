@@ -0,0 +1,387 @@
+/*! \file can_crc.c
+
+	\brief Параметрический расчет CRC с таблицами, построенными при компиляции
+
+	Вариант CRC задается параметрами каталога, CRC_DEFINE() строит для него таблицы
+	slicing-by-8 при компиляции. Таблица линейна по индексу:
+	T_k[i] = XOR по битам b индекса (i * x^(W+8k) mod P)_b, поэтому достаточно степеней
+	E_j = x^(W+j) mod P, j=0..63. Степени вычисляются цепочкой перечислений, каждое
+	следующее -- сдвиг предыдущего на один бит, запись таблицы -- XOR не более восьми степеней.
+	Для отраженных алгоритмов (refin) цепочка и таблицы строятся в отраженном виде.
+	Значения перечислений шире int -- расширение GCC и C23.
+
+	Ядра:
+	- slicing-by-8, одна зависимая выборка из таблицы на 8 байт, по разрядности width;
+	- для длинных буферов на x86 с PCLMULQDQ -- свертка блоков по 16 байт умножением
+	без переноса в прямом и отраженном виде. Константы свертки x^n mod P вычисляются
+	однократно при первом использовании под защитой g_once_init_enter();
+	- пакет буферов одной длины, can_crc_mb(): четыре независимые цепочки slicing-by-8 
+	чередуются для скрытия задержки выборки из таблицы.
+
+Тестирование:
+$ gcc -O2 -DTEST_CAN_CRC can_crc.c -o crc.exe `pkg-config --cflags --libs glib-2.0`
+$ ./crc.exe
+ */
+#include <string.h>
+#include <glib.h>
+#include "can_crc.h"
+
+#define CRC_MASK(W)	(~0ULL>>(64-(W)))
+#define CRC_REV1(x)	((((x)&0x5555555555555555ULL)<<1)  | (((x)>>1) &0x5555555555555555ULL))
+#define CRC_REV2(x)	((((x)&0x3333333333333333ULL)<<2)  | (((x)>>2) &0x3333333333333333ULL))
+#define CRC_REV4(x)	((((x)&0x0F0F0F0F0F0F0F0FULL)<<4)  | (((x)>>4) &0x0F0F0F0F0F0F0F0FULL))
+#define CRC_REV8(x)	((((x)&0x00FF00FF00FF00FFULL)<<8)  | (((x)>>8) &0x00FF00FF00FF00FFULL))
+#define CRC_REV16(x)	((((x)&0x0000FFFF0000FFFFULL)<<16) | (((x)>>16)&0x0000FFFF0000FFFFULL))
+#define CRC_REV32(x)	(((x)<<32) | ((x)>>32))
+//! отражение младших W бит
+#define CRC_REFLECT(W,x) (CRC_REV32(CRC_REV16(CRC_REV8(CRC_REV4(CRC_REV2(CRC_REV1((uint64_t)(x)))))))>>(64-(W)))
+//! умножение на x по модулю P: прямой вид -- сдвиг влево, отраженный -- вправо
+#define CRC_NEXT(W,P,R,c) ((R)? ((c)>>1) ^ (((c)&1)? CRC_REFLECT(W,P): 0) \
+	: (((c)<<1) & CRC_MASK(W)) ^ (((c)>>((W)-1))&1? (P): 0))
+#define CRC_POW8(n,W,P,R,k,pk) \
+	n##_e##k##_0 = CRC_NEXT(W,P,R,n##_e##pk##_7), \
+	n##_e##k##_1 = CRC_NEXT(W,P,R,n##_e##k##_0), \
+	n##_e##k##_2 = CRC_NEXT(W,P,R,n##_e##k##_1), \
+	n##_e##k##_3 = CRC_NEXT(W,P,R,n##_e##k##_2), \
+	n##_e##k##_4 = CRC_NEXT(W,P,R,n##_e##k##_3), \
+	n##_e##k##_5 = CRC_NEXT(W,P,R,n##_e##k##_4), \
+	n##_e##k##_6 = CRC_NEXT(W,P,R,n##_e##k##_5), \
+	n##_e##k##_7 = CRC_NEXT(W,P,R,n##_e##k##_6)
+//! степени E_(8k+b) = x^(W+8k+b) mod P, перечисления n_e<k>_<b>; n_e_7 = x^(W-1) -- начало цепочки
+#define CRC_POWERS(n,W,P,R) enum { \
+	n##_e_7 = (R)? 1: 1ULL<<((W)-1), \
+	CRC_POW8(n,W,P,R,0,), CRC_POW8(n,W,P,R,1,0), CRC_POW8(n,W,P,R,2,1), CRC_POW8(n,W,P,R,3,2), \
+	CRC_POW8(n,W,P,R,4,3), CRC_POW8(n,W,P,R,5,4), CRC_POW8(n,W,P,R,6,5), CRC_POW8(n,W,P,R,7,6) }
+//! бит b индекса i: в прямом виде -- x^(7-b) байта, в отраженном -- x^b
+#define CRC_BIT(n,R,k,b,i) (((i)>>((R)? 7-(b): (b)))&1? n##_e##k##_##b: 0)
+#define CRC_ENTRY(n,R,k,i) (CRC_BIT(n,R,k,0,i) ^ CRC_BIT(n,R,k,1,i) ^ CRC_BIT(n,R,k,2,i) ^ CRC_BIT(n,R,k,3,i) \
+	^ CRC_BIT(n,R,k,4,i) ^ CRC_BIT(n,R,k,5,i) ^ CRC_BIT(n,R,k,6,i) ^ CRC_BIT(n,R,k,7,i))
+#define CRC_T4(n,R,k,i)  CRC_ENTRY(n,R,k,(i)), CRC_ENTRY(n,R,k,(i)+1), CRC_ENTRY(n,R,k,(i)+2), CRC_ENTRY(n,R,k,(i)+3)
+#define CRC_T16(n,R,k,i) CRC_T4(n,R,k,(i)), CRC_T4(n,R,k,(i)+4), CRC_T4(n,R,k,(i)+8), CRC_T4(n,R,k,(i)+12)
+#define CRC_T64(n,R,k,i) CRC_T16(n,R,k,(i)), CRC_T16(n,R,k,(i)+16), CRC_T16(n,R,k,(i)+32), CRC_T16(n,R,k,(i)+48)
+#define CRC_TABLE(n,R,k) { CRC_T64(n,R,k,0), CRC_T64(n,R,k,64), CRC_T64(n,R,k,128), CRC_T64(n,R,k,192) }
+/*! \brief определение варианта CRC по параметрам каталога, refin и refout задают 0 или 1 */
+#define CRC_DEFINE(n, W, P, INIT, REFIN, REFOUT, XOROUT, CHECK, NAME) \
+	CRC_POWERS(n, W, P, REFIN); \
+	static const uint##W##_t n##_table[8][256] = { \
+		CRC_TABLE(n,REFIN,0), CRC_TABLE(n,REFIN,1), CRC_TABLE(n,REFIN,2), CRC_TABLE(n,REFIN,3), \
+		CRC_TABLE(n,REFIN,4), CRC_TABLE(n,REFIN,5), CRC_TABLE(n,REFIN,6), CRC_TABLE(n,REFIN,7) }; \
+	static can_crc_fold_t n##_fold; \
+	const can_crc_t n = { .name = NAME, .width = W, .refin = REFIN, .refout = REFOUT, \
+		.poly = P, .init = INIT, .xorout = XOROUT, .check = CHECK, \
+		.table = n##_table, .fold = &n##_fold, .update = _crc_slice##W, .update_mb = _crc_mb##W }
+
+static inline uint64_t _load_le64(const uint8_t* d)
+{
+	uint64_t v;
+	memcpy(&v, d, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+static inline uint64_t _load_be64(const uint8_t* d)
+{
+	uint64_t v;
+	memcpy(&v, d, 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+/*! \brief ядро slicing-by-8 для разрядности W
+
+	Состояние CRC занимает первые W/8 байт блока: в прямом виде -- старшие байты слова 
+	big-endian, в отраженном -- младшие байты слова little-endian. Байт j блока 
+	сдвигается на 8(7-j) бит до конца блока, поэтому выбирается из таблицы T_(7-j).
+	Шаги _crc_step и _crc_byte встраиваются с постоянным refin, ветвление уходит из цикла.
+	Для width=8 прямой и отраженный вид совпадают по индексу: состояние -- один байт, 
+	выборка идет по байтам данных без сборки слова.
+ */
+#define CRC_SLICE_KERNEL(W) \
+static inline uint64_t _crc_step##W(const uint##W##_t (*T)[256], const int refin, uint64_t state, const uint8_t* d) \
+{ \
+	if ((W)==8) \
+		return T[7][d[0]^state] ^ T[6][d[1]] ^ T[5][d[2]] ^ T[4][d[3]] \
+		     ^ T[3][d[4]] ^ T[2][d[5]] ^ T[1][d[6]] ^ T[0][d[7]]; \
+	if (refin) { \
+		uint64_t v = _load_le64(d) ^ state; \
+		return T[7][v&0xFF] ^ T[6][(v>>8)&0xFF] ^ T[5][(v>>16)&0xFF] ^ T[4][(v>>24)&0xFF] \
+		     ^ T[3][(v>>32)&0xFF] ^ T[2][(v>>40)&0xFF] ^ T[1][(v>>48)&0xFF] ^ T[0][v>>56]; \
+	} else { \
+		uint64_t v = _load_be64(d) ^ (state<<(64-(W))); \
+		return T[7][v>>56] ^ T[6][(v>>48)&0xFF] ^ T[5][(v>>40)&0xFF] ^ T[4][(v>>32)&0xFF] \
+		     ^ T[3][(v>>24)&0xFF] ^ T[2][(v>>16)&0xFF] ^ T[1][(v>>8)&0xFF] ^ T[0][v&0xFF]; \
+	} \
+} \
+static inline uint64_t _crc_byte##W(const uint##W##_t (*T)[256], const int refin, uint64_t state, uint8_t b) \
+{ \
+	return refin? (state>>8) ^ T[0][(state ^ b) & 0xFF] \
+		: ((state<<8) & CRC_MASK(W)) ^ T[0][((state>>((W)-8)) ^ b) & 0xFF]; \
+} \
+static inline uint64_t _crc_slice_loop##W(const uint##W##_t (*T)[256], const int refin, uint64_t state, const uint8_t* d, size_t len) \
+{ \
+	for (; len>=8; len-=8, d+=8) \
+		state = _crc_step##W(T, refin, state, d); \
+	for (; len>0; len--) \
+		state = _crc_byte##W(T, refin, state, *d++); \
+	return state; \
+} \
+static uint64_t _crc_slice##W(const can_crc_t* crc, uint64_t state, const uint8_t* d, size_t len) \
+{ \
+	return crc->refin? _crc_slice_loop##W(crc->table, 1, state, d, len) \
+		: _crc_slice_loop##W(crc->table, 0, state, d, len); \
+} \
+/*! четыре цепочки по буферам d, d+stride, d+2*stride, d+3*stride */ \
+static inline void _crc_mb4_##W(const uint##W##_t (*T)[256], const int refin, uint64_t* c, const uint8_t* d, size_t stride, size_t len) \
+{ \
+	const uint8_t* d0 = d, *d1 = d+stride, *d2 = d+2*stride, *d3 = d+3*stride; \
+	uint64_t c0 = c[0], c1 = c[1], c2 = c[2], c3 = c[3]; \
+	size_t k; \
+	for (k=0; k+8<=len; k+=8) { \
+		c0 = _crc_step##W(T, refin, c0, d0+k); \
+		c1 = _crc_step##W(T, refin, c1, d1+k); \
+		c2 = _crc_step##W(T, refin, c2, d2+k); \
+		c3 = _crc_step##W(T, refin, c3, d3+k); \
+	} \
+	for (; k<len; k++) { \
+		c0 = _crc_byte##W(T, refin, c0, d0[k]); \
+		c1 = _crc_byte##W(T, refin, c1, d1[k]); \
+		c2 = _crc_byte##W(T, refin, c2, d2[k]); \
+		c3 = _crc_byte##W(T, refin, c3, d3[k]); \
+	} \
+	c[0] = c0, c[1] = c1, c[2] = c2, c[3] = c3; \
+} \
+static void _crc_mb##W(const can_crc_t* crc, const uint8_t* data, size_t stride, size_t len, void* out, size_t n) \
+{ \
+	uint##W##_t* r = out; \
+	const uint64_t init = can_crc_init(crc); \
+	size_t i; \
+	for (i=0; i+4<=n; i+=4, data+=4*stride) { \
+		uint64_t c[4] = {init, init, init, init}; \
+		if (crc->refin) _crc_mb4_##W(crc->table, 1, c, data, stride, len); \
+		else            _crc_mb4_##W(crc->table, 0, c, data, stride, len); \
+		r[i+0] = can_crc_final(crc, c[0]); \
+		r[i+1] = can_crc_final(crc, c[1]); \
+		r[i+2] = can_crc_final(crc, c[2]); \
+		r[i+3] = can_crc_final(crc, c[3]); \
+	} \
+	for (; i<n; i++, data+=stride) \
+		r[i] = can_crc_final(crc, crc->update(crc, init, data, len)); \
+}
+CRC_SLICE_KERNEL(8)
+CRC_SLICE_KERNEL(16)
+CRC_SLICE_KERNEL(32)
+CRC_SLICE_KERNEL(64)
+
+CRC_DEFINE(can_crc8_sae_j1850,    8, 0x1D,       0xFF,   0, 0, 0xFF,   0x4B,   "CRC-8/SAE-J1850");
+CRC_DEFINE(can_crc8_h2f,          8, 0x2F,       0xFF,   0, 0, 0xFF,   0xDF,   "CRC-8/AUTOSAR");
+CRC_DEFINE(can_crc16_ccitt_false, 16, 0x1021,    0xFFFF, 0, 0, 0x0000, 0x29B1, "CRC-16/CCITT-FALSE");
+CRC_DEFINE(can_crc16_xmodem,      16, 0x1021,    0x0000, 0, 0, 0x0000, 0x31C3, "CRC-16/XMODEM");
+CRC_DEFINE(can_crc16_arc,         16, 0x8005,    0x0000, 1, 1, 0x0000, 0xBB3D, "CRC-16/ARC");
+CRC_DEFINE(can_crc32,             32, 0x04C11DB7u, 0xFFFFFFFFu, 1, 1, 0xFFFFFFFFu, 0xCBF43926u, "CRC-32/ISO-HDLC");
+CRC_DEFINE(can_crc32p4,           32, 0xF4ACFB13u, 0xFFFFFFFFu, 1, 1, 0xFFFFFFFFu, 0x1697D06Au, "CRC-32/AUTOSAR");
+CRC_DEFINE(can_crc64_xz,          64, 0x42F0E1EBA9EA3693ULL, ~0ULL, 1, 1, ~0ULL, 0x995DC9BBDF1939FAULL, "CRC-64/XZ");
+
+static uint64_t _reflect(uint64_t x, unsigned width)
+{
+	return CRC_REFLECT(width, x);
+}
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+/*! \brief x^n mod P в прямом виде */
+static uint64_t _xpow_mod(const can_crc_t* crc, unsigned n)
+{
+	const unsigned W = crc->width;
+	uint64_t r = 1;
+	for (; n>0; n--)
+		r = ((r<<1) & CRC_MASK(W)) ^ ((r>>(W-1))&1? crc->poly: 0);
+	return r;
+}
+/*! \brief константы свертки на 128 и 512 бит
+
+	Прямой вид: старшая половина состояния умножается на x^(n+64), младшая -- на x^n.
+	Отраженный вид: произведение отраженных 64 битных множителей сдвинуто на один бит,
+	поэтому берутся x^(n+63) и x^(n-1), половины состояния меняются местами.
+	Константы записывает один поток внутри g_once_init_enter(), остальные ждут 
+	g_once_init_leave() и читают готовые значения.
+ */
+static const uint64_t* _crc_fold(const can_crc_t* crc)
+{
+	can_crc_fold_t* fold = crc->fold;
+	if (g_once_init_enter(&fold->ready)) {
+		uint64_t* k = fold->k;
+		int i;
+		for (i=0; i<2; i++) {
+			unsigned n = i? 512: 128;
+			if (crc->refin) {
+				k[2*i+0] = _reflect(_xpow_mod(crc, n+63), 64);
+				k[2*i+1] = _reflect(_xpow_mod(crc, n-1),  64);
+			} else {
+				k[2*i+0] = _xpow_mod(crc, n);
+				k[2*i+1] = _xpow_mod(crc, n+64);
+			}
+		}
+		g_once_init_leave(&fold->ready, 1);
+	}
+	return fold->k;
+}
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i _fold(__m128i x, __m128i k)
+{
+	return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11), _mm_clmulepi64_si128(x, k, 0x00));
+}
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i _load(const uint8_t* d, __m128i bswap, int refin)
+{
+	__m128i x = _mm_loadu_si128((const __m128i*)d);
+	return refin? x: _mm_shuffle_epi8(x, bswap);
+}
+/*! \brief свертка блоков по 16 байт умножением без переноса
+	\return состояние CRC после обработки len & ~15 байт, len>=64
+ */
+__attribute__((target("pclmul,ssse3")))
+static uint64_t _crc_clmul(const can_crc_t* crc, uint64_t state, const uint8_t* d, size_t len)
+{
+	const uint64_t* k = _crc_fold(crc);
+	const int refin = crc->refin;
+	const __m128i bswap = _mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+	const __m128i k128 = _mm_set_epi64x(k[1], k[0]);
+	const __m128i k512 = _mm_set_epi64x(k[3], k[2]);
+	__m128i x0 = _load(d,    bswap, refin);
+	__m128i x1 = _load(d+16, bswap, refin);
+	__m128i x2 = _load(d+32, bswap, refin);
+	__m128i x3 = _load(d+48, bswap, refin);
+	x0 = _mm_xor_si128(x0, refin? _mm_set_epi64x(0, state): _mm_set_epi64x(state<<(64-crc->width), 0));
+	d += 64, len -= 64;
+	for (; len>=64; len-=64, d+=64) {
+		x0 = _mm_xor_si128(_fold(x0, k512), _load(d,    bswap, refin));
+		x1 = _mm_xor_si128(_fold(x1, k512), _load(d+16, bswap, refin));
+		x2 = _mm_xor_si128(_fold(x2, k512), _load(d+32, bswap, refin));
+		x3 = _mm_xor_si128(_fold(x3, k512), _load(d+48, bswap, refin));
+	}
+	x0 = _mm_xor_si128(_fold(x0, k128), x1);
+	x0 = _mm_xor_si128(_fold(x0, k128), x2);
+	x0 = _mm_xor_si128(_fold(x0, k128), x3);
+	for (; len>=16; len-=16, d+=16)
+		x0 = _mm_xor_si128(_fold(x0, k128), _load(d, bswap, refin));
+	uint8_t buf[16];
+	_mm_storeu_si128((__m128i*)buf, refin? x0: _mm_shuffle_epi8(x0, bswap));
+	return crc->update(crc, 0, buf, 16);
+}
+#define CPU_PCLMUL() (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3"))
+#else
+#define CPU_PCLMUL() 0
+#define _crc_clmul(crc, state, d, len) (state)
+#endif
+#define CRC_CLMUL_MIN 256 // длина буфера, с которой свертка быстрее таблиц
+
+/*! \brief начальное состояние расчета по частям */
+uint64_t can_crc_init(const can_crc_t* crc)
+{
+	return crc->refin? _reflect(crc->init, crc->width): crc->init;
+}
+/*! \brief обработка очередной части данных, результат не зависит от разбиения данных на части */
+uint64_t can_crc_update(const can_crc_t* crc, uint64_t state, const void* data, size_t len)
+{
+	const uint8_t* d = data;
+	if (len >= CRC_CLMUL_MIN && CPU_PCLMUL()) {
+		state = _crc_clmul(crc, state, d, len);
+		d += len & ~(size_t)15;
+		len &= 15;
+	}
+	return crc->update(crc, state, d, len);
+}
+/*! \brief значение CRC по состоянию расчета */
+uint64_t can_crc_final(const can_crc_t* crc, uint64_t state)
+{
+	if (crc->refin != crc->refout) state = _reflect(state, crc->width);
+	return state ^ crc->xorout;
+}
+uint64_t can_crc(const can_crc_t* crc, const void* data, size_t len)
+{
+	return can_crc_final(crc, can_crc_update(crc, can_crc_init(crc), data, len));
+}
+/*! \brief Контрольные суммы пакета буферов одной длины
+
+	Буферы расположены с шагом stride, например поле data массива struct can_frame 
+	или canfd_frame. Вычисляются четыре независимые цепочки одновременно.
+	\param data - первый буфер
+	\param stride - шаг между буферами в байтах
+	\param len - длина каждого буфера
+	\param out - результат, n значений разрядности width: uint8_t, uint16_t, uint32_t или uint64_t
+ */
+void can_crc_mb(const can_crc_t* crc, const void* data, size_t stride, size_t len, void* out, size_t n)
+{
+	crc->update_mb(crc, data, stride, len, out, n);
+}
+
+#ifdef TEST_CAN_CRC
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+/*! побитовый расчет по определению каталога */
+static uint64_t crc_bitwise(const can_crc_t* crc, const uint8_t* d, size_t len)
+{
+	const unsigned W = crc->width;
+	uint64_t r = crc->init;
+	size_t i;
+	for (i=0; i<len*8; i++) {
+		unsigned bit = crc->refin? d[i/8]>>(i%8) & 1: d[i/8]>>(7-i%8) & 1;
+		r = ((r>>(W-1)) ^ bit)&1? ((r<<1) & CRC_MASK(W)) ^ crc->poly: (r<<1) & CRC_MASK(W);
+	}
+	if (crc->refout) r = _reflect(r, W);
+	return r ^ crc->xorout;
+}
+static double seconds(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+int main(){
+	static const can_crc_t* catalogue[] = {
+		&can_crc8_sae_j1850, &can_crc8_h2f, &can_crc16_ccitt_false, &can_crc16_xmodem,
+		&can_crc16_arc, &can_crc32, &can_crc32p4, &can_crc64_xz,
+	};
+	const size_t size = 1<<22;
+	uint8_t* buf = malloc(size);
+	size_t i, n, len;
+	for (i=0; i<size; i++) buf[i] = rand();
+	for (n=0; n<sizeof(catalogue)/sizeof(catalogue[0]); n++) {
+		const can_crc_t* crc = catalogue[n];
+		uint64_t check = can_crc(crc, "123456789", 9);
+		int fail = check!=crc->check;
+		for (len=0; len<1500 && !fail; len++) {
+			size_t split = rand()%(len+1);
+			uint64_t state = can_crc_update(crc, can_crc_init(crc), buf+len%5, split);
+			state = can_crc_update(crc, state, buf+len%5+split, len-split);
+			if (can_crc_final(crc, state)!=crc_bitwise(crc, buf+len%5, len)) fail++;
+		}
+		// пакет буферов: каждая разрядность пишет результат своего размера
+		for (len=0; len<=72 && !fail; len++) {
+			uint64_t out[7];
+			uint8_t* r = (uint8_t*)out;
+			can_crc_mb(crc, buf+len, 72, len, out, 7);
+			for (i=0; i<7; i++) {
+				uint64_t v = 0;
+				memcpy(&v, r + i*(crc->width/8), crc->width/8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+				v >>= 64-crc->width;
+#endif
+				if (v!=crc_bitwise(crc, buf+len+i*72, len)) fail++;
+			}
+		}
+		double t = seconds();
+		for (i=0; i<10; i++) buf[0] = crc->update(crc, buf[0], buf, size);
+		t = seconds() - t;
+		double t2 = seconds();
+		for (i=0; i<10; i++) buf[0] = can_crc_update(crc, buf[0], buf, size);
+		t2 = seconds() - t2;
+		printf("%-20s check=%0*llX slicing-by-8 %.2f GB/s, %s %.2f GB/s ..%s\n", crc->name, 
+			crc->width/4, (unsigned long long)check, 10*size/t*1e-9, 
+			CPU_PCLMUL()? "pclmul": "table", 10*size/t2*1e-9, fail? "fail": "ok");
+	}
+	free(buf);
+	return 0;
+}
+#endif//TEST_CAN_CRC
@@ -0,0 +1,59 @@
+#ifndef CAN_CRC_H
+#define CAN_CRC_H
+/*! \file can_crc.h
+
+	\brief Параметрический расчет CRC по каталогу
+
+	Алгоритм задается параметрами каталога: width, poly, init, refin, refout, xorout.
+	Таблицы строятся при компиляции, см. can_crc.c.
+
+	Профили защиты AUTOSAR E2E:
+	- Profile 1    -- can_crc8_sae_j1850
+	- Profile 2    -- can_crc8_h2f
+	- Profile 4    -- can_crc32p4
+	- Profile 5, 6 -- can_crc16_ccitt_false
+	- Profile 7    -- can_crc64_xz
+
+	\see Каталог контрольных сумм СRC    <http://reveng.sourceforge.net/crc-catalogue/>
+	\see Specification of CRC Routines AUTOSAR CP R19-11
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct _can_crc can_crc_t;
+typedef struct _can_crc_fold can_crc_fold_t;
+struct _can_crc_fold {
+	size_t ready;	//!< признак готовности для g_once_init_enter()
+	uint64_t k[4];	//!< x^n mod P для свертки на 128 и 512 бит
+};
+struct _can_crc {
+	const char* name;
+	uint8_t width;	//!< 8, 16, 32 или 64
+	uint8_t refin;
+	uint8_t refout;
+	uint64_t poly;
+	uint64_t init;
+	uint64_t xorout;
+	uint64_t check;	//!< CRC строки "123456789"
+	const void* table;	//!< таблицы slicing-by-8 [8][256] разрядности width
+	can_crc_fold_t* fold;	//!< константы свертки PCLMUL, вычисляются однократно при первом использовании
+	uint64_t (*update)(const can_crc_t* crc, uint64_t state, const uint8_t* data, size_t len);
+	void (*update_mb)(const can_crc_t* crc, const uint8_t* data, size_t stride, size_t len, void* out, size_t n);
+};
+
+extern const can_crc_t can_crc8_sae_j1850;
+extern const can_crc_t can_crc8_h2f;
+extern const can_crc_t can_crc16_ccitt_false;
+extern const can_crc_t can_crc16_xmodem;
+extern const can_crc_t can_crc16_arc;
+extern const can_crc_t can_crc32;
+extern const can_crc_t can_crc32p4;
+extern const can_crc_t can_crc64_xz;
+
+uint64_t can_crc_init  (const can_crc_t* crc);
+uint64_t can_crc_update(const can_crc_t* crc, uint64_t state, const void* data, size_t len);
+uint64_t can_crc_final (const can_crc_t* crc, uint64_t state);
+uint64_t can_crc(const can_crc_t* crc, const void* data, size_t len);
+void     can_crc_mb(const can_crc_t* crc, const void* data, size_t stride, size_t len, void* out, size_t n);
+
+#endif//CAN_CRC_H
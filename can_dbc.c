@@ -3,7 +3,7 @@
 	\date 16-03-2023
 
 	Сборка
-$ gcc can_dbc.c -o dbc `pkg-config.exe --cflags --libs glib-2.0`
+$ gcc can_dbc.c can_dbc_batch.c can_ev_pcap.c -o dbc `pkg-config.exe --cflags --libs glib-2.0`
 
 Описание формата
 |  выбор элемента
@@ -157,9 +157,13 @@ Definition: BA_DEF_DEF "GenSigStartValue" 0
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
+#include <errno.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include <sys/can.h>
+#include "can_dbc.h"
 
 #define CAN_SFF_ID_Bits 11
 #define CAN_EFF_ID_Bits 29
@@ -176,7 +180,8 @@ SG_ "name"  преобразуется в
 
 #define name##_Type -- тип: 'signed' 'unsigned' 'float' 'enumerated' 'boolean'
 #define name##_Name -- текстовая константа название параметра
-#define name##_Pos  -- позиция поля в битах
+#define name##_Start -- стартовый бит сигнала в описании DBC
+#define name##_Pos  -- позиция младшего бита поля в слове данных, в паре с name##_Msk
 #define name##_Bits -- длина поля в битах bit size
 #define name##_Msk  -- маска выделения сигнала ULL до 64 бит
 #define name##_Factor -- множитель для отображения значения
@@ -189,29 +194,6 @@ VAL_ message_id signal_name
 #define CAN_DBC_VALUE_ID(v) используется для получения значения по имени
 #define CAN_DBC_VALUE_NAME(v) используется для получения текстового имени
  */
-// MilCAN:			if (can_id & J1939_EDP_Msk) -- MilCAN
-#define MilCAN_COMMAND_Msk	0x80000000
-#define MilCAN_SEGMENT_Msk	0x40000000
-// J1939: разбор форматов
-#define J1939_PRIORITY_Msk	0x1C000000
-#define J1939_PRIORITY_Pos	26
-#define J1939_EDP_Msk 		0x02000000
-#define J1939_EDP_Pos 		25
-#define J1939_DP_Msk 		0x01000000
-#define J1939_DP_Pos 		24
-#define J1939_PF_Msk 		0x00FF0000
-#define J1939_PF_Pos 		16
-#define J1939_PS_Msk 		0x0000FF00
-#define J1939_PS_Pos 		8
-#define J1939_SA_Msk 		0x000000FF
-#define J1939_SA_Pos 		0
-#define J1939_PDU1_PGN_Msk 	0x03FF0000
-#define J1939_PDU1_PGN_Pos	8	
-#define J1939_PDU2_PGN_Msk	0x03FFFF00
-#define J1939_PDU2_PGN_Pos	8	
-
-#define J1939_PF2_MASK 		0x00F00000	// >=240 broadcast
-#define J1939_DA_BROADCAST 0xFF 	// Destination Address -- Broadcast
 
 
 #include "iot_objects.h"
@@ -270,14 +252,22 @@ static inline uint8_t* ev_decode_tag(uint8_t * data, unsigned *tag, int *len){
 #define CAN_DBC_TYPE(obj) (obj##_Type)
 #define CAN_DBC_NAME(obj) (obj##_Name)
 
-typedef struct _can_dbc can_dbc_t;
-typedef struct _can_dbc_object can_dbc_object_t;
-typedef struct _can_dbc_signal can_dbc_signal_t;
+typedef struct _can_dbc_bo can_dbc_bo_t;
+typedef struct _can_dbc_sg can_dbc_sg_t;
+typedef struct _Enum Enum_t;
+typedef struct _AttrDef AttrDef_t;
+/*! \brief ссылка на фрагмент текста DBC без копирования */
+typedef struct _Slice Slice_t;
+struct _Slice {
+	const char* str;
+	uint32_t len;
+};
 struct _can_dbc_unit {
 	uint32_t oid;// OID(BU,id)
 	GQuark name_id;
 };
-struct _can_dbc_object {
+/*! \brief сообщение BO_ в процессе разбора */
+struct _can_dbc_bo {
 	uint32_t oid;// OID(BO,id)
 	GQuark name_id;
 	GQuark transmitter;
@@ -286,32 +276,12 @@ struct _can_dbc_object {
 //	uint16_t sg_size;// число полей
 	uint8_t data_len;
 //
-	GData * attrs;//!< атрибуты
-	GData * enums;//!< перечисления
+	Enum_t * attrs;//!< атрибуты BA_, список ключ-значение
 //	GSList* muxes;//!< Мультиплицируемые поля
-	GSList* sg_list;//!< Список сигналов, сортированный
-	char* comment; //!< комментарий CM_ BO_ 
+	can_dbc_sg_t* sg_list;//!< Список сигналов, сортированный
+	Slice_t comment; //!< комментарий CM_ BO_ 
 };
 
-//1. разбор формата DBC, получаем структуру can_dbc_t
-struct _can_dbc {
-	char* version;	//!< версия файла
-	// BU_:
-	GData* blocks;
-	char** block_units;	//!< таблица имен блоков
-	uint8_t  bu_size;	//!< размер таблицы имен
-	uint16_t bo_size;	//!< размер таблицы сообщений
-	// BO_:
-	GTree* objects;
-	//GTree* signals;
-//	can_dbc_object_t* objects;//!< таблица объектов
-	// SG_:
-//	can_dbc_signal_t* signals;//!< таблица сигналов
-	// BS_:
-	uint32_t baudrate;//!< скорость передачи данных на линии
-	// CM_
-	GString comments;//!< коментарии к проекту
-};
 // таблицы имен идентификаторов, используются для разбора и без разбора
 typedef struct _Names Names_t;
 struct _Names {
@@ -360,19 +330,29 @@ struct _Mux {
 	uint16_t offset;//!< Смещение по структуре данных с выравниванием на 8/16/32 бита
 };
 
-typedef struct _Enum Enum_t;
 struct _Enum {
 	GQuark  key;
-	int32_t val;
+	int64_t val;
+	Enum_t* next;
+};
+/*! \brief определение атрибута BA_DEF_ и значение по умолчанию BA_DEF_DEF_ */
+struct _AttrDef {
+	GQuark  key;	//!< имя атрибута
+	GQuark  def_label;//!< значение по умолчанию типа ENUM, 0 -- числовое значение def
+	int32_t def;	//!< значение по умолчанию
+	bool has_def;	//!< задано BA_DEF_DEF_
+	Enum_t* labels;	//!< значения типа ENUM, val -- номер значения в определении
+	AttrDef_t* next;
 };
 
-//2. если к пакету can_frame применить разбор can_dbc_decode() или can_dbc_debug()
-struct _can_dbc_signal{
-	unsigned pos:6;	// в битах от начала
-	unsigned len:6;	// длина в битах 0-64
+#define CAN_DBC_MUX_MAX 511 //!< наибольшее значение мультиплексора mNNN, поле mux_idx:10
+/*! \brief сигнал SG_ в процессе разбора */
+struct _can_dbc_sg{
+	unsigned pos:9;	// в битах от начала, до 511 для CAN FD
+	unsigned len:7;	// длина в битах 0-64
 	unsigned type:4; // data type UNSIGNED, SIGNED, FLOAT
 
-	  signed mux_idx:10;
+	  signed mux_idx:10;// страница мультиплексора 0..CAN_DBC_MUX_MAX, -1 -- вне страниц
 	unsigned mux:1; // поле является мультиплексором
 	unsigned byte_order:1; // поле 
 //	unsigned  SPN:16;		/*!< идентификатор описания */
@@ -380,70 +360,133 @@ struct _can_dbc_signal{
 // вынести 
 	GQuark units;// идентификатор единицы измерения - кварк или enum
 	float factor, offset;
-	unsigned min, max;
+	float min, max;
 /*	struct {
 		const Names_t* vals;
 		int size;
 	} enumerated;*/
-	char* comment;
+	Slice_t comment;
+	Enum_t* enums;//!< значения VAL_, сортированные по возрастанию
+	can_dbc_sg_t* next;
 };
-static
-uint64_t can_signal_value(struct can_frame *frame, can_dbc_signal_t* sg)
-{
-	uint64_t val = *(uint64_t*)frame->data;
-	if (sg->byte_order){
-	}
-	if (sg->type == _TYPE_INTEGER) {
-		val = (val>>sg->pos) & (~0ULL)>>(63-sg->len);
-	} else
-	return val;
-//	return val*sg->factor + sg->offset;
-}
 
 
-/*! \brief бинарный поиск по массиву идентификаторов 
-
-// bsearch(uint32_tconst void *key, const void *base, size_t num, size_t size,
-//              int (*cmp)(const void *key, const void *))
-*/
-static const char * get_name(uint32_t key, const Names_t * names, size_t num){
-	size_t l = 0, u = num;
+/* 	\brief выделяет из массива описаний объектов CAN по индексу
+	\param dbc_objects - массив описаний объектов, упорядоченный по идентификатору сообщения
+	\param size - длина массива, число записей
+	\param index - идентификатор сообщения
+	\return NULL если объект не найден
+ */
+const can_dbc_object_t* can_dbc_object_get(const can_dbc_object_t * dbc_objects, unsigned int size, unsigned index)
+{
+	size_t l = 0, u = size;
 	while (l < u) {
-		register const size_t mid = (l + u)>>1;
-		register int result = key - names[mid].key;
-		if (result < 0)
+		const size_t mid = (l + u)>>1;
+		const uint32_t oid = dbc_objects[mid].oid;
+		if (index < oid)
 			u = mid;
-		else if (result > 0)
+		else if (index > oid)
 			l = mid + 1;
 		else
-			return names[mid].name;
+			return &dbc_objects[mid];
 	}
 	return NULL;
 }
-/* 	\brief выделяет из массива описаний объектов CAN по индексу
-	\param dbc_objects - массив описаний объектов, упорядоченный по идентификатору сообщения
-	\param size - длина массива, число записей
-	\param index - идентификатор сообщения
-	\return NULL если объект не найден
+/* 	\brief поиск сообщения по записи индекса CAN_DBC_INDEX_AMBIGUOUS
+
+	Сначала ищется сообщение с полным идентификатором кадра. Если такого нет, для 29 битных
+	идентификаторов выбирается первое сообщение таблицы (с меньшим идентификатором) с тем же PGN,
+	так что кадры с адресом источника SA или приоритетом, не перечисленными в базе, разбираются
+	по описанию этого сообщения, как и для PGN с единственным сообщением.
  */
-const can_dbc_object_t* can_dbc_object_get(const can_dbc_object_t * dbc_objects, unsigned int size, unsigned index);
+const can_dbc_object_t* can_dbc_lookup_ambiguous(const can_dbc_t* dbc, canid_t can_id)
+{
+	can_id &= (CAN_EFF_FLAG|CAN_EFF_MASK);
+	const can_dbc_object_t* obj = can_dbc_object_get(dbc->object_table, dbc->bo_size, can_id);
+	if (obj!=NULL || !(can_id & CAN_EFF_FLAG)) return obj;
+	const uint32_t pgn = j1939_pgn(can_id);
+	uint32_t i;
+	for (i=0; i<dbc->bo_size; i++) {
+		const canid_t oid = dbc->object_table[i].oid;
+		if ((oid & CAN_EFF_FLAG) && j1939_pgn(oid)==pgn) return &dbc->object_table[i];
+	}
+	return NULL;
+}
 // далее есть два варианта - сохранить фрейм целиком, 64 бита, или выделить поле
 // мы не выделяем 64 битные поля
-const can_dbc_signal_t* can_dbc_signal_get(const can_dbc_signal_t *dbc_sg, unsigned int size,  unsigned int signal_id);
+/* 	\brief выделяет сигнал из диапазона сигналов сообщения
+	\param dbc_sg - сигналы сообщения, непрерывный диапазон таблицы сигналов
+	\param size - число сигналов сообщения
+	\param signal_id - идентификатор сигнала, смещение имени в таблице строк
+	\return NULL если сигнал не найден
+ */
+const can_dbc_signal_t* can_dbc_signal_get(const can_dbc_signal_t *dbc_sg, unsigned int size,  unsigned int signal_id)
+{
+	unsigned int i;
+	for (i=0; i<size; i++) {
+		if (dbc_sg[i].name == signal_id) return &dbc_sg[i];
+	}
+	return NULL;
+}
 
 static gint oid_cmp (  gconstpointer a,  gconstpointer b){
-	return a-b;
+	uint32_t ka = GPOINTER_TO_UINT(a), kb = GPOINTER_TO_UINT(b);
+	return (ka > kb) - (ka < kb);
 }
 static gint cmp_pos_cb (  gconstpointer a,  gconstpointer b){
-	const can_dbc_signal_t* as = a;
-	const can_dbc_signal_t* bs = b;
-	return (uint32_t)as->pos - (uint32_t)bs->pos + (as->mux_idx - bs->mux_idx)*64;
+	const can_dbc_sg_t* as = a;
+	const can_dbc_sg_t* bs = b;
+	return (int)as->pos - (int)bs->pos + (as->mux_idx - bs->mux_idx)*(CANFD_MAX_DLEN*8);
 }
 static gint cmp_enum_cb (  gconstpointer a,  gconstpointer b){
 	const Enum_t* as = a;
 	const Enum_t* bs = b;
-	return (long)as->val - (long)bs->val;
+	return (as->val > bs->val) - (as->val < bs->val);
+}
+/*! \brief выделение памяти из арены, память обнулена и выровнена на 8 байт */
+static void* arena_alloc(Arena_t* arena, size_t size)
+{
+	size = (size + 7) & ~(size_t)7;
+	ArenaChunk_t* chunk = arena->chunk;
+	if (chunk==NULL || chunk->used + size > chunk->size) {
+		size_t chunk_size = size > ARENA_CHUNK_SIZE/4? size: ARENA_CHUNK_SIZE;
+		ArenaChunk_t* block = g_malloc(sizeof(ArenaChunk_t) + chunk_size);
+		block->size = chunk_size;
+		block->used = 0;
+		if (chunk!=NULL && chunk_size!=ARENA_CHUNK_SIZE) {// большой блок не меняет текущий
+			block->next = chunk->next;
+			chunk->next = block;
+		} else {
+			block->next = chunk;
+			arena->chunk = block;
+		}
+		chunk = block;
+	}
+	void* ptr = (char*)chunk->data + chunk->used;
+	chunk->used += size;
+	return memset(ptr, 0, size);
 }
+#define arena_new0(arena, T) ((T*)arena_alloc(arena, sizeof(T)))
+/*! \brief копия строки в арене */
+static char* arena_strndup(Arena_t* arena, const char* str, size_t len)
+{
+	char* s = arena_alloc(arena, len+1);
+	memcpy(s, str, len);
+	return s;
+}
+/*! \brief освобождение арены, число операций по числу блоков */
+static void arena_free(Arena_t* arena)
+{
+	ArenaChunk_t* chunk = arena->chunk;
+	while (chunk) {
+		ArenaChunk_t* next = chunk->next;
+		g_free(chunk);
+		chunk = next;
+	}
+	arena->chunk = NULL;
+}
+G_DEFINE_QUARK(can-dbc-error-quark, can_dbc_error)
+
 can_dbc_t* can_dbc_init(can_dbc_t* dbc)
 {
 	if (dbc==NULL) dbc = g_new0(can_dbc_t,1);
@@ -453,8 +496,844 @@ can_dbc_t* can_dbc_init(can_dbc_t* dbc)
 }
 void can_dbc_free(can_dbc_t* dbc){
 	g_tree_destroy(dbc->objects);
+	if (dbc->mapped) g_mapped_file_unref(dbc->mapped);
+	arena_free(&dbc->arena);
 	g_free(dbc);
 }
+typedef struct _DbcCompiler DbcCompiler_t;
+struct _DbcCompiler {
+	can_dbc_object_t* obj;
+	can_dbc_signal_t* sg;
+	can_dbc_enum_t* en;
+	can_dbc_page_t* pg;
+	uint32_t* nm;
+	uint32_t sg_count;
+	uint32_t en_count;
+	uint32_t pg_count;
+	uint32_t nm_count;
+	const can_dbc_t* dbc;
+	GString* pool;		//!< таблица строк
+	GHashTable* index;	//!< кварк -> смещение в таблице строк
+};
+/*! \brief добавление строки в таблицу строк, повторяющиеся строки не дублируются */
+static uint32_t _string_add(DbcCompiler_t* cc, GQuark id)
+{
+	if (id==0) return 0;
+	gpointer offset = g_hash_table_lookup(cc->index, GUINT_TO_POINTER(id));
+	if (offset!=NULL) return GPOINTER_TO_UINT(offset);
+	const char* str = g_quark_to_string(id);
+	uint32_t pos = cc->pool->len;
+	g_string_append_len(cc->pool, str, strlen(str)+1);
+	g_hash_table_insert(cc->index, GUINT_TO_POINTER(id), GUINT_TO_POINTER(pos));
+	return pos;
+}
+/*! \brief число страниц мультиплексора: наибольшее значение m<N> +1, 0 -- нет сигнала M */
+static uint32_t _object_pages(const can_dbc_bo_t* bo)
+{
+	const can_dbc_sg_t* sg = bo->sg_list;
+	gboolean mux = FALSE;
+	int max_idx = -1;
+	for (; sg!=NULL; sg = sg->next) {
+		if (sg->mux && sg->mux_idx<0) mux = TRUE;
+		if (sg->mux_idx > max_idx) max_idx = sg->mux_idx;
+	}
+	return mux? max_idx+1: 0;
+}
+/*! \brief длина прямой таблицы имен перечисления, 0 -- перечисление разреженное */
+static uint32_t _enum_range(const Enum_t* list)
+{
+	if (list==NULL) return 0;
+	uint64_t count = 0;
+	int64_t min = list->val, max = list->val;
+	for (; list!=NULL; list = list->next, count++) max = list->val;
+	uint64_t range = max - min + 1;
+	return (range <= count*CAN_DBC_ENUM_DENSE && range <= 0xFFFF)? range: 0;
+}
+static gboolean _object_count_cb(gpointer key, gpointer value, gpointer user_data)
+{
+	can_dbc_bo_t* bo = value;
+	DbcCompiler_t* cc = user_data;
+	can_dbc_sg_t* sg = bo->sg_list;
+	for (; sg!=NULL; sg = sg->next) {
+		cc->sg_count++;
+		Enum_t* entry = sg->enums;
+		for (; entry!=NULL; entry = entry->next) cc->en_count++;
+		cc->nm_count += _enum_range(sg->enums);
+	}
+	cc->pg_count += _object_pages(bo);
+	return FALSE;
+}
+/*! \brief определение атрибута по имени, NULL -- атрибут не определен */
+static AttrDef_t* _attr_def(const can_dbc_t* dbc, GQuark key)
+{
+	AttrDef_t* ad = dbc->attr_defs;
+	while (ad!=NULL && ad->key!=key) ad = ad->next;
+	return ad;
+}
+/*! \brief значение атрибута BA_ сообщения
+	
+	Если атрибут сообщения не задан, используется значение BA_DEF_DEF_, для типа ENUM --
+	номер значения в определении BA_DEF_.
+	\param def - значение, если не задано ни то, ни другое
+ */
+static int _object_attr(const can_dbc_t* dbc, const can_dbc_bo_t* bo, const char* name, int def)
+{
+	GQuark key = g_quark_try_string(name);
+	if (key==0) return def;
+	const Enum_t* entry = bo->attrs;
+	for (; entry!=NULL; entry = entry->next)
+		if (entry->key==key) return entry->val;
+	const AttrDef_t* ad = _attr_def(dbc, key);
+	if (ad==NULL || !ad->has_def) return def;
+	if (ad->def_label==0) return ad->def;
+	for (entry = ad->labels; entry!=NULL; entry = entry->next)
+		if (entry->key==ad->def_label) return entry->val;
+	return def;
+}
+/*! \brief тип передачи по номеру значения GenMsgSendType
+
+	Номер значения переводится в имя по перечислению BA_DEF_ базы, имя -- в CAN_DBC_SEND_*
+	без учета регистра. Имена инструментов различаются: "cyclic","triggered",... или 
+	"Cyclic","not_used",...,"IfActive","NoMsgSendType". Неизвестное имя -- CAN_DBC_SEND_NONE.
+	Если перечисление в базе не определено, номер соответствует порядку _CanDbcSendType.
+ */
+static uint8_t _send_type(const can_dbc_t* dbc, int value)
+{
+	static const struct {
+		const char* name;
+		uint8_t type;
+	} send_types[] = {
+		{"cyclic",				CAN_DBC_SEND_CYCLIC},
+		{"triggered",			CAN_DBC_SEND_TRIGGERED},
+		{"spontaneous",			CAN_DBC_SEND_TRIGGERED},
+		{"cyclicIfActive",		CAN_DBC_SEND_IF_ACTIVE},
+		{"IfActive",			CAN_DBC_SEND_IF_ACTIVE},
+		{"cyclicAndTriggered",	CAN_DBC_SEND_CYCLIC_TRIGGERED},
+		{"cyclicAndSpontaneous",CAN_DBC_SEND_CYCLIC_TRIGGERED},
+		{"cyclicIfActiveAndTriggered",	CAN_DBC_SEND_IF_ACTIVE_TRIGGERED},
+		{"cyclicIfActiveAndSpontaneous",CAN_DBC_SEND_IF_ACTIVE_TRIGGERED},
+	};
+	GQuark key = g_quark_try_string("GenMsgSendType");
+	const AttrDef_t* ad = key? _attr_def(dbc, key): NULL;
+	if (ad==NULL || ad->labels==NULL)
+		return (value>=0 && value<CAN_DBC_SEND_NONE)? value: CAN_DBC_SEND_NONE;
+	const Enum_t* entry = ad->labels;
+	while (entry!=NULL && entry->val!=value) entry = entry->next;
+	if (entry==NULL) return CAN_DBC_SEND_NONE;
+	const char* name = g_quark_to_string(entry->key);
+	int i;
+	for (i=0; i<(int)G_N_ELEMENTS(send_types); i++)
+		if (g_ascii_strcasecmp(name, send_types[i].name)==0) return send_types[i].type;
+	return CAN_DBC_SEND_NONE;
+}
+static inline uint16_t _clamp16(int value)
+{
+	return value<0? 0: value>0xFFFF? 0xFFFF: value;
+}
+static gboolean _object_compile_cb(gpointer key, gpointer value, gpointer user_data)
+{
+	can_dbc_bo_t* bo = value;
+	DbcCompiler_t* cc = user_data;
+	can_dbc_object_t* obj = cc->obj++;
+	obj->oid  = GPOINTER_TO_UINT(key);
+	obj->name = _string_add(cc, bo->name_id);
+	obj->data_len = bo->data_len;
+	obj->cycle_time  = _clamp16(_object_attr(cc->dbc, bo, "GenMsgCycleTime", 0));
+	obj->start_delay = _clamp16(_object_attr(cc->dbc, bo, "GenMsgStartDelayTime", 0));
+	obj->delay_time  = _clamp16(_object_attr(cc->dbc, bo, "GenMsgDelayTime", 0));
+	int send_type = _object_attr(cc->dbc, bo, "GenMsgSendType", -1);
+	if (send_type<0)
+		obj->send_type = obj->cycle_time? CAN_DBC_SEND_CYCLIC: CAN_DBC_SEND_NONE;
+	else
+		obj->send_type = _send_type(cc->dbc, send_type);
+	obj->signals  = cc->sg_count;
+	obj->pages = _object_pages(bo);
+	obj->page_table = cc->pg_count;
+	can_dbc_page_t* pages = cc->pg;
+	cc->pg += obj->pages;
+	cc->pg_count += obj->pages;
+	can_dbc_sg_t* sg_list = bo->sg_list;
+	for (; sg_list!=NULL; sg_list = sg_list->next){
+		uint32_t k = cc->sg_count - obj->signals;
+		if (sg_list->mux_idx<0) {
+			obj->base_size++;
+			if (sg_list->mux && obj->mux==0) obj->mux = k+1;
+		} else 
+		if (obj->pages!=0) {// сигналы упорядочены по номеру страницы
+			can_dbc_page_t* page = &pages[sg_list->mux_idx];
+			if (page->sg_size==0) page->signals = cc->sg_count;
+			page->sg_size++;
+		}
+		can_dbc_signal_t* sg = cc->sg++;
+		sg->pos = sg_list->pos;
+		sg->len = sg_list->len;
+		sg->type = sg_list->type;
+		sg->mux_idx = sg_list->mux_idx;
+		sg->mux = sg_list->mux;
+		sg->byte_order = sg_list->byte_order;
+		sg->factor = sg_list->factor;
+		sg->offset = sg_list->offset;
+		sg->min = sg_list->min;
+		sg->max = sg_list->max;
+		sg->name  = _string_add(cc, sg_list->name_id);
+		sg->units = _string_add(cc, sg_list->units);
+		sg->enums = cc->en_count;
+		sg->en_names = cc->nm_count;
+		sg->en_range = _enum_range(sg_list->enums);
+		uint32_t* names = cc->nm;
+		cc->nm += sg->en_range;
+		cc->nm_count += sg->en_range;
+		Enum_t* entry = sg_list->enums;
+		for (; entry!=NULL; entry = entry->next) {
+			can_dbc_enum_t* en = cc->en++;
+			en->val  = entry->val;
+			en->name = _string_add(cc, entry->key);
+			if (sg->en_range) names[entry->val - sg_list->enums->val] = en->name;
+			cc->en_count++;
+		}
+		sg->en_size = cc->en_count - sg->enums;
+		cc->sg_count++;
+	}
+	obj->sg_size = cc->sg_count - obj->signals;
+	return FALSE;
+}
+static inline void _index_set(uint16_t* entry, uint32_t n)
+{
+	*entry = (*entry==0 && n<CAN_DBC_INDEX_AMBIGUOUS)? n: CAN_DBC_INDEX_AMBIGUOUS;
+}
+/*! \brief построение индекса CAN-ID -> сообщение по таблице сообщений */
+static can_dbc_index_t* _index_build(Arena_t* arena, const can_dbc_object_t* objects, uint32_t size)
+{
+	uint16_t dir[1024] = {0};
+	uint32_t i, n_pages = 0;
+	for (i=0; i<size; i++) {// страницы PDU2
+		canid_t can_id = objects[i].oid;
+		if ((can_id & CAN_EFF_FLAG) && (can_id & J1939_PF2_MASK) == J1939_PF2_MASK) {
+			uint32_t pgn = j1939_pgn(can_id);
+			if (dir[pgn>>8]==0) dir[pgn>>8] = ++n_pages;
+		}
+	}
+	can_dbc_index_t* index = arena_alloc(arena, sizeof(can_dbc_index_t) + n_pages*sizeof(index->pages[0]));
+	memcpy(index->pgn_dir, dir, sizeof(dir));
+	for (i=0; i<size; i++) {
+		canid_t can_id = objects[i].oid;
+		if (can_id & CAN_EFF_FLAG) {
+			uint32_t pgn = j1939_pgn(can_id);
+			if ((can_id & J1939_PF2_MASK) == J1939_PF2_MASK)
+				_index_set(&index->pages[index->pgn_dir[pgn>>8]-1][pgn & 0xFF], i+1);
+			else
+				_index_set(&index->pgn_dir[pgn>>8], i+1);
+		} else {
+			_index_set(&index->sff[can_id & CAN_SFF_MASK], i+1);
+		}
+	}
+	return index;
+}
+/*! \brief сигнал разбирается из данных кадра: длина 1..64 бит в пределах 8 байт от смещения
+	слова данных; за 8 байтом кадра -- только в сообщениях CAN FD с длиной данных больше 8
+ */
+static inline gboolean _signal_decodable(const can_dbc_object_t* obj, const can_dbc_signal_t* sg)
+{
+	return sg->len!=0 && can_signal_shift(sg)>=0 && can_signal_bytes(sg) <= can_dbc_object_dlen(obj);
+}
+/*! \brief векторы разбора сигналов
+
+	Для каждого сигнала таблицы сигналов заранее вычисляются сдвиг, маска, бит знака и 
+	масштаб, так что разбор сигнала сводится к выбору слова данных little/big-endian, 
+	сдвигу, маске, расширению знака и умножению со сложением без ветвлений. Массивы 
+	дополнены на 3 элемента, чтобы векторный разбор обрабатывал сигналы по 4.
+	Если сигналы сообщения выходят за 8 байт (CAN FD), слово данных читается для каждого
+	сигнала по смещению load: одно чтение 8 байт на сигнал, как и для кадров CAN.
+	Сообщения с сигналами длиннее 51 бита и сигналами типа float/double разбираются 
+	функциями can_signal_value() и can_signal_phys().
+ */
+static can_dbc_kernel_t* _kernel_build(Arena_t* arena, const can_dbc_t* dbc)
+{
+	can_dbc_kernel_t* kr = arena_new0(arena, can_dbc_kernel_t);
+	uint32_t size = dbc->sg_size + 3;
+	kr->shift = arena_alloc(arena, size*sizeof(uint64_t));
+	kr->mask  = arena_alloc(arena, size*sizeof(uint64_t));
+	kr->sign  = arena_alloc(arena, size*sizeof(uint64_t));
+	kr->order = arena_alloc(arena, size*sizeof(uint64_t));
+	kr->factor= arena_alloc(arena, size*sizeof(double));
+	kr->offset= arena_alloc(arena, size*sizeof(double));
+	kr->load  = arena_alloc(arena, size*sizeof(uint64_t));
+	kr->scalar= arena_alloc(arena, dbc->bo_size);
+	kr->fd    = arena_alloc(arena, dbc->bo_size);
+	uint32_t i, k;
+	for (i=0; i<dbc->bo_size; i++) {
+		const can_dbc_object_t* obj = &dbc->object_table[i];
+		if (obj->sg_size > kr->max_size) kr->max_size = obj->sg_size;
+		for (k=obj->signals; k<obj->signals+obj->sg_size; k++) {
+			const can_dbc_signal_t* sg = &dbc->signal_table[k];
+			if (sg->len>51 || sg->type==_TYPE_REAL || sg->type==_TYPE_DOUBLE) 
+				kr->scalar[i] = 1;
+			kr->factor[k] = sg->factor;
+			kr->offset[k] = sg->offset;
+			if (!_signal_decodable(obj, sg)) continue;// значение -- смещение
+			kr->load [k] = can_signal_offset(sg);
+			if (kr->load[k]!=0) kr->fd[i] = 1;
+			kr->shift[k] = can_signal_shift(sg);
+			kr->mask [k] = ~0ULL >> (64 - sg->len);
+			kr->sign [k] = (sg->type==_TYPE_INTEGER)? 1ULL<<(sg->len-1): 0;
+			kr->order[k] = sg->byte_order? 0: ~0ULL;
+		}
+	}
+	return kr;
+}
+/*! \brief разбор сигналов без ветвлений по векторам разбора */
+static void _kernel_decode(const can_dbc_kernel_t* kr, uint32_t first, uint32_t size, uint64_t le, uint64_t be, double* values)
+{
+	uint32_t k;
+	for (k=first; k<first+size; k++) {
+		uint64_t w = (le & ~kr->order[k]) | (be & kr->order[k]);
+		uint64_t v = (w >> kr->shift[k]) & kr->mask[k];
+		v = (v ^ kr->sign[k]) - kr->sign[k];
+		*values++ = (double)(int64_t)v * kr->factor[k] + kr->offset[k];
+	}
+}
+/*! \brief разбор сигналов CAN FD, слово данных читается по смещению каждого сигнала
+	\param data - данные кадра, CANFD_MAX_DLEN байт
+ */
+static void _kernel_decode_fd(const can_dbc_kernel_t* kr, uint32_t first, uint32_t size, const uint8_t* data, double* values)
+{
+	uint32_t k;
+	for (k=first; k<first+size; k++) {
+		uint64_t le;
+		memcpy(&le, data + kr->load[k], sizeof(le));
+		le = GUINT64_FROM_LE(le);
+		uint64_t w = (le & ~kr->order[k]) | (GUINT64_SWAP_LE_BE(le) & kr->order[k]);
+		uint64_t v = (w >> kr->shift[k]) & kr->mask[k];
+		v = (v ^ kr->sign[k]) - kr->sign[k];
+		*values++ = (double)(int64_t)v * kr->factor[k] + kr->offset[k];
+	}
+}
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+/*! \brief разбор сигналов AVX2, по 4 сигнала за итерацию
+
+	Преобразование int64 -> double выполняется сложением с константой 1.5*2^52 
+	в целочисленном виде и вычитанием в вещественном, значения не превышают 2^51.
+	Результат записывается блоками по 4, буфер значений дополнен до кратного 4.
+ */
+__attribute__((target("avx2,fma")))
+static void _kernel_decode_avx2(const can_dbc_kernel_t* kr, uint32_t first, uint32_t size, uint64_t le, uint64_t be, double* values)
+{
+	const __m256i vle = _mm256_set1_epi64x(le);
+	const __m256i vbe = _mm256_set1_epi64x(be);
+	const __m256i magic_i = _mm256_set1_epi64x(0x4338000000000000LL);
+	const __m256d magic_d = _mm256_set1_pd(6755399441055744.0);
+	uint32_t k;
+	for (k=first; k<first+size; k+=4, values+=4) {
+		__m256i w = _mm256_blendv_epi8(vle, vbe, _mm256_loadu_si256((const __m256i*)&kr->order[k]));
+		__m256i v = _mm256_srlv_epi64(w, _mm256_loadu_si256((const __m256i*)&kr->shift[k]));
+		v = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i*)&kr->mask[k]));
+		__m256i sign = _mm256_loadu_si256((const __m256i*)&kr->sign[k]);
+		v = _mm256_sub_epi64(_mm256_xor_si256(v, sign), sign);
+		__m256d d = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(v, magic_i)), magic_d);
+		d = _mm256_fmadd_pd(d, _mm256_loadu_pd(&kr->factor[k]), _mm256_loadu_pd(&kr->offset[k]));
+		_mm256_storeu_pd(values, d);
+	}
+}
+/*! \brief разбор сигналов CAN FD AVX2: слова данных 4 сигналов читаются одной выборкой
+	по смещениям load, порядок байт big-endian -- перестановкой байт в каждом слове
+ */
+__attribute__((target("avx2,fma")))
+static void _kernel_decode_fd_avx2(const can_dbc_kernel_t* kr, uint32_t first, uint32_t size, const uint8_t* data, double* values)
+{
+	const __m256i bswap = _mm256_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8, 7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8);
+	const __m256i magic_i = _mm256_set1_epi64x(0x4338000000000000LL);
+	const __m256d magic_d = _mm256_set1_pd(6755399441055744.0);
+	uint32_t k;
+	for (k=first; k<first+size; k+=4, values+=4) {
+		__m256i le = _mm256_i64gather_epi64((const long long*)data, _mm256_loadu_si256((const __m256i*)&kr->load[k]), 1);
+		__m256i w = _mm256_blendv_epi8(le, _mm256_shuffle_epi8(le, bswap), _mm256_loadu_si256((const __m256i*)&kr->order[k]));
+		__m256i v = _mm256_srlv_epi64(w, _mm256_loadu_si256((const __m256i*)&kr->shift[k]));
+		v = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i*)&kr->mask[k]));
+		__m256i sign = _mm256_loadu_si256((const __m256i*)&kr->sign[k]);
+		v = _mm256_sub_epi64(_mm256_xor_si256(v, sign), sign);
+		__m256d d = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(v, magic_i)), magic_d);
+		d = _mm256_fmadd_pd(d, _mm256_loadu_pd(&kr->factor[k]), _mm256_loadu_pd(&kr->offset[k]));
+		_mm256_storeu_pd(values, d);
+	}
+}
+#define CPU_AVX2() (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+#else
+#define CPU_AVX2() 0
+#define _kernel_decode_avx2 _kernel_decode
+#define _kernel_decode_fd_avx2 _kernel_decode_fd
+#endif
+/*! \brief разбор диапазона сигналов по описанию сигналов, без векторов разбора */
+static void _decode_scalar(const can_dbc_t* dbc, const can_dbc_object_t* obj, const uint8_t* data, 
+		uint32_t first, uint32_t size, double* values)
+{
+	const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj) + first;
+	uint32_t k;
+	for (k=first; k<first+size; k++, sg++)
+		values[k] = _signal_decodable(obj, sg)? can_signal_phys(sg, can_signal_raw(data, sg)): sg->offset;
+}
+/*! \brief разбор диапазона сигналов сообщения CAN, сигналы в пределах 8 байт
+	\param data - данные кадра, 8 байт
+	\param first - номер первого сигнала диапазона в сообщении
+	\param values - значения сигналов по номеру сигнала в сообщении
+ */
+static void _decode_range(const can_dbc_t* dbc, const can_dbc_object_t* obj, const uint8_t* data, 
+		uint32_t first, uint32_t size, double* values)
+{
+	const can_dbc_kernel_t* kr = dbc->kernel;
+	if (kr->scalar[obj - dbc->object_table]) {
+		_decode_scalar(dbc, obj, data, first, size, values);
+		return;
+	}
+	uint64_t le;
+	memcpy(&le, data, sizeof(le));
+	le = GUINT64_FROM_LE(le);
+	uint64_t be = GUINT64_SWAP_LE_BE(le);
+	if (CPU_AVX2())
+		_kernel_decode_avx2(kr, obj->signals + first, size, le, be, values + first);
+	else
+		_kernel_decode(kr, obj->signals + first, size, le, be, values + first);
+}
+/*! \brief разбор диапазона сигналов сообщения CAN FD, см. _decode_range()
+	\param data - данные кадра, CANFD_MAX_DLEN байт
+ */
+static void _decode_range_fd(const can_dbc_t* dbc, const can_dbc_object_t* obj, const uint8_t* data, 
+		uint32_t first, uint32_t size, double* values)
+{
+	const can_dbc_kernel_t* kr = dbc->kernel;
+	if (kr->scalar[obj - dbc->object_table])
+		_decode_scalar(dbc, obj, data, first, size, values);
+	else if (CPU_AVX2())
+		_kernel_decode_fd_avx2(kr, obj->signals + first, size, data, values + first);
+	else
+		_kernel_decode_fd(kr, obj->signals + first, size, data, values + first);
+}
+/*! \brief сигналы сообщения выходят за 8 байт кадра CAN */
+static inline gboolean _object_fd(const can_dbc_t* dbc, const can_dbc_object_t* obj)
+{
+	return dbc->kernel->fd[obj - dbc->object_table];
+}
+/*! \brief данные кадра CAN, дополненные нулями до CANFD_MAX_DLEN байт, чтобы чтение слова 
+	сигнала CAN FD не выходило за буфер
+ */
+static inline const uint8_t* _frame_pad(const struct can_frame* frame, struct canfd_frame* fd)
+{
+	memset(fd, 0, sizeof(*fd));
+	memcpy(fd->data, frame->data, CAN_MAX_DLEN);
+	return fd->data;
+}
+/*! \brief разбор всех сигналов сообщения
+
+	Значения вычисляются для всех сигналов сообщения, включая все страницы мультиплексора,
+	длина кадра не проверяется: данные за пределами кадра SocketCAN заполнены нулями.
+	Сигналы CAN FD за пределами 8 байт кадра CAN разбираются из данных, дополненных нулями.
+	\param values - буфер значений, не менее obj->sg_size+3 элементов
+ */
+void can_dbc_decode_frame(const can_dbc_t* dbc, const can_dbc_object_t* obj, const struct can_frame* frame, double* values)
+{
+	struct canfd_frame fd;
+	if (G_UNLIKELY(_object_fd(dbc, obj)))
+		_decode_range_fd(dbc, obj, _frame_pad(frame, &fd), 0, obj->sg_size, values);
+	else
+		_decode_range(dbc, obj, frame->data, 0, obj->sg_size, values);
+}
+/*! \brief разбор сообщения с мультиплексором по таблице страниц
+
+	Разбираются сигналы вне страниц мультиплексора, значение мультиплексора выбирает страницу 
+	в таблице страниц сообщения, разбираются только сигналы выбранной страницы. Время разбора 
+	не зависит от числа страниц, описанных в сообщении.
+	\param data - данные кадра: CANFD_MAX_DLEN байт для сообщений CAN FD, иначе 8 байт
+	\param values - значения по номеру сигнала в сообщении, буфер не менее obj->sg_size+3 элементов
+	\return выбранная страница, NULL если сообщение без мультиплексора или страница не описана
+ */
+static const can_dbc_page_t* _decode_mux(const can_dbc_t* dbc, const can_dbc_object_t* obj, const uint8_t* data, 
+		gboolean fd, double* values)
+{
+	if (fd)
+		_decode_range_fd(dbc, obj, data, 0, obj->base_size, values);
+	else
+		_decode_range(dbc, obj, data, 0, obj->base_size, values);
+	if (obj->mux==0) return NULL;
+	const can_dbc_signal_t* mux = can_dbc_object_signals(dbc, obj) + (obj->mux-1);
+	if (!_signal_decodable(obj, mux)) return NULL;
+	uint64_t mux_value = can_signal_raw(data, mux);
+	if (mux_value >= obj->pages) return NULL;
+	const can_dbc_page_t* page = &dbc->page_table[obj->page_table + mux_value];
+	if (page->sg_size==0) return NULL;
+	if (fd)
+		_decode_range_fd(dbc, obj, data, page->signals - obj->signals, page->sg_size, values);
+	else
+		_decode_range(dbc, obj, data, page->signals - obj->signals, page->sg_size, values);
+	return page;
+}
+const can_dbc_page_t* can_dbc_decode_mux(const can_dbc_t* dbc, const can_dbc_object_t* obj, const struct can_frame* frame, double* values)
+{
+	struct canfd_frame fd;
+	if (G_UNLIKELY(_object_fd(dbc, obj)))
+		return _decode_mux(dbc, obj, _frame_pad(frame, &fd), TRUE, values);
+	return _decode_mux(dbc, obj, frame->data, FALSE, values);
+}
+/*! \brief разбор кадра CAN FD, до 64 байт данных, см. can_dbc_decode_mux()
+
+	Данные за длиной кадра должны быть заполнены нулями, как в кадрах SocketCAN.
+ */
+const can_dbc_page_t* can_dbc_decode_mux_fd(const can_dbc_t* dbc, const can_dbc_object_t* obj, const struct canfd_frame* frame, double* values)
+{
+	return _decode_mux(dbc, obj, frame->data, _object_fd(dbc, obj), values);
+}
+/*! \brief разбор сообщения, собранного транспортным протоколом J1939 TP
+
+	Сообщение выбирается по PGN; для PDU1 адрес получателя входит в идентификатор.
+	Приоритет передаваемого сообщения в TP не передается, используется приоритет 6.
+	Сигналы разбираются в пределах первых 64 байт сообщения, как в кадре CAN FD, данные
+	за концом сообщения заполнены нулями. Вызывается из функции deliver сборки j1939_tp_recv().
+	\param values - буфер значений, не менее obj->sg_size+3 элементов
+	\return NULL если сообщение не описано в базе
+ */
+const can_dbc_object_t* can_dbc_decode_pg(const can_dbc_t* dbc, uint32_t pgn, uint8_t sa, uint8_t da,
+		const uint8_t* data, uint16_t size, double* values)
+{
+	struct canfd_frame frame = {.can_id = j1939_can_id(6, pgn, da, sa)};
+	const can_dbc_object_t* obj = can_dbc_lookup(dbc, frame.can_id);
+	if (obj==NULL) return NULL;
+	frame.len = size < CANFD_MAX_DLEN? size: CANFD_MAX_DLEN;
+	memcpy(frame.data, data, frame.len);
+	can_dbc_decode_mux_fd(dbc, obj, &frame, values);
+	return obj;
+}
+/*! \brief добавление значений диапазона сигналов в столбцы, сигналы за пределами кадра пропускаются */
+static inline void _columns_append(can_dbc_column_t* col, const can_dbc_signal_t* sg, const double* values, 
+		uint32_t size, uint8_t len, uint32_t row)
+{
+	uint32_t k;
+	for (k=0; k<size; k++, sg++, col++) {
+		if (col->values==NULL || can_signal_bytes(sg) > len) continue;
+		col->values[col->size] = values[k];
+		if (col->rows!=NULL) col->rows[col->size] = row;
+		col->size++;
+	}
+}
+/*! \brief пакетный разбор кадров в столбцы значений сигналов
+
+	Для каждого кадра описание сообщения выбирается по индексу CAN-ID, значения сигналов 
+	сообщения вычисляются can_dbc_decode_mux() и добавляются в столбцы. Из сигналов 
+	мультиплексора разбирается только страница, выбранная значением поля M. Сигналы, 
+	выходящие за длину кадра, пропускаются.
+	\param columns - столбцы по числу сигналов в таблице сигналов dbc->sg_size, 
+		индекс столбца совпадает с индексом сигнала
+	\return число распознанных кадров
+ */
+uint32_t can_dbc_decode(const can_dbc_t* dbc, const struct can_frame* frames, uint32_t n, can_dbc_column_t* columns)
+{
+	double* values = g_new(double, dbc->kernel->max_size + 3);
+	uint32_t i, count = 0;
+	for (i=0; i<n; i++) {
+		const struct can_frame* frame = &frames[i];
+		if (frame->can_id & (CAN_RTR_FLAG|CAN_ERR_FLAG)) continue;
+		const can_dbc_object_t* obj = can_dbc_lookup(dbc, frame->can_id);
+		if (obj==NULL) continue;
+		count++;
+		const can_dbc_page_t* page = can_dbc_decode_mux(dbc, obj, frame, values);
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+		_columns_append(&columns[obj->signals], sg, values, obj->base_size, frame->len, i);
+		if (page!=NULL) {
+			uint32_t first = page->signals - obj->signals;
+			_columns_append(&columns[page->signals], sg + first, values + first, page->sg_size, frame->len, i);
+		}
+	}
+	g_free(values);
+	return count;
+}
+/*! \brief компиляция базы в непрерывные таблицы, упорядоченные по идентификатору
+
+	Сообщения и сигналы копируются в таблицы в арене базы. Разбор кадра затрагивает 
+	описание сообщения и непрерывный диапазон сигналов вместо обхода дерева и списков.
+	\return число сообщений
+ */
+int can_dbc_compile(can_dbc_t* dbc)
+{
+	DbcCompiler_t cc = {0};
+	g_tree_foreach(dbc->objects, _object_count_cb, &cc);
+	uint32_t sg_size = cc.sg_count;
+	uint32_t en_size = cc.en_count;
+	uint32_t bo_size = g_tree_nnodes(dbc->objects);
+	can_dbc_object_t* objects = arena_alloc(&dbc->arena, bo_size*sizeof(can_dbc_object_t));
+	can_dbc_signal_t* signals = arena_alloc(&dbc->arena, sg_size*sizeof(can_dbc_signal_t));
+	can_dbc_enum_t* enums = arena_alloc(&dbc->arena, en_size*sizeof(can_dbc_enum_t));
+	uint32_t pg_size = cc.pg_count;
+	can_dbc_page_t* pages = arena_alloc(&dbc->arena, pg_size*sizeof(can_dbc_page_t));
+	uint32_t nm_size = cc.nm_count;
+	uint32_t* names = arena_alloc(&dbc->arena, nm_size*sizeof(uint32_t));
+	cc.obj = objects;
+	cc.sg  = signals;
+	cc.en  = enums;
+	cc.pg  = pages;
+	cc.nm  = names;
+	cc.sg_count = 0;
+	cc.en_count = 0;
+	cc.pg_count = 0;
+	cc.nm_count = 0;
+	cc.dbc   = dbc;
+	cc.pool  = g_string_new_len("", 1);// смещение 0 -- пустая строка
+	cc.index = g_hash_table_new(NULL, NULL);
+	g_tree_foreach(dbc->objects, _object_compile_cb, &cc);
+	dbc->strings = arena_strndup(&dbc->arena, cc.pool->str, cc.pool->len);
+	dbc->str_size = cc.pool->len;
+	g_string_free(cc.pool, TRUE);
+	g_hash_table_destroy(cc.index);
+	dbc->object_table = objects;
+	dbc->signal_table = signals;
+	dbc->bo_size = bo_size;
+	dbc->sg_size = sg_size;
+	dbc->enum_table = enums;
+	dbc->en_size = en_size;
+	dbc->name_table = names;
+	dbc->nm_size = nm_size;
+	dbc->page_table = pages;
+	dbc->pg_size = pg_size;
+	dbc->index = _index_build(&dbc->arena, objects, bo_size);
+	dbc->kernel = _kernel_build(&dbc->arena, dbc);
+	return bo_size;
+}
+/*! \brief Двоичный образ скомпилированной базы *.dbcb
+
+	Образ содержит таблицы сообщений, сигналов, значений перечислений, индекс CAN-ID 
+	и таблицу строк в том виде, в котором их строит can_dbc_compile(). Таблицы ссылаются 
+	друг на друга индексами и смещениями, указатели не используются, поэтому образ 
+	отображается в память только для чтения без разбора и перемещения, а страницы 
+	отображения разделяются между процессами. Секции выравнены на 8 байт, смещения 
+	заданы от начала образа. Образ привязан к версии формата, порядку байт и раскладке 
+	структур; размер и время изменения исходного файла DBC сохраняются для проверки 
+	актуальности образа.
+ */
+#define CAN_DBC_IMAGE_MAGIC		0x42434244	// "DBCB"
+#define CAN_DBC_IMAGE_VERSION	6
+#define CAN_DBC_IMAGE_LAYOUT	(sizeof(can_dbc_object_t) | sizeof(can_dbc_signal_t)<<8 | sizeof(can_dbc_enum_t)<<16 | sizeof(can_dbc_page_t)<<24)
+typedef struct _DbcImage DbcImage_t;
+struct _DbcImage {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t header_size;
+	uint32_t layout;	//!< размеры записей таблиц
+	uint32_t checksum;	//!< контрольная сумма образа после заголовка
+	uint64_t source_size;	//!< размер исходного файла DBC
+	 int64_t source_mtime;	//!< время изменения исходного файла DBC
+	uint32_t size;		//!< размер образа
+	uint32_t bo_size, sg_size, en_size, pg_size, nm_size;
+	uint32_t str_size, index_size;
+	uint32_t objects, signals, enums, pages, names, strings, index;// смещения секций
+	uint32_t reserved;
+};
+/*! \brief контрольная сумма образа FNV-1a по 32 битным словам, длина кратна 4 */
+static uint32_t _image_checksum(const uint32_t* data, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+	for (i=0; i<len/4; i++)
+		hash = (hash ^ data[i]) * 16777619u;
+	return hash;
+}
+/*! \brief добавить секцию в образ с выравниванием на 8 байт
+	\return смещение секции от начала образа
+ */
+static uint32_t _image_section(GString* image, const void* data, size_t size)
+{
+	static const char pad[8] = {0};
+	uint32_t offset = image->len;
+	g_string_append_len(image, data, size);
+	if (image->len & 7) g_string_append_len(image, pad, 8 - (image->len & 7));
+	return offset;
+}
+/*! \brief размер индекса CAN-ID, включая страницы PDU2 */
+static size_t _index_size(const can_dbc_index_t* index)
+{
+	uint32_t i, n_pages = 0;
+	for (i=0; i<1024; i++)// записи каталога PF>=240 -- номера страниц
+		if ((i & 0xF0)==0xF0 && index->pgn_dir[i]!=0) n_pages++;
+	return sizeof(can_dbc_index_t) + n_pages*sizeof(index->pages[0]);
+}
+/*! \brief запись двоичного образа скомпилированной базы
+	\param source - исходный файл DBC для последующей проверки актуальности образа, может быть NULL
+ */
+gboolean can_dbc_image_save(const can_dbc_t* dbc, const char* filename, const char* source, GError** error)
+{
+	g_return_val_if_fail(dbc->index!=NULL, FALSE);// база должна быть скомпилирована
+	GStatBuf st = {0};
+	if (source!=NULL && g_stat(source, &st)!=0) {
+		int errsv = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", source, g_strerror(errsv));
+		return FALSE;
+	}
+	DbcImage_t hdr = {
+		.magic = CAN_DBC_IMAGE_MAGIC,
+		.version = CAN_DBC_IMAGE_VERSION,
+		.header_size = sizeof(DbcImage_t),
+		.layout = CAN_DBC_IMAGE_LAYOUT,
+		.source_size  = st.st_size,
+		.source_mtime = st.st_mtime,
+		.bo_size = dbc->bo_size,
+		.sg_size = dbc->sg_size,
+		.en_size = dbc->en_size,
+		.pg_size = dbc->pg_size,
+		.nm_size = dbc->nm_size,
+		.str_size = dbc->str_size,
+		.index_size = _index_size(dbc->index),
+	};
+	GString* image = g_string_sized_new(sizeof(DbcImage_t) + hdr.index_size + hdr.str_size
+		+ hdr.bo_size*sizeof(can_dbc_object_t) + hdr.sg_size*sizeof(can_dbc_signal_t) + hdr.en_size*sizeof(can_dbc_enum_t)
+		+ hdr.pg_size*sizeof(can_dbc_page_t) + hdr.nm_size*sizeof(uint32_t));
+	_image_section(image, &hdr, sizeof(DbcImage_t));
+	hdr.index   = _image_section(image, dbc->index, hdr.index_size);
+	hdr.objects = _image_section(image, dbc->object_table, hdr.bo_size*sizeof(can_dbc_object_t));
+	hdr.signals = _image_section(image, dbc->signal_table, hdr.sg_size*sizeof(can_dbc_signal_t));
+	hdr.enums   = _image_section(image, dbc->enum_table,   hdr.en_size*sizeof(can_dbc_enum_t));
+	hdr.pages   = _image_section(image, dbc->page_table,   hdr.pg_size*sizeof(can_dbc_page_t));
+	hdr.names   = _image_section(image, dbc->name_table,   hdr.nm_size*sizeof(uint32_t));
+	hdr.strings = _image_section(image, dbc->strings, hdr.str_size);
+	hdr.size = image->len;
+	hdr.checksum = _image_checksum((const uint32_t*)(image->str + sizeof(DbcImage_t)), image->len - sizeof(DbcImage_t));
+	memcpy(image->str, &hdr, sizeof(DbcImage_t));
+	gboolean res = g_file_set_contents(filename, image->str, image->len, error);
+	g_string_free(image, TRUE);
+	return res;
+}
+/*! \brief проверка заголовка и границ секций образа */
+static const char* _image_check(const DbcImage_t* hdr, size_t size)
+{
+	if (size < sizeof(DbcImage_t) || hdr->magic!=CAN_DBC_IMAGE_MAGIC) 
+		return "not a DBC image";
+	if (hdr->version!=CAN_DBC_IMAGE_VERSION || hdr->header_size!=sizeof(DbcImage_t) 
+	 || hdr->layout!=CAN_DBC_IMAGE_LAYOUT)
+		return "unsupported image version";
+	if (hdr->size!=size
+	 || hdr->index   + (uint64_t)hdr->index_size > size || hdr->index_size < sizeof(can_dbc_index_t)
+	 || hdr->objects + (uint64_t)hdr->bo_size*sizeof(can_dbc_object_t) > size
+	 || hdr->signals + (uint64_t)hdr->sg_size*sizeof(can_dbc_signal_t) > size
+	 || hdr->enums   + (uint64_t)hdr->en_size*sizeof(can_dbc_enum_t)   > size
+	 || hdr->pages   + (uint64_t)hdr->pg_size*sizeof(can_dbc_page_t)   > size
+	 || hdr->names   + (uint64_t)hdr->nm_size*sizeof(uint32_t)         > size
+	 || hdr->strings + (uint64_t)hdr->str_size > size || hdr->str_size==0)
+		return "truncated image";
+	if (hdr->checksum != _image_checksum((const uint32_t*)(hdr+1), size - sizeof(DbcImage_t)))
+		return "checksum mismatch";
+	return NULL;
+}
+/*! \brief проверка индекса CAN-ID образа: номера сообщений и страниц PDU2 в пределах таблиц */
+static gboolean _image_check_index(const can_dbc_index_t* index, uint32_t index_size, uint32_t bo_size)
+{
+	if ((index_size - sizeof(can_dbc_index_t)) % sizeof(index->pages[0])!=0) return FALSE;
+	const uint32_t n_pages = (index_size - sizeof(can_dbc_index_t))/sizeof(index->pages[0]);
+	uint32_t i, k, count = 0;
+	for (i=0; i<=CAN_SFF_MASK; i++)
+		if (index->sff[i]>bo_size && index->sff[i]!=CAN_DBC_INDEX_AMBIGUOUS) return FALSE;
+	for (i=0; i<1024; i++) {
+		const uint16_t n = index->pgn_dir[i];
+		if ((i & 0xF0)!=0xF0) {// PDU1 -- сообщение
+			if (n>bo_size && n!=CAN_DBC_INDEX_AMBIGUOUS) return FALSE;
+		} else if (n!=0) {// PDU2 -- страница
+			if (n>n_pages) return FALSE;
+			count++;
+		}
+	}
+	if (count!=n_pages) return FALSE;
+	for (i=0; i<n_pages; i++)
+		for (k=0; k<256; k++)
+			if (index->pages[i][k]>bo_size && index->pages[i][k]!=CAN_DBC_INDEX_AMBIGUOUS) return FALSE;
+	return TRUE;
+}
+/*! \brief проверка ссылок между таблицами образа
+	
+	Индексы сигналов, значений перечислений, страниц и смещения строк, записанные в таблицах,
+	должны оставаться в пределах соответствующих таблиц: образ отображается в память без 
+	копирования, и разбор кадров использует эти индексы без проверок.
+ */
+static const char* _image_check_tables(const DbcImage_t* hdr, const char* data)
+{
+	const can_dbc_object_t* objects = (const can_dbc_object_t*)(data + hdr->objects);
+	const can_dbc_signal_t* signals = (const can_dbc_signal_t*)(data + hdr->signals);
+	const can_dbc_enum_t* enums = (const can_dbc_enum_t*)(data + hdr->enums);
+	const can_dbc_page_t* pages = (const can_dbc_page_t*)(data + hdr->pages);
+	const uint32_t* names = (const uint32_t*)(data + hdr->names);
+	const uint32_t str_size = hdr->str_size;
+	uint32_t i, k;
+	if (data[hdr->strings + str_size - 1]!='\0')
+		return "unterminated string table";
+	for (i=0; i<hdr->bo_size; i++) {
+		const can_dbc_object_t* obj = &objects[i];
+		if (obj->name >= str_size
+		 || obj->signals + (uint64_t)obj->sg_size > hdr->sg_size 
+		 || obj->base_size > obj->sg_size || obj->mux > obj->sg_size
+		 || obj->page_table + (uint64_t)obj->pages > hdr->pg_size)
+			return "message out of range";
+		for (k=obj->page_table; k<obj->page_table + obj->pages; k++)
+			if (pages[k].sg_size!=0 && (pages[k].signals < obj->signals 
+			 || pages[k].signals + (uint64_t)pages[k].sg_size > obj->signals + obj->sg_size))
+				return "page out of range";
+	}
+	for (i=0; i<hdr->sg_size; i++) {
+		const can_dbc_signal_t* sg = &signals[i];
+		if (sg->name >= str_size || sg->units >= str_size 
+		 || sg->len > 64 || can_signal_bytes(sg) > CANFD_MAX_DLEN || sg->type >= G_N_ELEMENTS(names_type)
+		 || sg->enums + (uint64_t)sg->en_size > hdr->en_size
+		 || sg->en_names + (uint64_t)sg->en_range > hdr->nm_size
+		 || (sg->en_range!=0 && sg->en_size==0))
+			return "signal out of range";
+	}
+	for (i=0; i<hdr->en_size; i++)
+		if (enums[i].name >= str_size) return "enum out of range";
+	for (i=0; i<hdr->nm_size; i++)
+		if (names[i] >= str_size) return "enum out of range";
+	if (!_image_check_index((const can_dbc_index_t*)(data + hdr->index), hdr->index_size, hdr->bo_size))
+		return "index out of range";
+	return NULL;
+}
+/*! \brief загрузка двоичного образа скомпилированной базы
+
+	Образ отображается в память только для чтения, таблицы базы ссылаются на отображение.
+	Разбор текста и компиляция не выполняются, дерево сообщений базы остается пустым.
+	\param source - исходный файл DBC; если задан, образ действителен только при совпадении 
+		размера и времени изменения исходного файла, иначе возвращается CAN_DBC_ERROR_STALE
+ */
+gboolean can_dbc_image_load(can_dbc_t* dbc, const char* filename, const char* source, GError** error)
+{
+	g_return_val_if_fail(dbc->mapped==NULL, FALSE);
+	GMappedFile* mapped = g_mapped_file_new(filename, FALSE, error);
+	if (mapped==NULL) return FALSE;
+	const char* data = g_mapped_file_get_contents(mapped);
+	const DbcImage_t* hdr = (const DbcImage_t*)data;
+	size_t size = g_mapped_file_get_length(mapped);
+	gint code = CAN_DBC_ERROR_IMAGE;
+	const char* msg = _image_check(hdr, size);
+	if (msg==NULL) msg = _image_check_tables(hdr, data);
+	if (msg==NULL && source!=NULL) {
+		GStatBuf st;
+		if (g_stat(source, &st)!=0 || (uint64_t)st.st_size!=hdr->source_size || (int64_t)st.st_mtime!=hdr->source_mtime) {
+			code = CAN_DBC_ERROR_STALE;
+			msg = "image is out of date";
+		}
+	}
+	if (msg!=NULL) {
+		g_set_error(error, CAN_DBC_ERROR, code, "%s: %s", filename, msg);
+		g_mapped_file_unref(mapped);
+		return FALSE;
+	}
+	dbc->mapped = mapped;
+	dbc->index = (const can_dbc_index_t*)(data + hdr->index);
+	dbc->object_table = (const can_dbc_object_t*)(data + hdr->objects);
+	dbc->signal_table = (const can_dbc_signal_t*)(data + hdr->signals);
+	dbc->enum_table   = (const can_dbc_enum_t*)  (data + hdr->enums);
+	dbc->strings = data + hdr->strings;
+	dbc->str_size = hdr->str_size;
+	dbc->bo_size = hdr->bo_size;
+	dbc->sg_size = hdr->sg_size;
+	dbc->en_size = hdr->en_size;
+	dbc->page_table = (const can_dbc_page_t*)(data + hdr->pages);
+	dbc->pg_size = hdr->pg_size;
+	dbc->name_table = (const uint32_t*)(data + hdr->names);
+	dbc->nm_size = hdr->nm_size;
+	dbc->kernel = _kernel_build(&dbc->arena, dbc);
+	return TRUE;
+}
 #if 0
 int can_dbc_debug(struct can_frame *frame, can_dbc_t* dbc,  GError* err)
 {
@@ -524,36 +1403,54 @@ int can_dbc_debug(struct can_frame *frame, can_dbc_t* dbc,  GError* err)
 	return 0;
 }
 #endif//_
+/*! \brief сдвиг младшего бита сигнала в слове данных, \see can_signal_shift() */
+static int _sg_shift(const can_dbc_sg_t* sg)
+{
+	const can_dbc_signal_t s = {.pos = sg->pos, .len = sg->len, .byte_order = sg->byte_order};
+	return can_signal_shift(&s);
+}
+/*! \brief смещение слова данных сигнала в кадре, \see can_signal_offset() */
+static int _sg_offset(const can_dbc_sg_t* sg)
+{
+	const can_dbc_signal_t s = {.pos = sg->pos, .len = sg->len, .byte_order = sg->byte_order};
+	return can_signal_offset(&s);
+}
 static gboolean _object_define_print_cb(  gpointer key,  gpointer value,  gpointer user_data  )
 {
-	can_dbc_object_t* obj = value;
+	can_dbc_bo_t* obj = value;
 	GString* str = user_data;
 	if (obj->sg_list==NULL) return FALSE;
-	GSList* sg_list = obj->sg_list;
-	while (sg_list){
-		can_dbc_signal_t *sg = sg_list->data;
+	can_dbc_sg_t* sg = obj->sg_list;
+	for (; sg!=NULL; sg = sg->next){
 		const char *name = g_quark_to_string(sg->name_id);
-		if (sg->comment!=NULL)
-			g_string_append_printf(str, "/*! %s \n */\n", sg->comment);
+		if (sg->comment.len!=0)
+			g_string_append_printf(str, "/*! %.*s \n */\n", sg->comment.len, sg->comment.str);
 
 //		g_string_append_printf(str, "#define %s_Name  \t\"%s\"\n", name, name);
-		g_string_append_printf(str, "#define %s_Pos   \t%d\n", name, sg->pos);
-//		g_string_append_printf(str, "#define %s_Msk   \t0x%016llXULL\n", name, (~0ULL)>>(64-sg->len)<<sg->pos);
+		g_string_append_printf(str, "#define %s_Type  \t%s\n", name, names_type[sg->type]);
+		g_string_append_printf(str, "#define %s_Start \t%d\n", name, sg->pos);
+		if (sg->len!=0 && _sg_shift(sg)>=0) {// позиция и маска в слове little-endian для Intel, big-endian для Motorola
+			g_string_append_printf(str, "#define %s_Pos   \t%d\n", name, _sg_shift(sg));
+			if (_sg_offset(sg)!=0)// CAN FD: слово данных по смещению, байт
+			g_string_append_printf(str, "#define %s_Offs  \t%d\n", name, _sg_offset(sg));
+			g_string_append_printf(str, "#define %s_Msk   \t0x%016llXULL\n", name, (~0ULL)>>(64-sg->len)<<_sg_shift(sg));
+		}
 		g_string_append_printf(str, "#define %s_Bits  \t%d\n", name, sg->len);
 		g_string_append_printf(str, "#define %s_Factor\t%g\n", name, sg->factor);
 		g_string_append_printf(str, "#define %s_Offset\t%g\n", name, sg->offset);
+		g_string_append_printf(str, "#define %s_Min   \t%g\n", name, sg->min);
+		g_string_append_printf(str, "#define %s_Max   \t%g\n", name, sg->max);
 		if (1){//sg->units!=0
 			const char* units = (sg->units!=0)?g_quark_to_string(sg->units):"";
 			g_string_append_printf(str, "#define %s_Units\t\"%s\"\n", name, units);
 		}
 		g_string_append_c(str, '\n');
-		sg_list = sg_list->next;
 	}
 	return FALSE;
 }
 static gboolean _object_struct_print_cb(  gpointer key,  gpointer value,  gpointer user_data  )
 {
-	can_dbc_object_t* obj = value;
+	can_dbc_bo_t* obj = value;
 	if (obj->sg_list==NULL) return FALSE;
 	const char* name = g_quark_to_string(obj->name_id);
 
@@ -563,10 +1460,9 @@ static gboolean _object_struct_print_cb(  gpointer key,  gpointer value,  gpoint
 	int i;
 	int offset=0;
 	//for (i=0; i< obj->sg_size; i++) 
-	GSList* sg_list = obj->sg_list;
-	while (sg_list){
-		//can_dbc_signal_t *sg = &obj->signals[i];
-		can_dbc_signal_t *sg = sg_list->data;
+	can_dbc_sg_t* sg = obj->sg_list;
+	for (; sg!=NULL; sg = sg->next){
+		//can_dbc_sg_t *sg = &obj->signals[i];
 		const char *type = names_type[sg->type];
 		const char *name = g_quark_to_string(sg->name_id);
 		if (offset<sg->pos) {
@@ -581,63 +1477,273 @@ static gboolean _object_struct_print_cb(  gpointer key,  gpointer value,  gpoint
 			sg->len, sg->pos, sg->pos+sg->len-1);
 		if (sg->mux_idx>=0)
 			g_string_append_printf((GString*) user_data, "m%d:", sg->mux_idx);
-		if (0 && sg->comment!=NULL)
-			g_string_append_printf((GString*) user_data, "%s", sg->comment);
+		if (0 && sg->comment.len!=0)
+			g_string_append_printf((GString*) user_data, "%.*s", sg->comment.len, sg->comment.str);
 		g_string_append((GString*) user_data, "*/\n");
 		offset += sg->len;
-		sg_list = sg_list->next;
 	}
 	g_string_append((GString*) user_data, "};\n\n");
 	return FALSE;
 }
-/*! \brief преобразование мультиплексора в таблицу смещений (синтез кода) */
-static void _object_mux_offset_print_cb( GQuark key_id, gpointer data, gpointer user_data)
-{
-	GSList* list = data;
-	GString* str = user_data;
-	g_string_append_printf(str, "Multiplexor_t _%s[] = {", g_quark_to_string(key_id));
-	while (list){
-		Multiplexor_t* entry = list->data;
-		g_string_append_printf(str, " {%d,%d},", entry->mux, entry->offset);
-		list = list->next;
-	}
-	g_string_append (str, "};\n");
-}
 /*! \brief преобразование значений констант в ассоциативный массив (синтез кода) */
-static void _object_key_value_print_cb( GQuark key_id, gpointer data, gpointer user_data)
+/*! \brief таблица имен перечисления и функция <Signal>_Name()
+
+	Плотное перечисление выводится прямой таблицей с индексом val - min, 
+	разреженное -- упорядоченными массивами значений и имен с бинарным поиском.
+ */
+static void _object_key_value_print_cb( GQuark key_id, const Enum_t* entry, GString* str)
 {
-	GSList* list = data;
-	GString* str = user_data;
-	g_string_append_printf(str, "Names_t _%s[] = {\n", g_quark_to_string(key_id));
-	while (list){
-		Enum_t* entry = list->data;
-		g_string_append_printf(str, "  {%2d, \"%s\"},\n", entry->val, 
-			g_quark_to_string(entry->key));
-		list = list->next;
+	const char* name = g_quark_to_string(key_id);
+	const Enum_t* list = entry;
+	uint32_t range = _enum_range(entry);
+	int64_t min = entry->val;
+	if (range!=0) {
+		g_string_append_printf(str, "static const char* const %s_Names[%u] = {\n", name, range);
+		for (; entry!=NULL; entry = entry->next)
+			g_string_append_printf(str, "\t[%2u] = \"%s\",\n", (uint32_t)(entry->val - min), 
+				g_quark_to_string(entry->key));
+		g_string_append (str, "};\n");
+		g_string_append_printf(str, "static inline const char* %s_Name(int64_t val) {\n", name);
+		if (min==0)
+			g_string_append (str, "\tuint64_t idx = val;\n");
+		else
+			g_string_append_printf(str, "\tuint64_t idx = (uint64_t)val - %" G_GUINT64_FORMAT "u;\n", (uint64_t)min);
+		g_string_append_printf(str, "\treturn idx < %u? %s_Names[idx]: NULL;\n}\n", range, name);
+		return;
 	}
+	uint32_t count = 0;
+	g_string_append_printf(str, "static const int64_t %s_Values[] = {", name);
+	for (; entry!=NULL; entry = entry->next, count++) {
+		if (entry->val==INT64_MIN)// -9223372036854775808 не является константой типа int64_t
+			g_string_append_printf(str, "%sINT64_MIN", count? ", ": "");
+		else
+			g_string_append_printf(str, "%s%" G_GINT64_FORMAT, count? ", ": "", (gint64)entry->val);
+	}
+	g_string_append_printf(str, "};\nstatic const char* const %s_Names[] = {\n", name);
+	for (entry = list; entry!=NULL; entry = entry->next)
+		g_string_append_printf(str, "\t\"%s\",\n", g_quark_to_string(entry->key));
 	g_string_append (str, "};\n");
+	g_string_append_printf(str, "static inline const char* %s_Name(int64_t val) {\n"
+		"\tconst int64_t* v = %s_Values;\n"
+		"\tuint32_t n = %u;\n"
+		"\twhile (n > 1) {\n"
+		"\t\tuint32_t half = n>>1;\n"
+		"\t\tv = (v[half] <= val)? v + half: v;\n"
+		"\t\tn -= half;\n"
+		"\t}\n"
+		"\treturn *v==val? %s_Names[v - %s_Values]: NULL;\n}\n", name, name, count, name, name);
 }
-/*! \brief генерация типов заданных перечислением блоков */
 static gboolean _object_enums_print_cb(  gpointer key,  gpointer value,  gpointer user_data  )
 {
-	can_dbc_object_t* obj = value;
+	can_dbc_bo_t* obj = value;
 	GString* str = user_data;
 	g_string_append_printf(str, "/* obj = %u %s */\n", GPOINTER_TO_UINT(key), g_quark_to_string(obj->name_id));
-	g_datalist_foreach(&obj->enums, _object_key_value_print_cb, str);
+	can_dbc_sg_t* sg = obj->sg_list;
+	for (; sg!=NULL; sg = sg->next)
+		if (sg->enums!=NULL) _object_key_value_print_cb(sg->name_id, sg->enums, str);
 	return FALSE;
 }
 /*! \brief генерация перечисления блоков */
 static gboolean _object_enumerate_print_cb(  gpointer key,  gpointer value,  gpointer user_data  )
 {
-	can_dbc_object_t* obj = value;
+	can_dbc_bo_t* obj = value;
 	GString* str = user_data;
 	g_string_append_printf(str, "\tBO_%-20s\t=0x%X,", 
 			g_quark_to_string(obj->name_id), GPOINTER_TO_UINT(key)/* & 0x1FFFF */);
-	if (obj->comment) 
-		g_string_append_printf(str, "\t/*!< %s */", obj->comment);
+	if (obj->comment.len!=0) 
+		g_string_append_printf(str, "\t/*!< %.*s */", obj->comment.len, obj->comment.str);
 	g_string_append_c(str,'\n');
 	return FALSE;
 }
+/*! \brief вещественная константа Си двойной точности, не зависит от локали */
+static const char* _float_literal(char* buf, float value)
+{
+	g_ascii_formatd(buf, G_ASCII_DTOSTR_BUF_SIZE-2, "%.8g", value);
+	if (strpbrk(buf, ".eEn")==NULL) strcat(buf, ".0");
+	return buf;
+}
+/*! \brief сигнал мультиплексора сообщения, NULL если сообщение не мультиплексировано */
+static const can_dbc_sg_t* _object_mux(const can_dbc_bo_t* obj)
+{
+	const can_dbc_sg_t* sg = obj->sg_list;
+	for (; sg!=NULL; sg = sg->next)
+		if (sg->mux && sg->mux_idx<0) return sg;
+	return NULL;
+}
+/*! \brief сигнал может быть разобран функциями кодирования: длина 1..64 бит в пределах 8 байт 
+	от смещения слова данных сигнала */
+static inline gboolean _sg_codec(const can_dbc_sg_t* sg, const can_dbc_sg_t* mux)
+{
+	return sg->len!=0 && _sg_shift(sg)>=0 && (sg->mux_idx<0 || mux!=NULL);
+}
+/*! \brief выражение для выделения сигнала из слова данных le/be без масштабирования,
+	для сигналов CAN FD за 8 байтом -- из слова, прочитанного по смещению сигнала
+ */
+static void _sg_raw_print(GString* str, const can_dbc_sg_t* sg)
+{
+	uint64_t mask = (~0ULL)>>(64-sg->len);
+	char word[32];
+	const char* w = sg->byte_order? "le": "be";
+	if (_sg_offset(sg)!=0) {
+		snprintf(word, sizeof(word), "can_get_%s64(data + %d)", w, _sg_offset(sg));
+		w = word;
+	}
+	if (sg->type==_TYPE_INTEGER && sg->len<64) {
+		uint64_t sign = 1ULL<<(sg->len-1);
+		g_string_append_printf(str, "((int64_t)(((%s >> %d) & 0x%llXULL) ^ 0x%llXULL) - 0x%llXLL)", 
+			w, _sg_shift(sg), (unsigned long long)mask, (unsigned long long)sign, (unsigned long long)sign);
+	} else 
+	if (sg->type==_TYPE_INTEGER)
+		g_string_append_printf(str, "(int64_t)(%s >> %d)", w, _sg_shift(sg));
+	else
+		g_string_append_printf(str, "((%s >> %d) & 0x%llXULL)", w, _sg_shift(sg), (unsigned long long)mask);
+}
+/*! \brief отступ строки сигнала, страницы мультиплексора -- ветви switch по значению M
+
+	Сигналы упорядочены по номеру страницы, компилятор строит по switch таблицу переходов.
+	\param sg - очередной сигнал, NULL -- завершение switch
+	\return номер текущей страницы, -1 вне switch
+ */
+static int _mux_case_print(GString* str, const can_dbc_sg_t* sg, int page)
+{
+	if (sg==NULL) {
+		if (page>=0) g_string_append(str, "\t\tbreak;\n\tdefault: break;\n\t}\n");
+		return -1;
+	}
+	if (sg->mux_idx<0) {
+		g_string_append_c(str, '\t');
+		return page;
+	}
+	if (page<0) 
+		g_string_append(str, "\tswitch (mux) {\n");
+	else if (page!=sg->mux_idx)
+		g_string_append(str, "\t\tbreak;\n");
+	if (page!=sg->mux_idx)
+		g_string_append_printf(str, "\tcase %d:\n", sg->mux_idx);
+	g_string_append(str, "\t\t");
+	return sg->mux_idx;
+}
+/*! \brief тип поля физического значения сигнала
+
+	Целые сигналы без масштаба (1,0) хранятся целым типом по длине и знаку, чтобы счетчики 
+	длиннее 24 бит не округлялись, остальные -- в double, как в can_dbc_decode_frame().
+	\return NULL для значения double
+ */
+static const char* _sg_int_type(const can_dbc_sg_t* sg)
+{
+	static const char* const types[2][4] = {
+		{"uint8_t", "uint16_t", "uint32_t", "uint64_t"},
+		{ "int8_t",  "int16_t",  "int32_t",  "int64_t"}};
+	if (sg->factor!=1.0f || sg->offset!=0.0f) return NULL;
+	if (sg->type!=_TYPE_UNSIGNED && sg->type!=_TYPE_INTEGER) return NULL;
+	int idx = sg->len<=8? 0: sg->len<=16? 1: sg->len<=32? 2: 3;
+	return types[sg->type==_TYPE_INTEGER][idx];
+}
+/*! \brief выражение для кодирования физического значения сигнала без сдвига */
+static void _sg_encode_print(GString* str, const can_dbc_sg_t* sg)
+{
+	char f[G_ASCII_DTOSTR_BUF_SIZE], o[G_ASCII_DTOSTR_BUF_SIZE];
+	const char* name = g_quark_to_string(sg->name_id);
+	if (_sg_int_type(sg)!=NULL) {
+		g_string_append_printf(str, "((uint64_t)v->%s & 0x%llXULL)", name, (unsigned long long)((~0ULL)>>(64-sg->len)));
+		return;
+	}
+	g_string_append(str, "((uint64_t)can_dbc_round(");
+	if (sg->offset!=0.0f)
+		g_string_append_printf(str, sg->factor!=1.0f? "(v->%s %c %s)": "v->%s %c %s", 
+			name, sg->offset<0? '+': '-', _float_literal(o, fabsf(sg->offset)));
+	else
+		g_string_append_printf(str, "v->%s", name);
+	if (sg->factor!=1.0f)
+		g_string_append_printf(str, " / %s", _float_literal(f, sg->factor));
+	g_string_append_printf(str, ") & 0x%llXULL)", (unsigned long long)((~0ULL)>>(64-sg->len)));
+}
+/*! \brief генерация функций разбора и кодирования сообщения
+
+	Для каждого сообщения BO_ создается структура физических значений сигналов и функции 
+	_decode/_encode, в которые подставлены сдвиги, маски и масштаб каждого сигнала. 
+	Сигналы мультиплексора разбираются по значению поля M в ветвях switch. Сигналы CAN FD
+	за 8 байтом выделяются из слова, прочитанного по смещению сигнала, и кодируются 
+	добавлением в слово по смещению, данные сообщения предварительно обнуляются.
+ */
+static gboolean _object_codec_print_cb(  gpointer key,  gpointer value,  gpointer user_data  )
+{
+	can_dbc_bo_t* obj = value;
+	GString* str = user_data;
+	if (obj->sg_list==NULL) return FALSE;
+	const char* name = g_quark_to_string(obj->name_id);
+	const can_dbc_sg_t* mux = _object_mux(obj);
+	const can_dbc_sg_t* sg;
+	char f[G_ASCII_DTOSTR_BUF_SIZE], o[G_ASCII_DTOSTR_BUF_SIZE];
+	gboolean le = FALSE, be = FALSE;
+	int page = -1, size = 0;
+	
+	g_string_append_printf(str, "typedef struct _%s_Value %s_Value_t;\n", name, name);
+	g_string_append_printf(str, "struct _%s_Value {\n", name);
+	for (sg = obj->sg_list; sg!=NULL; sg = sg->next){
+		if (!_sg_codec(sg, mux)) continue;
+		const char* type = _sg_int_type(sg);
+		g_string_append_printf(str, "\t%s %s;\n", type? type: "double", g_quark_to_string(sg->name_id));
+		if (_sg_offset(sg)!=0) size = MAX(size, _sg_offset(sg) + 8);
+		else if (sg->byte_order) le = TRUE; else be = TRUE;
+	}
+	g_string_append(str, "};\n");
+	
+	g_string_append_printf(str, "static inline void %s_decode(const uint8_t* data, %s_Value_t* v)\n{\n", name, name);
+	if (le) g_string_append(str, "\tconst uint64_t le = can_get_le64(data);\n");
+	if (be) g_string_append(str, "\tconst uint64_t be = can_get_be64(data);\n");
+	if (mux) {
+		g_string_append(str, "\tconst uint64_t mux = ");
+		_sg_raw_print(str, mux);
+		g_string_append(str, ";\n");
+	}
+	for (sg = obj->sg_list; sg!=NULL; sg = sg->next){
+		if (!_sg_codec(sg, mux)) continue;
+		page = _mux_case_print(str, sg, page);
+		const char* type = _sg_int_type(sg);
+		g_string_append_printf(str, "v->%s = (%s)", g_quark_to_string(sg->name_id), type? type: "double");
+		_sg_raw_print(str, sg);
+		if (sg->factor!=1.0f)
+			g_string_append_printf(str, " * %s", _float_literal(f, sg->factor));
+		if (sg->offset!=0.0f)
+			g_string_append_printf(str, " %c %s", sg->offset<0? '-': '+', _float_literal(o, fabsf(sg->offset)));
+		g_string_append(str, ";\n");
+	}
+	_mux_case_print(str, NULL, page);
+	g_string_append(str, "}\n");
+	
+	g_string_append_printf(str, "static inline void %s_encode(uint8_t* data, const %s_Value_t* v)\n{\n", name, name);
+	page = -1;
+	g_string_append(str, "\tuint64_t le = 0, be = 0;\n");
+	if (size!=0) 
+		g_string_append_printf(str, "\tmemset(data, 0, %d);\n", size);
+	if (mux) {
+		g_string_append(str, "\tconst uint64_t mux = ");
+		_sg_encode_print(str, mux);
+		g_string_append(str, ";\n");
+	}
+	for (sg = obj->sg_list; sg!=NULL; sg = sg->next){
+		if (!_sg_codec(sg, mux)) continue;
+		page = _mux_case_print(str, sg, page);
+		const int at = _sg_offset(sg);
+		const char* w = sg->byte_order? "le": "be";
+		if (at!=0)
+			g_string_append_printf(str, "can_put_%s64(data + %d, can_get_%s64(data + %d) | ", w, at, w, at);
+		else
+			g_string_append_printf(str, "%s |= ", w);
+		if (sg==mux) 
+			g_string_append(str, "mux");
+		else
+			_sg_encode_print(str, sg);
+		g_string_append_printf(str, at!=0? " << %d);\n": " << %d;\n", _sg_shift(sg));
+	}
+	_mux_case_print(str, NULL, page);
+	if (size!=0)
+		g_string_append(str, "\tcan_put_le64(data, can_get_le64(data) | le | can_bswap64(be));\n}\n\n");
+	else
+		g_string_append(str, "\tcan_put_le64(data, le | can_bswap64(be));\n}\n\n");
+	return FALSE;
+}
 /*! \brief генерация исходников */
 GString* can_dbc_gen_header(can_dbc_t *dbc, const char* filename)
 {
@@ -648,7 +1754,7 @@ GString* can_dbc_gen_header(can_dbc_t *dbc, const char* filename)
 	str = g_string_append (str, header);
 	str = g_string_append (str, "\n#define _");
 	str = g_string_append (str, header);
-	str = g_string_append (str, "\n\n");
+	str = g_string_append (str, "\n\n#include <string.h>\n#include \"can_ev.h\"\n");
 
 	str = g_string_append (str, "\nenum BU_ {\n");
 	for (i=0; i< dbc->bu_size; i++){
@@ -669,6 +1775,9 @@ GString* can_dbc_gen_header(can_dbc_t *dbc, const char* filename)
 	str = g_string_append (str, "/* Messages */\n");
 	g_tree_foreach (dbc->objects, _object_struct_print_cb, str);
 
+	str = g_string_append (str, "/* Decoders and encoders */\n");
+	g_tree_foreach (dbc->objects, _object_codec_print_cb, str);
+
 	str = g_string_append (str, "\n#endif//_");
 	str = g_string_append (str, header);
 	str = g_string_append (str, "\n");
@@ -676,23 +1785,18 @@ GString* can_dbc_gen_header(can_dbc_t *dbc, const char* filename)
 	return str;
 }
 
-/*! \brief разбор формата */
-int can_dbc_parse(char *buf, int size, can_dbc_t *dbc)
-{
-//	GSList_t **tail = &dbc->value.list;
-	char* str = buf;
-	while(isspace(str[0])) str++;
-	char ch = *str++;
-	while(ch!='\0') {
-		
+/*! \brief кварк из фрагмента текста, текст не изменяется */
+static GQuark _id(const char* s, int len){
+	if (len==0) return 0;
+	char buf[128];
+	if (len < (int)sizeof(buf)) {
+		memcpy(buf, s, len);
+		buf[len] = '\0';
+		return g_quark_from_string(buf);
 	}
-	return size;
-}
-static GQuark _id(char* s, int len){
-	char ch = s[len];
-	s[len] = '\0';
-	GQuark id = g_quark_from_string(s);
-	s[len] = ch;
+	char* str = g_strndup(s, len);
+	GQuark id = g_quark_from_string(str);
+	g_free(str);
 	return id;
 }
 
@@ -700,39 +1804,24 @@ static GQuark _id(char* s, int len){
  */
 #include <locale.h>
 
-typedef struct _MainOptions MainOptions;
-struct _MainOptions {
-    gchar *  input_file;
-    gchar * output_file;
-    gchar * config_file;
-    gboolean rbit;
-    gboolean verbose;
-};
-static MainOptions options = {
-    .input_file = NULL, // подписка по опросу устройств
-    .output_file = "test.h",
-    .rbit = FALSE,
-    .verbose = FALSE,
-};
-static GOptionEntry entries[] =
-{
-  { "input",    'i', 0, G_OPTION_ARG_FILENAME,  &options.input_file,    "input  file name",  "*.dbc" },
-  { "config",   'c', 0, G_OPTION_ARG_FILENAME,  &options.config_file,   "DBC file name", "*.dbc" },
-  { "output",   'o', 0, G_OPTION_ARG_FILENAME,  &options.output_file,   "output file name", "*.json|*.pcap|*.sql" },
-  { "rbit",  	'r', 0, G_OPTION_ARG_NONE,      &options.rbit,       	"Reverse bit order",       NULL },
-  { "verbose",  'v', 0, G_OPTION_ARG_NONE,      &options.verbose,       "Be verbose",       NULL },
-  { NULL }
-};
-/*! \brief разбор строки */
-static char* _char_string (char* s, char** comment, int * len) {
+/*! \brief пропуск пробелов, разбор не выходит за пределы строки */
+static inline char* _blank(char* s) {
+	while (s[0]==' ' || s[0]=='\t' || s[0]=='\r') s++;
+	return s;
+}
+/*! \brief разбор строки, строка может занимать несколько строк текста 
+	\param end - граница текста
+ */
+static char* _char_string (char* s, char* end, char** comment, int * len) {
 	if (s[0]=='"' && (s[1]!='"'&& s[1]!='\0')){
 		s++;
-		char* str = s++;
-		while (s[0]!='"' && s[0]!='\0') s++;
+		char* str = s;
+		char* q = memchr(s, '"', end - s);
+		if (q==NULL) q = end;
 		*comment = str;
-		*len = s - str;
-		s++;
-		while (isspace(s[0])) s++;
+		*len = q - str;
+		s = q;
+		if (s<end) s = _blank(s+1);
 	}
 	return s;
 }
@@ -743,7 +1832,7 @@ static char* _c_identifier(char* s, char** name, int * len) {
 		while (isalnum(s[0]) || s[0]=='_') s++;
 		*name= str;
 		*len = s - str;
-		while (isspace(s[0])) s++;
+		s = _blank(s);
 	}
 	return s;
 }
@@ -751,47 +1840,145 @@ static char* _c_identifier(char* s, char** name, int * len) {
 static char* _cob_id(char* s, uint32_t* cob_id) {
 	if (isdigit(s[0])){
 		*cob_id = strtoul(s, &s, 10);
-		while(isspace(s[0]))s++;
+		s = _blank(s);
 	}
 	return s;
 }
-/*! \brief поиск сигнала по идентификатору */
-static can_dbc_signal_t* _signal_lookup(GSList* sg_list, GQuark id){
-	while (sg_list){
-		can_dbc_signal_t* sig = sg_list->data;
-		if (sig->name_id == id) return sig;
-		sg_list = sg_list->next;
+/*! \brief разбор числа с плавающей точкой, strtof не должен пропускать перевод строки */
+static char* _float(char* s, float* value) {
+	if (isdigit(s[0]) || s[0]=='-' || s[0]=='+' || s[0]=='.'){
+		*value = strtof(s, &s);
 	}
-	return NULL;
+	return s;
 }
-
-int main (int argc, char*argv[])
+#define NEXT(p) (*(void**)((char*)(p) + next))
+/*! \brief устойчивая сортировка слиянием односвязного списка
+	\param next - смещение указателя на следующий элемент в структуре
+ */
+static void* _list_sort(void* list, size_t next, GCompareFunc cmp)
 {
-    setlocale(LC_ALL, "");
-    setlocale(LC_NUMERIC, "C");
-    GError* error = NULL;
-    GOptionContext *context;
-    context = g_option_context_new ("- command line interface");
-    g_option_context_add_main_entries (context, entries, NULL/*GETTEXT_PACKAGE*/);
-    if (!g_option_context_parse (context, &argc, &argv, &error))
-    {
-        g_print ("option parsing failed: %s\n", error->message);
-        exit (1);
-    }
-    g_option_context_free (context);
+	if (list==NULL || NEXT(list)==NULL) return list;
+	void* slow = list;
+	void* fast = NEXT(list);
+	while (fast!=NULL && NEXT(fast)!=NULL) {// деление пополам
+		slow = NEXT(slow);
+		fast = NEXT(NEXT(fast));
+	}
+	void* b = _list_sort(NEXT(slow), next, cmp);
+	NEXT(slow) = NULL;
+	void* a = _list_sort(list, next, cmp);
+	void* head = NULL;
+	void** tail = &head;
+	while (a!=NULL && b!=NULL) {
+		if (cmp(a, b)<=0) {
+			*tail = a, a = NEXT(a);
+		} else {
+			*tail = b, b = NEXT(b);
+		}
+		tail = &NEXT(*tail);
+	}
+	*tail = (a!=NULL)? a: b;
+	return head;
+}
+#undef NEXT
+/*! \brief состояние разбора
 
-	int verbose=options.verbose;
-	if (argc<2) return 1;
-	FILE* fp = fopen(argv[1], "r");
-	if (fp==NULL) return 1; 
-	if (verbose) printf("File %s\n", argv[1]);
-	char buf[4096];
-	can_dbc_t * dbc =  can_dbc_init(NULL);
-	can_dbc_object_t* object = NULL;
-	while (fgets(buf, 4096, fp)!=NULL){// разбор формата по строчкам
-		char *s = buf;
+	Сигналы добавляются в конец списка сообщения и сортируются один раз по окончании разбора.
+	Поиск сигнала для CM_ SG_ и VAL_ выполняется по хеш-таблице с ключом 
+	(идентификатор сообщения, кварк имени).
+ */
+typedef struct _DbcParser DbcParser_t;
+struct _DbcParser {
+	can_dbc_t* dbc;
+	const can_dbc_options_t* options;
+	const char* text;		//!< начало разбираемого фрагмента текста
+	int line;				//!< число строк перед фрагментом
+	can_dbc_bo_t* object;	//!< текущее сообщение BO_
+	uint32_t object_id;		//!< идентификатор текущего сообщения
+	can_dbc_sg_t** sg_tail;	//!< конец списка сигналов текущего сообщения
+	GHashTable* signals;	//!< (идентификатор сообщения, имя) -> сигнал
+	Arena_t scratch;		//!< ключи хеш-таблицы, освобождается по окончании разбора
+};
+static void _parser_init(DbcParser_t* p, can_dbc_t* dbc, const can_dbc_options_t* options)
+{
+	static const can_dbc_options_t defaults = {0};
+	memset(p, 0, sizeof(DbcParser_t));
+	p->dbc = dbc;
+	p->options = options? options: &defaults;
+	p->signals = g_hash_table_new(g_int64_hash, g_int64_equal);
+}
+static void _signal_index(DbcParser_t* p, uint32_t cob_id, can_dbc_sg_t* sg)
+{
+	uint64_t* key = arena_alloc(&p->scratch, sizeof(uint64_t));
+	*key = (uint64_t)cob_id<<32 | sg->name_id;
+	g_hash_table_insert(p->signals, key, sg);
+}
+/*! \brief поиск сигнала по идентификатору */
+static can_dbc_sg_t* _signal_lookup(DbcParser_t* p, uint32_t cob_id, GQuark id)
+{
+	uint64_t key = (uint64_t)cob_id<<32 | id;
+	return g_hash_table_lookup(p->signals, &key);
+}
+static gboolean _object_sort_cb(gpointer key, gpointer value, gpointer user_data)
+{
+	can_dbc_bo_t* bo = value;
+	bo->sg_list = _list_sort(bo->sg_list, offsetof(can_dbc_sg_t, next), cmp_pos_cb);
+	return FALSE;
+}
+/*! \brief завершение разбора: однократная сортировка сигналов каждого сообщения */
+static void _parser_finish(DbcParser_t* p)
+{
+	g_tree_foreach(p->dbc->objects, _object_sort_cb, NULL);
+	g_hash_table_destroy(p->signals);
+	arena_free(&p->scratch);
+}
+/*! \brief определение атрибута BA_DEF_ или BA_DEF_DEF_, создается при первом упоминании */
+static AttrDef_t* _attr_def_add(can_dbc_t* dbc, GQuark key)
+{
+	AttrDef_t* ad = _attr_def(dbc, key);
+	if (ad==NULL) {
+		ad = arena_new0(&dbc->arena, AttrDef_t);
+		ad->key = key;
+		ad->next = dbc->attr_defs;
+		dbc->attr_defs = ad;
+	}
+	return ad;
+}
+/*! \brief ссылка на текст комментария, копия в арене если буфер не принадлежит базе */
+static inline Slice_t _slice(DbcParser_t* p, const char* str, int len)
+{
+	if (p->options->copy_strings)
+		str = arena_strndup(&p->dbc->arena, str, len);
+	return (Slice_t){str, len};
+}
+/*! \brief ошибка разбора с указанием строки и позиции в строке */
+static void _parser_error(DbcParser_t* p, GError** error, gint code, const char* s, const char* msg)
+{
+	const char* line = p->text;
+	int n = p->line+1;
+	const char* eol;
+	while ((eol = memchr(line, '\n', s - line))!=NULL) {
+		line = eol+1;
+		n++;
+	}
+	g_set_error(error, CAN_DBC_ERROR, code, "line %d:%d: %s", n, (int)(s - line)+1, msg);
+}
+/*! \brief разбор текста DBC по месту
+	
+	Текст не копируется и не модифицируется. Разбор каждой записи ограничен строкой, 
+	кроме строк в кавычках, которые могут продолжаться на следующих строках. 
+	Текст [s, end) должен завершаться переводом строки или символом '\0'.
+	\param p - состояние разбора, текущее сообщение BO_, к которому добавляются сигналы SG_
+	\return -1 при ошибке формата, ошибка с позицией в тексте возвращается через \p error
+ */
+static int _dbc_parse_text(DbcParser_t* p, char* s, char* end, GError** error)
+{
+	int verbose = p->options->verbose;
+	can_dbc_t *dbc = p->dbc;
+	can_dbc_bo_t* object = p->object;
+	while (s < end){// разбор формата по строчкам
 		bool mux=false;
-		while (s[0]==' ') s++;
+		s = _blank(s);
 		if (strncmp(s, "BO_ ", 4)==0){// типы сообщений
 			s+=4;
 			char* name = NULL;
@@ -799,75 +1986,101 @@ int main (int argc, char*argv[])
 			uint32_t cob_id = ~0;
 			s = _cob_id(s, &cob_id);
 			s = _c_identifier(s, &name, &len);
+			if (cob_id==~0u || name==NULL){
+				_parser_error(p, error, CAN_DBC_ERROR_SYNTAX, s, "BO_: expected message id and name");
+				return -1;
+			}
 			if (s[0]==':'){
-				s++;
-				while (isspace(s[0])) s++;
+				s = _blank(s+1);
 			}
 			if (isdigit(s[0]))
 				size = strtol(s, &s, 10);
-			while (isspace(s[0])) s++;
+			s = _blank(s);
 			char* unit = NULL;
 			int ulen = 0;
 			s = _c_identifier(s, &unit, &ulen);
 			
 			if (verbose) printf ("BO_ %u %-.*s : %d %-.*s\n", cob_id, len, name, size, ulen, unit);
-			object = g_slice_new0(can_dbc_object_t);
+			object = arena_new0(&dbc->arena, can_dbc_bo_t);
 			object->name_id = _id(name, len);
 			object->transmitter = _id(unit, ulen);
 			object->data_len = size;
 			g_tree_insert(dbc->objects, GUINT_TO_POINTER(cob_id), object);
+			p->object = object;
+			p->sg_tail = &object->sg_list;
+			p->object_id = cob_id;
 		} else
 		if (strncmp(s, "SG_ ", 4)==0){// сигналы
 			s+=4;
-			can_dbc_signal_t* sg = g_slice_new0(can_dbc_signal_t);
+			can_dbc_sg_t* sg = arena_new0(&dbc->arena, can_dbc_sg_t);
 			int len = 0, pos=0, bits=0, ulen=0;
 			int mux_idx = -1;
 			bool order_le=false, sign=false;
 			char* name = NULL;
 			char* units= NULL;
 			s = _c_identifier(s, &name, &len);
-			if (s[0]=='m'){// mux'ed value
-				s++;
-				mux_idx  = strtol(s, &s, 10);
-				while (isspace(s[0])) s++;
+			if (name==NULL){
+				_parser_error(p, error, CAN_DBC_ERROR_SYNTAX, s, "SG_: expected signal name");
+				return -1;
+			}
+			if (p->object==NULL){
+				_parser_error(p, error, CAN_DBC_ERROR_OBJECT, name, "SG_ outside of BO_");
+				return -1;
+			}
+			if (s[0]=='m' && isdigit(s[1])){// mux'ed value
+				char* m = s+1;
+				long value = strtol(m, &s, 10);
+				if (value > CAN_DBC_MUX_MAX) {
+					_parser_error(p, error, CAN_DBC_ERROR_SYNTAX, m, "SG_: multiplexer value out of range 0..511");
+					return -1;
+				}
+				mux_idx = value;
+				s = _blank(s);
 			}
 			if (s[0]=='M') {
 				mux = true;
-				s++;
-				while (isspace(s[0])) s++;
+				s = _blank(s+1);
 			}
-			if (s[0]==':'){
-				s++;
-				while (isspace(s[0])) s++;
+			if (s[0]!=':' || !isdigit((s=_blank(s+1))[0])){
+				_parser_error(p, error, CAN_DBC_ERROR_SYNTAX, s, "SG_: expected ':' start_bit");
+				return -1;
 			}
-			if (isdigit(s[0]))
-				pos = strtol(s, &s, 10);
-			if (s[0]=='|') s++;
-			if (isdigit(s[0]))
-				bits = strtol(s, &s, 10);
-			if (s[0]=='@') s++;
-			if (s[0]=='1') order_le = true;
-			s++;
-			if (s[0]=='-') sign = true;
-			s++;
-			while (isspace(s[0])) s++;
+			pos = strtol(s, &s, 10);
+			if (s[0]!='|' || !isdigit(s[1])){
+				_parser_error(p, error, CAN_DBC_ERROR_SYNTAX, s, "SG_: expected '|' signal_size");
+				return -1;
+			}
+			char* b = s+1;
+			bits = strtol(b, &s, 10);
+			if (bits < 1 || bits > 64) {
+				_parser_error(p, error, CAN_DBC_ERROR_SYNTAX, b, "SG_: signal_size outside of 1..64");
+				return -1;
+			}
+			if (s[0]!='@' || (s[1]!='0' && s[1]!='1') || (s[2]!='+' && s[2]!='-')){
+				_parser_error(p, error, CAN_DBC_ERROR_SYNTAX, s, "SG_: expected '@' byte_order value_type");
+				return -1;
+			}
+			order_le = (s[1]=='1');
+			sign = (s[2]=='-');
+			s+=3;
+			s = _blank(s);
 			if (s[0]=='('){// множитель и смещение
-				s++;
-				sg->factor = strtof(s, &s);
+				s = _float(s+1, &sg->factor);
 				if (s[0]==',') s++; 
-				sg->offset = strtof(s, &s);
+				s = _float(s, &sg->offset);
 				if (s[0]==')') s++;
-				while (isspace(s[0])) s++;
+				s = _blank(s);
 			}
 			if (s[0]=='['){// минимум и максимум
-				s++;
-				sg->min = strtof(s, &s);
+				float min=0, max=0;
+				s = _float(s+1, &min);
 				if (s[0]=='|') s++; 
-				sg->max = strtof(s, &s);
+				s = _float(s, &max);
 				if (s[0]==']') s++;
-				while (isspace(s[0])) s++;
+				s = _blank(s);
+				sg->min = min, sg->max = max;
 			}
-			s = _char_string(s, &units, &ulen); // единицы измерения
+			s = _char_string(s, end, &units, &ulen); // единицы измерения
 			if (verbose) {
 				printf (" SG_ %-.*s ", len, name);
 				if (mux_idx>=0) {
@@ -878,11 +2091,24 @@ int main (int argc, char*argv[])
 						(order_le?'1':'0'), (sign?'-':'+'),
 						ulen, units);
 			}
-			if (!order_le && options.rbit) pos -= bits-1; 
+			if (!order_le && p->options->rbit) {// младший бит -> старший: биты Motorola нумеруются подряд в порядке pos^7
+				const int seq = (pos^7) - (bits-1);
+				pos = seq<0? -1: seq^7;
+			}
+			if (pos < 0 || pos >= CANFD_MAX_DLEN*8) {
+				_parser_error(p, error, CAN_DBC_ERROR_SYNTAX, name, "SG_: start_bit outside of 64 byte frame");
+				return -1;
+			}
+			const can_dbc_signal_t extent = {.pos = pos, .len = bits, .byte_order = order_le};
+			if (can_signal_bytes(&extent) > CANFD_MAX_DLEN) {
+				_parser_error(p, error, CAN_DBC_ERROR_SYNTAX, name, "SG_: signal outside of 64 byte frame");
+				return -1;
+			}
 			
 			sg->byte_order = order_le;
 			sg->pos = pos, sg->len = bits;
 			sg->mux_idx = mux_idx;
+			sg->mux = mux;
 			sg->name_id = _id(name, len);
 			if (units!=NULL) 
 				sg->units   = _id(units, ulen);
@@ -890,145 +2116,883 @@ int main (int argc, char*argv[])
 				sg->type = _TYPE_INTEGER;
 			else 	  
 				sg->type = _TYPE_UNSIGNED;
-			if (object!=NULL) 
-				object->sg_list = g_slist_insert_sorted(object->sg_list, sg, cmp_pos_cb);
-			else {
-				printf("Error SG\n");
-				_Exit(1);
-			}
+			*p->sg_tail = sg;
+			p->sg_tail = &sg->next;
+			_signal_index(p, p->object_id, sg);
 		} else
 		if (strncmp(s, "CM_ ", 4)==0){// коментарии
-			s+=4;
+			s = _blank(s+4);
 			if (strncmp(s, "BU_ ", 4)==0){
 				s+=4;
 				char* name = NULL, *comment=NULL;
 				int len = 0, clen = 0;
+				s = _blank(s);
 				s = _c_identifier(s, &name, &len);
-				s = _char_string(s, &comment, &clen);
+				s = _char_string(s, end, &comment, &clen);
 				if (verbose) printf ("CM_ BU_ %-.*s \"%-.*s\"\n", len, name, clen, comment);
 				if (name!=NULL && comment!=NULL){
 					//dbc->blocks;
 				}
 			} else
 			if (strncmp(s, "SG_ ", 4)==0){
-				s+=4;
-				while(isspace(s[0]))s++;
+				s = _blank(s+4);
 				char* name = NULL, *comment=NULL;
 				int len = 0,clen = 0;
 				uint32_t cob_id=~0;
 				s = _cob_id(s, &cob_id);
 				s = _c_identifier(s, &name, &len);
-				s = _char_string(s, &comment, &clen);
+				s = _char_string(s, end, &comment, &clen);
 				if (verbose) printf ("CM_ SG_ %u %-.*s \"%-.*s\"\n", cob_id, len, name, clen, comment);
-				object = g_tree_lookup(dbc->objects, GUINT_TO_POINTER(cob_id));
-				if (object!=NULL && comment!=NULL && clen!=0) {
-					can_dbc_signal_t* sig = _signal_lookup(object->sg_list, _id(name, len));
-					if (sig) sig->comment = g_strndup(comment,clen);
+				if (comment!=NULL && clen!=0) {
+					can_dbc_sg_t* sig = _signal_lookup(p, cob_id, _id(name, len));
+					if (sig) sig->comment = _slice(p, comment, clen);
 				}
 				
 			} else
 			if (strncmp(s, "BO_ ", 4)==0){
-				s+=4;
-				while(isspace(s[0]))s++;
-				char* name = NULL, *comment=NULL;
-				int len = 0,clen = 0;
+				s = _blank(s+4);
+				char *comment=NULL;
+				int clen = 0;
 				uint32_t cob_id=~0;
-//				s = _c_identifier(s, &name, &len);
 				s = _cob_id(s, &cob_id);
-				s = _char_string(s, &comment, &clen);
+				s = _char_string(s, end, &comment, &clen);
 				if (verbose) printf ("CM_ BO_ %u \"%-.*s\"\n", cob_id, clen, comment);
 				object = g_tree_lookup(dbc->objects, GUINT_TO_POINTER(cob_id));
 				if (object!=NULL && comment!=NULL && clen!=0) 
-					object->comment = g_strndup(comment,clen);
+					object->comment = _slice(p, comment, clen);
 			} else
 			if (s[0]=='"') {
 				char* comment=NULL;
 				int clen = 0;
-				s = _char_string(s, &comment, &clen);
+				s = _char_string(s, end, &comment, &clen);
 				if (verbose) printf ("CM_ \"%-.*s\"\n", clen, comment);
 			}
 		} else
 		if (strncmp(s, "BA_ ", 4)==0){// атрибуты
-			s+=4;
+			s = _blank(s+4);
 			char* attr=NULL;
 			int len=0;
-			s = _char_string(s, &attr, &len);
+			s = _char_string(s, end, &attr, &len);
 			if (strncmp(s, "BO_ ", 4)==0){
-				s+=4;
-				uint32_t idx = strtoul(s, &s, 10);// переделать на свою функцию
-				while (isspace(s[0])) s++;
-				int value = strtol(s, &s, 10);
+				s = _blank(s+4);
+				uint32_t idx = ~0;
+				s = _cob_id(s, &idx);
+				int value = 0;
+				if (isdigit(s[0]) || s[0]=='-')
+					value = strtol(s, &s, 10);
 				if (verbose) printf ("BA_ \"%-.*s\" BO_ %u %d;\n", len, attr, idx, value);
 				object = g_tree_lookup(dbc->objects, GUINT_TO_POINTER(idx));
 				if (object){
-					GQuark attr_id = _id(attr, len);
-					g_datalist_id_set_data(&object->attrs, attr_id, GUINT_TO_POINTER(value));
+					Enum_t* entry = arena_new0(&dbc->arena, Enum_t);
+					entry->key = _id(attr, len);
+					entry->val = value;
+					entry->next = object->attrs;
+					object->attrs = entry;
+				}
+			}
+		} else
+		if (strncmp(s, "BA_DEF_DEF_ ", 12)==0){// значения атрибутов по умолчанию
+			s = _blank(s+12);
+			char* attr=NULL;
+			int len=0;
+			s = _char_string(s, end, &attr, &len);
+			if (attr!=NULL) {
+				AttrDef_t* ad = _attr_def_add(dbc, _id(attr, len));
+				char* label=NULL;
+				int llen=0;
+				if (s[0]=='"') {
+					s = _char_string(s, end, &label, &llen);
+					if (label!=NULL) {
+						ad->def_label = _id(label, llen);
+						ad->def = 0;
+						ad->has_def = true;
+					}
+				} else
+				if (isdigit(s[0]) || s[0]=='-') {
+					ad->def_label = 0;
+					ad->def = strtol(s, &s, 10);
+					ad->has_def = true;
+				}
+				if (verbose) printf ("BA_DEF_DEF_ \"%-.*s\" %d;\n", len, attr, ad->def);
+			}
+		} else
+		if (strncmp(s, "BA_DEF_ ", 8)==0){// определения атрибутов
+			s = _blank(s+8);
+			if (strncmp(s, "BO_ ", 4)==0){
+				s = _blank(s+4);
+				char* attr=NULL;
+				int len=0;
+				char* type=NULL;
+				int tlen=0;
+				s = _char_string(s, end, &attr, &len);
+				s = _c_identifier(s, &type, &tlen);
+				if (attr!=NULL && tlen==4 && strncmp(type, "ENUM", 4)==0) {
+					AttrDef_t* ad = _attr_def_add(dbc, _id(attr, len));
+					Enum_t** tail = &ad->labels;
+					int idx = 0;
+					*tail = NULL;
+					while (s[0]=='"') {// "" -- пустое значение, номер учитывается
+						char* tag=NULL;
+						int tag_len=0;
+						if (s[1]=='"') s = _blank(s+2);
+						else {
+							s = _char_string(s, end, &tag, &tag_len);
+							if (tag==NULL) break;
+							Enum_t* entry = arena_new0(&dbc->arena, Enum_t);
+							entry->key = _id(tag, tag_len);
+							entry->val = idx;
+							*tail = entry;
+							tail = &entry->next;
+						}
+						idx++;
+						if (s[0]==',') s = _blank(s+1);
+					}
+					if (verbose) printf ("BA_DEF_ BO_ \"%-.*s\" ENUM %d;\n", len, attr, idx);
 				}
 			}
 		} else
 		if (strncmp(s, "VAL_ ",5)==0){// перечисления
-			GSList* list = NULL;
-			s+=5;
+			Enum_t* list = NULL;
+			s = _blank(s+5);
 			uint32_t cob_id=0;
 			char* name=NULL;
 			int len=0;
 			s = _cob_id(s, &cob_id);
 			s = _c_identifier(s, &name, &len); //
-			while (isspace(s[0]))s++;
-			while (isdigit(s[0])) {
-				long val = strtol(s, &s, 10);
+			while (isdigit(s[0]) || (s[0]=='-' && isdigit(s[1]))) {// значения сигналов до 64 бит без знака
+				int64_t val = s[0]=='-'? strtoll(s, &s, 10): (int64_t)strtoull(s, &s, 10);
 				char* tag=NULL;
 				int tlen=0;
-				while (isspace(s[0]))s++;
-				s = _char_string(s, &tag, &tlen);
+				s = _blank(s);
+				s = _char_string(s, end, &tag, &tlen);
 				if (tag!=NULL) {
-					Enum_t* entry =  g_slice_new(Enum_t);
+					Enum_t* entry = arena_new0(&dbc->arena, Enum_t);
 					entry->key = _id(tag, tlen);
 					entry->val = val;
-					list = g_slist_insert_sorted(list, entry, cmp_enum_cb);
+					entry->next = list;
+					list = entry;
 				}
 			}
-			object = g_tree_lookup(dbc->objects, GUINT_TO_POINTER(cob_id));
-			if (object) {
-				g_datalist_id_set_data(&object->enums, _id(name, len), list);
-			}
+			list = _list_sort(list, offsetof(Enum_t, next), cmp_enum_cb);
+			can_dbc_sg_t* sig = _signal_lookup(p, cob_id, _id(name, len));
+			if (sig) sig->enums = list;
 			if (verbose) {
 				printf ("VAL_ %u %-.*s", cob_id, len, name);
-				while (list){
-					Enum_t* entry = list->data;
-					printf (" %d \"%s\"", entry->val, g_quark_to_string(entry->key));
-					list = list->next;
+				for (; list!=NULL; list = list->next){
+					printf (" %" G_GINT64_FORMAT " \"%s\"", (gint64)list->val, g_quark_to_string(list->key));
 				}
 				printf("\n");
 			}
 		} else
 		if (strncmp(s, "BU_",  3)==0){// функциональные блоки
-			s+=3;
-			while (isspace(s[0])) s++;
+			s = _blank(s+3);
 			if (s[0]==':') {
 				s++;
 				if (verbose){ 
 					printf ("BU_:");
-					do {
+					while (s[0]!='\n' && s[0]!='\0') {
 						// есть вариант превратить в массив gchar**
-						while (isspace(s[0])) s++;
+						s = _blank(s);
 						if (isalpha(s[0])) {
 							char* name = s++;
 							while (isalnum(s[0]) || s[0]=='_') s++;
-							printf (" %-.*s", s-name, name);
-							GQuark id = _id(name, s - name);
-						}
-					} while (s[0]!='\0');
+							printf (" %-.*s", (int)(s-name), name);
+						} else
+						if (s[0]!='\n' && s[0]!='\0') s++;
+					}
 					printf ("\n");
 				}
 			}
 		}
-		if (feof(fp)) break;
+		// переход к следующей строке
+		char* eol = memchr(s, '\n', end - s);
+		s = (eol!=NULL)? eol+1: end;
+	}
+	return 0;
+}
+/*! \brief разбор текста DBC из буфера в памяти
+
+	Буфер не модифицируется и может не завершаться нулем. Комментарии CM_ ссылаются на текст 
+	буфера, буфер должен существовать до вызова can_dbc_free(), если не задан параметр 
+	copy_strings. Состояние разбора хранится на стеке, функция реентерабельна.
+	\param options - параметры разбора, NULL -- по умолчанию
+	\return FALSE при ошибке формата, база заполнена до места ошибки и освобождается can_dbc_free()
+ */
+gboolean can_dbc_parse(can_dbc_t *dbc, const char* buf, size_t size, const can_dbc_options_t* options, GError** error)
+{
+	if (size==0) return TRUE;
+	char* text = (char*)buf;
+	char* tail = text + size;
+	while (tail > text && tail[-1]!='\n') tail--;// начало незавершенной строки
+	DbcParser_t parser;
+	_parser_init(&parser, dbc, options);
+	parser.text = text;
+	int res = _dbc_parse_text(&parser, text, tail, error);
+	if (res==0 && tail < text + size) {// последняя строка без перевода строки
+		char* line = arena_strndup(&dbc->arena, tail, text + size - tail);
+		parser.text = line;
+		for (; text < tail; text++) 
+			if (text[0]=='\n') parser.line++;
+		res = _dbc_parse_text(&parser, line, line + (buf + size - tail), error);
+	}
+	_parser_finish(&parser);
+	return res==0;
+}
+/*! \brief загрузка файла DBC через отображение в память
+
+	Файл отображается только для чтения и разбирается по месту. Комментарии хранятся 
+	как ссылки на текст отображения, имена и единицы измерения -- кварки. 
+	Отображение освобождается вместе с базой в can_dbc_free().
+ */
+gboolean can_dbc_load(can_dbc_t *dbc, const char* filename, const can_dbc_options_t* options, GError** error)
+{
+	g_return_val_if_fail(dbc->mapped==NULL, FALSE);
+	GMappedFile* mapped = g_mapped_file_new(filename, FALSE, error);
+	if (mapped==NULL) return FALSE;
+	dbc->mapped = mapped;
+	can_dbc_options_t opts = options? *options: (can_dbc_options_t){0};
+	opts.copy_strings = FALSE;// текст отображения принадлежит базе
+	if (!can_dbc_parse(dbc, g_mapped_file_get_contents(mapped), g_mapped_file_get_length(mapped), &opts, error)){
+		g_prefix_error(error, "%s:", filename);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+#ifdef TEST_DBC
+/*! Тестирование скорости разбора
+$ gcc -DTEST_DBC -O2 can_dbc.c -o test_dbc `pkg-config --cflags --libs glib-2.0` -lm
+$ ./test_dbc [file.dbc]
+
+Синтезируется сообщение с мультиплексором, содержащее N сигналов, к каждому сигналу 
+комментарий CM_ SG_ и таблица значений VAL_. Время разбора на сигнал не должно 
+зависеть от N.
+ */
+static GString* _test_dbc_text(int n_signals)
+{
+	GString* str = g_string_sized_new(n_signals*160);
+	int i;
+	g_string_append(str, "BO_ 2364540158 MUX: 8 ECU\n");
+	g_string_append(str, " SG_ Page M : 0|8@1+ (1,0) [0|255] \"\" ECU\n");
+	for (i=0; i<n_signals; i++)
+		g_string_append_printf(str, " SG_ S%d m%d : %d|7@1+ (0.5,0) [0|63] \"V\" ECU\n", 
+			i, (i/8)%512, 8+(7-i%8)*7);
+	for (i=0; i<n_signals; i++)
+		g_string_append_printf(str, "CM_ SG_ 2364540158 S%d \"Signal %d\";\n", i, i);
+	for (i=0; i<n_signals; i++)
+		g_string_append_printf(str, "VAL_ 2364540158 S%d 3 \"C\" 1 \"A\" 2 \"B\" 0 \"Z\" ;\n", i);
+	return str;
+}
+/*! Векторный разбор: сравнение с разбором по одному сигналу can_signal_value() 
+	на кадрах со случайными данными для сообщений базы
+ */
+static void _test_kernel(const can_dbc_t* dbc, const char* name)
+{
+	const uint32_t n = 1u<<18;
+	struct can_frame* frames = g_new0(struct can_frame, n);
+	const can_dbc_object_t** objs = g_new(const can_dbc_object_t*, n);
+	double* values = g_new(double, dbc->kernel->max_size + 3);
+	double* ref    = g_new(double, dbc->kernel->max_size + 3);
+	uint64_t x = 1, signals = 0;
+	uint32_t i, k;
+	for (i=0; i<n; i++) {
+		x = x*6364136223846793005ULL + 1442695040888963407ULL;
+		objs[i] = &dbc->object_table[(x>>32) % dbc->bo_size];
+		frames[i].can_id = objs[i]->oid;
+		frames[i].len = 8;
+		memcpy(frames[i].data, &x, 8);
+		signals += objs[i]->sg_size;
+	}
+	gint64 t0 = g_get_monotonic_time();
+	for (i=0; i<n; i++) {
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, objs[i]);
+		for (k=0; k<objs[i]->sg_size; k++, sg++)
+			if (can_signal_bytes(sg)<=CAN_MAX_DLEN) ref[k] = can_signal_phys(sg, can_signal_value(&frames[i], sg));
+	}
+	gint64 t1 = g_get_monotonic_time();
+	const can_dbc_kernel_t* kr = dbc->kernel;
+	for (i=0; i<n; i++) {
+		uint64_t le = GUINT64_FROM_LE(*(uint64_t*)frames[i].data);
+		_kernel_decode(kr, objs[i]->signals, objs[i]->sg_size, le, GUINT64_SWAP_LE_BE(le), values);
+	}
+	gint64 t2 = g_get_monotonic_time();
+	for (i=0; i<n; i++) 
+		can_dbc_decode_frame(dbc, objs[i], &frames[i], values);
+	gint64 t3 = g_get_monotonic_time();
+	int fail = 0;
+	for (i=0; i<n; i++) {
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, objs[i]);
+		can_dbc_decode_frame(dbc, objs[i], &frames[i], values);
+		for (k=0; k<objs[i]->sg_size; k++) {
+			ref[k] = (sg[k].len!=0 && can_signal_bytes(&sg[k])<=8)? can_signal_phys(&sg[k], can_signal_value(&frames[i], &sg[k])): sg[k].offset;
+			if (fabs(ref[k]-values[k]) > 1e-9*fabs(ref[k])) fail++;
+		}
+	}
+	printf("kernel %s: %.1f signals/frame, scalar %.1f, branchless %.1f, %s %.1f Mframes/s ..%s\n", 
+		name, signals/(double)n, n/(double)(t1-t0), n/(double)(t2-t1), 
+		CPU_AVX2()?"avx2":"default", n/(double)(t3-t2), fail? "fail": "ok");
+	g_free(values);
+	g_free(ref);
+	g_free(objs);
+	g_free(frames);
+}
+/*! Мультиплексор: разбор выбранной страницы по таблице страниц в сравнении с разбором 
+	всех сигналов сообщения, 512 страниц по 8 сигналов
+ */
+static void _test_mux()
+{
+	GString* text = _test_dbc_text(4096);
+	can_dbc_t * dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text->str, text->len, NULL, NULL);
+	can_dbc_compile(dbc);
+	g_string_free(text, TRUE);
+	const can_dbc_object_t* obj = can_dbc_lookup(dbc, 2364540158u);
+	double* all    = g_new(double, obj->sg_size + 3);
+	double* values = g_new(double, obj->sg_size + 3);
+	const uint32_t n = 1u<<14;
+	struct can_frame* frames = g_new0(struct can_frame, n);
+	uint64_t x = 1;
+	uint32_t i, k;
+	for (i=0; i<n; i++) {
+		x = x*6364136223846793005ULL + 1442695040888963407ULL;
+		frames[i].can_id = obj->oid;
+		frames[i].len = 8;
+		memcpy(frames[i].data, &x, 8);
+	}
+	gint64 t0 = g_get_monotonic_time();
+	for (i=0; i<n; i++) can_dbc_decode_frame(dbc, obj, &frames[i], all);
+	gint64 t1 = g_get_monotonic_time();
+	for (i=0; i<n; i++) can_dbc_decode_mux(dbc, obj, &frames[i], values);
+	gint64 t2 = g_get_monotonic_time();
+	int fail = 0;
+	for (i=0; i<n; i++) {
+		can_dbc_decode_frame(dbc, obj, &frames[i], all);
+		const can_dbc_page_t* page = can_dbc_decode_mux(dbc, obj, &frames[i], values);
+		if (page==NULL || page != &dbc->page_table[obj->page_table + frames[i].data[0]]) { fail++; continue; }
+		for (k=page->signals - obj->signals; k<page->signals - obj->signals + page->sg_size; k++)
+			if (all[k]!=values[k]) fail++;
+	}
+	printf("mux: %u pages, all signals %.2f, page %.2f Mframes/s ..%s\n", obj->pages,
+		n/(double)(t1-t0), n/(double)(t2-t1), fail? "fail": "ok");
+	g_free(frames);
+	g_free(all);
+	g_free(values);
+	can_dbc_free(dbc);
+	// значение мультиплексора за пределами mux_idx:10
+	const char* bad = "BO_ 100 A: 8 ECU\n SG_ P M : 0|8@1+ (1,0) [0|0] \"\" ECU\n SG_ X m512 : 8|8@1+ (1,0) [0|0] \"\" ECU\n";
+	GError* error = NULL;
+	dbc = can_dbc_init(NULL);
+	gboolean ok = can_dbc_parse(dbc, bad, strlen(bad), NULL, &error);
+	printf("mux error: %s ..%s\n", error? error->message: "", 
+		!ok && g_error_matches(error, CAN_DBC_ERROR, CAN_DBC_ERROR_SYNTAX)?"ok":"fail");
+	g_clear_error(&error);
+	can_dbc_free(dbc);
+}
+/*! \brief значение определения "#define <name>_<suffix>" в сгенерированном заголовке */
+static gboolean _test_define(const char* text, const char* name, const char* suffix, uint64_t* value)
+{
+	char* key = g_strdup_printf("#define %s_%s", name, suffix);
+	const char* p = strstr(text, key);
+	if (p!=NULL) *value = strtoull(p + strlen(key), NULL, 0);
+	g_free(key);
+	return p!=NULL;
+}
+/*! Перечисления: прямая таблица имен и поиск по разреженным значениям */
+static void _test_enum()
+{
+	const char* text = 
+		"BO_ 100 A: 8 ECU\n"
+		" SG_ D : 0|8@1- (1,0) [0|0] \"\" ECU\n"
+		" SG_ S : 8|32@1+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ W : 32|32@1- (1,0) [0|0] \"\" ECU\n"
+		"VAL_ 100 D -2 \"Neg\" 0 \"Off\" 1 \"On\" 3 \"Error\" ;\n"
+		"VAL_ 100 S 1 \"A\" 1000 \"B\" 70000 \"C\" 2000000 \"D\" 2000001 \"E\" ;\n"
+		"VAL_ 100 W 2147483647 \"Max\" -1 \"SNA\" -2147483648 \"Min\" ;\n"
+		"BO_ 101 B: 8 ECU\n"
+		" SG_ U : 0|64@1+ (1,0) [0|0] \"\" ECU\n"
+		"VAL_ 101 U 0 \"Zero\" 4294967295 \"SNA32\" 18446744073709551615 \"SNA64\" ;\n";
+	can_dbc_t * dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text, strlen(text), NULL, NULL);
+	can_dbc_compile(dbc);
+	const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, can_dbc_lookup(dbc, 100));
+	static const int64_t d_val[] = {-3,-2,-1, 0, 1, 2, 3, 4};
+	static const char* d_name[]  = {NULL,"Neg",NULL,"Off","On",NULL,"Error",NULL};
+	static const int64_t s_val[] = {0, 1, 999, 1000, 70000, 2000000, 2000001, 2000002, -1};
+	static const char* s_name[]  = {NULL,"A",NULL,"B","C","D","E",NULL,NULL};
+	int i, fail = 0;
+	for (i=0; i<8; i++) {
+		const char* name = can_dbc_enum_name(dbc, &sg[0], d_val[i]);
+		if (g_strcmp0(name, d_name[i])!=0) fail++;
+	}
+	for (i=0; i<9; i++) {
+		const char* name = can_dbc_enum_name(dbc, &sg[1], s_val[i]);
+		if (g_strcmp0(name, s_name[i])!=0) fail++;
+	}
+	// значения с разностью больше 2^31 упорядочены по знаку
+	static const int64_t w_val[] = {INT32_MIN, INT32_MIN+1, -1, 0, INT32_MAX-1, INT32_MAX};
+	static const char* w_name[]  = {"Min",NULL,"SNA",NULL,NULL,"Max"};
+	for (i=0; i<6; i++) {
+		const char* name = can_dbc_enum_name(dbc, &sg[2], w_val[i]);
+		if (g_strcmp0(name, w_name[i])!=0) fail++;
+	}
+	// значения за пределами int32: 32 и 64 бит без знака
+	const can_dbc_signal_t* u = can_dbc_object_signals(dbc, can_dbc_lookup(dbc, 101));
+	static const uint64_t u_val[] = {0, 1, 0xFFFFFFFFu, 0x7FFFFFFFu, ~0ull, ~0ull>>1};
+	static const char* u_name[]  = {"Zero",NULL,"SNA32",NULL,"SNA64",NULL};
+	for (i=0; i<6; i++) {
+		const char* name = can_dbc_enum_name(dbc, u, (int64_t)u_val[i]);
+		if (g_strcmp0(name, u_name[i])!=0) fail++;
+	}
+	GString* header = can_dbc_gen_header(dbc, "test.h");
+	if (strstr(header->str, "static const int64_t U_Values[] = {-1, 0, 4294967295};")==NULL
+	 || strstr(header->str, "static inline const char* U_Name(int64_t val) {")==NULL) fail++;
+	g_string_free(header, TRUE);
+	printf("enum: dense %u, sparse %u ..%s\n", sg[0].en_range, sg[1].en_range, 
+		(fail==0 && sg[0].en_range==6 && sg[1].en_range==0 && sg[2].en_range==0)?"ok":"fail");
+	can_dbc_free(dbc);
+}
+/*! Несколько сообщений с одним PGN: кадры с адресом источника и приоритетом вне базы
+	разбираются по первому сообщению с тем же PGN
+ */
+static void _test_ambiguous()
+{
+	const char* text = 
+		"BO_ 2364539907 EEC1_3: 8 ECU\n"
+		" SG_ X : 0|8@1+ (1,0) [0|0] \"\" ECU\n"
+		"BO_ 2364539904 EEC1_0: 8 ECU\n"
+		" SG_ X : 0|8@1+ (1,0) [0|0] \"\" ECU\n"
+		"BO_ 2364539648 EEC2: 8 ECU\n"
+		" SG_ X : 0|8@1+ (1,0) [0|0] \"\" ECU\n";
+	can_dbc_t * dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text, strlen(text), NULL, NULL);
+	can_dbc_compile(dbc);
+	static const canid_t ids[]   = {0x8CF00403, 0x8CF00400, 0x8CF00405, 0x98F004FE, 0x8CF00505, 0x98F00311, 0x8CF00600};
+	static const char* names[]   = {"EEC1_3", "EEC1_0", "EEC1_0", "EEC1_0", NULL, "EEC2", NULL};
+	int i, fail = 0;
+	for (i=0; i<7; i++) {
+		const can_dbc_object_t* obj = can_dbc_lookup(dbc, ids[i]);
+		if (g_strcmp0(obj? can_dbc_string(dbc, obj->name): NULL, names[i])!=0) fail++;
+	}
+	printf("ambiguous PGN: first message by PGN ..%s\n", fail==0?"ok":"fail");
+	can_dbc_free(dbc);
+}
+/*! Позиция сигнала Motorola по младшему биту (rbit): сигнал 12 бит с переходом через границу байта */
+static void _test_rbit()
+{
+	const char* text = 
+		"BO_ 100 A: 8 ECU\n"
+		" SG_ L : 8|12@0+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ B : 20|4@0+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ R : 0|12@0+ (1,0) [0|0] \"\" ECU\n";
+	const can_dbc_options_t opts = {.rbit = TRUE};
+	can_dbc_t * dbc = can_dbc_init(NULL);
+	gboolean ok = can_dbc_parse(dbc, text, strlen(text), &opts, NULL);
+	can_dbc_compile(dbc);
+	const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, can_dbc_lookup(dbc, 100));
+	struct can_frame frame = {.can_id = 100, .len = 8, .data = {0x0A, 0xBC, 0x5F}};
+	double v[2][1];
+	can_dbc_column_t cols[2] = {{v[0]},{v[1]}};
+	can_dbc_decode(dbc, &frame, 1, cols);
+	// L: старший бит 3 байта 0, B: биты 23..20 байта 2; R со старшим битом до начала кадра отвергается
+	printf("rbit: L=%u|%u 0x%X B=%u|%u 0x%X ..%s\n", sg[0].pos, sg[0].len, (unsigned)v[0][0], sg[1].pos, sg[1].len, (unsigned)v[1][0],
+		(!ok && dbc->sg_size==2 && sg[0].pos==3 && sg[1].pos==23 && v[0][0]==0xABC && v[1][0]==0x5)?"ok":"fail");
+	can_dbc_free(dbc);
+}
+/*! Пакетный разбор: проверка выделения сигналов Intel/Motorola со знаком и скорость разбора
+	на потоке кадров J1939 из 16 сообщений по 8 сигналов
+ */
+static void _test_decode()
+{
+	const char* text = 
+		"BO_ 2566844926 T: 8 ECU\n"
+		" SG_ I : 16|12@1+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ M : 7|16@0- (0.5,1) [0|0] \"\" ECU\n"
+		" SG_ S : 60|4@1- (1,0) [0|0] \"\" ECU\n";
+	can_dbc_t * dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text, strlen(text), NULL, NULL);
+	can_dbc_compile(dbc);
+	struct can_frame frame = {.can_id = 2566844926u, .len = 8, 
+		.data = {0xFF, 0xFE, 0x34, 0x12, 0, 0, 0, 0x90}};
+	double v[3][1];
+	can_dbc_column_t cols[3] = {{v[0]},{v[1]},{v[2]}};
+	can_dbc_decode(dbc, &frame, 1, cols);// сигналы упорядочены по позиции: M, I, S
+	printf("decode: M=%g I=%g S=%g ..%s\n", v[0][0], v[1][0], v[2][0], 
+		(v[0][0]==0.0 && v[1][0]==0x234 && v[2][0]==-7)?"ok":"fail");
+	// _Pos и _Msk заголовка выделяют сигнал из слова little-endian (Intel) или big-endian (Motorola)
+	GString* header = can_dbc_gen_header(dbc, "test.h");
+	const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, can_dbc_lookup(dbc, frame.can_id));
+	uint64_t le, be, pos, msk;
+	memcpy(&le, frame.data, 8);
+	le = GUINT64_FROM_LE(le);
+	be = GUINT64_SWAP_LE_BE(le);
+	int j, fail = 0;
+	for (j=0; j<3; j++) {
+		const char* name = can_dbc_string(dbc, sg[j].name);
+		if (!_test_define(header->str, name, "Pos", &pos) || !_test_define(header->str, name, "Msk", &msk)
+		 || ((sg[j].byte_order? le: be) & msk)>>pos != (can_signal_value(&frame, &sg[j]) & (~0ULL>>(64-sg[j].len))))
+			fail++;
+	}
+	if (!_test_define(header->str, "M", "Pos", &pos)) pos = ~0ULL;
+	printf("header: M_Pos=%d ..%s\n", (int)pos, (fail==0 && pos==48)?"ok":"fail");
+	g_string_free(header, TRUE);
+	can_dbc_free(dbc);
+	// функции кодирования: счетчик 32 бит без масштаба -- целое поле, масштабированный -- double
+	const char* codec = 
+		"BO_ 2364540158 EEC1: 8 ECU\n"
+		" SG_ Odo : 0|32@1+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ Dist : 32|32@1- (0.125,-10) [0|0] \"\" ECU\n";
+	dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, codec, strlen(codec), NULL, NULL);
+	header = can_dbc_gen_header(dbc, "codec.h");
+	static const char* codec_text[] = {
+		"\tuint32_t Odo;\n", "\tdouble Dist;\n",
+		"v->Odo = (uint32_t)((le >> 0) & 0xFFFFFFFFULL);\n",
+		"v->Dist = (double)((int64_t)(((le >> 32) & 0xFFFFFFFFULL) ^ 0x80000000ULL) - 0x80000000LL) * 0.125 - 10.0;\n",
+		"le |= ((uint64_t)v->Odo & 0xFFFFFFFFULL) << 0;\n",
+		"le |= ((uint64_t)can_dbc_round((v->Dist + 10.0) / 0.125) & 0xFFFFFFFFULL) << 32;\n"};
+	for (j=0, fail=0; j<(int)G_N_ELEMENTS(codec_text); j++)
+		if (strstr(header->str, codec_text[j])==NULL) fail++;
+	printf("header: codec ..%s\n", (fail==0 && strstr(header->str, "float")==NULL)?"ok":"fail");
+	g_string_free(header, TRUE);
+	can_dbc_free(dbc);
+	
+	GString* str = g_string_new(NULL);
+	int i, k;
+	for (i=0; i<16; i++) {
+		g_string_append_printf(str, "BO_ %u M%d: 8 ECU\n", CAN_EFF_FLAG|0x18F00000u|(i<<8), i);
+		for (k=0; k<8; k++)
+			g_string_append_printf(str, " SG_ S%d_%d : %d|8@%d%c (0.1,-40) [0|0] \"\" ECU\n", 
+				i, k, (k&1)? k*8+7: k*8, k&1, (k&2)?'-':'+');
+	}
+	dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, str->str, str->len, NULL, NULL);
+	can_dbc_compile(dbc);
+	g_string_free(str, TRUE);
+	const uint32_t n = 1u<<20;
+	struct can_frame* frames = g_new0(struct can_frame, n);
+	uint64_t x = 1;
+	for (i=0; i<n; i++) {
+		x = x*6364136223846793005ULL + 1442695040888963407ULL;
+		frames[i].can_id = CAN_EFF_FLAG|0x18F00000u|((x>>60)<<8);
+		frames[i].len = 8;
+		memcpy(frames[i].data, &x, 8);
+	}
+	can_dbc_column_t* columns = g_new0(can_dbc_column_t, dbc->sg_size);
+	for (k=0; k<dbc->sg_size; k++) columns[k].values = g_new(double, n);
+	gint64 t = g_get_monotonic_time();
+	uint32_t count = can_dbc_decode(dbc, frames, n, columns);
+	t = g_get_monotonic_time() - t;
+	printf("decode: %u frames %.1f Mframes/s ..%s\n", n, n/(t*1.0), count==n?"ok":"fail");
+	_test_kernel(dbc, "J1939");
+	for (k=0; k<dbc->sg_size; k++) g_free(columns[k].values);
+	g_free(columns);
+	g_free(frames);
+	can_dbc_free(dbc);
+}
+/*! Сигналы CAN FD: разбор по смещению слова данных в сравнении с побитовым выделением, 
+	сигналы Intel/Motorola через границу 8 байт и в последнем байте кадра 64 байт
+ */
+static uint64_t _test_bits(const uint8_t* data, const can_dbc_signal_t* sg)
+{
+	uint64_t v = 0;
+	int i, b = sg->pos;
+	for (i=0; i<sg->len; i++) {
+		if (sg->byte_order) {// Intel: от младшего бита
+			b = sg->pos + i;
+			v |= (uint64_t)((data[b>>3]>>(b&7)) & 1)<<i;
+		} else {// Motorola: от старшего бита, 7..0 в байте 0, 15..8 в байте 1
+			v = (v<<1) | ((data[b>>3]>>(b&7)) & 1);
+			b = (b&7)==0? b + 15: b - 1;
+		}
+	}
+	if (sg->type==_TYPE_INTEGER && sg->len<64 && (v>>(sg->len-1)))
+		v |= ~0ULL<<sg->len;
+	return v;
+}
+static void _test_fd()
+{
+	const char* text = 
+		"BO_ 291 A: 64 ECU\n"
+		" SG_ I0 : 0|16@1+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ I1 : 60|12@1- (0.5,0) [0|0] \"\" ECU\n"
+		" SG_ I2 : 100|20@1+ (1,-10) [0|0] \"\" ECU\n"
+		" SG_ I3 : 450|51@1+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ I4 : 504|8@1- (1,0) [0|0] \"\" ECU\n"
+		" SG_ M0 : 63|16@0+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ M1 : 207|24@0- (0.1,0) [0|0] \"\" ECU\n"
+		" SG_ M2 : 511|8@0+ (1,0) [0|0] \"\" ECU\n"
+		"BO_ 292 B: 64 ECU\n"
+		" SG_ L0 : 300|56@1+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ L1 : 455|64@0+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ L2 : 4|8@1- (1,0) [0|0] \"\" ECU\n";
+	can_dbc_t * dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text, strlen(text), NULL, NULL);
+	can_dbc_compile(dbc);
+	const can_dbc_object_t* objs[2] = {can_dbc_lookup(dbc, 291), can_dbc_lookup(dbc, 292)};
+	const uint32_t n = 1u<<16;
+	struct canfd_frame* frames = g_new0(struct canfd_frame, n);
+	double values[16], ref[16];
+	uint64_t x = 1;
+	uint32_t i, k;
+	int fail = 0;
+	for (i=0; i<n; i++) {
+		frames[i].can_id = objs[i&1]->oid;
+		frames[i].len = CANFD_MAX_DLEN;
+		for (k=0; k<CANFD_MAX_DLEN; k+=8) {
+			x = x*6364136223846793005ULL + 1442695040888963407ULL;
+			memcpy(frames[i].data + k, &x, 8);
+		}
+	}
+	for (i=0; i<n; i++) {
+		const can_dbc_object_t* obj = objs[i&1];
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+		can_dbc_decode_mux_fd(dbc, obj, &frames[i], values);
+		for (k=0; k<obj->sg_size; k++) {
+			ref[k] = can_signal_phys(&sg[k], _test_bits(frames[i].data, &sg[k]));
+			if (ref[k]!=values[k] || can_signal_value_fd(&frames[i], &sg[k])!=_test_bits(frames[i].data, &sg[k])) fail++;
+		}
+		if (obj==objs[0]) {
+			_kernel_decode_fd(dbc->kernel, obj->signals, obj->sg_size, frames[i].data, values);
+			for (k=0; k<obj->sg_size; k++) 
+				if (ref[k]!=values[k]) fail++;
+		}
+	}
+	const can_dbc_object_t* obj = objs[0];
+	gint64 t = g_get_monotonic_time();
+	for (i=0; i<n; i++) can_dbc_decode_mux_fd(dbc, obj, &frames[i], values);
+	t = g_get_monotonic_time() - t;
+	GString* header = can_dbc_gen_header(dbc, "fd.h");
+	gboolean gen = strstr(header->str, "can_get_le64(data + ")!=NULL && strstr(header->str, "can_get_be64(data + ")!=NULL;
+	g_string_free(header, TRUE);
+	printf("fd: %u signals/frame, %.1f Mframes/s, header %s ..%s\n", obj->sg_size, n/(double)t, 
+		gen?"ok":"fail", (fail==0 && gen && dbc->kernel->fd[obj - dbc->object_table])?"ok":"fail");
+	can_dbc_free(dbc);
+	g_free(frames);
+	// начало, размер и конец сигнала за пределами кадра CAN FD
+	const char* bad[] = {"512|8@1+", "0|0@1+", "0|65@1+", "500|16@1+", "511|64@0+", "504|9@1+"};
+	for (i=0; i<G_N_ELEMENTS(bad); i++) {
+		char* sg_text = g_strdup_printf("BO_ 100 A: 64 ECU\n SG_ X : %s (1,0) [0|0] \"\" ECU\n", bad[i]);
+		GError* error = NULL;
+		dbc = can_dbc_init(NULL);
+		gboolean ok = can_dbc_parse(dbc, sg_text, strlen(sg_text), NULL, &error);
+		printf("fd error %s: %s ..%s\n", bad[i], error? error->message: "", 
+			!ok && g_error_matches(error, CAN_DBC_ERROR, CAN_DBC_ERROR_SYNTAX)?"ok":"fail");
+		g_clear_error(&error);
+		can_dbc_free(dbc);
+		g_free(sg_text);
+	}
+}
+int main(int argc, char* argv[])
+{
+	int n;
+	for (n=12500; n<=100000; n*=2) {
+		GString* text = _test_dbc_text(n);
+		can_dbc_t * dbc =  can_dbc_init(NULL);
+		gint64 t = g_get_monotonic_time();
+		can_dbc_parse(dbc, text->str, text->len, NULL, NULL);
+		t = g_get_monotonic_time() - t;
+		can_dbc_compile(dbc);
+		printf("signals %6d: %8.3f ms %6.1f ns/signal ..%s\n", n, t*1e-3, t*1e3/n, 
+			dbc->sg_size==n+1?"ok":"fail");
+		can_dbc_free(dbc);
+		g_string_free(text, TRUE);
+	}
+	const char* bad = "BO_ 100 A: 8 ECU\n SG_ X : 0|8@1+ (1,0) [0|0] \"\" ECU\n SG_ Y : 8 8@1+\n";
+	GError* error = NULL;
+	can_dbc_t * dbc =  can_dbc_init(NULL);
+	gboolean ok = can_dbc_parse(dbc, bad, strlen(bad), NULL, &error);
+	printf("error: %s ..%s\n", error? error->message: "", 
+		!ok && g_error_matches(error, CAN_DBC_ERROR, CAN_DBC_ERROR_SYNTAX)
+		&& strncmp(error->message, "line 3:", 7)==0?"ok":"fail");
+	g_clear_error(&error);
+	can_dbc_free(dbc);
+	// двоичный образ: таблицы после загрузки совпадают с результатом компиляции
+	GString* text = _test_dbc_text(1000);
+	dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text->str, text->len, NULL, NULL);
+	can_dbc_compile(dbc);
+	gchar* image = NULL;
+	int fd = g_file_open_tmp("test-XXXXXX.dbcb", &image, NULL);
+	if (fd>=0) g_close(fd, NULL);
+	can_dbc_image_save(dbc, image, NULL, NULL);
+	can_dbc_t * img = can_dbc_init(NULL);
+	gint64 t = g_get_monotonic_time();
+	ok = can_dbc_image_load(img, image, NULL, &error);
+	t = g_get_monotonic_time() - t;
+	ok = ok && img->sg_size==dbc->sg_size && img->en_size==dbc->en_size && img->nm_size==dbc->nm_size
+		&& memcmp(img->signal_table, dbc->signal_table, dbc->sg_size*sizeof(can_dbc_signal_t))==0
+		&& memcmp(img->enum_table, dbc->enum_table, dbc->en_size*sizeof(can_dbc_enum_t))==0
+		&& can_dbc_lookup(img, 2364540158u)!=NULL;
+	printf("image: %d us ..%s\n", (int)t, ok?"ok":"fail");
+	g_clear_error(&error);
+	can_dbc_free(img);
+	// поврежденный образ с верной контрольной суммой: ссылки за пределы таблиц
+	char* data = NULL;
+	gsize size = 0;
+	int fail = 0;
+	for (n=0; n<4 && g_file_get_contents(image, &data, &size, NULL); n++) {
+		DbcImage_t* hdr = (DbcImage_t*)data;
+		can_dbc_object_t* obj = (can_dbc_object_t*)(data + hdr->objects);
+		can_dbc_signal_t* sg  = (can_dbc_signal_t*)(data + hdr->signals);
+		can_dbc_index_t* index = (can_dbc_index_t*)(data + hdr->index);
+		switch (n) {
+		case 0: obj[0].signals = hdr->sg_size; break;
+		case 1: sg[0].name = hdr->str_size; break;
+		case 2: data[hdr->strings + hdr->str_size - 1] = 'x'; break;
+		case 3: index->sff[0] = hdr->bo_size + 1; break;
+		}
+		hdr->checksum = _image_checksum((const uint32_t*)(hdr+1), size - sizeof(DbcImage_t));
+		g_file_set_contents(image, data, size, NULL);
+		g_free(data);
+		img = can_dbc_init(NULL);
+		if (can_dbc_image_load(img, image, NULL, &error) || !g_error_matches(error, CAN_DBC_ERROR, CAN_DBC_ERROR_IMAGE)) fail++;
+		g_clear_error(&error);
+		can_dbc_free(img);
+		can_dbc_image_save(dbc, image, NULL, NULL);
+	}
+	printf("image: corrupt tables ..%s\n", (n==4 && fail==0)?"ok":"fail");
+	remove(image);
+	g_free(image);
+	can_dbc_free(dbc);
+	g_string_free(text, TRUE);
+	_test_enum();
+	_test_ambiguous();
+	_test_rbit();
+	_test_decode();
+	_test_mux();
+	_test_fd();
+	if (argc>1) {// база DBC для сравнения разбора
+		dbc = can_dbc_init(NULL);
+		if (!can_dbc_load(dbc, argv[1], NULL, &error)) {
+			printf("%s\n", error->message);
+			return 1;
+		}
+		can_dbc_compile(dbc);
+		if (dbc->bo_size) _test_kernel(dbc, argv[1]);
+		can_dbc_free(dbc);
+	}
+	return 0;
+}
+#elif !defined(CAN_DBC_LIB)
+typedef struct _MainOptions MainOptions;
+struct _MainOptions {
+    gchar *  input_file;
+    gchar * output_file;
+    gchar * config_file;
+    gchar * image_file;
+    gboolean rbit;
+    gboolean verbose;
+    gint threads;
+    gint sql_batch;
+    gboolean sql_copy;
+    gboolean sql_narrow;
+};
+#define MAIN_SQL_BATCH_MAX 1000000 //!< наибольшее число строк в одном INSERT или блоке COPY
+static MainOptions options = {
+    .input_file = NULL, // файл записи для пакетного разбора
+    .output_file = NULL,
+    .rbit = FALSE,
+    .verbose = FALSE,
+    .sql_batch = 1000,
+};
+static GOptionEntry entries[] =
+{
+  { "input",    'i', 0, G_OPTION_ARG_FILENAME,  &options.input_file,    "capture file name", "*.pcap|*.pcapng" },
+  { "config",   'c', 0, G_OPTION_ARG_FILENAME,  &options.config_file,   "DBC file name", "*.dbc" },
+  { "output",   'o', 0, G_OPTION_ARG_FILENAME,  &options.output_file,   "output file name", "*.json|*.pcap|*.sql|*.cols" },
+  { "image",    'b', 0, G_OPTION_ARG_FILENAME,  &options.image_file,    "compiled image file name", "*.dbcb" },
+  { "rbit",  	'r', 0, G_OPTION_ARG_NONE,      &options.rbit,       	"Reverse bit order",       NULL },
+  { "verbose",  'v', 0, G_OPTION_ARG_NONE,      &options.verbose,       "Be verbose",       NULL },
+  { "threads",  'j', 0, G_OPTION_ARG_INT,       &options.threads,       "decode threads, 0 -- all processors", "N" },
+  { "batch",      0, 0, G_OPTION_ARG_INT,       &options.sql_batch,     "rows per SQL INSERT or COPY block, default 1000", "N" },
+  { "copy",       0, 0, G_OPTION_ARG_NONE,      &options.sql_copy,      "SQL: COPY FROM stdin instead of INSERT", NULL },
+  { "narrow",     0, 0, G_OPTION_ARG_NONE,      &options.sql_narrow,    "SQL: one table of signal values", NULL },
+  { NULL }
+};
+int main (int argc, char*argv[])
+{
+    setlocale(LC_ALL, "");
+    setlocale(LC_NUMERIC, "C");
+    GError* error = NULL;
+    GOptionContext *context;
+    context = g_option_context_new ("- command line interface");
+    g_option_context_add_main_entries (context, entries, NULL/*GETTEXT_PACKAGE*/);
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_print ("option parsing failed: %s\n", error->message);
+        exit (1);
+    }
+    g_option_context_free (context);
+	if (options.threads < 0) {
+		g_print ("--threads: expected 0 or a positive number\n");
+		return 1;
+	}
+	if (options.threads > (gint)g_get_num_processors()*4)// больше потоков не ускоряет разбор
+		options.threads = g_get_num_processors()*4;
+	if (options.sql_batch <= 0 || options.sql_batch > MAIN_SQL_BATCH_MAX) {
+		g_print ("--batch: expected 1..%d rows\n", MAIN_SQL_BATCH_MAX);
+		return 1;
+	}
+
+	if (argc<2) return 1;
+	if (options.verbose) printf("File %s\n", argv[1]);
+	can_dbc_t * dbc =  can_dbc_init(NULL);
+	const can_dbc_options_t opts = {.rbit = options.rbit, .verbose = options.verbose};
+	if (!can_dbc_load(dbc, argv[1], &opts, &error)) {
+		g_print ("%s\n", error->message);
+		return 1;
+	}
+	can_dbc_compile(dbc);
+	if (options.verbose) printf("Compiled: %u objects, %u signals\n", dbc->bo_size, dbc->sg_size);
+	if (options.image_file!=NULL && !can_dbc_image_save(dbc, options.image_file, argv[1], &error)) {
+		g_print ("%s\n", error->message);
+		return 1;
+	}
+	if (options.input_file!=NULL) {// пакетный разбор файла записи
+		can_dbc_exporter_t exporter = {0};
+		if (options.output_file!=NULL && g_str_has_suffix(options.output_file, ".pcap")) {
+			if (!can_dbc_export_pcap(&exporter, options.output_file, &error)) {
+				g_print ("%s\n", error->message);
+				return 1;
+			}
+		} else if (options.output_file!=NULL && g_str_has_suffix(options.output_file, ".json")) {
+			if (!can_dbc_export_json(&exporter, options.output_file, &error)) {
+				g_print ("%s\n", error->message);
+				return 1;
+			}
+		} else if (options.output_file!=NULL && g_str_has_suffix(options.output_file, ".cols")) {
+			if (!can_dbc_export_columns(&exporter, options.output_file, 0, &error)) {
+				g_print ("%s\n", error->message);
+				return 1;
+			}
+		} else if (options.output_file!=NULL && g_str_has_suffix(options.output_file, ".sql")) {
+			const can_dbc_sql_options_t sql = {.batch = options.sql_batch, 
+				.copy = options.sql_copy, .narrow = options.sql_narrow};
+			if (!can_dbc_export_sql(&exporter, options.output_file, &sql, &error)) {
+				g_print ("%s\n", error->message);
+				return 1;
+			}
+		} else if (options.output_file!=NULL) {
+			g_print ("%s: unsupported output format\n", options.output_file);
+			return 1;
+		}
+		const can_dbc_batch_options_t batch = {.threads = options.threads};
+		can_dbc_batch_stats_t stats = {0};
+		gboolean ok = can_dbc_batch_decode(dbc, options.input_file, &batch, 
+			options.output_file!=NULL? &exporter: NULL, &stats, &error);
+		if (options.verbose)
+			printf("Decoded: %"G_GUINT64_FORMAT" of %"G_GUINT64_FORMAT" records, %u threads, %.2f s, %.1f Mframes/s, %.2f GB/s\n",
+				stats.frames, stats.records, stats.threads, stats.seconds, 
+				stats.frames/stats.seconds*1e-6, stats.bytes/stats.seconds*1e-9);
+		if (!ok) g_print ("%s\n", error->message);
+		can_dbc_free(dbc);
+		return ok? 0: 1;
 	}
-	fclose(fp);	
 	
 	GString* str = can_dbc_gen_header(dbc, "evm_can_h");
 	printf("%s\n", str->str);
 	g_string_free(str, TRUE);
+	can_dbc_free(dbc);
 	return 0;
-}
\ No newline at end of file
+}
+#endif// TEST_DBC, CAN_DBC_LIB
@@ -0,0 +1,480 @@
+#ifndef CAN_DBC_H
+#define CAN_DBC_H
+/*! \brief Библиотека разбора формата SAE J1939 DBC
+
+	Разбор выполняется из буфера в памяти can_dbc_parse() или из файла can_dbc_load(),
+	параметры разбора передаются при каждом вызове. Функции разбора не используют 
+	глобальных переменных, несколько баз могут разбираться одновременно в разных потоках.
+	
+	Сборка в составе приложения, без функции main:
+$ gcc -DCAN_DBC_LIB -c can_dbc.c `pkg-config --cflags glib-2.0`
+ */
+#include <stdint.h>
+#include <glib.h>
+#include <string.h>
+#include "can_j1939.h"
+#include "iot_objects.h"
+
+typedef struct _can_dbc can_dbc_t;
+typedef struct _can_dbc_object can_dbc_object_t;
+typedef struct _can_dbc_signal can_dbc_signal_t;
+typedef struct _can_dbc_index can_dbc_index_t;
+typedef struct _can_dbc_enum can_dbc_enum_t;
+typedef struct _can_dbc_kernel can_dbc_kernel_t;
+typedef struct _can_dbc_page can_dbc_page_t;
+/*! \brief Арена -- распределитель памяти блоками, выделение сдвигом указателя
+
+	Все объекты базы DBC: сообщения, сигналы, перечисления и строки размещаются 
+	в арене и освобождаются одним вызовом can_dbc_free().
+ */
+typedef struct _Arena Arena_t;
+typedef struct _ArenaChunk ArenaChunk_t;
+struct _ArenaChunk {
+	ArenaChunk_t* next;
+	size_t size;	//!< размер блока данных
+	size_t used;	//!< занято в блоке
+	uint64_t data[];
+};
+struct _Arena {
+	ArenaChunk_t* chunk;//!< текущий блок, начало списка блоков
+};
+#define ARENA_CHUNK_SIZE (64*1024)
+
+//1. разбор формата DBC, получаем структуру can_dbc_t
+struct _can_dbc {
+	char* version;	//!< версия файла
+	// BU_:
+	GData* blocks;
+	char** block_units;	//!< таблица имен блоков
+	uint8_t  bu_size;	//!< размер таблицы имен
+	uint32_t bo_size;	//!< размер таблицы сообщений
+	// BO_:
+	GTree* objects;
+	//GTree* signals;
+	const can_dbc_object_t* object_table;//!< таблица объектов, результат can_dbc_compile()
+	// SG_:
+	const can_dbc_signal_t* signal_table;//!< таблица сигналов
+	uint32_t sg_size;	//!< размер таблицы сигналов
+	// VAL_:
+	const can_dbc_enum_t* enum_table;//!< таблица значений перечислений
+	uint32_t en_size;	//!< размер таблицы значений
+	const uint32_t* name_table;//!< прямые таблицы имен перечислений, смещения в таблице строк
+	uint32_t nm_size;	//!< размер прямых таблиц имен
+	const can_dbc_page_t* page_table;//!< таблица страниц мультиплексоров
+	uint32_t pg_size;	//!< размер таблицы страниц
+	const char* strings;//!< таблица строк: имена и единицы измерения
+	uint32_t str_size;	//!< размер таблицы строк
+	const can_dbc_index_t* index;//!< индекс CAN-ID -> сообщение
+	const can_dbc_kernel_t* kernel;//!< векторы разбора сигналов
+	// BA_DEF_, BA_DEF_DEF_:
+	struct _AttrDef* attr_defs;//!< определения атрибутов: значения ENUM и по умолчанию
+	// BS_:
+	uint32_t baudrate;//!< скорость передачи данных на линии
+	// CM_
+	GString comments;//!< коментарии к проекту
+	GMappedFile* mapped;//!< отображение файла DBC, комментарии ссылаются на текст
+	Arena_t arena;//!< память под объекты базы
+};
+
+/*! Скомпилированная база
+
+	Результат can_dbc_compile() -- непрерывные таблицы без указателей. Сообщения упорядочены 
+	по идентификатору, сигналы каждого сообщения занимают непрерывный диапазон таблицы 
+	сигналов в порядке мультиплексора и позиции. Имена заданы смещением в таблице строк.
+ */
+struct _can_dbc_object {
+	uint32_t oid;	//!< идентификатор сообщения CAN, CAN_EFF_FLAG для расширенного формата
+	uint32_t name;	//!< смещение имени в таблице строк
+	uint32_t signals;//!< индекс первого сигнала в таблице сигналов
+	uint16_t sg_size;//!< число сигналов
+	uint16_t base_size;//!< число сигналов вне страниц мультиплексора, занимают начало диапазона
+	uint16_t mux;	//!< номер сигнала мультиплексора в сообщении +1, 0 -- нет мультиплексора
+	uint16_t pages;	//!< число страниц мультиплексора, значения 0..pages-1
+	uint32_t page_table;//!< индекс первой страницы в таблице страниц
+	uint8_t data_len;
+	uint8_t send_type;	//!< GenMsgSendType, см. CAN_DBC_SEND_*
+	uint16_t cycle_time;//!< GenMsgCycleTime, мс
+	uint16_t start_delay;//!< GenMsgStartDelayTime, мс, 0 -- начало распределяется планировщиком
+	uint16_t delay_time;//!< GenMsgDelayTime, мс, наименьший интервал передачи по событию
+};
+/*! \brief тип передачи GenMsgSendType, значения атрибута BA_ -- номер в перечислении BA_DEF_ 
+
+	Номер переводится в тип по имени значения в перечислении BA_DEF_ BO_ "GenMsgSendType",
+	неизвестные имена -- CAN_DBC_SEND_NONE. Если атрибут не задан ни BA_, ни BA_DEF_DEF_,
+	сообщение с GenMsgCycleTime передается циклически.
+ */
+enum _CanDbcSendType {
+	CAN_DBC_SEND_CYCLIC,
+	CAN_DBC_SEND_TRIGGERED,
+	CAN_DBC_SEND_IF_ACTIVE,	//!< cyclicIfActive -- циклически, пока сообщение активно
+	CAN_DBC_SEND_CYCLIC_TRIGGERED,
+	CAN_DBC_SEND_IF_ACTIVE_TRIGGERED,
+	CAN_DBC_SEND_NONE,
+};
+/*! \brief страница мультиплексора: сигналы m<N> занимают непрерывный диапазон таблицы сигналов */
+struct _can_dbc_page {
+	uint32_t signals;//!< индекс первого сигнала страницы в таблице сигналов
+	uint32_t sg_size;//!< число сигналов страницы, 0 -- страница не описана
+};
+/*! \brief Индекс разбора кадров CAN-ID -> сообщение
+
+	Значения -- номер сообщения в таблице сообщений +1, 0 -- сообщение не описано.
+	Для 11 битных идентификаторов используется прямая таблица. Для 29 битных 
+	идентификаторов ключом служит PGN: каталог по EDP,DP,PF; для формата PDU1 
+	запись каталога указывает на сообщение, для PDU2 (PF>=240) -- на страницу по PS.
+	Адрес источника SA в ключ не входит. Если несколько сообщений базы имеют один PGN,
+	запись помечается CAN_DBC_INDEX_AMBIGUOUS и поиск выполняется по полному идентификатору;
+	кадр с адресом SA или приоритетом вне базы разбирается по первому сообщению с тем же PGN.
+ */
+#define CAN_DBC_INDEX_AMBIGUOUS 0xFFFF
+struct _can_dbc_index {
+	uint16_t sff[CAN_SFF_MASK+1];	//!< 11 бит идентификатор
+	uint16_t pgn_dir[1024];	//!< EDP,DP,PF -> сообщение PDU1 или страница PDU2 +1
+	uint16_t pages[][256];	//!< страницы PDU2 по PS
+};
+//2. если к пакету can_frame применить разбор can_dbc_decode() или can_dbc_debug()
+struct _can_dbc_signal {
+	unsigned pos:9;	// в битах от начала, до 511 для CAN FD
+	unsigned len:7;	// длина в битах 1-64
+	unsigned type:4; // data type UNSIGNED, SIGNED, FLOAT
+	  signed mux_idx:10;
+	unsigned mux:1; // поле является мультиплексором
+	unsigned byte_order:1; // 1 - Intel, 0 - Motorola
+	float factor, offset;
+	float min, max;
+	uint32_t name;	//!< смещение имени в таблице строк, идентификатор сигнала
+	uint32_t units;	//!< смещение единиц измерения в таблице строк
+	uint32_t enums;	//!< индекс первого значения в таблице перечислений
+	uint32_t en_names;//!< индекс прямой таблицы имен, значение enum_table[enums].val -- начало
+	uint16_t en_size;//!< число значений VAL_, 0 -- не перечисление
+	uint16_t en_range;//!< длина прямой таблицы имен, 0 -- поиск по упорядоченным значениям
+};
+#define CAN_DBC_ENUM_DENSE 4 //!< прямая таблица имен, если диапазон значений не больше 4 x число значений
+/*! \brief значение перечисления VAL_, значения сигнала упорядочены по возрастанию */
+struct _can_dbc_enum {
+	int64_t  val;	//!< значение сигнала без масштабирования
+	uint32_t name;	//!< смещение имени в таблице строк
+};
+
+/*! \brief векторы разбора сигналов, индекс совпадает с индексом в таблице сигналов */
+struct _can_dbc_kernel {
+	uint64_t* shift;	//!< сдвиг младшего бита сигнала
+	uint64_t* mask;		//!< маска значения после сдвига
+	uint64_t* sign;		//!< бит знака, 0 -- без знака
+	uint64_t* order;	//!< ~0 -- Motorola, 0 -- Intel
+	double* factor;
+	double* offset;
+	uint64_t* load;		//!< смещение слова данных сигнала в кадре, байт, см. can_signal_offset()
+	uint8_t* scalar;	//!< по сообщениям: 1 -- разбор без векторов
+	uint8_t* fd;		//!< по сообщениям: 1 -- сигналы за пределами 8 байт, слово читается для каждого сигнала
+	uint32_t max_size;	//!< наибольшее число сигналов сообщения
+};
+/*! \brief столбец значений сигнала для пакетного разбора can_dbc_decode()
+
+	Значения добавляются в конец столбца, емкость столбцов задает вызывающая сторона:
+	не менее числа кадров в пакете.
+ */
+typedef struct _can_dbc_column can_dbc_column_t;
+struct _can_dbc_column {
+	double* values;	//!< физические значения, NULL -- сигнал не выбран
+	uint32_t* rows;	//!< номера кадров в пакете, может быть NULL
+	uint32_t size;	//!< число значений в столбце
+};
+/*! \brief параметры разбора */
+typedef struct _can_dbc_options can_dbc_options_t;
+struct _can_dbc_options {
+	gboolean rbit;		//!< позиция сигнала Motorola задана младшим битом
+	gboolean verbose;	//!< вывод разобранных записей в stdout
+	gboolean copy_strings;//!< копировать комментарии в базу, буфер можно освободить после разбора
+};
+/*! \brief ошибки разбора и загрузки, сообщение разбора содержит номер строки и позицию в строке */
+#define CAN_DBC_ERROR (can_dbc_error_quark())
+enum _CanDbcError {
+	CAN_DBC_ERROR_SYNTAX,	//!< нарушен формат записи
+	CAN_DBC_ERROR_OBJECT,	//!< сигнал SG_ вне описания сообщения BO_
+	CAN_DBC_ERROR_IMAGE,	//!< двоичный образ поврежден или другой версии
+	CAN_DBC_ERROR_STALE,	//!< двоичный образ старше исходного файла DBC
+	CAN_DBC_ERROR_CAPTURE,	//!< файл записи не PCAP или поврежден
+};
+GQuark can_dbc_error_quark(void);
+
+can_dbc_t* can_dbc_init(can_dbc_t* dbc);
+void can_dbc_free(can_dbc_t* dbc);
+gboolean can_dbc_parse(can_dbc_t* dbc, const char* buf, size_t size, const can_dbc_options_t* options, GError** error);
+gboolean can_dbc_load (can_dbc_t* dbc, const char* filename, const can_dbc_options_t* options, GError** error);
+int can_dbc_compile(can_dbc_t* dbc);
+gboolean can_dbc_image_save(const can_dbc_t* dbc, const char* filename, const char* source, GError** error);
+gboolean can_dbc_image_load(can_dbc_t* dbc, const char* filename, const char* source, GError** error);
+GString* can_dbc_gen_header(can_dbc_t *dbc, const char* filename);
+extern const char* names_type[];//!< имена типов C по типу сигнала _TYPE_*
+const can_dbc_page_t* can_dbc_decode_mux(const can_dbc_t* dbc, const can_dbc_object_t* obj, const struct can_frame* frame, double* values);
+const can_dbc_page_t* can_dbc_decode_mux_fd(const can_dbc_t* dbc, const can_dbc_object_t* obj, const struct canfd_frame* frame, double* values);
+void can_dbc_decode_frame(const can_dbc_t* dbc, const can_dbc_object_t* obj, const struct can_frame* frame, double* values);
+uint32_t can_dbc_decode(const can_dbc_t* dbc, const struct can_frame* frames, uint32_t n, can_dbc_column_t* columns);
+const can_dbc_object_t* can_dbc_decode_pg(const can_dbc_t* dbc, uint32_t pgn, uint8_t sa, uint8_t da,
+		const uint8_t* data, uint16_t size, double* values);
+const can_dbc_object_t* can_dbc_object_get(const can_dbc_object_t * dbc_objects, unsigned int size, unsigned index);
+const can_dbc_object_t* can_dbc_lookup_ambiguous(const can_dbc_t* dbc, canid_t can_id);
+const can_dbc_signal_t* can_dbc_signal_get(const can_dbc_signal_t *dbc_sg, unsigned int size,  unsigned int signal_id);
+
+/*! \brief планировщик передачи сообщений по атрибутам GenMsgSendType, GenMsgCycleTime, 
+	GenMsgStartDelayTime и GenMsgDelayTime скомпилированной базы, время в мс
+ */
+typedef struct _can_dbc_tx can_dbc_tx_t;
+typedef struct _can_dbc_tx_msg can_dbc_tx_msg_t;
+/*! \brief передача кадра: для сообщений CAN FD (длина данных в BO_ больше 8) flags содержит
+	CANFD_FDF, иначе len не больше 8 и начало кадра совпадает по разметке со struct can_frame
+ */
+typedef void (*can_dbc_send_fn)(void* user, const struct canfd_frame* frame);
+struct _can_dbc_tx_msg {
+	can_timer_t cycle;	//!< таймер циклической передачи
+	can_timer_t delay;	//!< отложенная передача по событию после GenMsgDelayTime
+	const can_dbc_object_t* object;
+	struct canfd_frame frame;	//!< данные передачи, обновляются приложением
+	uint32_t last;		//!< время последней передачи
+	uint8_t active;		//!< для cyclicIfActive
+};
+struct _can_dbc_tx {
+	const can_dbc_t* dbc;
+	can_dbc_tx_msg_t* msgs;	//!< индекс совпадает с индексом в таблице сообщений
+	can_timer_wheel_t wheel;
+	can_dbc_send_fn send;
+	void* user;
+	// статистика
+	uint32_t sent;
+	uint32_t max_burst;	//!< наибольшее число кадров за один тик
+	uint32_t burst, burst_tick;
+};
+can_dbc_tx_t* can_dbc_tx_new(const can_dbc_t* dbc, uint32_t now, can_dbc_send_fn send, void* user);
+void can_dbc_tx_free(can_dbc_tx_t* tx);
+can_dbc_tx_msg_t* can_dbc_tx_lookup(can_dbc_tx_t* tx, canid_t can_id);
+void can_dbc_tx_update(can_dbc_tx_msg_t* msg, const uint8_t* data, uint8_t len);
+void can_dbc_tx_trigger(can_dbc_tx_t* tx, can_dbc_tx_msg_t* msg);
+void can_dbc_tx_set_active(can_dbc_tx_t* tx, can_dbc_tx_msg_t* msg, gboolean active);
+void can_dbc_tx_poll(can_dbc_tx_t* tx, uint32_t now);
+
+/*! \brief разобранный кадр файла записи, значения сигналов по номеру сигнала в сообщении
+	как в can_dbc_decode_mux(): сигналы вне страниц и сигналы выбранной страницы
+ */
+typedef struct _can_dbc_row can_dbc_row_t;
+struct _can_dbc_row {
+	uint64_t ts;		//!< время приема, нс
+	const can_dbc_object_t* object;
+	const can_dbc_page_t* page;	//!< страница мультиплексора, NULL -- нет
+	const double* values;
+	const uint8_t* data;	//!< данные кадра в отображении файла записи
+	canid_t can_id;
+	uint8_t len;
+	uint8_t flags;		//!< флаги CAN FD записи PCAP, CANFD_FDF -- кадр CAN FD
+};
+/*! \brief получатель разобранных кадров
+
+	Функции вызываются из одного потока, кадры передаются в порядке времени приема.
+	Данные строк действительны до возврата из функции rows. Любая функция может быть NULL.
+ */
+typedef struct _can_dbc_exporter can_dbc_exporter_t;
+struct _can_dbc_exporter {
+	gboolean (*begin)(void* user, const can_dbc_t* dbc, GError** error);
+	gboolean (*rows) (void* user, const can_dbc_t* dbc, const can_dbc_row_t* rows, uint32_t n, GError** error);
+	gboolean (*end)  (void* user, GError** error);
+	void* user;
+};
+/*! \brief параметры пакетного разбора файла записи, 0 -- значение по умолчанию */
+typedef struct _can_dbc_batch_options can_dbc_batch_options_t;
+struct _can_dbc_batch_options {
+	uint32_t threads;	//!< потоков разбора, по умолчанию по числу процессоров
+	uint32_t chunk;		//!< записей в части файла, по умолчанию 16384
+	uint32_t window;	//!< частей в работе, по умолчанию 4 x threads
+};
+typedef struct _can_dbc_batch_stats can_dbc_batch_stats_t;
+struct _can_dbc_batch_stats {
+	uint64_t bytes;		//!< размер файла записи
+	uint64_t records;	//!< записей в файле
+	uint64_t frames;	//!< разобранных кадров
+	uint64_t late;		//!< кадров с отметкой времени раньше уже переданных
+	uint32_t chunks;
+	uint32_t threads;
+	double seconds;
+};
+gboolean can_dbc_batch_decode(const can_dbc_t* dbc, const char* capture, const can_dbc_batch_options_t* options,
+		const can_dbc_exporter_t* exporter, can_dbc_batch_stats_t* stats, GError** error);
+gboolean can_dbc_export_pcap(can_dbc_exporter_t* exporter, const char* filename, GError** error);
+gboolean can_dbc_export_columns(can_dbc_exporter_t* exporter, const char* filename, uint32_t group_rows, GError** error);
+gboolean can_dbc_export_json(can_dbc_exporter_t* exporter, const char* filename, GError** error);
+/*! \brief параметры экспорта в SQL, 0 -- значение по умолчанию */
+typedef struct _can_dbc_sql_options can_dbc_sql_options_t;
+struct _can_dbc_sql_options {
+	uint32_t batch;		//!< строк в одном INSERT или блоке COPY, по умолчанию 1000
+	gboolean copy;		//!< COPY ... FROM stdin (PostgreSQL) вместо INSERT
+	gboolean narrow;	//!< одна таблица значений сигналов вместо таблицы на сообщение
+};
+GString* can_dbc_gen_sql(const can_dbc_t* dbc, const can_dbc_sql_options_t* options);
+gboolean can_dbc_export_sql(can_dbc_exporter_t* exporter, const char* filename, const can_dbc_sql_options_t* options,
+		GError** error);
+
+/*! \brief запись разобранных кадров в JSON: фрагменты ключей и формат чисел сигналов
+	подготавливаются по скомпилированной базе, запись кадра выполняется без выделения памяти
+ */
+typedef struct _can_dbc_json can_dbc_json_t;
+can_dbc_json_t* can_dbc_json_new(const can_dbc_t* dbc);
+void can_dbc_json_free(can_dbc_json_t* js);
+size_t can_dbc_json_row_size(const can_dbc_json_t* js, const can_dbc_object_t* obj);
+size_t can_dbc_json_row(const can_dbc_json_t* js, const can_dbc_row_t* row, char* buf);
+
+/*! \brief номер группы параметров PGN из идентификатора J1939 */
+static inline uint32_t j1939_pgn(canid_t can_id)
+{
+	if ((can_id & J1939_PF2_MASK) == J1939_PF2_MASK)// >=240 broadcast
+		return (can_id & J1939_PDU2_PGN_Msk)>>J1939_PDU2_PGN_Pos;
+	else
+		return (can_id & J1939_PDU1_PGN_Msk)>>J1939_PDU1_PGN_Pos;
+}
+/*! \brief поиск описания сообщения по идентификатору кадра за O(1)
+	\return NULL если сообщение не описано в базе
+ */
+static inline const can_dbc_object_t* can_dbc_lookup(const can_dbc_t* dbc, canid_t can_id)
+{
+	const can_dbc_index_t* index = dbc->index;
+	uint32_t n;
+	if (can_id & CAN_EFF_FLAG){// Extended Frame Format
+		uint32_t pgn = j1939_pgn(can_id);
+		n = index->pgn_dir[pgn>>8];
+		if (n!=0 && (can_id & J1939_PF2_MASK) == J1939_PF2_MASK)
+			n = index->pages[n-1][pgn & 0xFF];
+	} else {
+		n = index->sff[can_id & CAN_SFF_MASK];
+	}
+	if (G_UNLIKELY(n == CAN_DBC_INDEX_AMBIGUOUS))
+		return can_dbc_lookup_ambiguous(dbc, can_id);
+	return n? &dbc->object_table[n-1]: NULL;
+}
+/*! \brief сигналы сообщения в скомпилированной базе */
+static inline const can_dbc_signal_t* can_dbc_object_signals(const can_dbc_t* dbc, const can_dbc_object_t* obj)
+{
+	return dbc->signal_table + obj->signals;
+}
+/*! \brief длина данных кадра, в пределах которой разбираются сигналы сообщения: 
+	CANFD_MAX_DLEN для сообщений CAN FD (длина данных в BO_ больше 8), иначе CAN_MAX_DLEN
+ */
+static inline uint8_t can_dbc_object_dlen(const can_dbc_object_t* obj)
+{
+	return obj->data_len > CAN_MAX_DLEN? CANFD_MAX_DLEN: CAN_MAX_DLEN;
+}
+/*! \brief строка по смещению в таблице строк скомпилированной базы */
+static inline const char* can_dbc_string(const can_dbc_t* dbc, uint32_t offset)
+{
+	return dbc->strings + offset;
+}
+
+/*! \brief имя значения перечисления VAL_ по значению сигнала без масштабирования
+
+	Плотные перечисления (диапазон значений не больше CAN_DBC_ENUM_DENSE числа значений) 
+	компилируются в прямую таблицу имен с индексом val - min, поиск за O(1). Для 
+	разреженных перечислений выполняется бинарный поиск без ветвлений по упорядоченным 
+	значениям.
+	\return NULL если значение не описано
+ */
+static inline const char* can_dbc_enum_name(const can_dbc_t* dbc, const can_dbc_signal_t* sg, int64_t val)
+{
+	uint32_t n = sg->en_size;
+	if (n==0) return NULL;
+	const can_dbc_enum_t* en = dbc->enum_table + sg->enums;
+	if (sg->en_range!=0) {
+		uint64_t idx = (uint64_t)val - (uint64_t)en->val;
+		uint32_t name = idx < sg->en_range? dbc->name_table[sg->en_names + idx]: 0;
+		return name? dbc->strings + name: NULL;
+	}
+	while (n > 1) {
+		uint32_t half = n>>1;
+		en = (en[half].val <= val)? en + half: en;
+		n -= half;
+	}
+	return en->val==val? dbc->strings + en->name: NULL;
+}
+/*! \brief число байт данных кадра, необходимых для выделения сигнала: последний байт сигнала +1
+
+	Для Motorola (@0) сигнал продолжается от старшего бита к младшим битам следующих байт.
+ */
+static inline int can_signal_bytes(const can_dbc_signal_t* sg)
+{
+	if (sg->byte_order) return (sg->pos + sg->len + 7)>>3;
+	return ((sg->pos | 7) - (sg->pos & 7) + sg->len + 7)>>3;
+}
+/*! \brief смещение слова данных сигнала в кадре, байт
+
+	Сигнал выделяется из слова 8 байт. Для сигналов в первых 8 байтах слово читается с начала
+	кадра, для сигналов CAN FD за 8 байтом -- так, чтобы слово заканчивалось последним байтом 
+	сигнала: чтение не выходит за can_signal_bytes() байт данных.
+ */
+static inline int can_signal_offset(const can_dbc_signal_t* sg)
+{
+	const int bytes = can_signal_bytes(sg);
+	return bytes > 8? bytes - 8: 0;
+}
+/*! \brief позиция младшего бита сигнала в слове данных по смещению can_signal_offset()
+
+	Для Intel (@1) слово читается как little-endian, позиция сигнала -- младший бит.
+	Для Motorola (@0) слово читается как big-endian, позиция -- старший бит сигнала 
+	в нумерации DBC: 7..0 в байте 0, 15..8 в байте 1 и т.д.
+	\return отрицательное значение, если сигнал занимает больше 8 байт
+ */
+static inline int can_signal_shift(const can_dbc_signal_t* sg)
+{
+	const int at = can_signal_offset(sg)<<3;
+	const int shift = sg->byte_order? sg->pos - at:
+		(56 + at - (sg->pos & ~7)) + (sg->pos & 7) - (sg->len - 1);
+	return (shift >= 0 && shift + sg->len <= 64)? shift: -1;
+}
+/*! \brief выделение сигнала из данных кадра одним чтением слова 8 байт по смещению сигнала
+	
+	Сигнал со знаком (_TYPE_INTEGER) расширяется до 64 бит. Длина сигнала 1..64 бит, 
+	сигнал не длиннее 8 байт (can_signal_shift() >= 0), соответствие длины кадра 
+	проверяется вызывающей стороной по can_signal_bytes().
+	\param data - данные кадра, не менее can_signal_offset()+8 байт
+	\return значение сигнала без масштабирования
+ */
+static inline uint64_t can_signal_raw(const uint8_t* data, const can_dbc_signal_t* sg)
+{
+	const int at = can_signal_offset(sg);
+	const int len = sg->len;
+	uint64_t val;
+	memcpy(&val, data + at, sizeof(val));
+	val = sg->byte_order? GUINT64_FROM_LE(val): GUINT64_FROM_BE(val);
+	const int shift = sg->byte_order? sg->pos - (at<<3):// как can_signal_shift(), без проверки
+		(56 + (at<<3) - (sg->pos & ~7)) + (sg->pos & 7) - (len - 1);
+	val = (val >> shift) & (~0ULL >> (64 - len));
+	if (sg->type == _TYPE_INTEGER) {// расширение знака
+		const uint64_t sign = 1ULL<<(len-1);
+		val = (val ^ sign) - sign;
+	}
+	return val;
+}
+/*! \brief выделение сигнала из кадра CAN, сигнал в пределах 8 байт */
+static inline uint64_t can_signal_value(const struct can_frame *frame, const can_dbc_signal_t* sg)
+{
+	return can_signal_raw(frame->data, sg);
+}
+/*! \brief выделение сигнала из кадра CAN FD, до 64 байт данных */
+static inline uint64_t can_signal_value_fd(const struct canfd_frame *frame, const can_dbc_signal_t* sg)
+{
+	return can_signal_raw(frame->data, sg);
+}
+/*! \brief физическое значение сигнала: raw_value * factor + offset */
+static inline double can_signal_phys(const can_dbc_signal_t* sg, uint64_t raw)
+{
+	double value;
+	switch (sg->type) {
+	case _TYPE_INTEGER: value = (int64_t)raw; break;
+	case _TYPE_REAL: {
+		union { uint32_t u; float f; } v = {.u = raw};
+		value = v.f;
+	} break;
+	case _TYPE_DOUBLE: {
+		union { uint64_t u; double f; } v = {.u = raw};
+		value = v.f;
+	} break;
+	default: value = raw; break;
+	}
+	return value*sg->factor + sg->offset;
+}
+#endif//CAN_DBC_H
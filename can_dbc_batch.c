@@ -0,0 +1,521 @@
+/*! \file can_dbc_batch.c
+
+	\brief Пакетный разбор файлов записи PCAP/PCAPNG в нескольких потоках
+
+	Поток чтения проходит заголовки записей файла, отображенного в память, и делит файл
+	на части по границам записей, для каждой части запоминается состояние чтения и
+	наименьшая отметка времени. Потоки разбора забирают следующую часть из общего
+	счетчика, как только она опубликована, и разбирают кадры по одной скомпилированной
+	базе; база только читается и между потоками не копируется. Результат части --
+	строки кадров и значения сигналов в буферах части, порядок строк по времени
+	приема строится сортировкой ключей, если в части встречаются кадры не по порядку.
+
+	Вызывающий поток сливает части по порядку их номеров: строки предыдущих частей,
+	не переданные получателю, сливаются со строками следующей части, передаются строки
+	не позднее наименьшего времени следующей части, остальные переносятся дальше. Так
+	порядок времени восстанавливается, если кадры перемешаны в пределах соседних частей,
+	например при записи с нескольких интерфейсов. Число частей в работе ограничено окном,
+	память не зависит от размера файла.
+
+Тестирование:
+$ gcc -O2 -DTEST_DBC_BATCH -DCAN_DBC_LIB can_dbc_batch.c can_dbc.c can_ev_pcap.c -o dbc_batch.exe `pkg-config --cflags --libs glib-2.0`
+$ ./dbc_batch.exe
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include "can_dbc.h"
+#include "can_ev_pcap.h"
+
+#define BATCH_CHUNK		16384
+#define BATCH_OUTPUT	4096	//!< строк в одном вызове получателя
+#define BATCH_SLACK		3		//!< запас буфера значений для векторного разбора
+
+enum {
+	CHUNK_FREE,
+	CHUNK_READY,	//!< границы части определены
+	CHUNK_BUSY,
+	CHUNK_DONE,		//!< строки части разобраны
+};
+/*! \brief строки кадров и значения сигналов, значения заданы смещениями в буфере pool */
+typedef struct _BatchRows BatchRows_t;
+struct _BatchRows {
+	can_dbc_row_t* rows;
+	uint32_t* voff;
+	uint32_t size, cap;
+	double* pool;
+	size_t used, pool_cap;
+};
+typedef struct _BatchKey BatchKey_t;
+struct _BatchKey {
+	uint64_t ts;
+	uint32_t idx;
+};
+typedef struct _BatchChunk BatchChunk_t;
+struct _BatchChunk {
+	can_pcap_reader_t rd;	//!< состояние чтения в начале части
+	size_t end;				//!< смещение конца части в файле
+	uint64_t min_ts;
+	uint32_t records;
+	int state;
+	BatchRows_t rows;
+	BatchKey_t* keys;		//!< порядок строк по времени
+	gboolean sorted;		//!< строки упорядочены, ключи не нужны
+};
+typedef struct _Batch Batch_t;
+struct _Batch {
+	const can_dbc_t* dbc;
+	can_pcap_reader_t rd;	//!< чтение заголовков записей
+	BatchChunk_t* chunks;
+	uint32_t window;
+	uint32_t chunk_records;
+	uint32_t published;		//!< частей с определенными границами
+	uint32_t claimed;		//!< частей, взятых потоками разбора
+	uint32_t consumed;		//!< частей, переданных получателю
+	gboolean walked;		//!< файл пройден до конца
+	gboolean abort;
+	int error;				//!< ошибка чтения CAN_PCAP_ERROR_*
+	GMutex lock;
+	GCond cond;
+	// слияние, выполняется в вызывающем потоке
+	BatchRows_t tail[2];	//!< строки, перенесенные в следующую часть
+	can_dbc_row_t* out;
+	uint32_t n_out;
+	uint64_t last_ts;
+	can_dbc_batch_stats_t stats;
+};
+
+static can_dbc_row_t* _rows_add(BatchRows_t* r, uint32_t n_values, double** values)
+{
+	if (r->size==r->cap) {
+		r->cap = r->cap? r->cap*2: 1024;
+		r->rows = g_renew(can_dbc_row_t, r->rows, r->cap);
+		r->voff = g_renew(uint32_t, r->voff, r->cap);
+	}
+	if (r->used + n_values + BATCH_SLACK > r->pool_cap) {
+		r->pool_cap = MAX(r->pool_cap*2, r->used + n_values + BATCH_SLACK);
+		r->pool = g_renew(double, r->pool, r->pool_cap);
+	}
+	r->voff[r->size] = r->used;
+	*values = r->pool + r->used;
+	r->used += n_values;
+	return &r->rows[r->size++];
+}
+/*! \brief ссылки строк на значения после того, как буфер значений перестал расти */
+static void _rows_resolve(BatchRows_t* r)
+{
+	uint32_t k;
+	for (k=0; k<r->size; k++)
+		r->rows[k].values = r->pool + r->voff[k];
+}
+static void _rows_free(BatchRows_t* r)
+{
+	g_free(r->rows);
+	g_free(r->voff);
+	g_free(r->pool);
+}
+static gint _key_cmp(gconstpointer a, gconstpointer b, gpointer user)
+{
+	(void)user;
+	const BatchKey_t* ka = a;
+	const BatchKey_t* kb = b;
+	if (ka->ts!=kb->ts) return ka->ts < kb->ts? -1: 1;
+	return ka->idx < kb->idx? -1: ka->idx > kb->idx;
+}
+/*! \brief разбор кадров части, выполняется в потоке разбора */
+static void _chunk_decode(const can_dbc_t* dbc, BatchChunk_t* c)
+{
+	can_pcap_reader_t* rd = &c->rd;
+	can_pcap_record_t rec;
+	BatchRows_t* r = &c->rows;
+	uint64_t last_ts = 0;
+	r->size = 0;
+	r->used = 0;
+	c->sorted = TRUE;
+	while (rd->pos < c->end && can_pcap_next(rd, &rec) > 0) {
+		if (!can_pcap_is_can(&rec)) continue;
+		struct canfd_frame frame = {.can_id = can_pcap_can_id(&rec)};
+		if (frame.can_id & (CAN_RTR_FLAG|CAN_ERR_FLAG)) continue;
+		const can_dbc_object_t* obj = can_dbc_lookup(dbc, frame.can_id);
+		if (obj==NULL) continue;
+		const uint8_t len = can_pcap_can_len(&rec);
+		frame.len = len < CANFD_MAX_DLEN? len: CANFD_MAX_DLEN;
+		memcpy(frame.data, can_pcap_can_data(&rec), frame.len);
+		double* values;
+		can_dbc_row_t* row = _rows_add(r, obj->sg_size, &values);
+		row->ts = rec.ts;
+		row->object = obj;
+		row->page = can_dbc_decode_mux_fd(dbc, obj, &frame, values);
+		row->data = can_pcap_can_data(&rec);
+		row->can_id = frame.can_id;
+		row->len = len;
+		row->flags = can_pcap_is_fd(&rec)? rec.data[CAN_PCAP_FLAGS_OFFSET] | CANFD_FDF: 0;
+		if (rec.ts < last_ts) c->sorted = FALSE;
+		last_ts = rec.ts;
+	}
+	_rows_resolve(r);
+	if (c->sorted) return;
+	c->keys = g_renew(BatchKey_t, c->keys, r->cap);
+	uint32_t k;
+	for (k=0; k<r->size; k++) {
+		c->keys[k].ts = r->rows[k].ts;
+		c->keys[k].idx = k;
+	}
+	g_qsort_with_data(c->keys, r->size, sizeof(BatchKey_t), _key_cmp, NULL);
+}
+static gpointer _walker_thread(gpointer data)
+{
+	Batch_t* b = data;
+	can_pcap_record_t rec;
+	int res = 1;
+	uint32_t seq;
+	for (seq=0; res>0; seq++) {
+		g_mutex_lock(&b->lock);
+		while (seq - b->consumed >= b->window && !b->abort)
+			g_cond_wait(&b->cond, &b->lock);
+		gboolean abort = b->abort;
+		g_mutex_unlock(&b->lock);
+		if (abort) break;
+		BatchChunk_t* c = &b->chunks[seq % b->window];
+		c->rd = b->rd;
+		uint64_t min_ts = UINT64_MAX;
+		uint32_t n = 0;
+		while (n < b->chunk_records && (res = can_pcap_next(&b->rd, &rec)) > 0) {
+			if (rec.ts < min_ts) min_ts = rec.ts;
+			n++;
+		}
+		if (n==0) break;
+		c->end = b->rd.pos;
+		c->min_ts = min_ts;
+		c->records = n;
+		b->stats.records += n;
+		g_mutex_lock(&b->lock);
+		c->state = CHUNK_READY;
+		b->published = seq+1;
+		g_cond_broadcast(&b->cond);
+		g_mutex_unlock(&b->lock);
+	}
+	g_mutex_lock(&b->lock);
+	b->walked = TRUE;
+	if (res<0) b->error = b->rd.error;
+	g_cond_broadcast(&b->cond);
+	g_mutex_unlock(&b->lock);
+	return NULL;
+}
+/*! \brief поток разбора: части берутся по общему счетчику, свободный поток забирает следующую */
+static gpointer _decode_thread(gpointer data)
+{
+	Batch_t* b = data;
+	for (;;) {
+		g_mutex_lock(&b->lock);
+		while (b->claimed >= b->published && !b->walked && !b->abort)
+			g_cond_wait(&b->cond, &b->lock);
+		if (b->abort || b->claimed >= b->published) {
+			g_mutex_unlock(&b->lock);
+			break;
+		}
+		BatchChunk_t* c = &b->chunks[b->claimed++ % b->window];
+		c->state = CHUNK_BUSY;
+		g_mutex_unlock(&b->lock);
+		_chunk_decode(b->dbc, c);
+		g_mutex_lock(&b->lock);
+		c->state = CHUNK_DONE;
+		g_cond_broadcast(&b->cond);
+		g_mutex_unlock(&b->lock);
+	}
+	return NULL;
+}
+static gboolean _flush(Batch_t* b, const can_dbc_exporter_t* ex, GError** error)
+{
+	gboolean ok = TRUE;
+	if (b->n_out!=0 && ex!=NULL && ex->rows!=NULL)
+		ok = ex->rows(ex->user, b->dbc, b->out, b->n_out, error);
+	b->n_out = 0;
+	return ok;
+}
+/*! \brief слияние строк части с перенесенными строками предыдущих частей
+	\param bound - наименьшее время следующей части, строки позднее переносятся дальше
+ */
+static gboolean _merge(Batch_t* b, BatchChunk_t* c, uint64_t bound, const can_dbc_exporter_t* ex, GError** error)
+{
+	BatchRows_t* tail = &b->tail[0];
+	BatchRows_t* next = &b->tail[1];
+	const can_dbc_row_t* rows = c->rows.rows;
+	const uint32_t n = c->rows.size;
+	uint32_t i = 0, j = 0;
+	next->size = 0;
+	next->used = 0;
+	while (i < tail->size || j < n) {
+		const can_dbc_row_t* row;
+		if (j==n || (i < tail->size && tail->rows[i].ts <= rows[c->sorted? j: c->keys[j].idx].ts))
+			row = &tail->rows[i++];
+		else
+			row = &rows[c->sorted? j++: c->keys[j++].idx];
+		if (row->ts > bound) {
+			double* values;
+			can_dbc_row_t* copy = _rows_add(next, row->object->sg_size, &values);
+			*copy = *row;
+			memcpy(values, row->values, row->object->sg_size*sizeof(double));
+			continue;
+		}
+		if (row->ts < b->last_ts) b->stats.late++;
+		else b->last_ts = row->ts;
+		b->out[b->n_out++] = *row;
+		if (b->n_out==BATCH_OUTPUT && !_flush(b, ex, error)) return FALSE;
+	}
+	if (!_flush(b, ex, error)) return FALSE;
+	_rows_resolve(next);
+	const BatchRows_t swap = *tail;
+	*tail = *next;
+	*next = swap;
+	b->stats.frames += n;
+	return TRUE;
+}
+/*! \brief разбор файла записи PCAP или PCAPNG в нескольких потоках
+
+	Кадры, описанные в базе, передаются получателю в порядке времени приема, кадры
+	CAN FD разбираются по всем байтам данных, до 64. Получатель вызывается из вызывающего потока.
+	\param dbc - скомпилированная база, только чтение
+	\param exporter - получатель, NULL -- только разбор и статистика
+	\param stats - статистика разбора, может быть NULL
+	\return FALSE -- ошибка файла записи или получателя, функция end получателя вызывается всегда
+ */
+gboolean can_dbc_batch_decode(const can_dbc_t* dbc, const char* capture, const can_dbc_batch_options_t* options,
+		const can_dbc_exporter_t* exporter, can_dbc_batch_stats_t* stats, GError** error)
+{
+	g_return_val_if_fail(dbc->index!=NULL, FALSE);// база должна быть скомпилирована
+	Batch_t* b = g_new0(Batch_t, 1);
+	gint64 t = g_get_monotonic_time();
+	int res = can_pcap_open(&b->rd, capture);
+	if (res!=CAN_PCAP_ERROR_NONE) {
+		if (res==CAN_PCAP_ERROR_OPEN)
+			g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "%s: %s", capture, g_strerror(errno));
+		else
+			g_set_error(error, CAN_DBC_ERROR, CAN_DBC_ERROR_CAPTURE, "%s: not a PCAP or PCAPNG file", capture);
+		if (exporter!=NULL && exporter->end!=NULL) exporter->end(exporter->user, NULL);
+		g_free(b);
+		return FALSE;
+	}
+	uint32_t threads = options && options->threads? options->threads: g_get_num_processors();
+	b->dbc = dbc;
+	b->chunk_records = options && options->chunk? options->chunk: BATCH_CHUNK;
+	b->window = options && options->window? options->window: 4*threads;
+	if (b->window < 2) b->window = 2;
+	b->chunks = g_new0(BatchChunk_t, b->window);
+	b->out = g_new(can_dbc_row_t, BATCH_OUTPUT);
+	b->stats.bytes = b->rd.size;
+	b->stats.threads = threads;
+	g_mutex_init(&b->lock);
+	g_cond_init(&b->cond);
+	gboolean ok = exporter==NULL || exporter->begin==NULL || exporter->begin(exporter->user, dbc, error);
+	if (!ok) b->abort = TRUE;
+	GThread* walker = g_thread_new("dbc-walk", _walker_thread, b);
+	GThread** workers = g_new(GThread*, threads);
+	uint32_t k, seq;
+	for (k=0; k<threads; k++)
+		workers[k] = g_thread_new("dbc-decode", _decode_thread, b);
+	for (seq=0; ok; seq++) {
+		g_mutex_lock(&b->lock);
+		BatchChunk_t* c = &b->chunks[seq % b->window];
+		while (!b->abort && !(seq < b->published && c->state==CHUNK_DONE && (seq+1 < b->published || b->walked))
+				&& !(b->walked && seq >= b->published))
+			g_cond_wait(&b->cond, &b->lock);
+		if (seq >= b->published) {
+			g_mutex_unlock(&b->lock);
+			break;
+		}
+		const uint64_t bound = seq+1 < b->published? b->chunks[(seq+1) % b->window].min_ts: UINT64_MAX;
+		g_mutex_unlock(&b->lock);
+		ok = _merge(b, c, bound, exporter, error);
+		g_mutex_lock(&b->lock);
+		c->state = CHUNK_FREE;
+		b->consumed = seq+1;
+		if (!ok) b->abort = TRUE;
+		g_cond_broadcast(&b->cond);
+		g_mutex_unlock(&b->lock);
+	}
+	g_thread_join(walker);
+	for (k=0; k<threads; k++)
+		g_thread_join(workers[k]);
+	g_free(workers);
+	if (ok && b->error!=CAN_PCAP_ERROR_NONE) {
+		g_set_error(error, CAN_DBC_ERROR, CAN_DBC_ERROR_CAPTURE, "%s: truncated record at offset %zu", capture, b->rd.pos);
+		ok = FALSE;
+	}
+	if (exporter!=NULL && exporter->end!=NULL && !exporter->end(exporter->user, ok? error: NULL))
+		ok = FALSE;
+	b->stats.chunks = b->consumed;
+	b->stats.seconds = (g_get_monotonic_time() - t)*1e-6;
+	if (stats!=NULL) *stats = b->stats;
+	for (k=0; k<b->window; k++) {
+		_rows_free(&b->chunks[k].rows);
+		g_free(b->chunks[k].keys);
+	}
+	_rows_free(&b->tail[0]);
+	_rows_free(&b->tail[1]);
+	g_free(b->chunks);
+	g_free(b->out);
+	g_mutex_clear(&b->lock);
+	g_cond_clear(&b->cond);
+	can_pcap_close(&b->rd);
+	g_free(b);
+	return ok;
+}
+
+static gboolean _pcap_rows(void* user, const can_dbc_t* dbc, const can_dbc_row_t* rows, uint32_t n, GError** error)
+{
+	(void)dbc;
+	can_pcap_writer_t* wr = user;
+	uint32_t k;
+	int res = 0;
+	for (k=0; k<n && res==0; k++) {
+		const can_dbc_row_t* row = &rows[k];
+		if (row->flags & CANFD_FDF) {
+			struct canfd_frame frame = {.can_id = row->can_id, .len = row->len, .flags = row->flags & ~CANFD_FDF};
+			memcpy(frame.data, row->data, MIN(row->len, CANFD_MAX_DLEN));
+			res = can_pcap_write_fd(wr, row->ts, &frame);
+		} else {
+			struct can_frame frame = {.can_id = row->can_id, .len = row->len};
+			memcpy(frame.data, row->data, MIN(row->len, CAN_MAX_DLEN));
+			res = can_pcap_write(wr, row->ts, &frame);
+		}
+	}
+	if (res!=0)
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "%s", g_strerror(errno));
+	return res==0;
+}
+static gboolean _pcap_end(void* user, GError** error)
+{
+	can_pcap_writer_t* wr = user;
+	int res = can_pcap_writer_close(wr);
+	if (res!=0)
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "%s", g_strerror(errno));
+	g_free(wr);
+	return res==0;
+}
+/*! \brief получатель: разобранные кадры записываются в файл PCAP в порядке времени */
+gboolean can_dbc_export_pcap(can_dbc_exporter_t* exporter, const char* filename, GError** error)
+{
+	can_pcap_writer_t* wr = g_new(can_pcap_writer_t, 1);
+	if (can_pcap_writer_open(wr, filename, 0)!=0) {
+		int errsv = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", filename, g_strerror(errsv));
+		g_free(wr);
+		return FALSE;
+	}
+	*exporter = (can_dbc_exporter_t){.rows = _pcap_rows, .end = _pcap_end, .user = wr};
+	return TRUE;
+}
+
+#ifdef TEST_DBC_BATCH
+#include <stdio.h>
+typedef struct _TestSink TestSink_t;
+struct _TestSink {
+	uint64_t rows;
+	uint64_t last_ts;
+	uint64_t unordered;
+	double sum;
+};
+static gboolean _test_rows(void* user, const can_dbc_t* dbc, const can_dbc_row_t* rows, uint32_t n, GError** error)
+{
+	(void)dbc;
+	(void)error;
+	TestSink_t* sink = user;
+	uint32_t k;
+	for (k=0; k<n; k++) {
+		if (rows[k].ts < sink->last_ts) sink->unordered++;
+		sink->last_ts = rows[k].ts;
+		sink->sum += rows[k].values[0] + rows[k].values[rows[k].object->sg_size-1];
+	}
+	sink->rows += n;
+	return TRUE;
+}
+int main(int argc, char* argv[])
+{
+	const uint32_t n_objects = 256, n_signals = 8;
+	GString* text = g_string_new("VERSION \"\"\nBU_: ECU\n");
+	uint32_t i, k;
+	for (i=0; i<n_objects; i++) {
+		g_string_append_printf(text, "BO_ %u M%u: 8 ECU\n", CAN_EFF_FLAG | (0x18F00000u + (i<<8)), i);
+		for (k=0; k<n_signals; k++)
+			g_string_append_printf(text, " SG_ S%u_%u : %u|8@1+ (0.5,%u) [0|0] \"\" ECU\n", i, k, k*8, k);
+	}
+	can_dbc_t* dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text->str, text->len, NULL, NULL);
+	can_dbc_compile(dbc);
+	g_string_free(text, TRUE);
+	// запись с двух интерфейсов: кадры второго интерфейса задержаны на 2.5 мкс
+	gchar* filename = NULL;
+	gchar* sorted = NULL;
+	int fd = g_file_open_tmp("test-XXXXXX.pcap", &filename, NULL);
+	if (fd>=0) g_close(fd, NULL);
+	fd = g_file_open_tmp("test-XXXXXX-sorted.pcap", &sorted, NULL);
+	if (fd>=0) g_close(fd, NULL);
+	const uint32_t N = argc>1? atoi(argv[1]): 4000000;
+	can_pcap_writer_t wr;
+	can_pcap_writer_open(&wr, filename, 0);
+	uint32_t expected = 0;
+	for (i=0; i<N; i++) {
+		const uint64_t ts = 1700000000000000000ull + i*1000ull - (i%3==0? 2500: 0);
+		if (i%64==63) {
+			struct canfd_frame fd = {.can_id = CAN_EFF_FLAG | 0x18DA00F1, .len = 32};
+			can_pcap_write_fd(&wr, ts, &fd);
+			continue;
+		}
+		struct can_frame frame = {.can_id = CAN_EFF_FLAG | (0x18F00000u + ((i % n_objects)<<8) + (i & 0xFF)), .len = 8};
+		for (k=0; k<8; k++) frame.data[k] = i>>k;
+		can_pcap_write(&wr, ts, &frame);
+		expected++;
+	}
+	can_pcap_writer_close(&wr);
+	printf("capture: %u records, %.1f MB, %u processors\n", N, wr.written*1e-6, g_get_num_processors());
+	double rate1 = 0, sum1 = 0;
+	uint32_t threads;
+	for (threads=1; threads<=MAX(8, g_get_num_processors()); threads*=2) {
+		TestSink_t sink = {0};
+		const can_dbc_exporter_t ex = {.rows = _test_rows, .user = &sink};
+		const can_dbc_batch_options_t opts = {.threads = threads};
+		can_dbc_batch_stats_t st;
+		GError* error = NULL;
+		gboolean ok = can_dbc_batch_decode(dbc, filename, &opts, &ex, &st, &error);
+		const double rate = st.frames/st.seconds;
+		if (threads==1) rate1 = rate, sum1 = sink.sum;
+		printf("threads %2u: %u chunks %6.1f Mframes/s %6.2f GB/s x%.2f ..%s\n", threads, st.chunks, rate*1e-6,
+			st.bytes/st.seconds*1e-9, rate/rate1, ok && sink.rows==expected && st.frames==expected && st.late==0
+			&& sink.unordered==0 && sink.sum==sum1? "ok": "fail");
+		g_clear_error(&error);
+	}
+	// экспорт в PCAP и повторный разбор: порядок времени восстановлен
+	can_dbc_exporter_t ex;
+	can_dbc_batch_stats_t st;
+	gboolean ok = can_dbc_export_pcap(&ex, sorted, NULL)
+		&& can_dbc_batch_decode(dbc, filename, NULL, &ex, &st, NULL);
+	can_pcap_reader_t rd;
+	can_pcap_record_t rec;
+	uint64_t last_ts = 0, n = 0, unordered = 0;
+	ok = ok && can_pcap_open(&rd, sorted)==0;
+	while (ok && can_pcap_next(&rd, &rec)>0) {
+		if (rec.ts < last_ts) unordered++;
+		last_ts = rec.ts;
+		n++;
+	}
+	if (ok) can_pcap_close(&rd);
+	printf("export pcap: %llu frames ..%s\n", (unsigned long long)n, ok && n==expected && unordered==0? "ok": "fail");
+	// поврежденная запись в конце файла
+	FILE* fp = fopen(filename, "ab");
+	fwrite("\1\2\3\4\5\6\7\10\11\12\13\14\15\16\17\20\21", 17, 1, fp);
+	fclose(fp);
+	GError* error = NULL;
+	TestSink_t sink = {0};
+	const can_dbc_exporter_t test = {.rows = _test_rows, .user = &sink};
+	ok = !can_dbc_batch_decode(dbc, filename, NULL, &test, &st, &error)
+		&& g_error_matches(error, CAN_DBC_ERROR, CAN_DBC_ERROR_CAPTURE) && sink.rows==expected;
+	printf("truncated: %s ..%s\n", error? error->message: "", ok? "ok": "fail");
+	g_clear_error(&error);
+	remove(filename);
+	remove(sorted);
+	g_free(filename);
+	g_free(sorted);
+	can_dbc_free(dbc);
+	return 0;
+}
+#endif//TEST_DBC_BATCH
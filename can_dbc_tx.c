@@ -0,0 +1,315 @@
+/*! \file can_dbc_tx.c
+
+	\brief Планировщик передачи сообщений по атрибутам базы DBC
+
+	Тип передачи GenMsgSendType:
+	cyclic -- каждые GenMsgCycleTime мс;
+	triggered -- по вызову can_dbc_tx_trigger(), не чаще GenMsgDelayTime;
+	cyclicIfActive -- циклически, пока приложение держит сообщение активным;
+	cyclicAndTriggered, cyclicIfActiveAndTriggered -- сочетание, передача по событию
+	не сдвигает фазу цикла.
+	Номер значения GenMsgSendType сопоставляется типу по имени в перечислении BA_DEF_ базы,
+	атрибуты, не заданные для сообщения BA_, берутся из BA_DEF_DEF_.
+
+	Сообщения с длиной данных больше 8 передаются кадрами CAN FD до 64 байт.
+
+	Первая передача через GenMsgStartDelayTime после запуска. Если задержка не задана,
+	начала сообщений с одинаковым периодом равномерно распределяются по периоду, группы
+	разных периодов сдвинуты друг относительно друга, так что кадры не собираются в пачки
+	на общих кратных периодов. Сроки передачи отсчитываются от срока предыдущей передачи,
+	а не от момента вызова, поэтому ошибка опроса не накапливается. Таймеры хранятся
+	в колесе can_timer.h: стоимость тика определяется числом передаваемых кадров.
+
+Тестирование:
+$ gcc -O2 -DTEST_DBC_TX -DCAN_DBC_LIB can_dbc_tx.c can_dbc.c can_timer.c -o dbc_tx.exe `pkg-config --cflags --libs glib-2.0`
+$ ./dbc_tx.exe
+ */
+#include <stdlib.h>
+#include "can_dbc.h"
+
+static inline gboolean _is_cyclic(uint8_t send_type)
+{
+	return send_type==CAN_DBC_SEND_CYCLIC || send_type==CAN_DBC_SEND_CYCLIC_TRIGGERED;
+}
+static inline gboolean _is_if_active(uint8_t send_type)
+{
+	return send_type==CAN_DBC_SEND_IF_ACTIVE || send_type==CAN_DBC_SEND_IF_ACTIVE_TRIGGERED;
+}
+static inline gboolean _is_triggered(uint8_t send_type)
+{
+	return send_type==CAN_DBC_SEND_TRIGGERED || send_type==CAN_DBC_SEND_CYCLIC_TRIGGERED
+		|| send_type==CAN_DBC_SEND_IF_ACTIVE_TRIGGERED;
+}
+static void _send(can_dbc_tx_t* tx, can_dbc_tx_msg_t* msg, uint32_t now)
+{
+	tx->send(tx->user, &msg->frame);
+	msg->last = now;
+	tx->sent++;
+	if (tx->burst_tick!=now) {
+		tx->burst_tick = now;
+		tx->burst = 0;
+	}
+	if (++tx->burst > tx->max_burst) tx->max_burst = tx->burst;
+}
+static void _cycle_expired(can_timer_t* timer, void* user)
+{
+	can_dbc_tx_t* tx = user;
+	can_dbc_tx_msg_t* msg = (can_dbc_tx_msg_t*)timer;
+	const uint32_t now = timer->expires;
+	can_timer_add(&tx->wheel, timer, now + msg->object->cycle_time);
+	_send(tx, msg, now);
+}
+static void _delay_expired(can_timer_t* timer, void* user)
+{
+	can_dbc_tx_t* tx = user;
+	can_dbc_tx_msg_t* msg = (can_dbc_tx_msg_t*)((char*)timer - offsetof(can_dbc_tx_msg_t, delay));
+	_send(tx, msg, timer->expires);
+}
+static int _cycle_cmp(const void* a, const void* b, void* user)
+{
+	const can_dbc_tx_msg_t* msgs = user;
+	const uint32_t i = *(const uint32_t*)a, j = *(const uint32_t*)b;
+	const uint16_t ci = msgs[i].object->cycle_time, cj = msgs[j].object->cycle_time;
+	if (ci!=cj) return ci<cj? -1: 1;
+	return i<j? -1: i>j;
+}
+/*! \brief создание планировщика по скомпилированной базе и запуск циклических сообщений
+	\param now - время запуска, мс
+	\param send - передача кадра, вызывается из can_dbc_tx_poll() и can_dbc_tx_trigger()
+ */
+can_dbc_tx_t* can_dbc_tx_new(const can_dbc_t* dbc, uint32_t now, can_dbc_send_fn send, void* user)
+{
+	can_dbc_tx_t* tx = g_new0(can_dbc_tx_t, 1);
+	tx->dbc  = dbc;
+	tx->send = send;
+	tx->user = user;
+	tx->msgs = g_new0(can_dbc_tx_msg_t, dbc->bo_size);
+	can_timer_wheel_init(&tx->wheel, now, tx);
+	uint32_t* order = g_new(uint32_t, dbc->bo_size);
+	uint32_t i, n = 0;
+	for (i=0; i<dbc->bo_size; i++) {
+		const can_dbc_object_t* obj = &dbc->object_table[i];
+		can_dbc_tx_msg_t* msg = &tx->msgs[i];
+		msg->object = obj;
+		msg->frame.can_id = obj->oid;
+		msg->frame.len = MIN(obj->data_len, can_dbc_object_dlen(obj));
+		msg->frame.flags = obj->data_len > CAN_MAX_DLEN? CANFD_FDF: 0;
+		msg->last = now - obj->delay_time;
+		msg->cycle.fn = _cycle_expired;
+		msg->delay.fn = _delay_expired;
+		if (_is_cyclic(obj->send_type) && obj->cycle_time!=0) {
+			if (obj->start_delay)
+				can_timer_add(&tx->wheel, &msg->cycle, now + obj->start_delay);
+			else
+				order[n++] = i;
+		}
+	}
+	// распределение начала: группа с периодом C из k сообщений занимает фазы C*j/k,
+	// группа сдвинута на число сообщений предыдущих групп
+	g_qsort_with_data(order, n, sizeof(uint32_t), _cycle_cmp, tx->msgs);
+	uint32_t first = 0, last = 0;
+	for (i=0; i<n; i++) {
+		const uint32_t cycle = tx->msgs[order[i]].object->cycle_time;
+		if (i==last) {// новая группа [first, last)
+			first = i;
+			while (last<n && tx->msgs[order[last]].object->cycle_time==cycle) last++;
+		}
+		const uint32_t phase = ((uint64_t)(i - first)*cycle/(last - first) + first) % cycle;
+		can_timer_add(&tx->wheel, &tx->msgs[order[i]].cycle, now + 1 + phase);
+	}
+	g_free(order);
+	return tx;
+}
+void can_dbc_tx_free(can_dbc_tx_t* tx)
+{
+	g_free(tx->msgs);
+	g_free(tx);
+}
+/*! \brief сообщение планировщика по идентификатору кадра, NULL -- не описано в базе */
+can_dbc_tx_msg_t* can_dbc_tx_lookup(can_dbc_tx_t* tx, canid_t can_id)
+{
+	const can_dbc_object_t* obj = can_dbc_lookup(tx->dbc, can_id);
+	return obj? &tx->msgs[obj - tx->dbc->object_table]: NULL;
+}
+/*! \brief обновление данных сообщения, передаются в следующем кадре
+	\param len - длина данных, не более 8 для CAN и 64 для CAN FD
+ */
+void can_dbc_tx_update(can_dbc_tx_msg_t* msg, const uint8_t* data, uint8_t len)
+{
+	len = MIN(len, can_dbc_object_dlen(msg->object));
+	memcpy(msg->frame.data, data, len);
+	msg->frame.len = len;
+}
+/*! \brief передача по событию, для типов без triggered не действует
+
+	Если с последней передачи прошло меньше GenMsgDelayTime, передача откладывается
+	до истечения интервала, повторные события в этом интервале объединяются.
+ */
+void can_dbc_tx_trigger(can_dbc_tx_t* tx, can_dbc_tx_msg_t* msg)
+{
+	const can_dbc_object_t* obj = msg->object;
+	if (!_is_triggered(obj->send_type)) return;
+	if (_is_if_active(obj->send_type) && !msg->active) return;
+	if (can_timer_pending(&msg->delay)) return;
+	const uint32_t now = can_timer_wheel_time(&tx->wheel);
+	if (now - msg->last >= obj->delay_time)
+		_send(tx, msg, now);
+	else
+		can_timer_add(&tx->wheel, &msg->delay, msg->last + obj->delay_time);
+}
+/*! \brief активность сообщения cyclicIfActive: передача сразу при активации и далее циклически,
+	при GenMsgCycleTime 0 -- однократно при активации
+ */
+void can_dbc_tx_set_active(can_dbc_tx_t* tx, can_dbc_tx_msg_t* msg, gboolean active)
+{
+	const can_dbc_object_t* obj = msg->object;
+	if (!_is_if_active(obj->send_type) || msg->active==!!active) return;
+	msg->active = !!active;
+	if (!active) {
+		can_timer_del(&tx->wheel, &msg->cycle);
+		can_timer_del(&tx->wheel, &msg->delay);
+	} else {
+		const uint32_t now = can_timer_wheel_time(&tx->wheel);
+		if (obj->cycle_time) can_timer_add(&tx->wheel, &msg->cycle, now + obj->cycle_time);
+		_send(tx, msg, now);
+	}
+}
+/*! \brief передача кадров, срок которых наступил к моменту now, мс */
+void can_dbc_tx_poll(can_dbc_tx_t* tx, uint32_t now)
+{
+	can_timer_wheel_advance(&tx->wheel, now);
+}
+
+#ifdef TEST_DBC_TX
+#include <stdio.h>
+#include <time.h>
+static uint32_t n_frames;
+static canid_t last_id;
+static struct canfd_frame last_frame;
+static void send(void* user, const struct canfd_frame* frame)
+{
+	(void)user;
+	n_frames++;
+	last_id = frame->can_id;
+	last_frame = *frame;
+}
+static double seconds(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+int main(){
+	static const int cycles[] = {10, 20, 50, 100, 100, 200, 500, 1000};
+	const int n_cyclic = 2000;
+	const uint32_t base = CAN_EFF_FLAG | 0x100;
+	GString* text = g_string_new("VERSION \"\"\nBU_: ECU\n");
+	int i;
+	for (i=0; i<n_cyclic+3; i++)
+		g_string_append_printf(text, "BO_ %u M%d: 8 ECU\n SG_ S%d : 0|8@1+ (1,0) [0|0] \"\" ECU\n", base+i, i, i);
+	for (i=0; i<n_cyclic; i++)
+		g_string_append_printf(text, "BA_ \"GenMsgCycleTime\" BO_ %u %d;\n", base+i, cycles[i%8]);
+	// triggered с интервалом 30 мс, cyclicIfActive 25 мс, cyclic с задержкой начала
+	g_string_append_printf(text, "BA_ \"GenMsgSendType\" BO_ %u 1;\nBA_ \"GenMsgDelayTime\" BO_ %u 30;\n",
+		base+n_cyclic, base+n_cyclic);
+	g_string_append_printf(text, "BA_ \"GenMsgSendType\" BO_ %u 2;\nBA_ \"GenMsgCycleTime\" BO_ %u 25;\n",
+		base+n_cyclic+1, base+n_cyclic+1);
+	g_string_append_printf(text, "BA_ \"GenMsgCycleTime\" BO_ %u 100;\nBA_ \"GenMsgStartDelayTime\" BO_ %u 500;\n",
+		base+n_cyclic+2, base+n_cyclic+2);
+	can_dbc_t* dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text->str, text->len, NULL, NULL);
+	can_dbc_compile(dbc);
+	can_dbc_tx_t* tx = can_dbc_tx_new(dbc, 0, send, NULL);
+	const uint32_t ticks = 10000;
+	uint32_t t;
+	double s = seconds();
+	for (t=1; t<=ticks; t++) can_dbc_tx_poll(tx, t);
+	s = seconds() - s;
+	uint32_t expect = 0;
+	for (i=0; i<n_cyclic; i++) expect += ticks/cycles[i%8];
+	expect += (ticks - 500)/100 + 1;
+	// средняя нагрузка 2000 сообщений: 2000/8*(1/10+1/20+1/50+2/100+1/200+1/500+1/1000) = 49.5 кадров/мс
+	printf("cyclic: %d messages, %u frames expected %u, max %u frames/ms, %.1f ns/frame ..%s\n",
+		n_cyclic+1, n_frames, expect, tx->max_burst, s/n_frames*1e9,
+		n_frames==expect && tx->max_burst<=60? "ok": "fail");
+	// triggered: 5 событий подряд, передача сразу и через 30 мс
+	can_dbc_tx_msg_t* trig = can_dbc_tx_lookup(tx, base+n_cyclic);
+	uint32_t n0 = n_frames;
+	for (i=0; i<5; i++) can_dbc_tx_trigger(tx, trig);
+	int ok = n_frames==n0+1;
+	for (; t<=ticks+29; t++) can_dbc_tx_poll(tx, t);
+	ok = ok && trig->last==ticks;
+	can_dbc_tx_poll(tx, t++);
+	ok = ok && trig->last==ticks+30;
+	// cyclicIfActive: неактивное не передается, активное -- каждые 25 мс
+	can_dbc_tx_msg_t* act = can_dbc_tx_lookup(tx, base+n_cyclic+1);
+	ok = ok && act->last==0;
+	can_dbc_tx_set_active(tx, act, TRUE);
+	uint32_t start = t-1;
+	for (; t<=start+100; t++) can_dbc_tx_poll(tx, t);
+	ok = ok && act->last==start+100;
+	can_dbc_tx_set_active(tx, act, FALSE);
+	for (; t<=start+200; t++) can_dbc_tx_poll(tx, t);
+	ok = ok && act->last==start+100;
+	printf("triggered, cyclicIfActive ..%s\n", ok? "ok": "fail");
+	can_dbc_tx_free(tx);
+	can_dbc_free(dbc);
+	g_string_free(text, TRUE);
+	// перечисление GenMsgSendType в порядке другого инструмента, период и тип передачи 
+	// по умолчанию заданы только BA_DEF_DEF_
+	const char* def_text = 
+		"BO_ 256 A: 8 ECU\n SG_ A : 0|8@1+ (1,0) [0|0] \"\" ECU\n"
+		"BO_ 257 B: 8 ECU\n SG_ B : 0|8@1+ (1,0) [0|0] \"\" ECU\n"
+		"BO_ 258 C: 8 ECU\n SG_ C : 0|8@1+ (1,0) [0|0] \"\" ECU\n"
+		"BO_ 259 D: 8 ECU\n SG_ D : 0|8@1+ (1,0) [0|0] \"\" ECU\n"
+		"BA_DEF_ BO_  \"GenMsgSendType\" ENUM  \"Cyclic\",\"not_used\",\"not_used\",\"not_used\","
+			"\"not_used\",\"Cyclic\",\"not_used\",\"IfActive\",\"NoMsgSendType\";\n"
+		"BA_DEF_ BO_  \"GenMsgCycleTime\" INT 0 65535;\n"
+		"BA_DEF_DEF_  \"GenMsgSendType\" \"Cyclic\";\n"
+		"BA_DEF_DEF_  \"GenMsgCycleTime\" 100;\n"
+		"BA_ \"GenMsgSendType\" BO_ 257 7;\n"
+		"BA_ \"GenMsgSendType\" BO_ 258 8;\n"
+		"BA_ \"GenMsgSendType\" BO_ 259 1;\n";
+	dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, def_text, strlen(def_text), NULL, NULL);
+	can_dbc_compile(dbc);
+	static const uint8_t send_types[] = {CAN_DBC_SEND_CYCLIC, CAN_DBC_SEND_IF_ACTIVE, CAN_DBC_SEND_NONE, CAN_DBC_SEND_NONE};
+	for (i=0, ok=1; i<4; i++) {
+		const can_dbc_object_t* obj = can_dbc_lookup(dbc, 256+i);
+		ok = ok && obj!=NULL && obj->send_type==send_types[i] && obj->cycle_time==100;
+	}
+	tx = can_dbc_tx_new(dbc, 0, send, NULL);
+	n_frames = 0;
+	for (t=1; t<=1000; t++) can_dbc_tx_poll(tx, t);
+	ok = ok && n_frames==10 && last_id==256;
+	printf("BA_DEF_ ENUM, BA_DEF_DEF_ ..%s\n", ok? "ok": "fail");
+	can_dbc_tx_free(tx);
+	can_dbc_free(dbc);
+	// cyclicIfActive без периода -- однократно при активации; сообщение CAN FD 64 байта
+	const char* fd_text =
+		"BO_ 300 E: 8 ECU\n SG_ E : 0|8@1+ (1,0) [0|0] \"\" ECU\n"
+		"BO_ 301 F: 64 ECU\n SG_ F : 504|8@1+ (1,0) [0|0] \"\" ECU\n"
+		"BA_ \"GenMsgSendType\" BO_ 300 2;\n"
+		"BA_ \"GenMsgSendType\" BO_ 301 1;\n";
+	dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, fd_text, strlen(fd_text), NULL, NULL);
+	can_dbc_compile(dbc);
+	tx = can_dbc_tx_new(dbc, 0, send, NULL);
+	n_frames = 0;
+	can_dbc_tx_msg_t* once = can_dbc_tx_lookup(tx, 300);
+	can_dbc_tx_set_active(tx, once, TRUE);
+	ok = n_frames==1 && last_id==300 && last_frame.len==8 && !(last_frame.flags & CANFD_FDF);
+	for (t=1; t<=100; t++) can_dbc_tx_poll(tx, t);
+	ok = ok && n_frames==1;
+	can_dbc_tx_msg_t* fd = can_dbc_tx_lookup(tx, 301);
+	uint8_t payload[CANFD_MAX_DLEN];
+	for (i=0; i<CANFD_MAX_DLEN; i++) payload[i] = i;
+	can_dbc_tx_update(fd, payload, sizeof(payload));
+	can_dbc_tx_trigger(tx, fd);
+	ok = ok && n_frames==2 && last_id==301 && last_frame.len==CANFD_MAX_DLEN && (last_frame.flags & CANFD_FDF)
+		&& memcmp(last_frame.data, payload, CANFD_MAX_DLEN)==0;
+	printf("cyclicIfActive without cycle, CAN FD ..%s\n", ok? "ok": "fail");
+	can_dbc_tx_free(tx);
+	can_dbc_free(dbc);
+	return 0;
+}
+#endif//TEST_DBC_TX
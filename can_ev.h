@@ -2,6 +2,7 @@
 #define _CAN_EV_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <sys/can.h>
 
 #define CAN_SFF_ID_Pos  0
@@ -15,7 +16,8 @@ SG_ "name"  преобразуется в
 
 #define name##_Type -- тип: 'signed' 'unsigned' 'float' 'enumerated' 'boolean'
 #define name##_Name -- текстовая константа название параметра
-#define name##_Pos  -- позиция поля в битах
+#define name##_Start -- стартовый бит сигнала в описании DBC
+#define name##_Pos  -- позиция младшего бита поля в слове данных, в паре с name##_Msk
 #define name##_Bits -- длина поля в битах bit size
 #define name##_Msk  -- маска выделения сигнала ULL до 64 бит
 #define name##_Factor -- множитель для отображения значения
@@ -40,7 +42,40 @@ SG_ "name"  преобразуется в
 #define CAN_DBC_TYPE(obj) (obj##_Type)
 #define CAN_DBC_NAME(obj) #obj
 
+// чтение и запись данных кадра одним 64 битным словом, компилятор сводит к одной загрузке
+static inline uint64_t can_get_le64(const uint8_t* d) {
+	return (uint64_t)d[0]     | (uint64_t)d[1]<<8  | (uint64_t)d[2]<<16 | (uint64_t)d[3]<<24
+		 | (uint64_t)d[4]<<32 | (uint64_t)d[5]<<40 | (uint64_t)d[6]<<48 | (uint64_t)d[7]<<56;
+}
+static inline uint64_t can_get_be64(const uint8_t* d) {
+	return (uint64_t)d[7]     | (uint64_t)d[6]<<8  | (uint64_t)d[5]<<16 | (uint64_t)d[4]<<24
+		 | (uint64_t)d[3]<<32 | (uint64_t)d[2]<<40 | (uint64_t)d[1]<<48 | (uint64_t)d[0]<<56;
+}
+static inline void can_put_le64(uint8_t* d, uint64_t v) {
+	int i;
+	for (i=0; i<8; i++, v>>=8) d[i] = (uint8_t)v;
+}
+static inline void can_put_be64(uint8_t* d, uint64_t v) {
+	int i;
+	for (i=7; i>=0; i--, v>>=8) d[i] = (uint8_t)v;
+}
+static inline uint64_t can_bswap64(uint64_t v) {
+	v = (v & 0x00FF00FF00FF00FFULL)<<8  | (v>>8  & 0x00FF00FF00FF00FFULL);
+	v = (v & 0x0000FFFF0000FFFFULL)<<16 | (v>>16 & 0x0000FFFF0000FFFFULL);
+	return v<<32 | v>>32;
+}
+// округление физического значения при кодировании сигнала
+static inline int64_t can_dbc_round(double x) {
+	return (int64_t)(x<0? x-0.5: x+0.5);
+}
+
 // вычисление контрольной суммы кадра
 unsigned char can_j1850_crc(unsigned char* buf, size_t len);
+void can_j1850_crc_mb(const unsigned char* data, size_t stride, size_t len, unsigned char* crc, size_t n);
+// CRC-16/XMODEM блочной загрузки SDO CANopen
+uint16_t canopen_crc(unsigned char* data, size_t len);
+uint16_t canopen_crc_init(void);
+uint16_t canopen_crc_update(uint16_t crc, const void* data, size_t len);
+uint16_t canopen_crc_final(uint16_t crc);
 
-#endif//_CAN_EV_H 
\ No newline at end of file
+#endif//_CAN_EV_H 
\ No newline at end of file
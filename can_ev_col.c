@@ -0,0 +1,660 @@
+/*! \file can_ev_col.c
+
+	\brief Экспорт разобранных сигналов в столбцовый формат, см. can_ev_col.h
+
+	Кадры накапливаются в буфере сообщения: время приема и значения сигналов без
+	масштабирования, по столбцу на сигнал. Значения выделяются can_signal_value_fd() из данных
+	кадра, целые сигналы сохраняются точно. Когда в буфере сообщения набирается группа
+	строк, столбцы кодируются и записываются в файл, буфер используется для следующей
+	группы: память зависит от числа сообщений и размера группы, но не от длины записи.
+	Оглавление собирается в памяти и записывается при закрытии.
+
+	Словарное кодирование выбирается для группы: если значение сигнала не описано в VAL_,
+	столбец группы записывается без словаря.
+
+Тестирование:
+$ gcc -O2 -DTEST_CAN_COL -DCAN_DBC_LIB can_ev_col.c can_dbc.c -o col.exe `pkg-config --cflags --libs glib-2.0`
+$ ./col.exe
+ */
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "can_dbc.h"
+#include "can_ev_col.h"
+
+#define COL_BUFFER	(1u<<20)	//!< буфер записи файла
+#define COL_MIN_ROWS	64		//!< начальная емкость буфера сообщения
+
+/*! \brief имя и единицы измерения столбца времени, дописываются к таблице строк базы */
+static const char _col_strings[] = "ts\0ns";
+
+typedef struct _ColColumn ColColumn_t;
+struct _ColColumn {
+	uint64_t* raw;		//!< значения без масштабирования, 0 -- значение отсутствует
+	uint64_t* valid;	//!< битовая карта наличия значений
+};
+typedef struct _ColBuffer ColBuffer_t;
+struct _ColBuffer {
+	uint64_t* ts;
+	ColColumn_t* columns;	//!< по номеру сигнала в сообщении
+	uint32_t rows, cap;
+	uint64_t total;		//!< строк сообщения записано
+};
+typedef struct _ColWriter ColWriter_t;
+struct _ColWriter {
+	FILE* fp;
+	char* filename;
+	const can_dbc_t* dbc;
+	ColBuffer_t* buffers;	//!< по номеру сообщения в таблице сообщений
+	uint32_t* first;		//!< первый столбец сообщения в таблице столбцов
+	uint32_t group_rows;
+	uint64_t pos;			//!< смещение в файле
+	uint8_t* scratch;		//!< данные столбца группы
+	uint64_t* codes;		//!< номера значений словаря
+	can_col_group_t* groups;
+	uint32_t n_groups, groups_cap;
+	can_col_chunk_t* chunks;
+	uint32_t n_chunks, chunks_cap;
+	uint64_t rows;
+};
+
+/*! \brief запись с дополнением до границы 8 байт */
+static gboolean _write(ColWriter_t* w, const void* data, size_t size, GError** error)
+{
+	static const uint8_t pad[8] = {0};
+	const size_t tail = (8 - (size & 7)) & 7;
+	if (fwrite(data, 1, size, w->fp)!=size || fwrite(pad, 1, tail, w->fp)!=tail) {
+		int errsv = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", w->filename, g_strerror(errsv));
+		return FALSE;
+	}
+	w->pos += size + tail;
+	return TRUE;
+}
+/*! \brief ширина значения без словаря по типу и длине сигнала */
+static uint8_t _plain_width(const can_dbc_signal_t* sg)
+{
+	if (sg->type==_TYPE_REAL)   return 4;
+	if (sg->type==_TYPE_DOUBLE) return 8;
+	return sg->len<=8? 1: sg->len<=16? 2: sg->len<=32? 4: 8;
+}
+/*! \brief упаковка значений младшими байтами, little-endian */
+static void _pack(uint8_t* dst, const uint64_t* src, uint32_t n, uint8_t width)
+{
+	uint32_t k;
+	switch (width) {
+	case 1:
+		for (k=0; k<n; k++) dst[k] = (uint8_t)src[k];
+		break;
+	case 2:
+		for (k=0; k<n; k++) {
+			uint16_t v = GUINT16_TO_LE((uint16_t)src[k]);
+			memcpy(dst + 2*k, &v, 2);
+		}
+		break;
+	case 4:
+		for (k=0; k<n; k++) {
+			uint32_t v = GUINT32_TO_LE((uint32_t)src[k]);
+			memcpy(dst + 4*k, &v, 4);
+		}
+		break;
+	default:
+		for (k=0; k<n; k++) {
+			uint64_t v = GUINT64_TO_LE(src[k]);
+			memcpy(dst + 8*k, &v, 8);
+		}
+		break;
+	}
+}
+/*! \brief номер значения в словаре сигнала, значения упорядочены по возрастанию
+	\return -1 если значение не описано
+ */
+static int _dict_index(const can_dbc_enum_t* en, uint32_t n, int64_t val)
+{
+	uint32_t lo = 0, hi = n;
+	while (lo < hi) {
+		uint32_t mid = (lo + hi)>>1;
+		if (en[mid].val < val) lo = mid+1;
+		else hi = mid;
+	}
+	return (lo < n && en[lo].val==val)? (int)lo: -1;
+}
+static void _buffer_grow(ColBuffer_t* b, uint32_t n_columns, uint32_t cap)
+{
+	uint32_t k;
+	if (b->columns==NULL) b->columns = g_new0(ColColumn_t, n_columns);
+	b->ts = g_renew(uint64_t, b->ts, cap);
+	for (k=0; k<n_columns; k++) {
+		b->columns[k].raw   = g_renew(uint64_t, b->columns[k].raw, cap);
+		b->columns[k].valid = g_renew(uint64_t, b->columns[k].valid, (cap+63)>>6);
+	}
+	b->cap = cap;
+}
+static void _buffer_free(ColBuffer_t* b, uint32_t n_columns)
+{
+	uint32_t k;
+	if (b->columns!=NULL) {
+		for (k=0; k<n_columns; k++) {
+			g_free(b->columns[k].raw);
+			g_free(b->columns[k].valid);
+		}
+		g_free(b->columns);
+	}
+	g_free(b->ts);
+}
+/*! \brief кодирование и запись столбца сигнала в группе
+
+	Статистика вычисляется по значениям без масштабирования и переводится в физические
+	единицы по factor и offset сигнала, для сигналов float -- по физическим значениям.
+ */
+static gboolean _column_write(ColWriter_t* w, const can_dbc_signal_t* sg, const ColColumn_t* col, uint32_t n,
+		can_col_chunk_t* ch, GError** error)
+{
+	const uint32_t words = (n+63)>>6;
+	uint32_t k, count = 0;
+	for (k=0; k<words; k++)
+		count += __builtin_popcountll(col->valid[k]);
+	ch->offset = w->pos;
+	ch->count = count;
+	ch->encoding = CAN_COL_PLAIN;
+	ch->width = _plain_width(sg);
+	if (count==0) return TRUE;
+	const can_dbc_enum_t* en = sg->en_size? w->dbc->enum_table + sg->enums: NULL;
+	gboolean dict = en!=NULL;
+	const gboolean real = sg->type==_TYPE_REAL || sg->type==_TYPE_DOUBLE;
+	int64_t  s_min = INT64_MAX, s_max = INT64_MIN;
+	uint64_t u_min = UINT64_MAX, u_max = 0;
+	double   f_min = INFINITY, f_max = -INFINITY;
+	for (k=0; k<n; k++) {
+		w->codes[k] = 0;
+		if (!(col->valid[k>>6]>>(k & 63) & 1)) continue;
+		const uint64_t raw = col->raw[k];
+		if (real) {
+			const double v = can_signal_phys(sg, raw);
+			if (v < f_min) f_min = v;
+			if (v > f_max) f_max = v;
+		} else if (sg->type==_TYPE_INTEGER) {
+			if ((int64_t)raw < s_min) s_min = raw;
+			if ((int64_t)raw > s_max) s_max = raw;
+		} else {
+			if (raw < u_min) u_min = raw;
+			if (raw > u_max) u_max = raw;
+		}
+		if (dict) {
+			const int idx = _dict_index(en, sg->en_size, (int64_t)raw);
+			if (idx<0) dict = FALSE;
+			else w->codes[k] = idx;
+		}
+	}
+	if (!real) {
+		f_min = sg->type==_TYPE_INTEGER? can_signal_phys(sg, s_min): can_signal_phys(sg, u_min);
+		f_max = sg->type==_TYPE_INTEGER? can_signal_phys(sg, s_max): can_signal_phys(sg, u_max);
+		if (f_min > f_max) {// factor < 0
+			const double v = f_min;
+			f_min = f_max;
+			f_max = v;
+		}
+	}
+	ch->min = f_min;
+	ch->max = f_max;
+	if (dict) {
+		ch->encoding = CAN_COL_DICT;
+		ch->width = sg->en_size <= 0x100? 1: 2;
+	}
+	uint8_t* p = w->scratch;
+	size_t size = 0;
+	if (count < n) {
+		ch->flags = CAN_COL_NULLS;
+		_pack(p, col->valid, words, 8);
+		size = words*8;
+	}
+	_pack(p + size, dict? w->codes: col->raw, n, ch->width);
+	size += (size_t)n*ch->width;
+	ch->size = size;
+	return _write(w, p, size, error);
+}
+/*! \brief запись группы строк сообщения, буфер сообщения освобождается для следующей группы */
+static gboolean _group_flush(ColWriter_t* w, uint32_t idx, GError** error)
+{
+	ColBuffer_t* b = &w->buffers[idx];
+	const can_dbc_object_t* obj = &w->dbc->object_table[idx];
+	const uint32_t n = b->rows;
+	if (n==0) return TRUE;
+	if (w->n_groups==w->groups_cap) {
+		w->groups_cap = w->groups_cap? w->groups_cap*2: 256;
+		w->groups = g_renew(can_col_group_t, w->groups, w->groups_cap);
+	}
+	if (w->n_chunks + obj->sg_size + 1 > w->chunks_cap) {
+		w->chunks_cap = MAX(w->chunks_cap*2, w->n_chunks + obj->sg_size + 1);
+		w->chunks = g_renew(can_col_chunk_t, w->chunks, w->chunks_cap);
+	}
+	can_col_group_t* gr = &w->groups[w->n_groups++];
+	can_col_chunk_t* ch = &w->chunks[w->n_chunks];
+	memset(ch, 0, (obj->sg_size + 1)*sizeof(can_col_chunk_t));
+	*gr = (can_col_group_t){.object = idx, .rows = n, .chunks = w->n_chunks, .ts_min = UINT64_MAX};
+	w->n_chunks += obj->sg_size + 1;
+	uint32_t k;
+	for (k=0; k<n; k++) {
+		if (b->ts[k] < gr->ts_min) gr->ts_min = b->ts[k];
+		if (b->ts[k] > gr->ts_max) gr->ts_max = b->ts[k];
+	}
+	*ch = (can_col_chunk_t){.offset = w->pos, .size = n*8ull, .column = w->first[idx], .count = n,
+		.encoding = CAN_COL_PLAIN, .width = 8, .min = gr->ts_min, .max = gr->ts_max};
+	_pack(w->scratch, b->ts, n, 8);
+	if (!_write(w, w->scratch, ch->size, error)) return FALSE;
+	const can_dbc_signal_t* sg = can_dbc_object_signals(w->dbc, obj);
+	for (k=0; k<obj->sg_size; k++) {
+		ch[k+1].column = w->first[idx] + k+1;
+		if (!_column_write(w, &sg[k], &b->columns[k], n, &ch[k+1], error)) return FALSE;
+	}
+	b->total += n;
+	b->rows = 0;
+	w->rows += n;
+	return TRUE;
+}
+/*! \brief перевод полей оглавления в little-endian на месте, на little-endian платформе пусто */
+static inline void _le32(void* p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	v = GUINT32_TO_LE(v);
+	memcpy(p, &v, 4);
+}
+static inline void _le64(void* p)// uint64_t и double
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	v = GUINT64_TO_LE(v);
+	memcpy(p, &v, 8);
+}
+static void _footer_to_le(can_col_footer_t* hdr)
+{
+	uint32_t* u32[] = {&hdr->version, &hdr->header_size, &hdr->n_objects, &hdr->n_columns, &hdr->n_dict,
+		&hdr->n_groups, &hdr->n_chunks, &hdr->str_size};
+	uint64_t* u64[] = {&hdr->rows, &hdr->objects, &hdr->columns, &hdr->dict, &hdr->groups, &hdr->chunks, &hdr->strings};
+	uint32_t i;
+	for (i=0; i<G_N_ELEMENTS(u32); i++) _le32(u32[i]);
+	for (i=0; i<G_N_ELEMENTS(u64); i++) _le64(u64[i]);
+}
+static void _tables_to_le(can_col_object_t* objects, uint32_t n_objects, can_col_column_t* columns, uint32_t n_columns,
+		can_col_dict_t* dict, uint32_t n_dict, can_col_group_t* groups, uint32_t n_groups,
+		can_col_chunk_t* chunks, uint32_t n_chunks)
+{
+	uint32_t i;
+	for (i=0; i<n_objects; i++) {
+		can_col_object_t* o = &objects[i];
+		_le32(&o->oid), _le32(&o->name), _le32(&o->columns), _le32(&o->n_columns), _le64(&o->rows);
+	}
+	for (i=0; i<n_columns; i++) {
+		can_col_column_t* c = &columns[i];
+		_le32(&c->name), _le32(&c->units), _le32(&c->dict), _le32(&c->n_dict);
+		_le64(&c->factor), _le64(&c->offset), _le64(&c->min), _le64(&c->max);
+	}
+	for (i=0; i<n_dict; i++)
+		_le64(&dict[i].val), _le32(&dict[i].name);
+	for (i=0; i<n_groups; i++) {
+		can_col_group_t* g = &groups[i];
+		_le32(&g->object), _le32(&g->rows), _le64(&g->ts_min), _le64(&g->ts_max), _le32(&g->chunks);
+	}
+	for (i=0; i<n_chunks; i++) {
+		can_col_chunk_t* c = &chunks[i];
+		_le64(&c->offset), _le64(&c->size), _le32(&c->column), _le32(&c->count), _le64(&c->min), _le64(&c->max);
+	}
+}
+/*! \brief оглавление: описание сообщений и сигналов базы, группы и столбцы групп
+
+	Таблицы групп и столбцов групп переводятся в little-endian на месте, после записи
+	оглавления они не используются.
+ */
+static gboolean _footer_write(ColWriter_t* w, GError** error)
+{
+	const can_dbc_t* dbc = w->dbc;
+	const uint64_t footer = w->pos;
+	can_col_footer_t hdr = {
+		.version = CAN_COL_VERSION,
+		.header_size = sizeof(can_col_footer_t),
+		.n_objects = dbc->bo_size,
+		.n_columns = dbc->bo_size + dbc->sg_size,
+		.n_dict = dbc->en_size,
+		.n_groups = w->n_groups,
+		.n_chunks = w->n_chunks,
+		.str_size = dbc->str_size + sizeof(_col_strings),
+		.rows = w->rows,
+	};
+	hdr.objects = sizeof(can_col_footer_t);
+	hdr.columns = hdr.objects + hdr.n_objects*(uint64_t)sizeof(can_col_object_t);
+	hdr.dict    = hdr.columns + hdr.n_columns*(uint64_t)sizeof(can_col_column_t);
+	hdr.groups  = hdr.dict    + hdr.n_dict*(uint64_t)sizeof(can_col_dict_t);
+	hdr.chunks  = hdr.groups  + hdr.n_groups*(uint64_t)sizeof(can_col_group_t);
+	hdr.strings = hdr.chunks  + hdr.n_chunks*(uint64_t)sizeof(can_col_chunk_t);
+	can_col_object_t* objects = g_new(can_col_object_t, hdr.n_objects);
+	can_col_column_t* columns = g_new0(can_col_column_t, hdr.n_columns);
+	can_col_dict_t* dict = g_new(can_col_dict_t, hdr.n_dict);
+	char* strings = g_malloc(hdr.str_size);
+	uint32_t i, k;
+	for (i=0; i<dbc->bo_size; i++) {
+		const can_dbc_object_t* obj = &dbc->object_table[i];
+		objects[i] = (can_col_object_t){.oid = obj->oid, .name = obj->name, .columns = w->first[i],
+			.n_columns = obj->sg_size + 1, .rows = w->buffers[i].total};
+		can_col_column_t* col = &columns[w->first[i]];
+		*col = (can_col_column_t){.name = dbc->str_size, .units = dbc->str_size + 3, .type = _TYPE_UNSIGNED,
+			.bits = 64, .width = 8, .factor = 1, .offset = 0};
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+		for (k=0; k<obj->sg_size; k++, sg++) {
+			col[k+1] = (can_col_column_t){.name = sg->name, .units = sg->units, .type = sg->type,
+				.bits = sg->len, .width = _plain_width(sg), .dict = sg->enums, .n_dict = sg->en_size,
+				.factor = sg->factor, .offset = sg->offset, .min = sg->min, .max = sg->max};
+		}
+	}
+	for (i=0; i<dbc->en_size; i++)
+		dict[i] = (can_col_dict_t){.val = dbc->enum_table[i].val, .name = dbc->enum_table[i].name};
+	memcpy(strings, dbc->strings, dbc->str_size);
+	memcpy(strings + dbc->str_size, _col_strings, sizeof(_col_strings));
+	can_col_trailer_t trailer = {.footer = footer, .magic = CAN_COL_MAGIC};
+	_le64(&trailer.footer);
+	const can_col_footer_t n = hdr;
+	_footer_to_le(&hdr);
+	_tables_to_le(objects, n.n_objects, columns, n.n_columns, dict, n.n_dict, w->groups, n.n_groups, w->chunks, n.n_chunks);
+	gboolean ok = _write(w, &hdr, sizeof(hdr), error)
+		&& _write(w, objects, n.n_objects*sizeof(can_col_object_t), error)
+		&& _write(w, columns, n.n_columns*sizeof(can_col_column_t), error)
+		&& _write(w, dict,    n.n_dict*sizeof(can_col_dict_t), error)
+		&& _write(w, w->groups, n.n_groups*sizeof(can_col_group_t), error)
+		&& _write(w, w->chunks, n.n_chunks*sizeof(can_col_chunk_t), error)
+		&& _write(w, strings, n.str_size, error)
+		&& _write(w, &trailer, sizeof(trailer), error);
+	g_free(objects);
+	g_free(columns);
+	g_free(dict);
+	g_free(strings);
+	return ok;
+}
+static gboolean _col_begin(void* user, const can_dbc_t* dbc, GError** error)
+{
+	(void)error;
+	ColWriter_t* w = user;
+	uint32_t i, first = 0;
+	w->dbc = dbc;
+	w->buffers = g_new0(ColBuffer_t, dbc->bo_size);
+	w->first = g_new(uint32_t, dbc->bo_size);
+	for (i=0; i<dbc->bo_size; i++) {
+		w->first[i] = first;
+		first += dbc->object_table[i].sg_size + 1;
+	}
+	w->scratch = g_new(uint8_t, (size_t)w->group_rows*8 + ((w->group_rows+63)>>6)*8);
+	w->codes = g_new(uint64_t, w->group_rows);
+	return TRUE;
+}
+/*! \brief кадры добавляются в буферы сообщений, сигналы вне выбранной страницы
+	мультиплексора и за длиной кадра отмечаются как отсутствующие
+ */
+static gboolean _col_rows(void* user, const can_dbc_t* dbc, const can_dbc_row_t* rows, uint32_t n, GError** error)
+{
+	ColWriter_t* w = user;
+	uint32_t i, k;
+	for (i=0; i<n; i++) {
+		const can_dbc_row_t* row = &rows[i];
+		const can_dbc_object_t* obj = row->object;
+		const uint32_t idx = obj - dbc->object_table;
+		ColBuffer_t* b = &w->buffers[idx];
+		if (b->rows==b->cap) {
+			if (b->cap==w->group_rows) {
+				if (!_group_flush(w, idx, error)) return FALSE;
+			} else
+				_buffer_grow(b, obj->sg_size, MIN(MAX(b->cap*2, COL_MIN_ROWS), w->group_rows));
+		}
+		struct canfd_frame frame = {.can_id = row->can_id, .len = MIN(row->len, can_dbc_object_dlen(obj))};
+		memcpy(frame.data, row->data, frame.len);
+		const uint32_t r = b->rows++;
+		const uint64_t bit = 1ULL<<(r & 63);
+		uint32_t first = 0, last = 0;
+		if (row->page!=NULL) {
+			first = row->page->signals - obj->signals;
+			last  = first + row->page->sg_size;
+		}
+		b->ts[r] = row->ts;
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+		for (k=0; k<obj->sg_size; k++, sg++) {
+			ColColumn_t* col = &b->columns[k];
+			if (bit==1) col->valid[r>>6] = 0;
+			if ((k < obj->base_size || (k >= first && k < last)) && sg->len!=0 && can_signal_bytes(sg) <= frame.len) {
+				col->raw[r] = can_signal_value_fd(&frame, sg);
+				col->valid[r>>6] |= bit;
+			} else
+				col->raw[r] = 0;
+		}
+	}
+	return TRUE;
+}
+static gboolean _col_end(void* user, GError** error)
+{
+	ColWriter_t* w = user;
+	gboolean ok = TRUE;
+	uint32_t i;
+	if (w->dbc!=NULL) {
+		for (i=0; i<w->dbc->bo_size && ok; i++)
+			ok = _group_flush(w, i, error);
+		ok = ok && _footer_write(w, error);
+		for (i=0; i<w->dbc->bo_size; i++)
+			_buffer_free(&w->buffers[i], w->dbc->object_table[i].sg_size);
+	}
+	if (fclose(w->fp)!=0 && ok) {
+		int errsv = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", w->filename, g_strerror(errsv));
+		ok = FALSE;
+	}
+	g_free(w->buffers);
+	g_free(w->first);
+	g_free(w->scratch);
+	g_free(w->codes);
+	g_free(w->groups);
+	g_free(w->chunks);
+	g_free(w->filename);
+	g_free(w);
+	return ok;
+}
+/*! \brief получатель: разобранные кадры записываются в столбцовый файл группами строк
+	\param group_rows - строк в группе, 0 -- CAN_COL_GROUP_ROWS
+ */
+gboolean can_dbc_export_columns(can_dbc_exporter_t* exporter, const char* filename, uint32_t group_rows, GError** error)
+{
+	FILE* fp = fopen(filename, "wb");
+	if (fp==NULL) {
+		int errsv = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", filename, g_strerror(errsv));
+		return FALSE;
+	}
+	setvbuf(fp, NULL, _IOFBF, COL_BUFFER);
+	ColWriter_t* w = g_new0(ColWriter_t, 1);
+	w->fp = fp;
+	w->filename = g_strdup(filename);
+	w->group_rows = group_rows? group_rows: CAN_COL_GROUP_ROWS;
+	if (!_write(w, CAN_COL_MAGIC, 8, error)) {
+		_col_end(w, NULL);
+		return FALSE;
+	}
+	*exporter = (can_dbc_exporter_t){.begin = _col_begin, .rows = _col_rows, .end = _col_end, .user = w};
+	return TRUE;
+}
+
+#ifdef TEST_CAN_COL
+/*! \brief значение столбца группы без масштабирования */
+static uint64_t _test_value(const uint8_t* data, const can_col_chunk_t* ch, uint32_t rows, uint32_t k)
+{
+	const uint8_t* p = data + ch->offset + ((ch->flags & CAN_COL_NULLS)? ((rows+63)>>6)*8: 0) + k*ch->width;
+	uint64_t v = 0;
+	memcpy(&v, p, ch->width);
+	return GUINT64_FROM_LE(v);
+}
+static gboolean _test_present(const uint8_t* data, const can_col_chunk_t* ch, uint32_t k)
+{
+	return !(ch->flags & CAN_COL_NULLS) || (data[ch->offset + (k>>3)]>>(k & 7) & 1);
+}
+/*! значение SNA 0xFFFFFFFF сигнала 32 бит без знака кодируется словарем */
+static int _test_sna(const char* filename)
+{
+	const char* text =
+		"BO_ 300 S: 8 ECU\n"
+		" SG_ V : 0|32@1+ (1,0) [0|0] \"\" ECU\n"
+		"VAL_ 300 V 0 \"Off\" 1 \"On\" 4294967295 \"SNA\" ;\n";
+	can_dbc_t* dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text, strlen(text), NULL, NULL);
+	can_dbc_compile(dbc);
+	const can_dbc_object_t* obj = can_dbc_lookup(dbc, 300);
+	static const uint32_t v[] = {1, 0xFFFFFFFFu, 0};
+	struct can_frame f[3];
+	can_dbc_row_t rows[3];
+	double values[3];
+	uint32_t k;
+	for (k=0; k<3; k++) {
+		f[k] = (struct can_frame){.can_id = 300, .len = 8};
+		memcpy(f[k].data, &v[k], 4);// little-endian
+		rows[k] = (can_dbc_row_t){.ts = k, .object = obj, .values = &values[k], .data = f[k].data, .can_id = 300, .len = 8};
+		rows[k].page = can_dbc_decode_mux(dbc, obj, &f[k], &values[k]);
+	}
+	can_dbc_exporter_t ex;
+	GError* error = NULL;
+	gboolean ok = can_dbc_export_columns(&ex, filename, 0, &error) && ex.begin(ex.user, dbc, &error)
+		&& ex.rows(ex.user, dbc, rows, 3, &error);
+	ok = ex.end(ex.user, ok? &error: NULL) && ok;
+	gchar* data = NULL;
+	gsize size = 0;
+	int fail = !ok || !g_file_get_contents(filename, &data, &size, NULL);
+	if (!fail) {
+		const can_col_trailer_t* tr = (const can_col_trailer_t*)(data + size - sizeof(can_col_trailer_t));
+		const can_col_footer_t* hdr = (const can_col_footer_t*)(data + tr->footer);
+		const uint8_t* base = (const uint8_t*)hdr;
+		const can_col_chunk_t* ch = (const can_col_chunk_t*)(base + hdr->chunks);
+		const can_col_dict_t* dict = (const can_col_dict_t*)(base + hdr->dict);
+		fail = hdr->n_dict!=3 || ch[1].encoding!=CAN_COL_DICT;
+		for (k=0; k<3 && !fail; k++) {
+			const uint64_t code = _test_value((const uint8_t*)data, &ch[1], 3, k);
+			if (code>=3 || (uint64_t)dict[code].val!=v[k]) fail++;
+		}
+		if (!fail) printf("dict: SNA %" G_GINT64_FORMAT " -> %s ..ok\n", (gint64)dict[2].val, can_dbc_string(dbc, dict[2].name));
+	}
+	if (fail) printf("dict: SNA 0xFFFFFFFF ..fail\n");
+	g_clear_error(&error);
+	g_free(data);
+	remove(filename);
+	can_dbc_free(dbc);
+	return fail;
+}
+int main(int argc, char* argv[])
+{
+	const char* text =
+		"BO_ 100 A: 8 ECU\n"
+		" SG_ Gear : 0|4@1+ (1,0) [0|15] \"\" ECU\n"
+		" SG_ Temp : 8|8@1- (0.5,-10) [-74|53.5] \"C\" ECU\n"
+		" SG_ Speed : 16|16@1+ (0.01,0) [0|655.35] \"km/h\" ECU\n"
+		"BO_ 2364540158 MUX: 8 ECU\n"
+		" SG_ Page M : 0|8@1+ (1,0) [0|255] \"\" ECU\n"
+		" SG_ P0 m0 : 8|16@1+ (1,0) [0|0] \"\" ECU\n"
+		" SG_ P1 m1 : 8|32@1+ (1,0) [0|0] \"\" ECU\n"
+		"VAL_ 100 Gear 0 \"P\" 1 \"R\" 2 \"N\" 3 \"D\" ;\n";
+	can_dbc_t* dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text, strlen(text), NULL, NULL);
+	can_dbc_compile(dbc);
+	const can_dbc_object_t* a   = can_dbc_lookup(dbc, 100);
+	const can_dbc_object_t* mux = can_dbc_lookup(dbc, 2364540158u);
+	const uint32_t N = argc>1? atoi(argv[1]): 1000000, batch = 4096;
+	struct can_frame* frames = g_new0(struct can_frame, batch);
+	can_dbc_row_t* rows = g_new0(can_dbc_row_t, batch);
+	double* values = g_new(double, batch*8);
+	gchar* filename = NULL;
+	int fd = g_file_open_tmp("test-XXXXXX.cols", &filename, NULL);
+	if (fd>=0) g_close(fd, NULL);
+	can_dbc_exporter_t ex;
+	GError* error = NULL;
+	gboolean ok = can_dbc_export_columns(&ex, filename, 0, &error) && ex.begin(ex.user, dbc, &error);
+	uint64_t x = 1;
+	uint32_t i, k;
+	gint64 t = g_get_monotonic_time();
+	for (i=0; i<N && ok; i+=batch) {
+		const uint32_t n = MIN(batch, N-i);
+		for (k=0; k<n; k++) {
+			x = x*6364136223846793005ULL + 1442695040888963407ULL;
+			struct can_frame* f = &frames[k];
+			const can_dbc_object_t* obj = (i+k)&1? mux: a;
+			f->can_id = obj->oid;
+			f->len = 8;
+			memcpy(f->data, &x, 8);
+			if (obj==a) f->data[0] = (i+k==((N-1)&~1u))? 7: (x>>62);// последнее значение не описано в VAL_
+			else f->data[0] = (x>>63);
+			rows[k] = (can_dbc_row_t){.ts = 1700000000000000000ull + (i+k)*1000ull, .object = obj,
+				.values = values + 8*k, .data = f->data, .can_id = f->can_id, .len = f->len};
+			rows[k].page = can_dbc_decode_mux(dbc, obj, f, values + 8*k);
+		}
+		ok = ex.rows(ex.user, dbc, rows, n, &error);
+	}
+	ok = ex.end(ex.user, ok? &error: NULL) && ok;
+	t = g_get_monotonic_time() - t;
+	// чтение: оглавление, столбцы сигналов Temp и Gear сообщения A, страницы мультиплексора
+	GMappedFile* mapped = ok? g_mapped_file_new(filename, FALSE, &error): NULL;
+	ok = mapped!=NULL;
+	const uint8_t* data = ok? (const uint8_t*)g_mapped_file_get_contents(mapped): NULL;
+	const size_t size = ok? g_mapped_file_get_length(mapped): 0;
+	const can_col_trailer_t* tr = (const can_col_trailer_t*)(data + size - sizeof(can_col_trailer_t));
+	ok = ok && memcmp(data, CAN_COL_MAGIC, 8)==0 && memcmp(tr->magic, CAN_COL_MAGIC, 8)==0;
+	const can_col_footer_t* hdr = ok? (const can_col_footer_t*)(data + tr->footer): NULL;
+	ok = ok && hdr->version==CAN_COL_VERSION && hdr->rows==N && hdr->n_objects==2;
+	uint64_t fail = 0, dict_groups = 0, a_rows = 0, p0 = 0, p1 = 0;
+	if (ok) {
+		const uint8_t* base = (const uint8_t*)hdr;
+		const can_col_object_t* objects = (const can_col_object_t*)(base + hdr->objects);
+		const can_col_column_t* columns = (const can_col_column_t*)(base + hdr->columns);
+		const can_col_group_t*  groups  = (const can_col_group_t*) (base + hdr->groups);
+		const can_col_chunk_t*  chunks  = (const can_col_chunk_t*) (base + hdr->chunks);
+		const char* strings = (const char*)(base + hdr->strings);
+		const uint32_t ia = a - dbc->object_table, im = mux - dbc->object_table;
+		const can_col_column_t* temp = &columns[objects[ia].columns + 2];
+		if (strcmp(strings + temp->name, "Temp")!=0 || strcmp(strings + columns[objects[ia].columns].name, "ts")!=0) fail++;
+		for (i=0; i<hdr->n_groups; i++) {
+			const can_col_group_t* gr = &groups[i];
+			const can_col_chunk_t* ch = &chunks[gr->chunks];
+			if (gr->object==ia) {
+				a_rows += gr->rows;
+				if (ch[1].encoding==CAN_COL_DICT) dict_groups++;
+				double t_min = INFINITY, t_max = -INFINITY;
+				for (k=0; k<gr->rows; k++) {
+					const uint64_t ts = _test_value(data, &ch[0], gr->rows, k);
+					const double v = (int8_t)_test_value(data, &ch[2], gr->rows, k)*temp->factor + temp->offset;
+					t_min = MIN(t_min, v);
+					t_max = MAX(t_max, v);
+					const uint64_t gear = _test_value(data, &ch[1], gr->rows, k);
+					const uint64_t row = (ts - 1700000000000000000ull)/1000;
+					if ((row & 1) || (ch[1].encoding==CAN_COL_DICT && gear > 3)) fail++;
+					if (ch[1].encoding==CAN_COL_DICT) {
+						const can_col_dict_t* d = (const can_col_dict_t*)(base + hdr->dict) + columns[objects[ia].columns+1].dict;
+						if (d[gear].val!=(int64_t)gear) fail++;
+					}
+				}
+				if (t_min!=ch[2].min || t_max!=ch[2].max) fail++;
+			} else if (gr->object==im) {
+				if (!(ch[2].flags & CAN_COL_NULLS) || ch[2].count + ch[3].count != gr->rows) fail++;
+				for (k=0; k<gr->rows; k++)
+					if (_test_present(data, &ch[2], k) == _test_present(data, &ch[3], k)) fail++;
+				p0 += ch[2].count;
+				p1 += ch[3].count;
+			}
+		}
+		// последняя группа A содержит значение вне VAL_ и записана без словаря
+		ok = a_rows==objects[ia].rows && a_rows==(N+1)/2 && dict_groups+1==objects[ia].rows/CAN_COL_GROUP_ROWS +
+			(objects[ia].rows%CAN_COL_GROUP_ROWS!=0) && p0+p1==N/2;
+	}
+	printf("columns: %u rows, %u groups, %.1f MB, %.1f Mrows/s, %.1f bytes/row ..%s\n", N, ok? hdr->n_groups: 0,
+		size*1e-6, N/(double)t, size/(double)N, ok && fail==0? "ok": "fail");
+	if (error) printf("%s\n", error->message);
+	g_clear_error(&error);
+	if (mapped) g_mapped_file_unref(mapped);
+	remove(filename);
+	fail += _test_sna(filename);
+	g_free(filename);
+	g_free(frames);
+	g_free(rows);
+	g_free(values);
+	can_dbc_free(dbc);
+	return 0;
+}
+#endif//TEST_CAN_COL
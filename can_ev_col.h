@@ -0,0 +1,105 @@
+#ifndef CAN_EV_COL_H
+#define CAN_EV_COL_H
+/*! \file can_ev_col.h
+
+	\brief Столбцовый двоичный формат записи разобранных сигналов
+
+	Файл: сигнатура CAN_COL_MAGIC, группы строк, оглавление, концевик can_col_trailer_t.
+	Группа строк содержит кадры одного сообщения BO_: столбец времени приема и по столбцу
+	на каждый сигнал SG_ сообщения. Данные столбцов группы записываются подряд с выравниванием
+	на 8 байт, оглавление задает смещение, размер, кодирование и статистику каждого столбца
+	группы: при чтении выбранных сигналов остальные столбцы не читаются, группы
+	отбираются по времени и по min/max без чтения данных.
+
+	Значения хранятся без масштабирования, целыми шириной 1, 2, 4 или 8 байт по длине
+	сигнала, физическое значение raw*factor+offset задает описание столбца. Сигналы с
+	таблицей VAL_ кодируются номером значения в словаре сигнала, если все значения группы
+	описаны в таблице. Статистика min/max -- в физических единицах. Если сигнал есть не во
+	всех кадрах группы (страница мультиплексора, короткий кадр), перед значениями
+	записывается битовая карта наличия, значения отсутствующих строк -- нули.
+
+	Оглавление: заголовок can_col_footer_t, таблицы сообщений, столбцов, словаря, групп,
+	столбцов групп и строк, смещения таблиц -- от начала оглавления. Порядок байт little-endian
+	во всех полях оглавления и данных, включая double; структуры оглавления без выравнивающих
+	промежутков и записываются как есть после перевода полей.
+ */
+#include <stdint.h>
+
+#define CAN_COL_MAGIC	"CANCOL01"
+#define CAN_COL_VERSION	2
+#define CAN_COL_GROUP_ROWS	16384	//!< строк в группе по умолчанию
+
+enum {
+	CAN_COL_PLAIN,	//!< значения без масштабирования
+	CAN_COL_DICT,	//!< номер значения в словаре сигнала, ширина 1 или 2 байта
+};
+#define CAN_COL_NULLS	0x01	//!< перед значениями битовая карта наличия, бит на строку
+
+typedef struct _can_col_footer can_col_footer_t;
+struct _can_col_footer {
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t n_objects, n_columns, n_dict, n_groups, n_chunks, str_size;
+	uint64_t rows;		//!< строк во всех группах
+	uint64_t objects, columns, dict, groups, chunks, strings;// смещения таблиц
+};
+/*! \brief сообщение BO_, первый столбец сообщения -- время приема, нс */
+typedef struct _can_col_object can_col_object_t;
+struct _can_col_object {
+	uint32_t oid;		//!< идентификатор сообщения, CAN_EFF_FLAG для расширенного формата
+	uint32_t name;		//!< смещение имени в таблице строк
+	uint32_t columns;	//!< первый столбец сообщения в таблице столбцов
+	uint32_t n_columns;	//!< число столбцов, включая время
+	uint64_t rows;
+};
+/*! \brief столбец: описание сигнала SG_ */
+typedef struct _can_col_column can_col_column_t;
+struct _can_col_column {
+	uint32_t name;
+	uint32_t units;
+	uint8_t  type;		//!< тип значения _TYPE_*
+	uint8_t  bits;		//!< длина сигнала в битах
+	uint8_t  width;		//!< байт на значение при кодировании CAN_COL_PLAIN
+	uint8_t  reserved;
+	uint32_t dict;		//!< первое значение в таблице словаря
+	uint32_t n_dict;	//!< число значений VAL_, 0 -- не перечисление
+	uint32_t reserved2;
+	double factor, offset;
+	double min, max;	//!< диапазон [min|max] описания сигнала
+};
+/*! \brief значение словаря, значения сигнала упорядочены по возрастанию как int64_t:
+	значения 64 битных сигналов без знака больше INT64_MAX записываются в дополнительном коде
+ */
+typedef struct _can_col_dict can_col_dict_t;
+struct _can_col_dict {
+	int64_t  val;		//!< значение VAL_ без масштабирования
+	uint32_t name;
+	uint32_t reserved;
+};
+typedef struct _can_col_group can_col_group_t;
+struct _can_col_group {
+	uint32_t object;	//!< номер сообщения в таблице сообщений
+	uint32_t rows;
+	uint64_t ts_min, ts_max;
+	uint32_t chunks;	//!< первый столбец группы в таблице столбцов групп, по числу столбцов сообщения
+	uint32_t reserved;
+};
+/*! \brief данные столбца в группе */
+typedef struct _can_col_chunk can_col_chunk_t;
+struct _can_col_chunk {
+	uint64_t offset;	//!< смещение данных от начала файла
+	uint64_t size;		//!< 0 -- в группе нет значений
+	uint32_t column;
+	uint32_t count;		//!< число значений без учета отсутствующих
+	uint8_t  encoding;	//!< CAN_COL_PLAIN или CAN_COL_DICT
+	uint8_t  width;
+	uint8_t  flags;		//!< CAN_COL_NULLS
+	uint8_t  reserved[5];
+	double min, max;
+};
+typedef struct _can_col_trailer can_col_trailer_t;
+struct _can_col_trailer {
+	uint64_t footer;	//!< смещение оглавления от начала файла
+	char magic[8];
+};
+#endif//CAN_EV_COL_H
@@ -0,0 +1,150 @@
+#ifndef CAN_EV_FMT_H
+#define CAN_EV_FMT_H
+/*! \file can_ev_fmt.h
+
+	\brief Запись чисел в текст для экспорта JSON и SQL
+
+	Функции пишут в буфер вызывающей стороны и возвращают указатель за последним
+	символом, завершающий ноль не записывается. Число занимает не более CAN_FMT_NUMBER
+	символов.
+
+	Физическое значение сигнала выводится с числом знаков после точки, которое задают
+	factor и offset (0.01 -- два знака), незначащие нули отбрасываются: это кратчайшая
+	запись значения с разрешением сигнала. Целые и значения с десятичным разрешением
+	записываются без printf.
+
+	Если разрешение не десятичное (сигналы float и double, factor 1/3) или значение вне
+	диапазона точных целых double, can_fmt_general() выводит кратчайшую запись, однозначно
+	восстанавливающую значение, через snprintf("%.*g") с 15..17 знаками и проверкой strtod().
+	Этот путь медленнее и требует LC_NUMERIC "C". can_fmt_decimals() также использует
+	snprintf, она вызывается при подготовке экспорта, а не на каждый кадр.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAN_FMT_NUMBER		32		//!< наибольшая длина числа
+#define CAN_FMT_DECIMALS	9		//!< наибольшее число знаков после точки
+#define CAN_FMT_GENERAL		0xFF	//!< разрешение не десятичное
+
+static const char can_fmt_digits[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/*! \brief целое без знака, по два разряда за шаг */
+static inline char* can_fmt_u64(char* p, uint64_t v)
+{
+	char tmp[20];
+	char* t = tmp + sizeof(tmp);
+	while (v >= 100) {
+		const uint32_t r = v % 100;
+		v /= 100;
+		t -= 2;
+		memcpy(t, can_fmt_digits + 2*r, 2);
+	}
+	if (v >= 10) {
+		t -= 2;
+		memcpy(t, can_fmt_digits + 2*v, 2);
+	} else
+		*--t = '0' + v;
+	const size_t n = tmp + sizeof(tmp) - t;
+	memcpy(p, t, n);
+	return p + n;
+}
+static inline char* can_fmt_i64(char* p, int64_t v)
+{
+	if (v < 0) {
+		*p++ = '-';
+		return can_fmt_u64(p, -(uint64_t)v);
+	}
+	return can_fmt_u64(p, v);
+}
+/*! \brief кратчайшая запись double, однозначно восстанавливающая значение
+
+	Целые до 2^53 записываются без printf, остальные значения -- snprintf("%.*g").
+	\param inf - запись бесконечности и NaN: "null" для JSON, "NULL" для SQL
+ */
+static inline char* can_fmt_general(char* p, double v, const char* inf)
+{
+	if (!isfinite(v)) {
+		const size_t n = strlen(inf);
+		memcpy(p, inf, n);
+		return p + n;
+	}
+	if (v==(double)(int64_t)v && fabs(v) < 9007199254740992.0)
+		return can_fmt_i64(p, (int64_t)v);
+	int prec, n = 0;
+	for (prec=15; prec<=17; prec++) {
+		n = snprintf(p, CAN_FMT_NUMBER, "%.*g", prec, v);
+		if (strtod(p, NULL)==v) break;
+	}
+	return p + n;
+}
+/*! \brief значение с decimals знаками после точки, незначащие нули отбрасываются
+	\param scale - 10^decimals
+ */
+static inline char* can_fmt_fixed(char* p, double v, uint32_t decimals, double scale, const char* inf)
+{
+	const double x = v*scale;
+	if (!(fabs(x) < 9007199254740992.0)) return can_fmt_general(p, v, inf);
+	int64_t n = llround(x);
+	if (n < 0) {
+		*p++ = '-';
+		n = -n;
+	}
+	uint32_t d = decimals;
+	while (d!=0 && n % 10==0) {
+		n /= 10;
+		d--;
+	}
+	if (d==0) return can_fmt_u64(p, n);
+	char tmp[24];
+	const size_t len = can_fmt_u64(tmp, n) - tmp;
+	if (len <= d) {// 0.00ddd
+		*p++ = '0';
+		*p++ = '.';
+		memset(p, '0', d - len);
+		p += d - len;
+		memcpy(p, tmp, len);
+		return p + len;
+	}
+	memcpy(p, tmp, len - d);
+	p += len - d;
+	*p++ = '.';
+	memcpy(p, tmp + len - d, d);
+	return p + d;
+}
+/*! \brief число десятичных знаков, при котором x*10^d -- целое, x задан как float
+	\return CAN_FMT_GENERAL если таких знаков больше CAN_FMT_DECIMALS
+ */
+static inline uint8_t can_fmt_decimals(float x)
+{
+	char buf[CAN_FMT_NUMBER];
+	int prec;
+	double v = x;
+	for (prec=1; prec<=9; prec++) {// кратчайшая десятичная запись float: 0.01f -> 0.01
+		snprintf(buf, sizeof(buf), "%.*g", prec, x);
+		if ((float)strtod(buf, NULL)==x) {
+			v = strtod(buf, NULL);
+			break;
+		}
+	}
+	double scale = 1;
+	uint8_t d;
+	for (d=0; d<=CAN_FMT_DECIMALS; d++, scale*=10) {
+		const double s = v*scale;
+		if (fabs(s - nearbyint(s)) <= 1e-9*fabs(s)) return d;
+	}
+	return CAN_FMT_GENERAL;
+}
+/*! \brief знаков после точки для физического значения сигнала: наибольшее из factor и offset */
+static inline uint8_t can_fmt_signal_decimals(float factor, float offset)
+{
+	const uint8_t df = can_fmt_decimals(factor);
+	const uint8_t dn = can_fmt_decimals(offset);
+	return (df==CAN_FMT_GENERAL || dn==CAN_FMT_GENERAL)? CAN_FMT_GENERAL: (df > dn? df: dn);
+}
+#endif//CAN_EV_FMT_H
@@ -0,0 +1,509 @@
+/*! \file can_ev_json.c
+
+	\brief Экспорт разобранных кадров в формат JSON, строка JSON на кадр
+
+	{"ts":1700000000123456789,"id":2364540158,"name":"EEC1","signals":{"EngSpeed":1234.5,"Gear":"D"}}
+
+	Постоянные части записи подготавливаются при создании по скомпилированной базе: для
+	каждого сообщения -- фрагмент с идентификатором и именем, для каждого сигнала --
+	экранированный ключ ,"name": и число десятичных знаков значения. Запись кадра сводится
+	к копированию фрагментов и выводу чисел без выделения памяти. Для каждого
+	сообщения известна наибольшая длина записи, проверка места в буфере выполняется один
+	раз на кадр.
+
+	Числа выводятся функциями can_ev_fmt.h с разрешением сигнала, для сигналов float и
+	double -- кратчайшей записью через snprintf, остальные -- без printf. Значения перечислений
+	выводятся именем из таблицы VAL_, при factor 0 -- числом. Имена перечислений также
+	подготавливаются фрагментами строк JSON по таблице значений сигнала.
+
+	Строки базы DBC записываются в JSON в кодировке UTF-8: строки, не являющиеся UTF-8,
+	считаются записанными в CP1251 и перекодируются один раз при подготовке фрагментов.
+
+Тестирование:
+$ gcc -O2 -DTEST_CAN_JSON -DCAN_DBC_LIB can_ev_json.c can_dbc.c -o json.exe `pkg-config --cflags --libs glib-2.0`
+$ ./json.exe
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "can_dbc.h"
+#include "can_ev_fmt.h"
+
+#define JSON_BUFFER		(1u<<20)	//!< буфер записи файла
+
+static const char _json_ts[] = "{\"ts\":";
+static const char _json_tail[] = "}}\n";
+
+/*! \brief подготовленная запись сигнала */
+typedef struct _JsonSignal JsonSignal_t;
+struct _JsonSignal {
+	uint32_t key;		//!< смещение фрагмента ,"name": в пуле
+	uint16_t key_len;	//!< длина фрагмента с запятой
+	uint8_t decimals;	//!< знаков после точки, CAN_FMT_GENERAL -- кратчайшая запись
+	uint8_t enums;		//!< значения выводятся именами VAL_
+	uint32_t labels;	//!< первое имя значения сигнала в таблице имен
+	double scale;		//!< 10^decimals
+};
+/*! \brief имя значения перечисления: строка JSON в кавычках в пуле фрагментов
+	Для плотных перечислений имена расположены по значению, val - min, иначе -- по номеру
+	значения в таблице перечислений сигнала.
+ */
+typedef struct _JsonLabel JsonLabel_t;
+struct _JsonLabel {
+	uint32_t at;		//!< смещение в пуле
+	uint32_t len;		//!< 0 -- значение не описано
+};
+typedef struct _JsonObject JsonObject_t;
+struct _JsonObject {
+	uint32_t head;		//!< смещение фрагмента ,"id":N,"name":"M","signals": в пуле
+	uint32_t head_len;
+	uint32_t row_size;	//!< наибольшая длина записи кадра
+};
+struct _can_dbc_json {
+	const can_dbc_t* dbc;
+	JsonSignal_t* signals;	//!< по номеру сигнала в таблице сигналов
+	JsonObject_t* objects;	//!< по номеру сообщения в таблице сообщений
+	JsonLabel_t* labels;	//!< имена значений перечислений
+	char* pool;				//!< фрагменты ключей и имена значений
+	uint32_t max_row;
+};
+/*! \brief строка JSON в кавычках, управляющие символы, кавычки и \ экранируются
+	\return указатель за последним символом, не более 6*strlen(s)+2 символов
+ */
+static char* _json_string(char* p, const char* s)
+{
+	static const char hex[] = "0123456789abcdef";
+	*p++ = '"';
+	for (; *s; s++) {
+		const unsigned char c = *s;
+		if (c >= 0x20 && c!='"' && c!='\\') {
+			*p++ = c;
+			continue;
+		}
+		*p++ = '\\';
+		switch (c) {
+		case '"':  *p++ = '"';  break;
+		case '\\': *p++ = '\\'; break;
+		case '\n': *p++ = 'n';  break;
+		case '\r': *p++ = 'r';  break;
+		case '\t': *p++ = 't';  break;
+		default:
+			memcpy(p, "u00", 3);
+			p[3] = hex[c>>4];
+			p[4] = hex[c & 15];
+			p += 5;
+			break;
+		}
+	}
+	*p++ = '"';
+	return p;
+}
+/*! \brief строка базы в UTF-8: строки в другой кодировке считаются записанными в CP1251
+	\return строка, освобождается g_free()
+ */
+static char* _json_utf8(const char* s)
+{
+	char* u = NULL;
+	if (!g_utf8_validate(s, -1, NULL)) {
+		u = g_convert(s, -1, "UTF-8", "CP1251", NULL, NULL, NULL);
+		if (u==NULL) u = g_convert(s, -1, "UTF-8", "ISO-8859-1", NULL, NULL, NULL);
+	}
+	return u!=NULL? u: g_strdup(s);
+}
+/*! \brief строка базы в UTF-8 в кавычках добавляется в пул фрагментов
+	\return длина фрагмента
+ */
+static uint32_t _json_append(GString* pool, const char* s)
+{
+	char* u = _json_utf8(s);
+	const size_t at = pool->len;
+	g_string_set_size(pool, at + 6*strlen(u) + 2);
+	g_string_truncate(pool, _json_string(pool->str + at, u) - pool->str);
+	g_free(u);
+	return pool->len - at;
+}
+/*! \brief подготовка фрагментов записи по скомпилированной базе */
+can_dbc_json_t* can_dbc_json_new(const can_dbc_t* dbc)
+{
+	g_return_val_if_fail(dbc->index!=NULL, NULL);// база должна быть скомпилирована
+	can_dbc_json_t* js = g_new0(can_dbc_json_t, 1);
+	js->dbc = dbc;
+	js->signals = g_new0(JsonSignal_t, dbc->sg_size);
+	js->objects = g_new0(JsonObject_t, dbc->bo_size);
+	js->labels = g_new0(JsonLabel_t, dbc->en_size + dbc->nm_size);
+	uint32_t n_labels = 0;
+	GString* pool = g_string_sized_new(dbc->str_size*2 + dbc->bo_size*32);
+	char buf[CAN_FMT_NUMBER];
+	uint32_t i, k;
+	for (i=0; i<dbc->bo_size; i++) {
+		const can_dbc_object_t* obj = &dbc->object_table[i];
+		JsonObject_t* jo = &js->objects[i];
+		jo->head = pool->len;
+		g_string_append(pool, ",\"id\":");
+		g_string_append_len(pool, buf, can_fmt_u64(buf, obj->oid) - buf);
+		g_string_append(pool, ",\"name\":");
+		_json_append(pool, can_dbc_string(dbc, obj->name));
+		g_string_append(pool, ",\"signals\":");
+		jo->head_len = pool->len - jo->head;
+		uint32_t size = sizeof(_json_ts) + 20 + jo->head_len + sizeof(_json_tail);
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+		for (k=0; k<obj->sg_size; k++) {
+			JsonSignal_t* jsg = &js->signals[obj->signals + k];
+			const size_t at = pool->len;
+			g_string_append_c(pool, ',');
+			_json_append(pool, can_dbc_string(dbc, sg[k].name));
+			g_string_append_c(pool, ':');
+			jsg->key = at;
+			jsg->key_len = pool->len - at;
+			jsg->enums = sg[k].en_size!=0 && sg[k].factor!=0;// raw восстанавливается делением на factor
+			jsg->decimals = CAN_FMT_GENERAL;
+			if (sg[k].type!=_TYPE_REAL && sg[k].type!=_TYPE_DOUBLE)
+				jsg->decimals = can_fmt_signal_decimals(sg[k].factor, sg[k].offset);
+			jsg->scale = jsg->decimals==CAN_FMT_GENERAL? 1: pow(10, jsg->decimals);
+			uint32_t value = CAN_FMT_NUMBER;
+			const can_dbc_enum_t* en = dbc->enum_table + sg[k].enums;
+			uint32_t e;
+			jsg->labels = n_labels;
+			for (e=0; e<sg[k].en_size && jsg->enums; e++) {
+				JsonLabel_t* lb = &js->labels[n_labels + (sg[k].en_range? (uint64_t)en[e].val - (uint64_t)en[0].val: e)];
+				lb->at  = pool->len;
+				lb->len = _json_append(pool, can_dbc_string(dbc, en[e].name));
+				value = MAX(value, lb->len);
+			}
+			if (jsg->enums) n_labels += sg[k].en_range? sg[k].en_range: sg[k].en_size;
+			size += jsg->key_len + value;
+		}
+		jo->row_size = size;
+		js->max_row = MAX(js->max_row, size);
+	}
+	js->pool = g_string_free(pool, FALSE);
+	return js;
+}
+void can_dbc_json_free(can_dbc_json_t* js)
+{
+	g_free(js->signals);
+	g_free(js->objects);
+	g_free(js->labels);
+	g_free(js->pool);
+	g_free(js);
+}
+/*! \brief наибольшая длина записи кадра сообщения, NULL -- всех сообщений базы */
+size_t can_dbc_json_row_size(const can_dbc_json_t* js, const can_dbc_object_t* obj)
+{
+	return obj? js->objects[obj - js->dbc->object_table].row_size: js->max_row;
+}
+/*! \brief имя значения перечисления, поиск как в can_dbc_enum_name()
+	\return NULL если значение не описано
+ */
+static inline const JsonLabel_t* _json_label(const can_dbc_json_t* js, const can_dbc_signal_t* sg,
+		const JsonSignal_t* jsg, int64_t val)
+{
+	const can_dbc_enum_t* en = js->dbc->enum_table + sg->enums;
+	const JsonLabel_t* lb = js->labels + jsg->labels;
+	if (sg->en_range!=0) {
+		const uint64_t idx = (uint64_t)val - (uint64_t)en->val;
+		return idx < sg->en_range && lb[idx].len!=0? &lb[idx]: NULL;
+	}
+	const can_dbc_enum_t* base = en;
+	uint32_t n = sg->en_size;
+	while (n > 1) {
+		uint32_t half = n>>1;
+		en = (en[half].val <= val)? en + half: en;
+		n -= half;
+	}
+	return en->val==val? &lb[en - base]: NULL;
+}
+/*! \brief запись разобранного кадра в буфер, завершается переводом строки
+
+	Выводятся сигналы вне страниц мультиплексора и сигналы выбранной страницы, сигналы
+	за длиной кадра пропускаются.
+	\param buf - буфер не менее can_dbc_json_row_size() символов
+	\return число записанных символов
+ */
+size_t can_dbc_json_row(const can_dbc_json_t* js, const can_dbc_row_t* row, char* buf)
+{
+	const can_dbc_t* dbc = js->dbc;
+	const can_dbc_object_t* obj = row->object;
+	const JsonObject_t* jo = &js->objects[obj - dbc->object_table];
+	char* p = buf;
+	memcpy(p, _json_ts, sizeof(_json_ts)-1);
+	p = can_fmt_u64(p + sizeof(_json_ts)-1, row->ts);
+	memcpy(p, js->pool + jo->head, jo->head_len);
+	p += jo->head_len;
+	char* first = p;
+	uint32_t lo = 0, hi = 0, k;
+	if (row->page!=NULL) {
+		lo = row->page->signals - obj->signals;
+		hi = lo + row->page->sg_size;
+	}
+	const uint8_t len = MIN(row->len, can_dbc_object_dlen(obj));
+	const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+	const JsonSignal_t* jsg = &js->signals[obj->signals];
+	for (k=0; k<obj->sg_size; k++, sg++, jsg++) {
+		if (!(k < obj->base_size || (k >= lo && k < hi)) || sg->len==0 || can_signal_bytes(sg) > len)
+			continue;
+		const double v = row->values[k];
+		memcpy(p, js->pool + jsg->key, jsg->key_len);
+		p += jsg->key_len;
+		if (jsg->enums) {
+			const JsonLabel_t* lb = _json_label(js, sg, jsg, llround((v - sg->offset)/sg->factor));
+			if (lb!=NULL) {
+				memcpy(p, js->pool + lb->at, lb->len);
+				p += lb->len;
+				continue;
+			}
+		}
+		p = jsg->decimals==CAN_FMT_GENERAL? can_fmt_general(p, v, "null"):
+			can_fmt_fixed(p, v, jsg->decimals, jsg->scale, "null");
+	}
+	if (p==first) *p++ = '{';
+	else *first = '{';// запятая перед первым сигналом
+	memcpy(p, _json_tail, sizeof(_json_tail)-1);
+	return p + sizeof(_json_tail)-1 - buf;
+}
+
+typedef struct _JsonWriter JsonWriter_t;
+struct _JsonWriter {
+	int fd;
+	char* filename;
+	can_dbc_json_t* js;
+	char* buf;
+	size_t size, used;
+};
+static gboolean _json_flush(JsonWriter_t* w, GError** error)
+{
+	const char* buf = w->buf;
+	size_t size = w->used;
+	w->used = 0;
+	while (size>0) {
+		ssize_t r = write(w->fd, buf, size);
+		if (r<0) {
+			if (errno==EINTR) continue;
+			int errsv = errno;
+			g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", w->filename, g_strerror(errsv));
+			return FALSE;
+		}
+		buf += r, size -= r;
+	}
+	return TRUE;
+}
+static gboolean _json_begin(void* user, const can_dbc_t* dbc, GError** error)
+{
+	(void)error;
+	JsonWriter_t* w = user;
+	w->js = can_dbc_json_new(dbc);
+	w->size = MAX(JSON_BUFFER, 2*can_dbc_json_row_size(w->js, NULL));
+	w->buf = g_malloc(w->size);
+	return TRUE;
+}
+static gboolean _json_rows(void* user, const can_dbc_t* dbc, const can_dbc_row_t* rows, uint32_t n, GError** error)
+{
+	(void)dbc;
+	JsonWriter_t* w = user;
+	uint32_t k;
+	for (k=0; k<n; k++) {
+		if (w->used + can_dbc_json_row_size(w->js, rows[k].object) > w->size && !_json_flush(w, error))
+			return FALSE;
+		w->used += can_dbc_json_row(w->js, &rows[k], w->buf + w->used);
+	}
+	return TRUE;
+}
+static gboolean _json_end(void* user, GError** error)
+{
+	JsonWriter_t* w = user;
+	gboolean ok = _json_flush(w, error);
+	if (close(w->fd)<0 && ok) {
+		int errsv = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", w->filename, g_strerror(errsv));
+		ok = FALSE;
+	}
+	if (w->js!=NULL) can_dbc_json_free(w->js);
+	g_free(w->buf);
+	g_free(w->filename);
+	g_free(w);
+	return ok;
+}
+/*! \brief получатель: разобранные кадры записываются в файл JSON, строка на кадр */
+gboolean can_dbc_export_json(can_dbc_exporter_t* exporter, const char* filename, GError** error)
+{
+	int fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (fd<0) {
+		int errsv = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", filename, g_strerror(errsv));
+		return FALSE;
+	}
+	JsonWriter_t* w = g_new0(JsonWriter_t, 1);
+	w->fd = fd;
+	w->filename = g_strdup(filename);
+	*exporter = (can_dbc_exporter_t){.begin = _json_begin, .rows = _json_rows, .end = _json_end, .user = w};
+	return TRUE;
+}
+
+#ifdef TEST_CAN_JSON
+#include <glib/gstdio.h>
+/*! запись через g_string_append_printf для сравнения скорости */
+static void _test_printf(GString* str, const can_dbc_t* dbc, const can_dbc_row_t* row)
+{
+	const can_dbc_object_t* obj = row->object;
+	const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+	uint32_t k;
+	g_string_append_printf(str, "{\"ts\":%"G_GUINT64_FORMAT",\"id\":%u,\"name\":\"%s\",\"signals\":{",
+		row->ts, obj->oid, can_dbc_string(dbc, obj->name));
+	for (k=0; k<obj->base_size; k++)
+		g_string_append_printf(str, "%s\"%s\":%.17g", k? ",": "", can_dbc_string(dbc, sg[k].name), row->values[k]);
+	g_string_append(str, "}}\n");
+}
+int main(int argc, char* argv[])
+{
+	const char* text =
+		"BO_ 100 A: 8 ECU\n"
+		" SG_ Gear : 0|4@1+ (1,0) [0|15] \"\" ECU\n"
+		" SG_ Temp : 8|8@1- (0.5,-40) [-104|23.5] \"C\" ECU\n"
+		" SG_ Speed : 16|16@1+ (0.01,0) [0|655.35] \"km/h\" ECU\n"
+		" SG_ Odo : 32|32@1+ (0.001,0) [0|0] \"km\" ECU\n"
+		"BO_ 2364540158 MUX: 8 ECU\n"
+		" SG_ Page M : 0|8@1+ (1,0) [0|255] \"\" ECU\n"
+		" SG_ P0 m0 : 8|16@1- (1,0) [0|0] \"\" ECU\n"
+		" SG_ P1 m1 : 8|32@1+ (0.3,0) [0|0] \"\" ECU\n"
+		"BO_ 200 Z: 1 ECU\n"
+		" SG_ Mode : 0|2@1+ (0,1) [0|0] \"\" ECU\n"
+		"VAL_ 100 Gear 0 \"P\" 1 \"R\" 2 \"N\" 3 \"D\" ;\n"
+		"VAL_ 200 Mode 1 \"On\" ;\n";
+	can_dbc_t* dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text, strlen(text), NULL, NULL);
+	can_dbc_compile(dbc);
+	can_dbc_json_t* js = can_dbc_json_new(dbc);
+	const can_dbc_object_t* a   = can_dbc_lookup(dbc, 100);
+	const can_dbc_object_t* mux = can_dbc_lookup(dbc, 2364540158u);
+	double values[16];
+	char* buf = g_malloc(can_dbc_json_row_size(js, NULL));
+	// проверка записи
+	struct can_frame f = {.can_id = 100, .len = 8, .data = {3, 0xF6, 0x39, 0x30, 0x40, 0xE2, 0x01, 0x00}};
+	can_dbc_row_t row = {.ts = 1700000000123456789ull, .object = a, .values = values, .data = f.data, .can_id = 100, .len = 8};
+	row.page = can_dbc_decode_mux(dbc, a, &f, values);
+	buf[can_dbc_json_row(js, &row, buf)] = 0;
+	const char* expect = "{\"ts\":1700000000123456789,\"id\":100,\"name\":\"A\",\"signals\":"
+		"{\"Gear\":\"D\",\"Temp\":-45,\"Speed\":123.45,\"Odo\":123.456}}\n";
+	int fail = strcmp(buf, expect)!=0;
+	printf("%s", buf);
+	struct can_frame m = {.can_id = mux->oid, .len = 8, .data = {1, 7, 0, 0, 0}};
+	row = (can_dbc_row_t){.ts = 1, .object = mux, .values = values, .data = m.data, .can_id = m.can_id, .len = 8};
+	row.page = can_dbc_decode_mux(dbc, mux, &m, values);
+	buf[can_dbc_json_row(js, &row, buf)] = 0;
+	fail += strcmp(buf, "{\"ts\":1,\"id\":2364540158,\"name\":\"MUX\",\"signals\":{\"Page\":1,\"P1\":2.1}}\n")!=0;
+	printf("%s", buf);
+	// короткий кадр: сигналы за длиной кадра пропускаются
+	f.len = 2;
+	row = (can_dbc_row_t){.ts = 2, .object = a, .values = values, .data = f.data, .can_id = 100, .len = 2};
+	row.page = can_dbc_decode_mux(dbc, a, &f, values);
+	buf[can_dbc_json_row(js, &row, buf)] = 0;
+	fail += strcmp(buf, "{\"ts\":2,\"id\":100,\"name\":\"A\",\"signals\":{\"Gear\":\"D\",\"Temp\":-45}}\n")!=0;
+	printf("%s", buf);
+	// перечисление с factor 0: raw не восстанавливается, выводится число
+	struct can_frame z = {.can_id = 200, .len = 1, .data = {3}};
+	row = (can_dbc_row_t){.ts = 3, .object = can_dbc_lookup(dbc, 200), .values = values, .data = z.data, .can_id = 200, .len = 1};
+	row.page = can_dbc_decode_mux(dbc, row.object, &z, values);
+	buf[can_dbc_json_row(js, &row, buf)] = 0;
+	fail += strcmp(buf, "{\"ts\":3,\"id\":200,\"name\":\"Z\",\"signals\":{\"Mode\":1}}\n")!=0;
+	printf("%s", buf);
+	// имена в CP1251 перекодируются в UTF-8, строки UTF-8 записываются как есть
+	{
+		const char* cp_text =
+			"BO_ 300 C: 1 ECU\n"
+			" SG_ S : 0|2@1+ (1,0) [0|0] \"\" ECU\n"
+			"VAL_ 300 S 0 \"\xC2\xFB\xEA\xEB\" 1 \"\xC2\xEA\xEB\" 2 \"\xD0\xA0\xD0\xB5\xD0\xB6\xD0\xB8\xD0\xBC\" ;\n";
+		can_dbc_t* cp = can_dbc_init(NULL);
+		can_dbc_parse(cp, cp_text, strlen(cp_text), NULL, NULL);
+		can_dbc_compile(cp);
+		can_dbc_json_t* cjs = can_dbc_json_new(cp);
+		char* cbuf = g_malloc(can_dbc_json_row_size(cjs, NULL) + 1);
+		static const char* const labels[] = {"\xD0\x92\xD0\xBA\xD0\xBB", "\xD0\xA0\xD0\xB5\xD0\xB6\xD0\xB8\xD0\xBC"};
+		uint32_t j;
+		for (j=0; j<2; j++) {
+			struct can_frame c = {.can_id = 300, .len = 1, .data = {j+1}};
+			row = (can_dbc_row_t){.ts = 4, .object = can_dbc_lookup(cp, 300), .values = values, .data = c.data, .can_id = 300, .len = 1};
+			row.page = can_dbc_decode_mux(cp, row.object, &c, values);
+			cbuf[can_dbc_json_row(cjs, &row, cbuf)] = 0;
+			char* expect_cp = g_strdup_printf("{\"ts\":4,\"id\":300,\"name\":\"C\",\"signals\":{\"S\":\"%s\"}}\n", labels[j]);
+			fail += strcmp(cbuf, expect_cp)!=0 || !g_utf8_validate(cbuf, -1, NULL);
+			printf("%s", cbuf);
+			g_free(expect_cp);
+		}
+		g_free(cbuf);
+		can_dbc_json_free(cjs);
+		can_dbc_free(cp);
+	}
+	char num[CAN_FMT_NUMBER];
+	*_json_string(num, "a\"b\\c\n\1") = 0;
+	fail += strcmp(num, "\"a\\\"b\\\\c\\n\\u0001\"")!=0;
+	// кратчайшая запись: значения восстанавливаются без потерь
+	const double probe[] = {0.1, 1.0/3, -2.5e-300, 1e22, 123456789012345678.0, 5e-324};
+	uint32_t i;
+	for (i=0; i<G_N_ELEMENTS(probe); i++) {
+		*can_fmt_general(num, probe[i], "null") = 0;
+		if (strtod(num, NULL)!=probe[i]) fail++;
+	}
+	printf("row: ..%s\n", fail? "fail": "ok");
+	// скорость: запись в буфер и g_string_append_printf
+	const uint32_t N = argc>1? atoi(argv[1]): 1000000;
+	can_dbc_row_t* rows = g_new(can_dbc_row_t, 1024);
+	double* vals = g_new(double, 1024*8);
+	struct can_frame* frames = g_new0(struct can_frame, 1024);
+	uint64_t x = 1;
+	for (i=0; i<1024; i++) {
+		x = x*6364136223846793005ULL + 1442695040888963407ULL;
+		frames[i] = (struct can_frame){.can_id = i&1? mux->oid: 100, .len = 8};
+		memcpy(frames[i].data, &x, 8);
+		frames[i].data[0] &= i&1? 1: 3;
+		rows[i] = (can_dbc_row_t){.ts = 1700000000000000000ull + i*1000ull, .object = i&1? mux: a,
+			.values = vals + 8*i, .data = frames[i].data, .can_id = frames[i].can_id, .len = 8};
+		rows[i].page = can_dbc_decode_mux(dbc, rows[i].object, &frames[i], vals + 8*i);
+	}
+	char* out = g_malloc(1024*can_dbc_json_row_size(js, NULL));
+	size_t bytes = 0;
+	gint64 t0 = g_get_monotonic_time();
+	for (i=0; i<N; i+=1024) {
+		size_t used = 0;
+		uint32_t k;
+		for (k=0; k<1024; k++) used += can_dbc_json_row(js, &rows[k], out + used);
+		bytes += used;
+	}
+	gint64 t1 = g_get_monotonic_time();
+	GString* str = g_string_sized_new(1<<20);
+	for (i=0; i<N; i+=1024) {
+		uint32_t k;
+		g_string_truncate(str, 0);
+		for (k=0; k<1024; k++) _test_printf(str, dbc, &rows[k]);
+	}
+	gint64 t2 = g_get_monotonic_time();
+	printf("json: %.1f Mrows/s %.0f MB/s, printf %.1f Mrows/s x%.1f\n", N/(double)(t1-t0), bytes/(double)(t1-t0),
+		N/(double)(t2-t1), (t2-t1)/(double)(t1-t0));
+	// экспорт в файл
+	can_dbc_exporter_t ex;
+	GError* error = NULL;
+	gchar* filename = NULL;
+	int fd = g_file_open_tmp("test-XXXXXX.json", &filename, NULL);
+	if (fd>=0) g_close(fd, NULL);
+	gboolean ok = can_dbc_export_json(&ex, filename, &error) && ex.begin(ex.user, dbc, &error);
+	for (i=0; i<N && ok; i+=1024)
+		ok = ex.rows(ex.user, dbc, rows, 1024, &error);
+	ok = ex.end(ex.user, ok? &error: NULL) && ok;
+	GStatBuf st = {0};
+	g_stat(filename, &st);
+	printf("export: %.1f MB ..%s\n", st.st_size*1e-6, ok && (uint64_t)st.st_size==bytes? "ok": "fail");
+	remove(filename);
+	g_free(filename);
+	g_string_free(str, TRUE);
+	g_free(out);
+	g_free(frames);
+	g_free(vals);
+	g_free(rows);
+	g_free(buf);
+	can_dbc_json_free(js);
+	can_dbc_free(dbc);
+	return 0;
+}
+#endif//TEST_CAN_JSON
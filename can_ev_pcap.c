@@ -0,0 +1,477 @@
+/*! \file can_ev_pcap.c
+
+	\brief Экспорт и чтение данных в формате PCAP и PCAPNG, Linktype = SocketCAN
+
+	Файл захвата отображается в память целиком, чтение записи сводится к разбору
+	заголовка и проверке границ, данные кадра не копируются. Отображение помечается
+	MADV_SEQUENTIAL: ядро читает файл с упреждением и освобождает прочитанные страницы.
+	Смещение записи rd->pos можно сохранить и восстановить, чтобы разбирать файл частями.
+
+	Запись: заголовки и данные кадров собираются в буфере, выровненном на страницу,
+	запись в файл выполняется блоками размера буфера, последний блок -- при закрытии.
+	Запись может разрываться границей блока.
+
+	\see https://www.tcpdump.org/linktypes/LINKTYPE_CAN_SOCKETCAN.html
+	\see PCAP Next Generation (pcapng) Capture File Format, IETF draft
+
+Тестирование:
+$ gcc -O2 -DTEST_CAN_PCAP can_ev_pcap.c -o pcap.exe
+$ ./pcap.exe
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "can_ev_pcap.h"
+
+#define PCAP_MAGIC_US	0xA1B2C3D4u
+#define PCAP_MAGIC_NS	0xA1B23C4Du
+#define PCAPNG_SHB		0x0A0D0D0Au
+#define PCAPNG_BOM		0x1A2B3C4Du
+#define PCAPNG_IDB		1
+#define PCAPNG_PB		2	//!< устаревший Packet Block
+#define PCAPNG_SPB		3
+#define PCAPNG_EPB		6
+#define PCAPNG_OPT_TSRESOL	9
+#define PCAPNG_OPT_TSOFFSET	14
+#define PCAP_HEADER_SIZE	24
+#define PCAP_RECORD_SIZE	16
+
+static inline uint16_t _u16(const can_pcap_reader_t* rd, const uint8_t* p)
+{
+	uint16_t v;
+	memcpy(&v, p, 2);
+	return rd->swapped? __builtin_bswap16(v): v;
+}
+static inline uint32_t _u32(const can_pcap_reader_t* rd, const uint8_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return rd->swapped? __builtin_bswap32(v): v;
+}
+static inline uint64_t _u64(const can_pcap_reader_t* rd, const uint8_t* p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return rd->swapped? __builtin_bswap64(v): v;
+}
+/*! \brief разрешение 10^-v или 2^-v секунды, по умолчанию PCAPNG -- микросекунды */
+static void _if_resolution(can_pcap_if_t* ifc, uint8_t tsresol)
+{
+	uint8_t v = tsresol & 0x7F;
+	ifc->shift = 0;
+	ifc->mul = 1;
+	ifc->div = 1;
+	if ((tsresol & 0x80) && v!=0) {
+		ifc->shift = v;
+		return;
+	}
+	if (tsresol & 0x80) v = 0;
+	for (; v<9; v++)  ifc->mul *= 10;
+	for (; v>9 && v<=19; v--) ifc->div *= 10;
+}
+static inline uint64_t _if_time(const can_pcap_if_t* ifc, uint64_t t)
+{
+	uint64_t ns;
+	if (ifc->shift)
+		ns = (uint64_t)(((unsigned __int128)t * 1000000000u) >> ifc->shift);
+	else
+		ns = t*ifc->mul/ifc->div;
+	return ns + (uint64_t)ifc->offset*1000000000u;
+}
+static int _header(can_pcap_reader_t* rd)
+{
+	uint32_t magic;
+	if (rd->size < 12) return rd->error = CAN_PCAP_ERROR_FORMAT;
+	memcpy(&magic, rd->base, 4);
+	rd->swapped = 0;
+	if (magic==PCAPNG_SHB) {
+		rd->ng = 1;
+		rd->start = rd->pos = 0;
+		return 0;
+	}
+	if (magic==__builtin_bswap32(PCAP_MAGIC_US) || magic==__builtin_bswap32(PCAP_MAGIC_NS)) {
+		rd->swapped = 1;
+		magic = __builtin_bswap32(magic);
+	}
+	if ((magic!=PCAP_MAGIC_US && magic!=PCAP_MAGIC_NS) || rd->size < PCAP_HEADER_SIZE)
+		return rd->error = CAN_PCAP_ERROR_FORMAT;
+	rd->ng = 0;
+	rd->n_if = 1;
+	rd->ifs[0].linktype = _u32(rd, rd->base+20) & 0xFFFF;
+	rd->ifs[0].offset = 0;
+	_if_resolution(&rd->ifs[0], magic==PCAP_MAGIC_NS? 9: 6);
+	rd->start = rd->pos = PCAP_HEADER_SIZE;
+	return 0;
+}
+/*! \brief чтение из буфера вызывающей стороны, буфер должен существовать до закрытия
+	\return 0 или код ошибки CAN_PCAP_ERROR_*
+ */
+int can_pcap_open_memory(can_pcap_reader_t* rd, const void* data, size_t size)
+{
+	memset(rd, 0, offsetof(can_pcap_reader_t, ifs));
+	rd->base = data;
+	rd->size = size;
+	rd->fd = -1;
+	return _header(rd);
+}
+/*! \brief открытие файла захвата, файл отображается в память
+	\return 0 или код ошибки CAN_PCAP_ERROR_*
+ */
+int can_pcap_open(can_pcap_reader_t* rd, const char* filename)
+{
+	memset(rd, 0, offsetof(can_pcap_reader_t, ifs));
+	rd->fd = open(filename, O_RDONLY);
+	if (rd->fd<0) return rd->error = CAN_PCAP_ERROR_OPEN;
+	struct stat st;
+	void* base = MAP_FAILED;
+	rd->error = CAN_PCAP_ERROR_OPEN;
+	if (fstat(rd->fd, &st)==0) {
+		if (st.st_size>0)
+			base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, rd->fd, 0);
+		else
+			rd->error = CAN_PCAP_ERROR_FORMAT;
+	}
+	if (base==MAP_FAILED) {
+		close(rd->fd);
+		rd->fd = -1;
+		return rd->error;
+	}
+	rd->error = CAN_PCAP_ERROR_NONE;
+	madvise(base, st.st_size, MADV_SEQUENTIAL);
+	rd->base = base;
+	rd->size = st.st_size;
+	return _header(rd);
+}
+void can_pcap_close(can_pcap_reader_t* rd)
+{
+	if (rd->fd>=0) {
+		munmap((void*)rd->base, rd->size);
+		close(rd->fd);
+	}
+	rd->base = NULL;
+	rd->size = rd->pos = 0;
+	rd->fd = -1;
+}
+static int _next_pcap(can_pcap_reader_t* rd, can_pcap_record_t* rec)
+{
+	if (rd->size - rd->pos < PCAP_RECORD_SIZE) {
+		if (rd->pos!=rd->size) rd->error = CAN_PCAP_ERROR_TRUNCATED;
+		return rd->error? -1: 0;
+	}
+	const uint8_t* p = rd->base + rd->pos;
+	const uint32_t caplen = _u32(rd, p+8);
+	if (rd->size - rd->pos - PCAP_RECORD_SIZE < caplen) {
+		rd->error = CAN_PCAP_ERROR_TRUNCATED;
+		return -1;
+	}
+	rec->ts = _u32(rd, p)*1000000000ull + _if_time(&rd->ifs[0], _u32(rd, p+4));
+	rec->caplen = caplen;
+	rec->len = _u32(rd, p+12);
+	rec->data = p + PCAP_RECORD_SIZE;
+	rec->linktype = rd->ifs[0].linktype;
+	rec->ifindex = 0;
+	rd->pos += PCAP_RECORD_SIZE + caplen;
+	return 1;
+}
+static void _idb(can_pcap_reader_t* rd, const uint8_t* body, uint32_t size)
+{
+	if (rd->n_if>=CAN_PCAP_MAX_IF || size<8) return;
+	can_pcap_if_t* ifc = &rd->ifs[rd->n_if++];
+	ifc->linktype = _u16(rd, body);
+	ifc->offset = 0;
+	_if_resolution(ifc, 6);
+	uint32_t i = 8;
+	while (i+4 <= size) {
+		const uint16_t code = _u16(rd, body+i), olen = _u16(rd, body+i+2);
+		if (code==0 || i+4+olen > size) break;
+		if (code==PCAPNG_OPT_TSRESOL && olen>=1) _if_resolution(ifc, body[i+4]);
+		if (code==PCAPNG_OPT_TSOFFSET && olen>=8) ifc->offset = _u64(rd, body+i+4);
+		i += 4 + ((olen+3u) & ~3u);
+	}
+}
+static int _next_pcapng(can_pcap_reader_t* rd, can_pcap_record_t* rec)
+{
+	while (rd->size - rd->pos >= 12) {
+		const uint8_t* p = rd->base + rd->pos;
+		uint32_t type;
+		memcpy(&type, p, 4);
+		if (type==PCAPNG_SHB) {// новая секция: порядок байт и интерфейсы
+			uint32_t bom;
+			memcpy(&bom, p+8, 4);
+			if (bom!=PCAPNG_BOM && bom!=__builtin_bswap32(PCAPNG_BOM)) break;
+			rd->swapped = bom!=PCAPNG_BOM;
+			rd->n_if = 0;
+		} else type = _u32(rd, p);
+		const uint32_t blen = _u32(rd, p+4);
+		if (blen<12 || (blen & 3) || blen > rd->size - rd->pos) break;
+		const uint8_t* body = p+8;
+		const uint32_t size = blen-12;
+		rd->pos += blen;
+		uint32_t ifindex = 0, caplen = 0, len = 0;
+		uint64_t ts = 0;
+		const uint8_t* data = NULL;
+		switch (type) {
+		case PCAPNG_IDB:
+			_idb(rd, body, size);
+			continue;
+		case PCAPNG_EPB:
+			if (size<20) continue;
+			ifindex = _u32(rd, body);
+			ts = (uint64_t)_u32(rd, body+4)<<32 | _u32(rd, body+8);
+			caplen = _u32(rd, body+12);
+			len = _u32(rd, body+16);
+			data = body+20;
+			if (caplen > size-20) caplen = size-20;
+			break;
+		case PCAPNG_PB:
+			if (size<20) continue;
+			ifindex = _u16(rd, body);
+			ts = (uint64_t)_u32(rd, body+4)<<32 | _u32(rd, body+8);
+			caplen = _u32(rd, body+12);
+			len = _u32(rd, body+16);
+			data = body+20;
+			if (caplen > size-20) caplen = size-20;
+			break;
+		case PCAPNG_SPB:
+			if (size<4) continue;
+			len = _u32(rd, body);
+			caplen = len < size-4? len: size-4;
+			data = body+4;
+			break;
+		default:
+			continue;
+		}
+		if (ifindex >= rd->n_if) continue;// интерфейс не описан
+		const can_pcap_if_t* ifc = &rd->ifs[ifindex];
+		rec->ts = type==PCAPNG_SPB? 0: _if_time(ifc, ts);
+		rec->data = data;
+		rec->caplen = caplen;
+		rec->len = len;
+		rec->linktype = ifc->linktype;
+		rec->ifindex = ifindex;
+		return 1;
+	}
+	if (rd->pos!=rd->size) {
+		rd->error = CAN_PCAP_ERROR_TRUNCATED;
+		return -1;
+	}
+	return 0;
+}
+/*! \brief следующая запись файла
+	\return 1 -- запись, 0 -- конец файла, -1 -- файл поврежден, rd->error
+ */
+int can_pcap_next(can_pcap_reader_t* rd, can_pcap_record_t* rec)
+{
+	return rd->ng? _next_pcapng(rd, rec): _next_pcap(rd, rec);
+}
+
+static int _write_all(can_pcap_writer_t* wr, const uint8_t* buf, size_t size)
+{
+	while (size>0) {
+		ssize_t r = write(wr->fd, buf, size);
+		if (r<0) {
+			if (errno==EINTR) continue;
+			return -1;
+		}
+		buf += r, size -= r;
+		wr->written += r;
+	}
+	return 0;
+}
+static int _put(can_pcap_writer_t* wr, const uint8_t* data, size_t n)
+{
+	while (n>0) {
+		size_t k = wr->size - wr->used;
+		if (k > n) k = n;
+		memcpy(wr->buf + wr->used, data, k);
+		wr->used += k, data += k, n -= k;
+		if (wr->used==wr->size) {
+			if (_write_all(wr, wr->buf, wr->size)<0) return -1;
+			wr->used = 0;
+		}
+	}
+	return 0;
+}
+/*! \brief создание файла PCAP с наносекундами, LINKTYPE_CAN_SOCKETCAN
+	\param buffer_size - размер буфера, округляется до 4096, 0 -- 1 МиБ
+	\return 0 или -1, errno
+ */
+int can_pcap_writer_open(can_pcap_writer_t* wr, const char* filename, size_t buffer_size)
+{
+	memset(wr, 0, sizeof(can_pcap_writer_t));
+	if (buffer_size==0) buffer_size = 1<<20;
+	wr->size = (buffer_size + 4095) & ~(size_t)4095;
+	if (posix_memalign((void**)&wr->buf, 4096, wr->size)!=0) return -1;
+	wr->fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (wr->fd<0) {
+		free(wr->buf);
+		wr->buf = NULL;
+		return -1;
+	}
+	const uint32_t hdr[6] = {PCAP_MAGIC_NS, 0, 0, 0, CANFD_MTU, LINKTYPE_CAN_SOCKETCAN};
+	const uint16_t version[2] = {2, 4};
+	memcpy(wr->buf, hdr, sizeof(hdr));
+	memcpy(wr->buf+4, version, sizeof(version));
+	wr->used = PCAP_HEADER_SIZE;
+	return 0;
+}
+static int _write_record(can_pcap_writer_t* wr, uint64_t ts, canid_t can_id, uint8_t len, uint8_t flags, const uint8_t* data)
+{
+	uint8_t rec[PCAP_RECORD_SIZE + CANFD_MTU];
+	const uint32_t caplen = CAN_PCAP_DATA_OFFSET + len;
+	const uint32_t hdr[4] = {ts/1000000000u, ts%1000000000u, caplen, caplen};
+	memcpy(rec, hdr, sizeof(hdr));
+	uint8_t* d = rec + PCAP_RECORD_SIZE;
+	d[0] = can_id>>24, d[1] = can_id>>16, d[2] = can_id>>8, d[3] = can_id;
+	d[CAN_PCAP_LEN_OFFSET] = len;
+	d[CAN_PCAP_FLAGS_OFFSET] = flags;
+	d[6] = d[7] = 0;
+	memcpy(d + CAN_PCAP_DATA_OFFSET, data, len);
+	wr->records++;
+	return _put(wr, rec, PCAP_RECORD_SIZE + caplen);
+}
+/*! \brief запись кадра CAN, ts -- время в нс */
+int can_pcap_write(can_pcap_writer_t* wr, uint64_t ts, const struct can_frame* frame)
+{
+	uint8_t len = frame->len < CAN_MAX_DLEN? frame->len: CAN_MAX_DLEN;
+	return _write_record(wr, ts, frame->can_id, len, 0, frame->data);
+}
+/*! \brief запись кадра CAN FD, ts -- время в нс */
+int can_pcap_write_fd(can_pcap_writer_t* wr, uint64_t ts, const struct canfd_frame* frame)
+{
+	uint8_t len = frame->len < CANFD_MAX_DLEN? frame->len: CANFD_MAX_DLEN;
+	return _write_record(wr, ts, frame->can_id, len, frame->flags | CANFD_FDF, frame->data);
+}
+int can_pcap_writer_flush(can_pcap_writer_t* wr)
+{
+	int r = _write_all(wr, wr->buf, wr->used);
+	wr->used = 0;
+	return r;
+}
+int can_pcap_writer_close(can_pcap_writer_t* wr)
+{
+	int r = can_pcap_writer_flush(wr);
+	if (close(wr->fd)<0) r = -1;
+	free(wr->buf);
+	wr->buf = NULL;
+	wr->fd = -1;
+	return r;
+}
+
+#ifdef TEST_CAN_PCAP
+#include <stdio.h>
+#include <time.h>
+static double seconds(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+static size_t block(uint8_t* p, uint32_t type, const void* body, uint32_t size)
+{
+	uint32_t blen = 12 + ((size+3) & ~3u);
+	memcpy(p, &type, 4);
+	memcpy(p+4, &blen, 4);
+	memset(p+8, 0, blen-12);
+	memcpy(p+8, body, size);
+	memcpy(p+blen-4, &blen, 4);
+	return blen;
+}
+int main(){
+	// временный файл, как g_file_open_tmp(): модуль собирается без glib
+	char filename[4096];
+	const char* tmpdir = getenv("TMPDIR");
+	snprintf(filename, sizeof(filename), "%s/test-XXXXXX.pcap", tmpdir && tmpdir[0]? tmpdir: "/tmp");
+	const int tmp = mkstemps(filename, 5);
+	if (tmp<0) return 1;
+	close(tmp);
+	const uint32_t N = 4000000;
+	const uint64_t t0 = 1700000000123456789ull;
+	can_pcap_writer_t wr;
+	uint32_t i;
+	if (can_pcap_writer_open(&wr, filename, 0)!=0) return 1;
+	double t = seconds();
+	for (i=0; i<N; i++) {
+		if (i%16==15) {
+			struct canfd_frame fd = {.can_id = CAN_EFF_FLAG|(0x18DA00F1+(i&0xFF)), .len = 48, .flags = CANFD_BRS};
+			memset(fd.data, i, 48);
+			can_pcap_write_fd(&wr, t0 + i*1000ull, &fd);
+		} else {
+			struct can_frame f = {.can_id = i & CAN_SFF_MASK, .len = i%9};
+			memset(f.data, i, 8);
+			can_pcap_write(&wr, t0 + i*1000ull, &f);
+		}
+	}
+	can_pcap_writer_close(&wr);
+	t = seconds() - t;
+	printf("write: %u records %.1f MB, %llu writes, %.1f Mrecords/s\n", N, wr.written*1e-6,
+		(unsigned long long)((wr.written + wr.size - 1)/wr.size), N/t*1e-6);
+	can_pcap_reader_t rd;
+	can_pcap_record_t rec;
+	uint32_t n = 0, bad = 0;
+	t = seconds();
+	if (can_pcap_open(&rd, filename)!=0) return 1;
+	while (can_pcap_next(&rd, &rec)>0) {
+		const int fd = n%16==15;
+		if (!can_pcap_is_can(&rec) || can_pcap_is_fd(&rec)!=fd || rec.ts!=t0 + n*1000ull) bad++;
+		else if (fd && (can_pcap_can_id(&rec)!=(CAN_EFF_FLAG|(0x18DA00F1+(n&0xFF))) || can_pcap_can_len(&rec)!=48))
+			bad++;
+		else if (!fd && (can_pcap_can_id(&rec)!=(n & CAN_SFF_MASK) || can_pcap_can_len(&rec)!=n%9
+			|| (n%9 && can_pcap_can_data(&rec)[n%9-1]!=(uint8_t)n)))
+			bad++;
+		n++;
+	}
+	t = seconds() - t;
+	printf("read: %u records, %.1f Mrecords/s, %.2f GB/s ..%s\n", n, n/t*1e-6, rd.size/t*1e-9,
+		(n==N && bad==0 && rd.error==0)? "ok": "fail");
+	can_pcap_close(&rd);
+	remove(filename);
+	// PCAPNG: два интерфейса, мкс и 2^-20 с со смещением, неизвестный блок, SPB
+	static uint8_t ng[4096];
+	size_t pos = 0;
+	const uint32_t shb[4] = {PCAPNG_BOM, 1, 0xFFFFFFFF, 0xFFFFFFFF};
+	pos += block(ng+pos, PCAPNG_SHB, shb, sizeof(shb));
+	uint8_t idb0[8] = {LINKTYPE_CAN_SOCKETCAN, 0, 0, 0, 72, 0, 0, 0};
+	pos += block(ng+pos, PCAPNG_IDB, idb0, sizeof(idb0));
+	uint8_t idb1[8+8+12+4] = {LINKTYPE_CAN_SOCKETCAN, 0, 0, 0, 72, 0, 0, 0,
+		PCAPNG_OPT_TSRESOL, 0, 1, 0, 0x80|20, 0, 0, 0, PCAPNG_OPT_TSOFFSET, 0, 8, 0, 10};
+	pos += block(ng+pos, PCAPNG_IDB, idb1, sizeof(idb1));
+	pos += block(ng+pos, 0x0BAD, "skip", 4);
+	uint8_t epb[20+16];
+	const uint32_t epb_hdr[5] = {1, 0, 3u<<20, 16, 16};// 3 c
+	memcpy(epb, epb_hdr, 20);
+	const uint8_t frame[16] = {0,0,0x01,0x23, 2, 0,0,0, 0xAA,0xBB};
+	memcpy(epb+20, frame, 16);
+	pos += block(ng+pos, PCAPNG_EPB, epb, sizeof(epb));
+	const uint32_t epb0_hdr[5] = {0, 0, 1500000, 16, 16};// 1.5 c
+	memcpy(epb, epb0_hdr, 20);
+	pos += block(ng+pos, PCAPNG_EPB, epb, sizeof(epb));
+	uint8_t spb[4+16];
+	const uint32_t spb_len = 16;
+	memcpy(spb, &spb_len, 4);
+	memcpy(spb+4, frame, 16);
+	pos += block(ng+pos, PCAPNG_SPB, spb, sizeof(spb));
+	int ok = can_pcap_open_memory(&rd, ng, pos)==0;
+	ok = ok && can_pcap_next(&rd, &rec)==1 && rec.ifindex==1 && rec.ts==13000000000ull
+		&& can_pcap_can_id(&rec)==0x123 && can_pcap_can_data(&rec)[1]==0xBB;
+	ok = ok && can_pcap_next(&rd, &rec)==1 && rec.ifindex==0 && rec.ts==1500000000ull;
+	ok = ok && can_pcap_next(&rd, &rec)==1 && rec.caplen==16 && can_pcap_is_can(&rec);
+	ok = ok && can_pcap_next(&rd, &rec)==0 && rd.error==0;
+	ok = ok && can_pcap_open_memory(&rd, ng, pos-4)==0;
+	while (can_pcap_next(&rd, &rec)>0);
+	ok = ok && rd.error==CAN_PCAP_ERROR_TRUNCATED;
+	printf("pcapng: resolution, offset, skipped blocks, truncation ..%s\n", ok? "ok": "fail");
+	// PCAP с обратным порядком байт и микросекундами
+	uint32_t sw[6+4+4] = {PCAP_MAGIC_US, 2|4<<16, 0, 0, 72, LINKTYPE_CAN_SOCKETCAN, 7, 250, 16, 16};
+	for (i=0; i<10; i++) sw[i] = __builtin_bswap32(sw[i]);
+	memcpy(sw+10, frame, 16);
+	ok = can_pcap_open_memory(&rd, sw, sizeof(sw))==0 && rd.swapped;
+	ok = ok && can_pcap_next(&rd, &rec)==1 && rec.ts==7000250000ull && can_pcap_can_id(&rec)==0x123;
+	ok = ok && can_pcap_next(&rd, &rec)==0;
+	printf("pcap: swapped byte order ..%s\n", ok? "ok": "fail");
+	return 0;
+}
+#endif//TEST_CAN_PCAP
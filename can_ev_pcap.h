@@ -0,0 +1,111 @@
+#ifndef CAN_EV_PCAP_H
+#define CAN_EV_PCAP_H
+/*! \file can_ev_pcap.h
+
+	\brief Чтение и запись файлов PCAP и PCAPNG, Linktype = SocketCAN
+
+	Чтение: файл отображается в память, записи возвращаются ссылками на данные
+	отображения без копирования, время приема приводится к наносекундам. Поддерживаются
+	PCAP с микро- и наносекундами в обоих порядках байт и PCAPNG: секции SHB, интерфейсы
+	IDB с if_tsresol и if_tsoffset, пакеты EPB, SPB и устаревшие PB, остальные блоки
+	пропускаются.
+	Запись: PCAP с наносекундами, записи собираются в буфере и записываются блоками
+	размера буфера, кратного странице.
+
+	Данные записи LINKTYPE_CAN_SOCKETCAN: идентификатор с флагами в сетевом порядке байт,
+	длина данных, флаги CAN FD, два резервных байта, данные.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/can.h>
+
+#define LINKTYPE_CAN_SOCKETCAN	227
+#define CAN_PCAP_ID_OFFSET		0
+#define CAN_PCAP_LEN_OFFSET		4
+#define CAN_PCAP_FLAGS_OFFSET	5
+#define CAN_PCAP_DATA_OFFSET	8
+#define CAN_PCAP_MAX_IF	64	//!< интерфейсов в секции PCAPNG
+
+enum {
+	CAN_PCAP_ERROR_NONE,
+	CAN_PCAP_ERROR_OPEN,	//!< файл не открыт или не отображен, errno
+	CAN_PCAP_ERROR_FORMAT,	//!< не PCAP и не PCAPNG
+	CAN_PCAP_ERROR_TRUNCATED,//!< запись выходит за конец файла
+};
+/*! \brief запись файла, данные -- ссылка на отображение файла */
+typedef struct _can_pcap_record can_pcap_record_t;
+struct _can_pcap_record {
+	uint64_t ts;		//!< время приема, нс от 1970 года
+	const uint8_t* data;
+	uint32_t caplen;	//!< длина данных в файле
+	uint32_t len;		//!< исходная длина пакета
+	uint16_t linktype;
+	uint16_t ifindex;	//!< номер интерфейса PCAPNG
+};
+/*! \brief интерфейс PCAPNG: перевод отметки времени в нс */
+typedef struct _can_pcap_if can_pcap_if_t;
+struct _can_pcap_if {
+	uint16_t linktype;
+	uint8_t  shift;		//!< разрешение 2^-shift с, 0 -- десятичное
+	uint64_t mul, div;	//!< десятичное разрешение: ts*mul/div
+	int64_t  offset;	//!< if_tsoffset, с
+};
+typedef struct _can_pcap_reader can_pcap_reader_t;
+struct _can_pcap_reader {
+	const uint8_t* base;
+	size_t size;
+	size_t pos;			//!< смещение следующей записи
+	size_t start;		//!< смещение первой записи после заголовка файла
+	int fd;				//!< -1 -- буфер вызывающей стороны
+	int error;
+	uint8_t ng;			//!< формат PCAPNG
+	uint8_t swapped;	//!< порядок байт файла отличается от порядка байт машины
+	uint16_t n_if;
+	can_pcap_if_t ifs[CAN_PCAP_MAX_IF];	//!< PCAP: единственный интерфейс ifs[0]
+};
+typedef struct _can_pcap_writer can_pcap_writer_t;
+struct _can_pcap_writer {
+	int fd;
+	uint8_t* buf;
+	size_t size;		//!< размер буфера, кратен 4096
+	size_t used;
+	uint64_t records;
+	uint64_t written;	//!< байт записано в файл
+};
+
+int  can_pcap_open(can_pcap_reader_t* rd, const char* filename);
+int  can_pcap_open_memory(can_pcap_reader_t* rd, const void* data, size_t size);
+int  can_pcap_next(can_pcap_reader_t* rd, can_pcap_record_t* rec);
+void can_pcap_close(can_pcap_reader_t* rd);
+
+int  can_pcap_writer_open(can_pcap_writer_t* wr, const char* filename, size_t buffer_size);
+int  can_pcap_write(can_pcap_writer_t* wr, uint64_t ts, const struct can_frame* frame);
+int  can_pcap_write_fd(can_pcap_writer_t* wr, uint64_t ts, const struct canfd_frame* frame);
+int  can_pcap_writer_flush(can_pcap_writer_t* wr);
+int  can_pcap_writer_close(can_pcap_writer_t* wr);
+
+/*! \brief идентификатор кадра SocketCAN с флагами EFF/RTR/ERR */
+static inline canid_t can_pcap_can_id(const can_pcap_record_t* rec)
+{
+	const uint8_t* d = rec->data + CAN_PCAP_ID_OFFSET;
+	return (canid_t)d[0]<<24 | (canid_t)d[1]<<16 | (canid_t)d[2]<<8 | d[3];
+}
+static inline uint8_t can_pcap_can_len(const can_pcap_record_t* rec)
+{
+	return rec->data[CAN_PCAP_LEN_OFFSET];
+}
+static inline const uint8_t* can_pcap_can_data(const can_pcap_record_t* rec)
+{
+	return rec->data + CAN_PCAP_DATA_OFFSET;
+}
+static inline int can_pcap_is_fd(const can_pcap_record_t* rec)
+{
+	return (rec->data[CAN_PCAP_FLAGS_OFFSET] & CANFD_FDF) || rec->caplen > CAN_MTU;
+}
+/*! \brief запись -- кадр SocketCAN полной длины */
+static inline int can_pcap_is_can(const can_pcap_record_t* rec)
+{
+	return rec->linktype==LINKTYPE_CAN_SOCKETCAN && rec->caplen >= CAN_PCAP_DATA_OFFSET
+		&& rec->caplen >= CAN_PCAP_DATA_OFFSET + (uint32_t)rec->data[CAN_PCAP_LEN_OFFSET];
+}
+#endif//CAN_EV_PCAP_H
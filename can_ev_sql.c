@@ -0,0 +1,729 @@
+/*! \file can_ev_sql.c
+
+	\brief Экспорт разобранных кадров в SQL: схема по базе DBC и пакетная загрузка данных
+
+	Схема строится по скомпилированной базе can_dbc_gen_sql():
+	* "message" и "signal" -- описание сообщений BO_ и сигналов SG_: масштаб, диапазон,
+	  единицы измерения, номер сигнала -- индекс в таблице сигналов базы;
+	* по таблице "msg_<BO_>" на сообщение: столбец "ts" -- время приема, нс, и столбец на сигнал. Тип
+	  столбца выбирается по типу сигнала names_type[] и масштабу: целые сигналы с целыми
+	  factor и offset -- SMALLINT, INTEGER или BIGINT по диапазону физических значений,
+	  float -- REAL, остальные -- DOUBLE PRECISION. Сигналы с таблицей VAL_ хранят значение
+	  без масштабирования, имена значений -- в таблице "val_<BO_>_<SG_>". Префиксы отделяют
+	  таблицы сообщений от постоянных таблиц и таблиц имен; если имена таблиц все же совпадают
+	  (одинаковые имена BO_ или "val_A_B_C" для A.B_C и A_B.C), экспорт завершается ошибкой;
+	* в узкой схеме (narrow) -- одна таблица "signal_value" (ts, signal, value) со строкой на
+	  сигнал кадра и одна таблица имен значений "signal_val" (signal, value, name). Значения
+	  обеих таблиц физические и записываются одинаково, имя значения сигнала выбирается
+	  соединением по (signal, value).
+	Отсутствующие в кадре сигналы (страница мультиплексора, короткий кадр) -- NULL в широкой
+	схеме и нет строки в узкой.
+
+	Данные: строки накапливаются в буфере таблицы и записываются пакетом по batch строк --
+	многострочный INSERT или блок COPY ... FROM stdin (формат PostgreSQL). Схема и данные
+	записываются в одной транзакции. Числа выводятся функциями can_ev_fmt.h, без printf для
+	значений с десятичным разрешением, целые сигналы выделяются из данных кадра и выводятся точно.
+
+Тестирование:
+$ gcc -O2 -DTEST_CAN_SQL -DCAN_DBC_LIB can_ev_sql.c can_dbc.c -o sql.exe `pkg-config --cflags --libs glib-2.0`
+$ ./sql.exe
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "can_dbc.h"
+#include "can_ev_fmt.h"
+
+#define SQL_BUFFER	(1u<<20)	//!< буфер записи файла
+#define SQL_BATCH	1000		//!< строк в пакете по умолчанию
+
+/*! \brief формат значения столбца */
+enum {
+	SQL_INT,	//!< целое raw*factor+offset, factor и offset целые
+	SQL_UINT64,	//!< 64 бит без знака без масштабирования, NUMERIC(20)
+	SQL_ENUM,	//!< перечисление VAL_, значение без масштабирования
+	SQL_FIXED,	//!< десятичное разрешение factor и offset
+	SQL_GENERAL,//!< кратчайшая запись double
+};
+typedef struct _SqlSignal SqlSignal_t;
+struct _SqlSignal {
+	uint8_t kind;
+	uint8_t decimals;	//!< знаков после точки для SQL_FIXED
+	double scale;		//!< 10^decimals
+	int64_t factor, offset;// для SQL_INT
+};
+typedef struct _SqlTable SqlTable_t;
+struct _SqlTable {
+	GString* head;		//!< INSERT INTO ... VALUES или COPY ... FROM stdin;
+	GString* rows;		//!< строки пакета
+	uint32_t count;		//!< строк в пакете
+	uint32_t row_size;	//!< наибольшая длина записи кадра
+};
+typedef struct _SqlWriter SqlWriter_t;
+struct _SqlWriter {
+	int fd;
+	char* filename;
+	can_dbc_sql_options_t options;
+	const can_dbc_t* dbc;
+	SqlSignal_t* signals;	//!< по номеру сигнала в таблице сигналов
+	SqlTable_t* tables;		//!< по номеру сообщения, в узкой схеме -- одна таблица
+	const char* null;		//!< запись отсутствующего значения
+	GString* out;
+};
+
+/*! \brief идентификатор SQL в двойных кавычках */
+static void _sql_ident(GString* str, const char* name)
+{
+	g_string_append_c(str, '"');
+	for (; *name; name++) {
+		if (*name=='"') g_string_append_c(str, '"');
+		g_string_append_c(str, *name);
+	}
+	g_string_append_c(str, '"');
+}
+/*! \brief строковая константа SQL в одинарных кавычках */
+static void _sql_literal(GString* str, const char* s)
+{
+	g_string_append_c(str, '\'');
+	for (; *s; s++) {
+		if (*s=='\'') g_string_append_c(str, '\'');
+		g_string_append_c(str, *s);
+	}
+	g_string_append_c(str, '\'');
+}
+/*! \brief кратчайшая запись float, однозначно восстанавливающая значение */
+static void _sql_float(GString* str, float x)
+{
+	char buf[CAN_FMT_NUMBER];
+	if (!isfinite(x)) {
+		g_string_append(str, "NULL");
+		return;
+	}
+	int prec;
+	for (prec=6; prec<9; prec++) {
+		snprintf(buf, sizeof(buf), "%.*g", prec, x);
+		if ((float)strtod(buf, NULL)==x) break;
+	}
+	snprintf(buf, sizeof(buf), "%.*g", prec, x);
+	g_string_append(str, buf);
+}
+/*! \brief тип столбца и формат значения сигнала
+
+	Тип выбирается по типу сигнала names_type[]: целые сигналы с целыми factor и offset
+	хранятся целыми по диапазону физических значений, остальные -- числами с плавающей точкой.
+ */
+static const char* _sql_signal(const can_dbc_signal_t* sg, SqlSignal_t* ss)
+{
+	const char* type = names_type[sg->type];
+	*ss = (SqlSignal_t){.kind = SQL_GENERAL, .decimals = CAN_FMT_GENERAL, .scale = 1};
+	if (strcmp(type, "float")==0)
+		return sg->factor==1 && sg->offset==0? "REAL": "DOUBLE PRECISION";
+	if ((strcmp(type, "unsigned")!=0 && strcmp(type, "signed")!=0) || sg->len==0)
+		return "DOUBLE PRECISION";
+	const gboolean sign = strcmp(type, "signed")==0;
+	if (sg->en_size!=0) {
+		ss->kind = SQL_ENUM;
+		return sg->len < 32 || (sign && sg->len==32)? "INTEGER": sign || sg->len < 64? "BIGINT": "NUMERIC(20)";
+	}
+	const uint8_t decimals = can_fmt_signal_decimals(sg->factor, sg->offset);
+	if (decimals==0) {
+		if (!sign && sg->len==64 && sg->factor==1 && sg->offset==0) {
+			ss->kind = SQL_UINT64;
+			return "NUMERIC(20)";
+		}
+		const double lo = sign? -ldexp(1, sg->len-1): 0;
+		const double hi = sign?  ldexp(1, sg->len-1)-1: ldexp(1, sg->len)-1;
+		const double a = lo*sg->factor + sg->offset, b = hi*sg->factor + sg->offset;
+		const double p_min = MIN(a, b), p_max = MAX(a, b);
+		if (p_min >= -9223372036854775808.0 && p_max < 9223372036854775808.0) {// raw*factor+offset в int64
+			ss->kind = SQL_INT;
+			ss->factor = llround(sg->factor);
+			ss->offset = llround(sg->offset);
+			return p_min >= -32768 && p_max <= 32767? "SMALLINT":
+				p_min >= -2147483648.0 && p_max <= 2147483647? "INTEGER": "BIGINT";
+		}
+	} else if (decimals!=CAN_FMT_GENERAL) {
+		ss->kind = SQL_FIXED;
+		ss->decimals = decimals;
+		ss->scale = pow(10, decimals);
+	}
+	return "DOUBLE PRECISION";
+}
+/*! \brief физическое значение VAL_ для таблицы "signal_val" узкой схемы: масштабирование и
+	формат те же, что у значений сигнала в "signal_value"
+ */
+static char* _sql_enum_value(char* p, const can_dbc_signal_t* sg, int64_t val)
+{
+	can_dbc_signal_t phys = *sg;
+	phys.en_size = 0;
+	SqlSignal_t ss;
+	_sql_signal(&phys, &ss);
+	const uint64_t raw = val;
+	switch (ss.kind) {
+	case SQL_INT:
+		return can_fmt_i64(p, (int64_t)raw*ss.factor + ss.offset);
+	case SQL_UINT64:
+		return can_fmt_u64(p, raw);
+	case SQL_FIXED:
+		return can_fmt_fixed(p, can_signal_phys(sg, raw), ss.decimals, ss.scale, "NULL");
+	default:
+		return can_fmt_general(p, can_signal_phys(sg, raw), "NULL");
+	}
+}
+/*! \brief имя таблицы значений сообщения в широкой схеме */
+static char* _sql_message_name(const can_dbc_t* dbc, const can_dbc_object_t* obj)
+{
+	return g_strdup_printf("msg_%s", can_dbc_string(dbc, obj->name));
+}
+/*! \brief имя таблицы значений перечисления в широкой схеме */
+static char* _sql_enum_name(const can_dbc_t* dbc, const can_dbc_object_t* obj, const can_dbc_signal_t* sg)
+{
+	return g_strdup_printf("val_%s_%s", can_dbc_string(dbc, obj->name), can_dbc_string(dbc, sg->name));
+}
+static void _sql_message_table(GString* str, const can_dbc_t* dbc, const can_dbc_object_t* obj)
+{
+	char* name = _sql_message_name(dbc, obj);
+	_sql_ident(str, name);
+	g_free(name);
+}
+static void _sql_enum_table(GString* str, const can_dbc_t* dbc, const can_dbc_object_t* obj, const can_dbc_signal_t* sg)
+{
+	char* name = _sql_enum_name(dbc, obj, sg);
+	_sql_ident(str, name);
+	g_free(name);
+}
+/*! \brief проверка совпадения имен таблиц широкой схемы
+	\return имя первой повторяющейся таблицы, NULL -- имена различны; освобождается g_free()
+ */
+static char* _sql_table_clash(const can_dbc_t* dbc)
+{
+	GHashTable* names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	char* clash = NULL;
+	uint32_t i, k;
+	for (i=0; i<dbc->bo_size && clash==NULL; i++) {
+		const can_dbc_object_t* obj = &dbc->object_table[i];
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+		if (obj->sg_size==0) continue;
+		char* name = _sql_message_name(dbc, obj);
+		for (k=0; clash==NULL; k++) {
+			if (g_hash_table_contains(names, name)) clash = g_strdup(name);
+			g_hash_table_add(names, name);
+			while (k<obj->sg_size && sg[k].en_size==0) k++;
+			if (k>=obj->sg_size) break;
+			name = _sql_enum_name(dbc, obj, &sg[k]);
+		}
+	}
+	g_hash_table_destroy(names);
+	return clash;
+}
+/*! \brief схема базы данных по скомпилированной базе DBC: таблицы описания сообщений и
+	сигналов, таблицы значений и таблицы имен перечислений VAL_
+	\param options - параметры экспорта, NULL -- по умолчанию
+ */
+GString* can_dbc_gen_sql(const can_dbc_t* dbc, const can_dbc_sql_options_t* options)
+{
+	const gboolean narrow = options!=NULL && options->narrow;
+	GString* str = g_string_sized_new(4096);
+	uint32_t i, k, e;
+	g_string_append(str,
+		"CREATE TABLE \"message\" (\"id\" BIGINT PRIMARY KEY, \"name\" TEXT NOT NULL, \"len\" SMALLINT NOT NULL);\n"
+		"CREATE TABLE \"signal\" (\"id\" INTEGER PRIMARY KEY, \"message\" BIGINT NOT NULL, \"name\" TEXT NOT NULL,"
+		" \"units\" TEXT NOT NULL, \"factor\" DOUBLE PRECISION NOT NULL, \"offset\" DOUBLE PRECISION NOT NULL,"
+		" \"min\" DOUBLE PRECISION, \"max\" DOUBLE PRECISION);\n");
+	if (narrow)
+		g_string_append(str,
+			"CREATE TABLE \"signal_value\" (\"ts\" BIGINT NOT NULL, \"signal\" INTEGER NOT NULL, \"value\" DOUBLE PRECISION);\n"
+			"CREATE TABLE \"signal_val\" (\"signal\" INTEGER NOT NULL, \"value\" DOUBLE PRECISION NOT NULL, \"name\" TEXT NOT NULL,"
+			" PRIMARY KEY (\"signal\", \"value\"));\n");
+	for (i=0; i<dbc->bo_size; i++) {
+		const can_dbc_object_t* obj = &dbc->object_table[i];
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+		g_string_append_printf(str, "INSERT INTO \"message\" VALUES (%u, ", obj->oid);
+		_sql_literal(str, can_dbc_string(dbc, obj->name));
+		g_string_append_printf(str, ", %u);\n", obj->data_len);
+		for (k=0; k<obj->sg_size; k++) {
+			g_string_append_printf(str, "INSERT INTO \"signal\" VALUES (%u, %u, ", obj->signals + k, obj->oid);
+			_sql_literal(str, can_dbc_string(dbc, sg[k].name));
+			g_string_append(str, ", ");
+			_sql_literal(str, can_dbc_string(dbc, sg[k].units));
+			const float v[] = {sg[k].factor, sg[k].offset, sg[k].min, sg[k].max};
+			for (e=0; e<G_N_ELEMENTS(v); e++) {
+				g_string_append(str, ", ");
+				_sql_float(str, v[e]);
+			}
+			g_string_append(str, ");\n");
+		}
+		if (narrow || obj->sg_size==0) continue;
+		g_string_append(str, "CREATE TABLE ");
+		_sql_message_table(str, dbc, obj);
+		g_string_append(str, " (\"ts\" BIGINT NOT NULL");
+		for (k=0; k<obj->sg_size; k++) {
+			SqlSignal_t ss;
+			g_string_append(str, ", ");
+			_sql_ident(str, can_dbc_string(dbc, sg[k].name));
+			g_string_append_printf(str, " %s", _sql_signal(&sg[k], &ss));
+		}
+		g_string_append(str, ");\n");
+		for (k=0; k<obj->sg_size; k++) {
+			if (sg[k].en_size==0) continue;
+			g_string_append(str, "CREATE TABLE ");
+			_sql_enum_table(str, dbc, obj, &sg[k]);
+			g_string_append(str, " (\"value\" BIGINT PRIMARY KEY, \"name\" TEXT NOT NULL);\n");
+		}
+	}
+	// имена значений перечислений
+	for (i=0; i<dbc->bo_size; i++) {
+		const can_dbc_object_t* obj = &dbc->object_table[i];
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+		for (k=0; k<obj->sg_size; k++) {
+			const can_dbc_enum_t* en = dbc->enum_table + sg[k].enums;
+			for (e=0; e<sg[k].en_size; e++) {
+				if (narrow) {
+					char buf[CAN_FMT_NUMBER];
+					g_string_append_printf(str, "INSERT INTO \"signal_val\" VALUES (%u, ", obj->signals + k);
+					g_string_append_len(str, buf, _sql_enum_value(buf, &sg[k], en[e].val) - buf);
+					g_string_append(str, ", ");
+				} else {
+					g_string_append(str, "INSERT INTO ");
+					_sql_enum_table(str, dbc, obj, &sg[k]);
+					g_string_append_printf(str, " VALUES (%" G_GINT64_FORMAT ", ", (gint64)en[e].val);
+				}
+				_sql_literal(str, can_dbc_string(dbc, en[e].name));
+				g_string_append(str, ");\n");
+			}
+		}
+	}
+	return str;
+}
+/*! \brief значение сигнала кадра
+	\param v - физическое значение из can_dbc_decode_mux()
+ */
+static inline char* _sql_value(char* p, const SqlSignal_t* ss, const can_dbc_signal_t* sg, const struct canfd_frame* frame,
+		double v, const char* null)
+{
+	switch (ss->kind) {
+	case SQL_INT: {
+		const uint64_t raw = can_signal_value_fd(frame, sg);
+		return can_fmt_i64(p, (int64_t)raw*ss->factor + ss->offset);
+	}
+	case SQL_UINT64:
+		return can_fmt_u64(p, can_signal_value_fd(frame, sg));
+	case SQL_ENUM: {
+		const uint64_t raw = can_signal_value_fd(frame, sg);
+		return sg->type==_TYPE_INTEGER? can_fmt_i64(p, raw): can_fmt_u64(p, raw);
+	}
+	case SQL_FIXED:
+		return can_fmt_fixed(p, v, ss->decimals, ss->scale, null);
+	default:
+		return can_fmt_general(p, v, null);
+	}
+}
+/*! \brief запись пакета таблицы в буфер файла, при заполнении буфер записывается в файл */
+static gboolean _sql_flush(SqlWriter_t* w, SqlTable_t* t, gboolean force, GError** error)
+{
+	if (t!=NULL && t->count!=0) {
+		g_string_append_len(w->out, t->head->str, t->head->len);
+		if (w->options.copy) {
+			g_string_append_len(w->out, t->rows->str, t->rows->len);
+			g_string_append(w->out, "\\.\n");
+		} else {// запятая после последней строки
+			g_string_append_len(w->out, t->rows->str, t->rows->len - 2);
+			g_string_append(w->out, ";\n");
+		}
+		g_string_truncate(t->rows, 0);
+		t->count = 0;
+	}
+	if (w->out->len < SQL_BUFFER && !force) return TRUE;
+	const char* buf = w->out->str;
+	size_t size = w->out->len;
+	while (size>0) {
+		ssize_t r = write(w->fd, buf, size);
+		if (r<0) {
+			if (errno==EINTR) continue;
+			int errsv = errno;
+			g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", w->filename, g_strerror(errsv));
+			return FALSE;
+		}
+		buf += r, size -= r;
+	}
+	g_string_truncate(w->out, 0);
+	return TRUE;
+}
+/*! \brief заголовок пакета: INSERT INTO "T" ("a","b") VALUES или COPY "T" ("a","b") FROM stdin; */
+static GString* _sql_head(const SqlWriter_t* w, const char* table, const char* const* columns, uint32_t n)
+{
+	GString* str = g_string_new(w->options.copy? "COPY ": "INSERT INTO ");
+	uint32_t k;
+	_sql_ident(str, table);
+	g_string_append(str, " (");
+	for (k=0; k<n; k++) {
+		if (k) g_string_append_c(str, ',');
+		_sql_ident(str, columns[k]);
+	}
+	g_string_append(str, w->options.copy? ") FROM stdin;\n": ") VALUES\n");
+	return str;
+}
+static gboolean _sql_begin(void* user, const can_dbc_t* dbc, GError** error)
+{
+	SqlWriter_t* w = user;
+	uint32_t i, k;
+	if (!w->options.narrow) {
+		char* clash = _sql_table_clash(dbc);
+		if (clash!=NULL) {
+			g_set_error(error, CAN_DBC_ERROR, CAN_DBC_ERROR_OBJECT, "%s: duplicate table \"%s\"", w->filename, clash);
+			g_free(clash);
+			return FALSE;
+		}
+	}
+	w->dbc = dbc;
+	w->signals = g_new0(SqlSignal_t, dbc->sg_size);
+	for (i=0; i<dbc->sg_size; i++) {
+		can_dbc_signal_t sg = dbc->signal_table[i];
+		if (w->options.narrow) sg.en_size = 0;// в узкой схеме -- физическое значение
+		_sql_signal(&sg, &w->signals[i]);
+	}
+	const uint32_t n = w->options.narrow? 1: dbc->bo_size;
+	w->tables = g_new0(SqlTable_t, n);
+	for (i=0; i<n; i++) {
+		SqlTable_t* t = &w->tables[i];
+		t->rows = g_string_new(NULL);
+		if (w->options.narrow) {
+			static const char* const columns[] = {"ts", "signal", "value"};
+			t->head = _sql_head(w, "signal_value", columns, 3);
+			continue;
+		}
+		const can_dbc_object_t* obj = &dbc->object_table[i];
+		const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+		const char** columns = g_new(const char*, obj->sg_size + 1);
+		columns[0] = "ts";
+		for (k=0; k<obj->sg_size; k++)
+			columns[k+1] = can_dbc_string(dbc, sg[k].name);
+		char* table = _sql_message_name(dbc, obj);
+		t->head = _sql_head(w, table, columns, obj->sg_size + 1);
+		g_free(table);
+		t->row_size = 24 + obj->sg_size*(CAN_FMT_NUMBER+1) + 4;
+		g_free(columns);
+	}
+	if (w->options.narrow) {
+		for (i=0; i<dbc->bo_size; i++)
+			w->tables[0].row_size = MAX(w->tables[0].row_size,
+				dbc->object_table[i].sg_size*(2 + 20 + 1 + 10 + 1 + CAN_FMT_NUMBER + 3));
+	}
+	g_string_append(w->out, "BEGIN;\n");
+	GString* ddl = can_dbc_gen_sql(dbc, &w->options);
+	g_string_append_len(w->out, ddl->str, ddl->len);
+	g_string_free(ddl, TRUE);
+	return TRUE;
+}
+/*! \brief запись кадра в пакет таблицы
+	\return число строк таблицы
+ */
+static uint32_t _sql_row(SqlWriter_t* w, SqlTable_t* t, const can_dbc_row_t* row)
+{
+	const can_dbc_t* dbc = w->dbc;
+	const can_dbc_object_t* obj = row->object;
+	const gboolean copy = w->options.copy;
+	struct canfd_frame frame = {.can_id = row->can_id, .len = MIN(row->len, can_dbc_object_dlen(obj))};
+	memcpy(frame.data, row->data, frame.len);
+	uint32_t lo = 0, hi = 0, k, count = 0;
+	if (row->page!=NULL) {
+		lo = row->page->signals - obj->signals;
+		hi = lo + row->page->sg_size;
+	}
+	const size_t at = t->rows->len;
+	g_string_set_size(t->rows, at + t->row_size);
+	char* p = t->rows->str + at;
+	char ts[24];
+	const size_t ts_len = can_fmt_u64(ts, row->ts) - ts;
+	const can_dbc_signal_t* sg = can_dbc_object_signals(dbc, obj);
+	const SqlSignal_t* ss = &w->signals[obj->signals];
+	if (!w->options.narrow) {
+		if (!copy) *p++ = '(';
+		memcpy(p, ts, ts_len);
+		p += ts_len;
+	}
+	for (k=0; k<obj->sg_size; k++, sg++, ss++) {
+		const gboolean valid = (k < obj->base_size || (k >= lo && k < hi)) && sg->len!=0 &&
+			can_signal_bytes(sg) <= frame.len;
+		if (w->options.narrow) {
+			if (!valid) continue;
+			if (!copy) *p++ = '(';
+			memcpy(p, ts, ts_len);
+			p += ts_len;
+			*p++ = copy? '\t': ',';
+			p = can_fmt_u64(p, obj->signals + k);
+			*p++ = copy? '\t': ',';
+			p = _sql_value(p, ss, sg, &frame, row->values[k], w->null);
+			if (!copy) {
+				memcpy(p, "),\n", 3);
+				p += 3;
+			} else
+				*p++ = '\n';
+			count++;
+			continue;
+		}
+		*p++ = copy? '\t': ',';
+		if (valid)
+			p = _sql_value(p, ss, sg, &frame, row->values[k], w->null);
+		else {
+			const size_t n = strlen(w->null);
+			memcpy(p, w->null, n);
+			p += n;
+		}
+	}
+	if (!w->options.narrow) {
+		if (!copy) {
+			memcpy(p, "),\n", 3);
+			p += 3;
+		} else
+			*p++ = '\n';
+		count = 1;
+	}
+	g_string_truncate(t->rows, p - t->rows->str);
+	return count;
+}
+static gboolean _sql_rows(void* user, const can_dbc_t* dbc, const can_dbc_row_t* rows, uint32_t n, GError** error)
+{
+	SqlWriter_t* w = user;
+	uint32_t k;
+	for (k=0; k<n; k++) {
+		if (rows[k].object->sg_size==0) continue;
+		SqlTable_t* t = &w->tables[w->options.narrow? 0: rows[k].object - dbc->object_table];
+		t->count += _sql_row(w, t, &rows[k]);
+		if (t->count >= w->options.batch && !_sql_flush(w, t, FALSE, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+static gboolean _sql_end(void* user, GError** error)
+{
+	SqlWriter_t* w = user;
+	gboolean ok = TRUE;
+	uint32_t i;
+	if (w->dbc!=NULL) {
+		const uint32_t n = w->options.narrow? 1: w->dbc->bo_size;
+		for (i=0; i<n && ok; i++)
+			ok = _sql_flush(w, &w->tables[i], FALSE, error);
+		for (i=0; i<n; i++) {
+			g_string_free(w->tables[i].head, TRUE);
+			g_string_free(w->tables[i].rows, TRUE);
+		}
+	}
+	if (ok) {
+		g_string_append(w->out, "COMMIT;\n");
+		ok = _sql_flush(w, NULL, TRUE, error);
+	}
+	if (close(w->fd)<0 && ok) {
+		int errsv = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", w->filename, g_strerror(errsv));
+		ok = FALSE;
+	}
+	g_string_free(w->out, TRUE);
+	g_free(w->tables);
+	g_free(w->signals);
+	g_free(w->filename);
+	g_free(w);
+	return ok;
+}
+/*! \brief получатель: схема и разобранные кадры записываются в файл SQL
+	\param options - параметры экспорта, NULL -- по умолчанию: таблица на сообщение, INSERT по 1000 строк
+ */
+gboolean can_dbc_export_sql(can_dbc_exporter_t* exporter, const char* filename, const can_dbc_sql_options_t* options,
+		GError** error)
+{
+	int fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (fd<0) {
+		int errsv = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errsv), "%s: %s", filename, g_strerror(errsv));
+		return FALSE;
+	}
+	SqlWriter_t* w = g_new0(SqlWriter_t, 1);
+	w->fd = fd;
+	w->filename = g_strdup(filename);
+	if (options!=NULL) w->options = *options;
+	if (w->options.batch==0) w->options.batch = SQL_BATCH;
+	w->null = w->options.copy? "\\N": "NULL";
+	w->out = g_string_sized_new(SQL_BUFFER + SQL_BUFFER/4);
+	*exporter = (can_dbc_exporter_t){.begin = _sql_begin, .rows = _sql_rows, .end = _sql_end, .user = w};
+	return TRUE;
+}
+
+#ifdef TEST_CAN_SQL
+#include <glib/gstdio.h>
+/*! экспорт кадров в файл, результат без схемы сравнивается с ожидаемым */
+static int _test_export(const char* filename, const can_dbc_t* dbc, const can_dbc_sql_options_t* options,
+		const can_dbc_row_t* rows, uint32_t n, const char* expect)
+{
+	can_dbc_exporter_t ex;
+	GError* error = NULL;
+	gboolean ok = can_dbc_export_sql(&ex, filename, options, &error) && ex.begin(ex.user, dbc, &error)
+		&& ex.rows(ex.user, dbc, rows, n, &error);
+	ok = ex.end(ex.user, ok? &error: NULL) && ok;
+	char* text = NULL;
+	if (ok) g_file_get_contents(filename, &text, NULL, NULL);
+	remove(filename);
+	GString* ddl = can_dbc_gen_sql(dbc, options);
+	const size_t head = sizeof("BEGIN;\n")-1 + ddl->len;
+	int fail = text==NULL || strlen(text) < head || strncmp(text, "BEGIN;\n", 7)!=0
+		|| strncmp(text + 7, ddl->str, ddl->len)!=0 || strcmp(text + head, expect)!=0;
+	printf("%s%s", text!=NULL && strlen(text) >= head? text + head: "", fail? "..fail\n": "");
+	g_string_free(ddl, TRUE);
+	g_free(text);
+	return fail;
+}
+int main(int argc, char* argv[])
+{
+	const char* text =
+		"BO_ 100 A: 8 ECU\n"
+		" SG_ Gear : 0|4@1+ (1,0) [0|15] \"\" ECU\n"
+		" SG_ Temp : 8|8@1- (0.5,-40) [-104|23.5] \"C\" ECU\n"
+		" SG_ Speed : 16|16@1+ (0.01,0) [0|655.35] \"km/h\" ECU\n"
+		" SG_ Odo : 32|32@1+ (0.001,0) [0|0] \"km\" ECU\n"
+		"BO_ 2364540158 MUX: 8 ECU\n"
+		" SG_ Page M : 0|8@1+ (1,0) [0|255] \"\" ECU\n"
+		" SG_ P0 m0 : 8|16@1- (1,0) [0|0] \"\" ECU\n"
+		" SG_ P1 m1 : 8|32@1+ (0.3,0) [0|0] \"\" ECU\n"
+		"VAL_ 100 Gear 0 \"P\" 1 \"R\" 2 \"N\" 3 \"D'\" ;\n";
+	can_dbc_t* dbc = can_dbc_init(NULL);
+	can_dbc_parse(dbc, text, strlen(text), NULL, NULL);
+	can_dbc_compile(dbc);
+	const can_dbc_object_t* a   = can_dbc_lookup(dbc, 100);
+	const can_dbc_object_t* mux = can_dbc_lookup(dbc, 2364540158u);
+	// схема
+	GString* ddl = can_dbc_gen_sql(dbc, NULL);
+	printf("%s", ddl->str);
+	int fail = strstr(ddl->str, "CREATE TABLE \"msg_A\" (\"ts\" BIGINT NOT NULL, \"Gear\" INTEGER, \"Temp\" DOUBLE PRECISION,"
+			" \"Speed\" DOUBLE PRECISION, \"Odo\" DOUBLE PRECISION);\n")==NULL
+		|| strstr(ddl->str, "CREATE TABLE \"msg_MUX\" (\"ts\" BIGINT NOT NULL, \"Page\" SMALLINT, \"P0\" SMALLINT,"
+			" \"P1\" DOUBLE PRECISION);\n")==NULL
+		|| strstr(ddl->str, "INSERT INTO \"val_A_Gear\" VALUES (3, 'D''');\n")==NULL
+		|| strstr(ddl->str, "INSERT INTO \"signal\" VALUES (1, 100, 'Temp', 'C', 0.5, -40, -104, 23.5);\n")==NULL;
+	g_string_free(ddl, TRUE);
+	printf("schema: ..%s\n", fail? "fail": "ok");
+	// узкая схема: имена значений по физическому значению, как в "signal_value"
+	{
+		const char* val_text =
+			"BO_ 300 T: 8 ECU\n SG_ Temp : 0|8@1- (0.5,-40) [0|0] \"C\" ECU\n"
+			"VAL_ 300 Temp -1 \"SNA\" 100 \"Hot\" ;\n";
+		can_dbc_t* vdbc = can_dbc_init(NULL);
+		can_dbc_parse(vdbc, val_text, strlen(val_text), NULL, NULL);
+		can_dbc_compile(vdbc);
+		const can_dbc_sql_options_t narrow = {.narrow = TRUE};
+		ddl = can_dbc_gen_sql(vdbc, &narrow);
+		const int bad = strstr(ddl->str, "INSERT INTO \"signal_val\" VALUES (0, -40.5, 'SNA');\n")==NULL
+			|| strstr(ddl->str, "INSERT INTO \"signal_val\" VALUES (0, 10, 'Hot');\n")==NULL;
+		printf("narrow VAL_: ..%s\n", bad? "fail": "ok");
+		fail += bad;
+		g_string_free(ddl, TRUE);
+		can_dbc_free(vdbc);
+	}
+	// данные: пакеты по 2 строки, короткий кадр и страница мультиплексора
+	gchar* filename = NULL;
+	int fd = g_file_open_tmp("test-XXXXXX.sql", &filename, NULL);
+	if (fd>=0) g_close(fd, NULL);
+	double values[3][8];
+	struct can_frame f[3] = {
+		{.can_id = 100, .len = 8, .data = {3, 0xF6, 0x39, 0x30, 0x40, 0xE2, 0x01, 0x00}},
+		{.can_id = mux->oid, .len = 8, .data = {1, 7, 0, 0, 0}},
+		{.can_id = 100, .len = 2, .data = {3, 0xF6}},
+	};
+	can_dbc_row_t rows[3];
+	uint32_t i;
+	for (i=0; i<3; i++) {
+		rows[i] = (can_dbc_row_t){.ts = i+1, .object = i==1? mux: a, .values = values[i], .data = f[i].data,
+			.can_id = f[i].can_id, .len = f[i].len};
+		rows[i].page = can_dbc_decode_mux(dbc, rows[i].object, &f[i], values[i]);
+	}
+	can_dbc_sql_options_t options = {.batch = 2};
+	fail += _test_export(filename, dbc, &options, rows, 3,
+		"INSERT INTO \"msg_A\" (\"ts\",\"Gear\",\"Temp\",\"Speed\",\"Odo\") VALUES\n"
+		"(1,3,-45,123.45,123.456),\n"
+		"(3,3,-45,NULL,NULL);\n"
+		"INSERT INTO \"msg_MUX\" (\"ts\",\"Page\",\"P0\",\"P1\") VALUES\n"
+		"(2,1,NULL,2.1);\n"
+		"COMMIT;\n");
+	options.copy = TRUE;
+	fail += _test_export(filename, dbc, &options, rows, 3,
+		"COPY \"msg_A\" (\"ts\",\"Gear\",\"Temp\",\"Speed\",\"Odo\") FROM stdin;\n"
+		"1\t3\t-45\t123.45\t123.456\n"
+		"3\t3\t-45\t\\N\t\\N\n"
+		"\\.\n"
+		"COPY \"msg_MUX\" (\"ts\",\"Page\",\"P0\",\"P1\") FROM stdin;\n"
+		"2\t1\t\\N\t2.1\n"
+		"\\.\n"
+		"COMMIT;\n");
+	options = (can_dbc_sql_options_t){.batch = 2, .narrow = TRUE};
+	fail += _test_export(filename, dbc, &options, rows, 3,
+		"INSERT INTO \"signal_value\" (\"ts\",\"signal\",\"value\") VALUES\n"
+		"(1,0,3),\n(1,1,-45),\n(1,2,123.45),\n(1,3,123.456);\n"
+		"INSERT INTO \"signal_value\" (\"ts\",\"signal\",\"value\") VALUES\n"
+		"(2,4,1),\n(2,6,2.1);\n"
+		"INSERT INTO \"signal_value\" (\"ts\",\"signal\",\"value\") VALUES\n"
+		"(3,0,3),\n(3,1,-45);\n"
+		"COMMIT;\n");
+	printf("export: ..%s\n", fail? "fail": "ok");
+	// совпадение имен таблиц: A.B_C и A_B.C
+	{
+		const char* clash_text =
+			"BO_ 1 A: 8 ECU\n SG_ B_C : 0|8@1+ (1,0) [0|0] \"\" ECU\n"
+			"BO_ 2 A_B: 8 ECU\n SG_ C : 0|8@1+ (1,0) [0|0] \"\" ECU\n"
+			"VAL_ 1 B_C 0 \"x\" ;\nVAL_ 2 C 0 \"y\" ;\n";
+		can_dbc_t* clash = can_dbc_init(NULL);
+		can_dbc_parse(clash, clash_text, strlen(clash_text), NULL, NULL);
+		can_dbc_compile(clash);
+		can_dbc_exporter_t ex;
+		GError* error = NULL;
+		gboolean ok = can_dbc_export_sql(&ex, filename, NULL, &error) && ex.begin(ex.user, clash, &error);
+		ex.end(ex.user, NULL);
+		remove(filename);
+		const int bad = ok || error==NULL || strstr(error->message, "\"val_A_B_C\"")==NULL;
+		printf("clash: %s ..%s\n", error!=NULL? error->message: "", bad? "fail": "ok");
+		fail += bad;
+		g_clear_error(&error);
+		can_dbc_free(clash);
+	}
+	// скорость записи
+	const uint32_t N = argc>1? atoi(argv[1]): 1000000;
+	can_dbc_row_t* batch = g_new(can_dbc_row_t, 1024);
+	double* vals = g_new(double, 1024*8);
+	struct can_frame* frames = g_new0(struct can_frame, 1024);
+	uint64_t x = 1;
+	for (i=0; i<1024; i++) {
+		x = x*6364136223846793005ULL + 1442695040888963407ULL;
+		frames[i] = (struct can_frame){.can_id = i&1? mux->oid: 100, .len = 8};
+		memcpy(frames[i].data, &x, 8);
+		frames[i].data[0] &= i&1? 1: 3;
+		batch[i] = (can_dbc_row_t){.ts = 1700000000000000000ull + i*1000ull, .object = i&1? mux: a,
+			.values = vals + 8*i, .data = frames[i].data, .can_id = frames[i].can_id, .len = 8};
+		batch[i].page = can_dbc_decode_mux(dbc, batch[i].object, &frames[i], vals + 8*i);
+	}
+	const char* modes[] = {"insert", "copy", "narrow"};
+	for (i=0; i<G_N_ELEMENTS(modes); i++) {
+		options = (can_dbc_sql_options_t){.copy = i==1, .narrow = i==2};
+		can_dbc_exporter_t ex;
+		GError* error = NULL;
+		uint32_t k;
+		gint64 t0 = g_get_monotonic_time();
+		gboolean ok = can_dbc_export_sql(&ex, filename, &options, &error) && ex.begin(ex.user, dbc, &error);
+		for (k=0; k<N && ok; k+=1024)
+			ok = ex.rows(ex.user, dbc, batch, 1024, &error);
+		ok = ex.end(ex.user, ok? &error: NULL) && ok;
+		gint64 t1 = g_get_monotonic_time();
+		GStatBuf st = {0};
+		g_stat(filename, &st);
+		printf("%s: %.1f Mrows/s %.0f MB/s ..%s\n", modes[i], N/(double)(t1-t0), st.st_size/(double)(t1-t0),
+			ok? "ok": "fail");
+		fail += !ok;
+		remove(filename);
+	}
+	g_free(filename);
+	g_free(frames);
+	g_free(vals);
+	g_free(batch);
+	can_dbc_free(dbc);
+	return fail!=0;
+}
+#endif//TEST_CAN_SQL
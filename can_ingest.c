@@ -0,0 +1,386 @@
+/*! \file can_ingest.c
+
+	\brief Пакетный прием кадров CAN: recvmmsg() для сокетов, read() для потоков
+
+	Один системный вызов заполняет непрерывный свободный участок кольца, до конца массива
+	ячеек. Для сокета каждой ячейке соответствует заголовок recvmmsg(), время приема
+	берется из SCM_TIMESTAMPNS, если у сокета включен SO_TIMESTAMPNS. Поток читается
+	блоком прямо в ячейки, неполная запись в конце блока дочитывается следующим вызовом.
+
+	Фильтры имеют смысл фильтров SocketCAN: кадр принимается, если совпадает хотя бы
+	с одним фильтром, (can_id ^ filter.can_id) & filter.can_mask == 0, CAN_INV_FILTER
+	инвертирует фильтр. Результат для всех 11 бит идентификаторов вычисляется заранее
+	и хранится битовой картой, для 29 бит фильтры проверяются по списку. Пакет
+	уплотняется на месте, кадры до первого отброшенного не перемещаются.
+
+	Открытие сокета CAN_RAW и фильтры ядра остаются вызывающей стороне: заголовки
+	linux/can.h повторяют определения sys/can.h.
+
+Тестирование:
+$ gcc -O2 -DTEST_CAN_INGEST can_ingest.c -o ingest.exe
+$ ./ingest.exe
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	// recvmmsg
+#endif
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "can_ingest.h"
+
+#if defined(__linux__) && defined(SO_TIMESTAMPNS)
+#define HAVE_RECVMMSG 1
+#endif
+
+/*! \brief кольцо из size ячеек по mtu байт, size -- степень двойки
+	\param stamps - массив size значений времени приема или NULL
+ */
+void can_ring_init(can_ring_t* ring, void* slots, uint64_t* stamps, uint32_t size, uint32_t mtu)
+{
+	ring->slots  = slots;
+	ring->stamps = stamps;
+	ring->size = size;
+	ring->mtu  = mtu;
+	ring->head = ring->tail = 0;
+}
+static inline int _filter_match(const struct can_filter* f, canid_t can_id)
+{
+	int match = ((can_id ^ f->can_id) & f->can_mask & ~CAN_INV_FILTER)==0;
+	return (f->can_id & CAN_INV_FILTER)? !match: match;
+}
+static inline uint32_t _sff_index(canid_t can_id)
+{
+	return (can_id & CAN_SFF_MASK) | ((can_id & CAN_RTR_FLAG)? CAN_SFF_MASK+1: 0);
+}
+/*! \brief компиляция набора фильтров, n = 0 -- принимать все кадры
+	\return 0 или -1 при ошибке выделения памяти
+ */
+int can_filter_set_compile(can_filter_set_t* set, const struct can_filter* filters, uint32_t n)
+{
+	memset(set, 0, sizeof(can_filter_set_t));
+	if (n==0) return 0;
+	set->eff = malloc(n*sizeof(struct can_filter));
+	if (set->eff==NULL) return -1;
+	set->enabled = 1;
+	uint32_t i, k;
+	for (k=0; k<n; k++) {// фильтр, требующий SFF, не совпадает с 29 бит идентификатором
+		const struct can_filter* f = &filters[k];
+		if ((f->can_id & CAN_INV_FILTER) || (f->can_mask & CAN_EFF_FLAG)==0 || (f->can_id & CAN_EFF_FLAG))
+			set->eff[set->n_eff++] = *f;
+	}
+	for (i=0; i<2*(CAN_SFF_MASK+1); i++) {
+		canid_t can_id = (i & CAN_SFF_MASK) | ((i > CAN_SFF_MASK)? CAN_RTR_FLAG: 0);
+		for (k=0; k<n; k++)
+			if (_filter_match(&filters[k], can_id)) break;
+		if (k<n) set->sff[i/64] |= 1ULL<<(i%64);
+	}
+	return 0;
+}
+void can_filter_set_free(can_filter_set_t* set)
+{
+	free(set->eff);
+	memset(set, 0, sizeof(can_filter_set_t));
+}
+static inline int _filter_pass(const can_filter_set_t* set, canid_t can_id)
+{
+	if ((can_id & (CAN_EFF_FLAG|CAN_ERR_FLAG))==0) {
+		uint32_t i = _sff_index(can_id);
+		return (set->sff[i/64]>>(i%64)) & 1;
+	}
+	uint32_t k;
+	for (k=0; k<set->n_eff; k++)
+		if (_filter_match(&set->eff[k], can_id)) return 1;
+	return 0;
+}
+static inline void _ring_move(can_ring_t* ring, uint32_t dst, uint32_t src)
+{
+	memcpy(can_ring_frame(ring, dst), can_ring_frame(ring, src), ring->mtu);
+	if (ring->stamps) ring->stamps[dst & (ring->size-1)] = ring->stamps[src & (ring->size-1)];
+}
+/*! \brief фильтрация кадров first..first+n-1 кольца с уплотнением на месте
+	\return число оставленных кадров, они занимают ячейки начиная с first
+ */
+uint32_t can_filter_set_apply(const can_filter_set_t* set, can_ring_t* ring, uint32_t first, uint32_t n)
+{
+	if (!set->enabled) return n;
+	uint32_t i, k = 0;
+	for (i=0; i<n; i++) {
+		if (!_filter_pass(set, can_ring_frame(ring, first+i)->can_id)) continue;
+		if (k!=i) _ring_move(ring, first+k, first+i);
+		k++;
+	}
+	return k;
+}
+static uint64_t _clock_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec*1000000000u + ts.tv_nsec;
+}
+
+#ifdef HAVE_RECVMMSG
+#define CONTROL_SIZE CMSG_SPACE(sizeof(struct timespec))
+/*! \brief заголовки recvmmsg(): массив struct mmsghdr, за ним массивы iovec и буферов управления */
+typedef struct _RecvControl RecvControl_t;
+struct _RecvControl {
+	uint64_t data[(CONTROL_SIZE+7)/8];
+};
+#endif
+/*! \brief источник -- сокет, кадр в каждой датаграмме
+	\param batch - наибольшее число кадров за один вызов recvmmsg()
+	\return 0 или -1 при ошибке выделения памяти
+ */
+int can_source_socket(can_source_t* src, int fd, uint32_t batch)
+{
+	memset(src, 0, sizeof(can_source_t));
+	src->fd = fd;
+	src->type = CAN_SOURCE_SOCKET;
+	src->batch = batch? batch: 1;
+#ifdef HAVE_RECVMMSG
+	src->msgs = calloc(src->batch, sizeof(struct mmsghdr) + sizeof(struct iovec) + sizeof(RecvControl_t));
+	if (src->msgs==NULL) return -1;
+#endif
+	return 0;
+}
+/*! \brief источник -- поток записей по mtu байт кольца: канал или файл записи */
+int can_source_stream(can_source_t* src, int fd)
+{
+	memset(src, 0, sizeof(can_source_t));
+	src->fd = fd;
+	src->type = CAN_SOURCE_STREAM;
+	return 0;
+}
+int can_source_set_filter(can_source_t* src, const struct can_filter* filters, uint32_t n)
+{
+	can_filter_set_free(&src->filter);
+	return can_filter_set_compile(&src->filter, filters, n);
+}
+void can_source_close(can_source_t* src)
+{
+	can_filter_set_free(&src->filter);
+	free(src->msgs);
+	src->msgs = NULL;
+}
+/*! \brief прием датаграмм в ячейки head..head+n-1, усеченные и короткие датаграммы отбрасываются */
+static int _read_socket(can_source_t* src, can_ring_t* ring, uint32_t n)
+{
+	if (n > src->batch) n = src->batch;
+	uint32_t i, k = 0;
+#ifdef HAVE_RECVMMSG
+	struct mmsghdr* hdr = src->msgs;
+	struct iovec* iov = (struct iovec*)(hdr + src->batch);
+	RecvControl_t* control = (RecvControl_t*)(iov + src->batch);
+	for (i=0; i<n; i++) {
+		iov[i].iov_base = can_ring_frame(ring, ring->head+i);
+		iov[i].iov_len  = ring->mtu;
+		hdr[i].msg_hdr = (struct msghdr){
+			.msg_iov = &iov[i], .msg_iovlen = 1,
+			.msg_control = ring->stamps? control[i].data: NULL, .msg_controllen = ring->stamps? CONTROL_SIZE: 0,
+		};
+	}
+	src->calls++;
+	int r = recvmmsg(src->fd, hdr, n, MSG_DONTWAIT, NULL);
+	if (r<0) return (errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR)? 0: -1;
+	if (r==0) src->eof = 1;
+	uint64_t now = 0;
+	for (i=0; i<(uint32_t)r; i++) {
+		const struct msghdr* h = &hdr[i].msg_hdr;
+		if (hdr[i].msg_len < CAN_MTU || (h->msg_flags & MSG_TRUNC)) continue;
+		if (k!=i) memcpy(can_ring_frame(ring, ring->head+k), can_ring_frame(ring, ring->head+i), ring->mtu);
+		if (ring->stamps) {
+			uint64_t stamp = 0;
+			struct cmsghdr* c = CMSG_FIRSTHDR(h);
+			for (; c!=NULL; c = CMSG_NXTHDR((struct msghdr*)h, c)) {
+				if (c->cmsg_level==SOL_SOCKET && c->cmsg_type==SCM_TIMESTAMPNS) {
+					struct timespec ts;
+					memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+					stamp = (uint64_t)ts.tv_sec*1000000000u + ts.tv_nsec;
+				}
+			}
+			if (stamp==0) stamp = now? now: (now = _clock_ns());
+			ring->stamps[(ring->head+k) & (ring->size-1)] = stamp;
+		}
+		k++;
+	}
+#else
+	const uint64_t now = ring->stamps? _clock_ns(): 0;
+	for (i=0; i<n; i++) {
+		src->calls++;
+		ssize_t r = recv(src->fd, can_ring_frame(ring, ring->head+k), ring->mtu, MSG_DONTWAIT);
+		if (r<0) {
+			if (errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR) break;
+			if (k==0) return -1;
+			break;
+		}
+		if (r < CAN_MTU) continue;
+		if (ring->stamps) ring->stamps[(ring->head+k) & (ring->size-1)] = now;
+		k++;
+	}
+#endif
+	return k;
+}
+/*! \brief чтение блока записей в ячейки head..head+n-1, неполная запись остается в ячейке head+k */
+static int _read_stream(can_source_t* src, can_ring_t* ring, uint32_t n)
+{
+	uint8_t* buf = (uint8_t*)can_ring_frame(ring, ring->head);
+	src->calls++;
+	ssize_t r = read(src->fd, buf + src->partial, (size_t)n*ring->mtu - src->partial);
+	if (r<0) return (errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR)? 0: -1;
+	if (r==0) {
+		src->eof = 1;
+		return 0;
+	}
+	size_t total = src->partial + (size_t)r;
+	uint32_t k = total / ring->mtu;
+	src->partial = total % ring->mtu;
+	if (ring->stamps && k) {
+		const uint64_t now = _clock_ns();
+		uint32_t i;
+		for (i=0; i<k; i++) ring->stamps[(ring->head+i) & (ring->size-1)] = now;
+	}
+	return k;
+}
+/*! \brief чтение пакета кадров в свободный непрерывный участок кольца с фильтрацией
+	\return число добавленных кадров, 0 -- нет данных, кольцо заполнено или конец потока (src->eof),
+	-1 -- ошибка, errno
+ */
+int can_source_read(can_source_t* src, can_ring_t* ring)
+{
+	const uint32_t pos = ring->head & (ring->size-1);
+	uint32_t n = ring->size - can_ring_count(ring);
+	if (n > ring->size - pos) n = ring->size - pos;
+	if (n==0) {
+		src->overruns++;
+		return 0;
+	}
+	int k = (src->type==CAN_SOURCE_STREAM)? _read_stream(src, ring, n): _read_socket(src, ring, n);
+	if (k<=0) return k;
+	uint32_t kept = can_filter_set_apply(&src->filter, ring, ring->head, k);
+	if (src->partial && kept!=(uint32_t)k)// неполная запись следует за оставленными кадрами
+		memmove(can_ring_frame(ring, ring->head+kept), can_ring_frame(ring, ring->head+k), src->partial);
+	src->filtered += k - kept;
+	src->frames += kept;
+	ring->head += kept;
+	return kept;
+}
+
+#ifdef TEST_CAN_INGEST
+#include <stdio.h>
+#include <fcntl.h>
+static double seconds(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+static struct can_frame make_frame(uint32_t i)
+{
+	struct can_frame f = {.can_id = (i%3==0)? CAN_EFF_FLAG | (0x18FEF100 + (i & 0xFF)): (i & CAN_SFF_MASK), .len = 8};
+	memcpy(f.data, &i, sizeof(i));
+	return f;
+}
+// 0x100..0x1FF и PGN 0xFEF1 от адресов 0..0x7F
+static const struct can_filter filters[] = {
+	{.can_id = 0x100, .can_mask = CAN_EFF_FLAG|0x700},
+	{.can_id = CAN_EFF_FLAG|0x18FEF100, .can_mask = CAN_EFF_FLAG|0x1FFFFF80},
+};
+static int expect_pass(uint32_t i)
+{
+	struct can_frame f = make_frame(i);
+	if (f.can_id & CAN_EFF_FLAG) return (f.can_id & 0xFF) < 0x80;
+	return (f.can_id & 0x700)==0x100;
+}
+int main(){
+	enum { RING = 4096, N = 4000000 };
+	static struct can_frame slots[RING];
+	static uint64_t stamps[RING];
+	can_ring_t ring;
+	can_source_t src;
+	uint32_t i, expect = 0, got = 0, bad = 0;
+	// файл записи
+	FILE* fp = tmpfile();
+	struct can_frame* frames = malloc(N*sizeof(struct can_frame));
+	for (i=0; i<N; i++) {
+		frames[i] = make_frame(i);
+		expect += expect_pass(i);
+	}
+	fwrite(frames, sizeof(struct can_frame), N, fp);
+	fflush(fp);
+	lseek(fileno(fp), 0, SEEK_SET);
+	can_ring_init(&ring, slots, stamps, RING, CAN_MTU);
+	can_source_stream(&src, fileno(fp));
+	can_source_set_filter(&src, filters, 2);
+	double t = seconds();
+	uint32_t prev = 0;
+	while (!src.eof) {
+		if (can_source_read(&src, &ring)<0) break;
+		const struct can_frame* batch;
+		uint32_t n;
+		while ((n = can_ring_peek(&ring, &batch))!=0) {
+			for (i=0; i<n; i++) {
+				uint32_t seq;
+				memcpy(&seq, batch[i].data, 4);
+				if (!expect_pass(seq) || (got && seq<=prev)) bad++;
+				prev = seq;
+			}
+			got += n;
+			can_ring_consume(&ring, n);
+		}
+	}
+	t = seconds() - t;
+	printf("stream: %u frames, %u passed, expected %u, %llu reads, %.1f Mframes/s ..%s\n", N, got, expect,
+		(unsigned long long)src.calls, N/t*1e-6, (got==expect && bad==0)? "ok": "fail");
+	can_source_close(&src);
+	fclose(fp);
+	// канал: неполные записи дочитываются
+	int p[2];
+	int ok = pipe(p)==0;
+	can_ring_init(&ring, slots, NULL, RING, CAN_MTU);
+	can_source_stream(&src, p[0]);
+	fcntl(p[0], F_SETFL, O_NONBLOCK);
+	ok = ok && write(p[1], frames, 10*CAN_MTU + 5)==10*CAN_MTU + 5;
+	ok = ok && can_source_read(&src, &ring)==10 && src.partial==5;
+	ok = ok && write(p[1], (uint8_t*)frames + 10*CAN_MTU + 5, CAN_MTU - 5)==CAN_MTU - 5;
+	ok = ok && can_source_read(&src, &ring)==1 && memcmp(can_ring_frame(&ring, 10), &frames[10], CAN_MTU)==0;
+	ok = ok && can_source_read(&src, &ring)==0 && !src.eof;
+	close(p[1]);
+	ok = ok && can_source_read(&src, &ring)==0 && src.eof;
+	printf("pipe: partial records ..%s\n", ok? "ok": "fail");
+	close(p[0]);
+	can_source_close(&src);
+	// датаграммы: пакетами по 64, SOCK_SEQPACKET не ограничен длиной очереди датаграмм
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv)!=0) return 1;
+	int on = 1;
+	setsockopt(sv[1], SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+	can_ring_init(&ring, slots, stamps, RING, CAN_MTU);
+	can_source_socket(&src, sv[1], 64);
+	const uint32_t n_dgram = 200000;
+	got = bad = 0;
+	t = seconds();
+	for (i=0; i<n_dgram; i+=64) {
+		uint32_t j;
+		for (j=i; j<i+64 && j<n_dgram; j++) send(sv[0], &frames[j], CAN_MTU, 0);
+		int n = can_source_read(&src, &ring);
+		if (n<0) break;
+		for (j=0; j<(uint32_t)n; j++) {
+			uint32_t seq;
+			memcpy(&seq, can_ring_frame(&ring, ring.tail+j)->data, 4);
+			if (seq!=got+j || stamps[(ring.tail+j)&(RING-1)]==0) bad++;
+		}
+		got += n;
+		can_ring_consume(&ring, n);
+	}
+	t = seconds() - t;
+	printf("socket: %u datagrams, %u received, %llu recvmmsg, %.2f Mframes/s incl. send ..%s\n", n_dgram, got,
+		(unsigned long long)src.calls, n_dgram/t*1e-6, (got==n_dgram && bad==0)? "ok": "fail");
+	can_source_close(&src);
+	close(sv[0]);
+	close(sv[1]);
+	free(frames);
+	return 0;
+}
+#endif//TEST_CAN_INGEST
@@ -0,0 +1,91 @@
+#ifndef CAN_INGEST_H
+#define CAN_INGEST_H
+/*! \file can_ingest.h
+
+	\brief Пакетный прием кадров CAN в кольцевой буфер
+
+	Кольцо состоит из ячеек размером mtu: CAN_MTU -- struct can_frame, CANFD_MTU -- struct
+	canfd_frame; заголовки структур совпадают, длина кадра задана полем len. Память кольца
+	предоставляет вызывающая сторона. Источник читает кадры пакетами прямо в свободные
+	ячейки кольца: сокет -- recvmmsg(), поток (канал, файл записи) -- read() большими блоками.
+	Фильтры применяются ко всему пакету после чтения. Непрерывный участок кольца
+	передается разбору без копирования, см. can_ring_peek(): при mtu = CAN_MTU участок --
+	массив struct can_frame для can_dbc_decode().
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/can.h>
+
+#define CAN_INV_FILTER	0x20000000U	//!< инверсия фильтра, как в SocketCAN
+
+typedef struct _can_ring can_ring_t;
+struct _can_ring {
+	uint8_t* slots;		//!< size ячеек по mtu байт
+	uint64_t* stamps;	//!< время приема, нс, может быть NULL
+	uint32_t size;		//!< степень двойки
+	uint32_t mtu;		//!< CAN_MTU или CANFD_MTU
+	uint32_t head;		//!< счетчик записанных кадров
+	uint32_t tail;		//!< счетчик прочитанных кадров
+};
+/*! \brief набор фильтров, откомпилированный для пакетной проверки */
+typedef struct _can_filter_set can_filter_set_t;
+struct _can_filter_set {
+	uint64_t sff[2*(CAN_SFF_MASK+1)/64];//!< результат для 11 бит идентификаторов, с RTR и без
+	struct can_filter* eff;	//!< фильтры, проверяемые для 29 бит идентификаторов
+	uint32_t n_eff;
+	uint32_t enabled;
+};
+enum {
+	CAN_SOURCE_SOCKET,	//!< сокет, один кадр в датаграмме
+	CAN_SOURCE_STREAM,	//!< поток записей по mtu байт
+};
+typedef struct _can_source can_source_t;
+struct _can_source {
+	int fd;
+	int type;
+	uint32_t batch;		//!< наибольшее число кадров за один системный вызов
+	uint32_t partial;	//!< байты неполной записи потока в ячейке head
+	int eof;			//!< конец потока
+	can_filter_set_t filter;
+	void* msgs;			//!< заголовки recvmmsg()
+	// статистика
+	uint64_t frames;	//!< принято кадров после фильтра
+	uint64_t filtered;	//!< отброшено фильтром
+	uint64_t calls;		//!< системных вызовов чтения
+	uint64_t overruns;	//!< чтение при заполненном кольце
+};
+
+void can_ring_init(can_ring_t* ring, void* slots, uint64_t* stamps, uint32_t size, uint32_t mtu);
+static inline uint32_t can_ring_count(const can_ring_t* ring)
+{
+	return ring->head - ring->tail;
+}
+static inline struct can_frame* can_ring_frame(const can_ring_t* ring, uint32_t seq)
+{
+	return (struct can_frame*)(ring->slots + (size_t)(seq & (ring->size-1))*ring->mtu);
+}
+/*! \brief непрерывный участок непрочитанных кадров от tail до конца кольца
+	\return число кадров участка
+ */
+static inline uint32_t can_ring_peek(const can_ring_t* ring, const struct can_frame** frames)
+{
+	uint32_t n = ring->head - ring->tail;
+	uint32_t end = ring->size - (ring->tail & (ring->size-1));
+	*frames = can_ring_frame(ring, ring->tail);
+	return n < end? n: end;
+}
+static inline void can_ring_consume(can_ring_t* ring, uint32_t n)
+{
+	ring->tail += n;
+}
+
+int  can_filter_set_compile(can_filter_set_t* set, const struct can_filter* filters, uint32_t n);
+void can_filter_set_free(can_filter_set_t* set);
+uint32_t can_filter_set_apply(const can_filter_set_t* set, can_ring_t* ring, uint32_t first, uint32_t n);
+
+int  can_source_socket(can_source_t* src, int fd, uint32_t batch);
+int  can_source_stream(can_source_t* src, int fd);
+int  can_source_set_filter(can_source_t* src, const struct can_filter* filters, uint32_t n);
+int  can_source_read(can_source_t* src, can_ring_t* ring);
+void can_source_close(can_source_t* src);
+#endif//CAN_INGEST_H
@@ -34,41 +34,98 @@ CRC32/IEEE-802.3
 CRC32/
 	width=32 poly=0xF4ACFB13 init=0xFFFFFFFF refin=true refout=true xorout=0xFFFFFFFF check=0x1697D06A name="CRC-32/"
 
+Реализация:
+	обертка над вариантом can_crc8_sae_j1850 каталога can_crc.c: slicing-by-8, 
+	для длинных буферов на x86 -- свертка PCLMULQDQ, can_j1850_crc_mb() считает CRC 
+	пакета кадров фиксированной длины четырьмя независимыми цепочками.
+
 Тестирование:
-$ gcc -DTEST_CRC can_j1850_crc.c -o crc.exe
+$ gcc -O2 -DTEST_CRC can_j1850_crc.c can_crc.c -o crc.exe `pkg-config --cflags --libs glib-2.0`
 $ ./crc.exe
 CRC = 4B ..ok
 
 */
 #include <stddef.h>
+#include <stdint.h>
+#include "can_crc.h"
 
 #define CRC8_J1850_INIT 	0xFF
 #define CRC8_J1850_POLY 	0x1D
 #define CRC8_J1850_XOR 		0xFF
 #define CRC8_J1850_CHECK 	0x4B
-static const unsigned char CRC8I_Lookup4[16] = {
-0x00, 0x1D, 0x3A, 0x27,
-0x74, 0x69, 0x4E, 0x53,
-0xE8, 0xF5, 0xD2, 0xCF,
-0x9C, 0x81, 0xA6, 0xBB,
-};
-
+/*! \brief Контрольная сумма CRC-8/SAE-J1850 */
 unsigned char can_j1850_crc(unsigned char* buf, size_t len){
+	return can_crc(&can_crc8_sae_j1850, buf, len);
+}
+/*! \brief Контрольные суммы CRC-8/SAE-J1850 пакета буферов одной длины
+
+	Буферы расположены с шагом stride, например поле data массива struct can_frame 
+	или canfd_frame. Вычисляются четыре независимые цепочки одновременно.
+	\param data - первый буфер
+	\param stride - шаг между буферами в байтах
+	\param len - длина каждого буфера
+	\param crc - результат, n значений
+ */
+void can_j1850_crc_mb(const unsigned char* data, size_t stride, size_t len, unsigned char* crc, size_t n)
+{
+	can_crc_mb(&can_crc8_sae_j1850, data, stride, len, crc, n);
+}
+
+#ifdef TEST_CRC
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+static unsigned char crc_bitwise(const unsigned char* buf, size_t len){
 	unsigned char crc = CRC8_J1850_INIT;
 	int i;
-	for(i=0; i<len; i++) {
-		crc^= *buf++;
-		crc = (crc << 4) ^ CRC8I_Lookup4[(crc&0xFF) >> 4];
-		crc = (crc << 4) ^ CRC8I_Lookup4[(crc&0xFF) >> 4];
+	for (; len>0; len--) {
+		crc ^= *buf++;
+		for (i=0; i<8; i++) crc = (crc & 0x80)? (crc<<1)^CRC8_J1850_POLY: crc<<1;
 	}
 	return crc^CRC8_J1850_XOR;
 }
-
-#ifdef TEST_CRC
-#include <stdio.h>
+static double seconds(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
 int main(){
 	unsigned char test[] = "123456789";
 	unsigned char crc = can_j1850_crc(test, 9);
 	printf ("CRC = %02X ..%s\n", crc, crc==CRC8_J1850_CHECK?"ok":"fail");
+	// сверка с побитовым расчетом для всех длин и путей
+	const size_t size = 1<<20;
+	unsigned char* buf = malloc(size);
+	size_t i, len;
+	int fail = 0;
+	for (i=0; i<size; i++) buf[i] = rand();
+	for (len=0; len<2048; len++)
+		if (can_j1850_crc(buf+len%7, len)!=crc_bitwise(buf+len%7, len)) fail++;
+	printf ("bitwise ..%s\n", fail? "fail": "ok");
+	unsigned char crcs[1000];
+	for (len=1; len<=64; len++) {
+		can_j1850_crc_mb(buf, 72, len, crcs, 1000);
+		for (i=0; i<1000; i++)
+			if (crcs[i]!=crc_bitwise(buf+i*72, len)) fail++;
+	}
+	printf ("multi-buffer ..%s\n", fail? "fail": "ok");
+	double t = seconds();
+	for (i=0; i<100; i++) buf[0] = can_crc8_sae_j1850.update(&can_crc8_sae_j1850, buf[0], buf, size);
+	t = seconds() - t;
+	printf ("slicing-by-8: %.2f GB/s\n", 100*size/t*1e-9);
+	t = seconds();
+	for (i=0; i<100; i++) buf[0] = can_j1850_crc(buf, size);
+	t = seconds() - t;
+	printf ("can_j1850_crc: %.2f GB/s\n", 100*size/t*1e-9);
+	t = seconds();
+	for (i=0; i<100; i++) can_j1850_crc_mb(buf+crcs[0], 8, 8, crcs, 1000);
+	t = seconds() - t;
+	printf ("multi-buffer 8 byte: %.1f Mframes/s\n", 100*1000/t*1e-6);
+	t = seconds();
+	for (i=0; i<100; i++) can_j1850_crc_mb(buf+crcs[0], 64, 64, crcs, 1000);
+	t = seconds() - t;
+	printf ("multi-buffer 64 byte: %.1f Mframes/s\n", 100*1000/t*1e-6);
+	free(buf);
+	return 0;
 }
 #endif
\ No newline at end of file
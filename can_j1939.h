@@ -2,22 +2,35 @@
 #define CAN_J1939_H
 #include <stdint.h>
 #include <sys/can.h>
+#include "can_timer.h"
 // для разбора PCAP файла
 #define CAN_ID_OFFSET       0
 #define CAN_DLC_OFFSET      4
 #define CAN_DATA_OFFSET     5
 
-// \see in include/linux/can.h: SocketCAN
-typedef uint32_t canid_t;
-struct can_frame {
-	canid_t can_id;  /* 32 bit CAN_ID + EFF/RTR/ERR flags */
-	uint8_t can_dlc; /* frame payload length in byte (0 .. 8) */
-	uint8_t data[8];// __attribute__((aligned(8)));
-};
-struct can_filter {
-	canid_t can_id;
-	canid_t can_mask;
-};
+// MilCAN:			if (can_id & J1939_EDP_Msk) -- MilCAN
+#define MilCAN_COMMAND_Msk	0x80000000
+#define MilCAN_SEGMENT_Msk	0x40000000
+// J1939: разбор форматов
+#define J1939_PRIORITY_Msk	0x1C000000
+#define J1939_PRIORITY_Pos	26
+#define J1939_EDP_Msk 		0x02000000
+#define J1939_EDP_Pos 		25
+#define J1939_DP_Msk 		0x01000000
+#define J1939_DP_Pos 		24
+#define J1939_PF_Msk 		0x00FF0000
+#define J1939_PF_Pos 		16
+#define J1939_PS_Msk 		0x0000FF00
+#define J1939_PS_Pos 		8
+#define J1939_SA_Msk 		0x000000FF
+#define J1939_SA_Pos 		0
+#define J1939_PDU1_PGN_Msk 	0x03FF0000
+#define J1939_PDU1_PGN_Pos	8	
+#define J1939_PDU2_PGN_Msk	0x03FFFF00
+#define J1939_PDU2_PGN_Pos	8	
+
+#define J1939_PF2_MASK 		0x00F00000	// >=240 broadcast
+#define J1939_DA_BROADCAST 0xFF 	// Destination Address -- Broadcast
 
 
 /* J1939 использует длинные идентификаторы 29 бит
@@ -181,4 +194,142 @@ struct J1939_SPN {
 	// получатели пакета - список идентификаторов
 };
 
+/*! Транспортный протокол J1939-21: передача групп параметров до 1785 байт
+	TP.CM (PGN 0xEC00) -- управление соединением, TP.DT (PGN 0xEB00) -- данные по 7 байт
+ */
+#define J1939_TP_CM_PGN		0xEC00
+#define J1939_TP_DT_PGN		0xEB00
+#define J1939_TP_RTS		16	//!< TP.CM_RTS запрос передачи CMDT
+#define J1939_TP_CTS		17	//!< TP.CM_CTS разрешение передачи
+#define J1939_TP_EOMA		19	//!< TP.CM_EndOfMsgAck подтверждение приема
+#define J1939_TP_BAM		32	//!< TP.CM_BAM широковещательная передача
+#define J1939_TP_ABORT		255	//!< TP.Conn_Abort
+#define J1939_TP_MAX_SIZE	1785	//!< 255 пакетов по 7 байт
+#define J1939_NULL_ADDR		0xFE	//!< нулевой адрес, узел без адреса
+// таймауты J1939-21, мс
+#define J1939_TP_Tr		200
+#define J1939_TP_Th		500
+#define J1939_TP_T1		750	//!< ожидание следующего TP.DT
+#define J1939_TP_T2		1250	//!< ожидание TP.DT после CTS
+#define J1939_TP_T3		1250	//!< ожидание CTS или EndOfMsgAck после последнего TP.DT окна
+#define J1939_TP_T4		1050	//!< ожидание CTS после CTS удержания соединения
+// причины разрыва TP.Conn_Abort
+#define J1939_TP_ABORT_BUSY		1	//!< нет свободного сеанса
+#define J1939_TP_ABORT_TIMEOUT	3
+#define J1939_TP_ABORT_SEQUENCE	7	//!< неверный номер пакета
+
+/*! \brief идентификатор кадра J1939, для PDU1 адрес получателя DA подставляется в PS */
+static inline canid_t j1939_can_id(uint8_t priority, uint32_t pgn, uint8_t da, uint8_t sa)
+{
+	canid_t can_id = CAN_EFF_FLAG | (canid_t)priority<<J1939_PRIORITY_Pos | pgn<<J1939_PDU1_PGN_Pos | sa;
+	if (((pgn>>8) & 0xFF) < 240) can_id = (can_id & ~J1939_PS_Msk) | (canid_t)da<<J1939_PS_Pos;
+	return can_id;
+}
+/*! \brief сеанс сборки сообщения TP
+
+	Данные пакета с номером n копируются на место (n-1)*7 в буфере сеанса, буфер 
+	рассчитан на 256 пакетов, поэтому последний пакет копируется без проверки длины.
+ */
+struct J1939_TP_Session {
+	uint32_t PGN;		/*!< группа параметров передаваемого сообщения */
+	uint32_t deadline;	/*!< время таймаута, мс */
+	uint16_t size;		/*!< размер сообщения в байтах */
+	uint8_t  packets;	/*!< число пакетов сообщения */
+	uint8_t  next;		/*!< номер ожидаемого пакета */
+	uint8_t  window;	/*!< последний пакет текущего окна CTS */
+	uint8_t  state;
+	uint8_t  sa, da;
+	uint8_t  max_cts;	/*!< наибольшее число пакетов на один CTS из RTS */
+	uint8_t  active;	/*!< сеанс адресован узлу: узел отвечает CTS и EndOfMsgAck */
+	uint16_t link;		/*!< следующий сеанс того же SA +1 */
+	uint16_t prev, succ;/*!< очередь таймаута +1 */
+	uint8_t  data[256*7];
+};
+/*! \brief очередь сеансов с одинаковым таймаутом, упорядочена по времени таймаута */
+struct J1939_TP_Queue {
+	uint16_t head, tail;/*!< номер сеанса +1 */
+	uint16_t timeout;	/*!< мс */
+};
+typedef void (*J1939_TP_Deliver_fn)(void* user, uint32_t pgn, uint8_t sa, uint8_t da, const uint8_t* data, uint16_t size);
+typedef void (*J1939_TP_Send_fn)(void* user, const struct can_frame* frame);
+/*! \brief сборка сообщений транспортного протокола BAM и CMDT
+
+	Сеансы выделяются из пула, заданного при инициализации, в процессе работы память 
+	не выделяется. Сеанс определяется парой (SA, DA), для BAM DA=0xFF; PGN сообщения 
+	передается в TP.CM. Поиск сеанса -- по таблице SA и цепочке сеансов отправителя.
+	Сеансы в каждом состоянии ожидания имеют одинаковый таймаут, поэтому очереди 
+	таймаутов упорядочены без сортировки: перезапуск таймера переносит сеанс в конец 
+	очереди, проверка таймаутов просматривает только начало очередей.
+ */
+struct J1939_TP {
+	struct J1939_TP_Session* pool;
+	uint16_t size;		/*!< размер пула */
+	uint16_t free;		/*!< список свободных сеансов +1, связан по link */
+	uint16_t by_sa[256];/*!< первый сеанс отправителя +1 */
+	struct J1939_TP_Queue queue[4];
+	uint8_t addr;		/*!< собственный адрес узла, J1939_NULL_ADDR -- только прием */
+	uint8_t monitor;	/*!< собирать CMDT между другими узлами */
+	uint8_t priority;	/*!< приоритет кадров TP.CM */
+	J1939_TP_Deliver_fn deliver;
+	J1939_TP_Send_fn send;
+	void* user;
+	// статистика
+	uint32_t completed;
+	uint32_t aborted;
+	uint32_t timeouts;
+	uint32_t dropped;	/*!< нет свободного сеанса */
+};
+void j1939_tp_init(struct J1939_TP* tp, struct J1939_TP_Session* pool, uint16_t size, uint8_t addr,
+		J1939_TP_Deliver_fn deliver, J1939_TP_Send_fn send, void* user);
+int  j1939_tp_recv(struct J1939_TP* tp, const struct can_frame* frame, uint32_t now);
+void j1939_tp_poll(struct J1939_TP* tp, uint32_t now);
+
+/*! Диспетчер групп параметров по таблицам struct J1939_PGN_Entry
+
+	Запись приема (control без J1939_PGN_TX) получает кадры группы PGN от отправителя addr,
+	addr = J1939_DA_BROADCAST -- от любого отправителя. Если cycle не 0, cycle задает таймаут
+	приема: каждый принятый кадр перезагружает счетчик, по истечении таймаута обработчик 
+	вызывается с data = NULL, count обнуляется.
+	Запись передачи (J1939_PGN_TX) каждые cycle тиков вызывает обработчик с буфером 
+	data_size байт, обработчик возвращает число байт кадра для адресата addr, 0 -- не передавать.
+	Первое срабатывание через count тиков, если count не 0, иначе через cycle.
+ */
+#define J1939_PGN_TX			0x0001	//!< запись передачи
+#define J1939_PGN_PRIORITY_Pos	8
+#define J1939_PGN_PRIORITY_Msk	0x0700	//!< приоритет кадров передачи
+/*! \brief запись диспетчера, таймер -- первое поле */
+struct J1939_PGN_Slot {
+	can_timer_t timer;
+	struct J1939_PGN_Entry* entry;
+	uint16_t link;		/*!< следующая запись той же ячейки хеша +1 */
+	uint16_t bucket;	/*!< ячейка хеша с номером слота: первая запись +1 */
+};
+/*! \brief диспетчер групп параметров
+
+	Записи размещаются в пуле слотов вызывающей стороны, пул одновременно служит 
+	хеш-таблицей PGN -> цепочка записей, поиск записи по кадру -- O(1). Счетчики 
+	cycle/count перезагружаются колесом таймеров, стоимость тика зависит от числа 
+	событий, а не от числа записей.
+ */
+struct J1939_PGN_Dispatcher {
+	struct J1939_PGN_Slot* slots;
+	uint16_t size;		/*!< размер пула */
+	uint16_t count;		/*!< число записей */
+	uint8_t addr;		/*!< собственный адрес, J1939_NULL_ADDR -- принимать все PDU1 */
+	J1939_TP_Send_fn send;
+	void* user;
+	can_timer_wheel_t wheel;
+	// статистика
+	uint32_t received;
+	uint32_t unhandled;	/*!< нет записи приема */
+	uint32_t sent;
+	uint32_t timeouts;
+};
+void j1939_pgn_init(struct J1939_PGN_Dispatcher* d, struct J1939_PGN_Slot* slots, uint16_t size, uint8_t addr,
+		J1939_TP_Send_fn send, void* user, uint32_t now);
+int  j1939_pgn_register(struct J1939_PGN_Dispatcher* d, struct J1939_PGN_Entry* table, uint16_t n);
+int  j1939_pgn_recv(struct J1939_PGN_Dispatcher* d, const struct can_frame* frame);
+void j1939_pgn_deliver(void* d, uint32_t pgn, uint8_t sa, uint8_t da, const uint8_t* data, uint16_t size);
+void j1939_pgn_poll(struct J1939_PGN_Dispatcher* d, uint32_t now);
+
 #endif//CAN_J1939_H
\ No newline at end of file
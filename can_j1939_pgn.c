@@ -0,0 +1,246 @@
+/*! \file can_j1939_pgn.c
+
+	\brief Диспетчер групп параметров J1939 и циклическая служба по таблицам struct J1939_PGN_Entry
+
+	Таблицы записей регистрируются в диспетчере, принятый кадр направляется обработчику
+	записи по хешу PGN. Слот пула с номером i служит ячейкой хеш-таблицы i и хранит запись;
+	записи одной ячейки связаны в цепочку, число ячеек равно размеру пула. Точное совпадение
+	адреса отправителя имеет приоритет перед записью для любого отправителя.
+
+	Длинные сообщения собираются транспортным протоколом, функция j1939_pgn_deliver()
+	передается в j1939_tp_init() как функция deliver с аргументом user = диспетчер.
+
+Тестирование:
+$ gcc -O2 -DTEST_J1939_PGN can_j1939_pgn.c can_timer.c -o pgn.exe
+$ ./pgn.exe
+ */
+#include <string.h>
+#include "can_j1939.h"
+
+#define SLOT(d, n) (&(d)->slots[(n)-1])
+
+static inline uint32_t _bucket(const struct J1939_PGN_Dispatcher* d, uint32_t pgn)
+{
+	return ((uint64_t)(pgn * 0x9E3779B1u) * d->size)>>32;
+}
+static void _timer_expired(can_timer_t* timer, void* user);
+
+/*! \brief инициализация, пул слотов предоставляется вызывающей стороной
+	\param addr - собственный адрес узла, источник кадров передачи
+	\param send - отправка кадров записей передачи
+	\param now - текущее время, тики
+ */
+void j1939_pgn_init(struct J1939_PGN_Dispatcher* d, struct J1939_PGN_Slot* slots, uint16_t size, uint8_t addr,
+		J1939_TP_Send_fn send, void* user, uint32_t now)
+{
+	memset(d, 0, sizeof(struct J1939_PGN_Dispatcher));
+	memset(slots, 0, size*sizeof(struct J1939_PGN_Slot));
+	d->slots = slots;
+	d->size = size;
+	d->addr = addr;
+	d->send = send;
+	d->user = user;
+	can_timer_wheel_init(&d->wheel, now, d);
+}
+/*! \brief регистрация таблицы записей, записи остаются во владении вызывающей стороны
+	\return 0 или -1, если пул заполнен
+ */
+int j1939_pgn_register(struct J1939_PGN_Dispatcher* d, struct J1939_PGN_Entry* table, uint16_t n)
+{
+	if (n > d->size - d->count) return -1;
+	const uint32_t now = can_timer_wheel_time(&d->wheel);
+	uint16_t i;
+	for (i=0; i<n; i++) {
+		struct J1939_PGN_Entry* entry = &table[i];
+		struct J1939_PGN_Slot* slot = &d->slots[d->count++];
+		struct J1939_PGN_Slot* head = &d->slots[_bucket(d, entry->PGN)];
+		slot->entry = entry;
+		slot->link = head->bucket;
+		head->bucket = d->count;
+		slot->timer.fn = _timer_expired;
+		if (entry->cycle) {
+			if (entry->count==0) entry->count = entry->cycle;
+			can_timer_add(&d->wheel, &slot->timer, now + entry->count);
+		}
+	}
+	return 0;
+}
+static struct J1939_PGN_Slot* _lookup(const struct J1939_PGN_Dispatcher* d, uint32_t pgn, uint8_t sa)
+{
+	struct J1939_PGN_Slot* any = NULL;
+	uint16_t n = d->slots[_bucket(d, pgn)].bucket;
+	for (; n; n = SLOT(d, n)->link) {
+		struct J1939_PGN_Slot* slot = SLOT(d, n);
+		const struct J1939_PGN_Entry* entry = slot->entry;
+		if (entry->PGN!=pgn || (entry->control & J1939_PGN_TX)) continue;
+		if (entry->addr==sa) return slot;
+		if (entry->addr==J1939_DA_BROADCAST && any==NULL) any = slot;
+	}
+	return any;
+}
+static int _dispatch(struct J1939_PGN_Dispatcher* d, uint32_t pgn, uint8_t sa, uint8_t da, const uint8_t* data, uint16_t size)
+{
+	if (d->addr!=J1939_NULL_ADDR && da!=d->addr && da!=J1939_DA_BROADCAST) return 0;
+	struct J1939_PGN_Slot* slot = _lookup(d, pgn, sa);
+	if (slot==NULL) {
+		d->unhandled++;
+		return 0;
+	}
+	struct J1939_PGN_Entry* entry = slot->entry;
+	if (entry->cycle) {// перезагрузка таймаута приема
+		entry->count = entry->cycle;
+		can_timer_add(&d->wheel, &slot->timer, can_timer_wheel_time(&d->wheel) + entry->cycle);
+	}
+	d->received++;
+	entry->pfnPgnHandler((uint8_t*)data, size, sa);
+	return 1;
+}
+/*! \brief обработка принятого кадра
+	\return 1 -- кадр передан обработчику, 0 -- нет записи приема или кадр адресован другому узлу
+ */
+int j1939_pgn_recv(struct J1939_PGN_Dispatcher* d, const struct can_frame* frame)
+{
+	const canid_t can_id = frame->can_id;
+	if ((can_id & (CAN_EFF_FLAG|CAN_RTR_FLAG|CAN_ERR_FLAG))!=CAN_EFF_FLAG) return 0;
+	uint32_t pgn = (can_id & J1939_PDU2_PGN_Msk)>>J1939_PDU2_PGN_Pos;
+	uint8_t da = J1939_DA_BROADCAST;
+	if ((can_id & J1939_PF2_MASK) != J1939_PF2_MASK) {// PDU1
+		da = pgn & 0xFF;
+		pgn &= ~0xFFu;
+	}
+	return _dispatch(d, pgn, can_id & J1939_SA_Msk, da, frame->data, frame->len);
+}
+/*! \brief обработка сообщения, собранного транспортным протоколом, см. J1939_TP_Deliver_fn */
+void j1939_pgn_deliver(void* user, uint32_t pgn, uint8_t sa, uint8_t da, const uint8_t* data, uint16_t size)
+{
+	_dispatch(user, pgn, sa, da, data, size);
+}
+static void _timer_expired(can_timer_t* timer, void* user)
+{
+	struct J1939_PGN_Dispatcher* d = user;
+	struct J1939_PGN_Slot* slot = (struct J1939_PGN_Slot*)timer;
+	struct J1939_PGN_Entry* entry = slot->entry;
+	if ((entry->control & J1939_PGN_TX)==0) {// таймаут приема, до следующего кадра
+		entry->count = 0;
+		d->timeouts++;
+		entry->pfnPgnHandler(NULL, 0, entry->addr);
+		return;
+	}
+	entry->count = entry->cycle;
+	can_timer_add(&d->wheel, timer, timer->expires + entry->cycle);
+	struct can_frame frame = {0};
+	int16_t len = entry->pfnPgnHandler(frame.data, entry->data_size<8? entry->data_size: 8, entry->addr);
+	if (len>0 && d->send) {
+		uint8_t priority = (entry->control & J1939_PGN_PRIORITY_Msk)>>J1939_PGN_PRIORITY_Pos;
+		frame.can_id = j1939_can_id(priority, entry->PGN, entry->addr, d->addr);
+		frame.len = len<8? len: 8;
+		d->send(d->user, &frame);
+		d->sent++;
+	}
+}
+/*! \brief продвижение времени диспетчера, вызов обработчиков передачи и таймаутов
+	\param now - текущее время, тики
+ */
+void j1939_pgn_poll(struct J1939_PGN_Dispatcher* d, uint32_t now)
+{
+	can_timer_wheel_advance(&d->wheel, now);
+}
+
+#ifdef TEST_J1939_PGN
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#define N_ENTRIES 4096
+static struct J1939_PGN_Slot slots[N_ENTRIES+8];
+static struct J1939_PGN_Entry table[N_ENTRIES];
+static uint32_t rx_count, rx_any, rx_timeout, tx_count, n_sent;
+static struct can_frame last_sent;
+static int16_t on_rx(uint8_t* data, uint16_t size, uint8_t sa)
+{
+	(void)size;
+	(void)sa;
+	if (data==NULL) rx_timeout++;
+	else rx_count++;
+	return 0;
+}
+static int16_t on_rx_any(uint8_t* data, uint16_t size, uint8_t sa)
+{
+	(void)data;
+	(void)size;
+	(void)sa;
+	rx_any++;
+	return 0;
+}
+static int16_t on_tx(uint8_t* data, uint16_t size, uint8_t da)
+{
+	(void)da;
+	memset(data, 0xA5, size);
+	tx_count++;
+	return size;
+}
+static void send(void* user, const struct can_frame* frame)
+{
+	(void)user;
+	last_sent = *frame;
+	n_sent++;
+}
+static double seconds(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+int main(){
+	static struct J1939_PGN_Dispatcher disp;
+	struct J1939_PGN_Dispatcher* d = &disp;
+	j1939_pgn_init(d, slots, N_ENTRIES+8, 0x20, send, NULL, 0);
+	// прием: EEC1 от SA 0 с таймаутом, EEC1 от любого отправителя, запрос PDU1 для узла
+	struct J1939_PGN_Entry rx[] = {
+		{.PGN = 0xF004, .cycle = 100, .addr = 0x00, .pfnPgnHandler = on_rx},
+		{.PGN = 0xF004, .addr = J1939_DA_BROADCAST, .pfnPgnHandler = on_rx_any},
+		{.PGN = 0xEA00, .addr = J1939_DA_BROADCAST, .pfnPgnHandler = on_rx_any},
+	};
+	j1939_pgn_register(d, rx, 3);
+	struct can_frame eec1 = {.can_id = j1939_can_id(3, 0xF004, 0xFF, 0x00), .len = 8};
+	struct can_frame other = {.can_id = j1939_can_id(3, 0xF004, 0xFF, 0x17), .len = 8};
+	struct can_frame req_own = {.can_id = j1939_can_id(6, 0xEA00, 0x20, 0x17), .len = 3};
+	struct can_frame req_other = {.can_id = j1939_can_id(6, 0xEA00, 0x21, 0x17), .len = 3};
+	uint32_t t;
+	for (t=1; t<=300; t++) {
+		if (t<=150 && t%10==0) j1939_pgn_recv(d, &eec1);
+		j1939_pgn_poll(d, t);
+	}
+	int ok = j1939_pgn_recv(d, &other) && j1939_pgn_recv(d, &req_own) && !j1939_pgn_recv(d, &req_other);
+	printf("rx: %u frames, %u any, %u timeout ..%s\n", rx_count, rx_any, rx_timeout,
+		ok && rx_count==15 && rx_any==2 && rx_timeout==1 && rx[0].count==0? "ok": "fail");
+	// передача: циклические записи с разнесенным началом
+	int i;
+	for (i=0; i<N_ENTRIES; i++) {
+		table[i].control = J1939_PGN_TX | 6<<J1939_PGN_PRIORITY_Pos;
+		table[i].PGN = 0xFF00 + (i&0xFF);
+		table[i].cycle = i<8? 10: 1000;
+		table[i].count = 1 + i%table[i].cycle;
+		table[i].addr = J1939_DA_BROADCAST;
+		table[i].data_size = 8;
+		table[i].pfnPgnHandler = on_tx;
+	}
+	ok = j1939_pgn_register(d, table, N_ENTRIES)==0 && j1939_pgn_register(d, table, 9)==-1;
+	const uint32_t start = t, ticks = 100000;
+	double s = seconds();
+	for (t=start; t<start+ticks; t++) j1939_pgn_poll(d, t);
+	s = seconds() - s;
+	uint32_t expect = 8*(ticks/10) + (N_ENTRIES-8)*(ticks/1000);
+	ok = ok && last_sent.can_id==j1939_can_id(6, last_sent.can_id>>8 & 0xFFFF, 0xFF, 0x20) && last_sent.len==8;
+	printf("tx: %u entries, %u sent, expected %u ..%s\n", N_ENTRIES, n_sent, expect,
+		ok && n_sent==expect && tx_count==n_sent? "ok": "fail");
+	printf("poll: %.1f ns/tick, %.1f ns/frame\n", s/ticks*1e9, s/n_sent*1e9);
+	// маршрутизация
+	struct can_frame f = {.can_id = j1939_can_id(6, 0xF004, 0xFF, 0x00), .len = 8};
+	const int n = 10000000;
+	rx_count = 0;
+	s = seconds();
+	for (i=0; i<n; i++) j1939_pgn_recv(d, &f);
+	s = seconds() - s;
+	printf("recv: %.1f ns/frame ..%s\n", s/n*1e9, rx_count==(uint32_t)n? "ok": "fail");
+	return 0;
+}
+#endif//TEST_J1939_PGN
@@ -0,0 +1,434 @@
+/*! \file can_j1939_tp.c
+
+	\brief Сборка сообщений транспортного протокола J1939-21 TP: BAM и CMDT
+
+	BAM -- широковещательная передача: TP.CM_BAM, затем TP.DT с интервалом 50..200 мс.
+	CMDT -- передача с установлением соединения: RTS, CTS окнами пакетов, TP.DT, EndOfMsgAck.
+	Если сеанс CMDT адресован узлу (DA совпадает с собственным адресом), узел отвечает
+	CTS и EndOfMsgAck, при ошибке -- TP.Conn_Abort. В режиме монитора сеансы CMDT между
+	другими узлами собираются без ответа, состояние отслеживается по кадрам CTS получателя.
+
+	Таймауты J1939-21:
+	T1 -- 750 мс между пакетами TP.DT, в том числе BAM;
+	T2 -- 1250 мс от CTS до первого пакета TP.DT;
+	T3 -- 1250 мс от последнего пакета окна до CTS или EndOfMsgAck;
+	T4 -- 1050 мс от CTS удержания соединения (число пакетов 0) до следующего CTS.
+
+	Сеанс определяется парой (SA, DA) без PGN: J1939-21 допускает один BAM от каждого
+	источника и одно соединение CMDT на пару адресов. Новый BAM или RTS от той же пары
+	неявно отменяет незавершенный сеанс, независимо от PGN.
+
+	Собранное сообщение передается функции deliver, данные действительны до возврата
+	из функции. Для разбора сигналов по базе DBC используется can_dbc_decode_pg().
+
+Тестирование:
+$ gcc -O2 -DTEST_J1939_TP can_j1939_tp.c -o tp.exe
+$ ./tp.exe
+ */
+#include <string.h>
+#include "can_j1939.h"
+
+enum {
+	TP_FREE,
+	TP_BAM,	//!< ожидание TP.DT BAM, T1
+	TP_DATA,//!< ожидание TP.DT внутри окна, T1
+	TP_CTS,	//!< ожидание первого TP.DT после CTS, T2
+	TP_WAIT,//!< ожидание CTS получателя, T3
+	TP_HOLD,//!< соединение удерживается получателем, T4
+};
+enum { Q_T1, Q_T2, Q_T3, Q_T4 };
+static const uint8_t _state_queue[] = {
+	[TP_BAM] = Q_T1, [TP_DATA] = Q_T1, [TP_CTS] = Q_T2, [TP_WAIT] = Q_T3, [TP_HOLD] = Q_T4,
+};
+#define SESSION(tp, n) (&(tp)->pool[(n)-1])
+
+/*! \brief инициализация, пул сеансов предоставляется вызывающей стороной
+	\param addr - собственный адрес узла, J1939_NULL_ADDR -- узел не отвечает на RTS и
+		собирает сеансы CMDT между другими узлами в режиме монитора
+	\param send - отправка кадров TP.CM, может быть NULL для пассивного приема
+ */
+void j1939_tp_init(struct J1939_TP* tp, struct J1939_TP_Session* pool, uint16_t size, uint8_t addr,
+		J1939_TP_Deliver_fn deliver, J1939_TP_Send_fn send, void* user)
+{
+	memset(tp, 0, sizeof(struct J1939_TP));
+	tp->pool = pool;
+	tp->size = size;
+	tp->addr = addr;
+	tp->monitor = (addr==J1939_NULL_ADDR);
+	tp->priority = 7;
+	tp->deliver = deliver;
+	tp->send = send;
+	tp->user = user;
+	tp->queue[Q_T1].timeout = J1939_TP_T1;
+	tp->queue[Q_T2].timeout = J1939_TP_T2;
+	tp->queue[Q_T3].timeout = J1939_TP_T3;
+	tp->queue[Q_T4].timeout = J1939_TP_T4;
+	uint16_t i;
+	for (i=size; i>0; i--) {
+		SESSION(tp, i)->state = TP_FREE;
+		SESSION(tp, i)->link = tp->free;
+		tp->free = i;
+	}
+}
+static void _queue_remove(struct J1939_TP* tp, uint16_t n)
+{
+	struct J1939_TP_Session* s = SESSION(tp, n);
+	struct J1939_TP_Queue* q = &tp->queue[_state_queue[s->state]];
+	if (s->prev) SESSION(tp, s->prev)->succ = s->succ; else q->head = s->succ;
+	if (s->succ) SESSION(tp, s->succ)->prev = s->prev; else q->tail = s->prev;
+	s->prev = s->succ = 0;
+}
+/*! \brief перевод сеанса в состояние ожидания и перезапуск таймера: сеанс переносится в конец очереди */
+static void _timer(struct J1939_TP* tp, uint16_t n, uint8_t state, uint32_t now)
+{
+	struct J1939_TP_Session* s = SESSION(tp, n);
+	if (s->state!=TP_FREE) _queue_remove(tp, n);
+	s->state = state;
+	struct J1939_TP_Queue* q = &tp->queue[_state_queue[state]];
+	s->deadline = now + q->timeout;
+	s->prev = q->tail;
+	if (q->tail) SESSION(tp, q->tail)->succ = n; else q->head = n;
+	q->tail = n;
+}
+static uint16_t _session_find(const struct J1939_TP* tp, uint8_t sa, uint8_t da)
+{
+	uint16_t n = tp->by_sa[sa];
+	while (n && tp->pool[n-1].da!=da) n = tp->pool[n-1].link;
+	return n;
+}
+static uint16_t _session_alloc(struct J1939_TP* tp, uint8_t sa, uint8_t da)
+{
+	uint16_t n = tp->free;
+	if (n==0) return 0;
+	struct J1939_TP_Session* s = SESSION(tp, n);
+	tp->free = s->link;
+	s->sa = sa;
+	s->da = da;
+	s->link = tp->by_sa[sa];
+	tp->by_sa[sa] = n;
+	return n;
+}
+static void _session_free(struct J1939_TP* tp, uint16_t n)
+{
+	struct J1939_TP_Session* s = SESSION(tp, n);
+	if (s->state!=TP_FREE) _queue_remove(tp, n);
+	s->state = TP_FREE;
+	uint16_t* link = &tp->by_sa[s->sa];
+	while (*link!=n) link = &SESSION(tp, *link)->link;
+	*link = s->link;
+	s->link = tp->free;
+	tp->free = n;
+}
+/*! \brief отправка кадра TP.CM от собственного адреса узла */
+static void _send_cm(struct J1939_TP* tp, uint8_t da, uint8_t control, uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4, uint32_t pgn)
+{
+	if (tp->send==NULL) return;
+	struct can_frame frame = {
+		.can_id = j1939_can_id(tp->priority, J1939_TP_CM_PGN, da, tp->addr),
+		.len = 8,
+		.data = {control, b1, b2, b3, b4, pgn, pgn>>8, pgn>>16},
+	};
+	tp->send(tp->user, &frame);
+}
+static void _abort(struct J1939_TP* tp, uint16_t n, uint8_t reason)
+{
+	struct J1939_TP_Session* s = SESSION(tp, n);
+	if (s->active) _send_cm(tp, s->sa, J1939_TP_ABORT, reason, 0xFF, 0xFF, 0xFF, s->PGN);
+	_session_free(tp, n);
+}
+/*! \brief CTS на следующее окно пакетов, узел -- получатель */
+static void _send_cts(struct J1939_TP* tp, uint16_t n, uint32_t now)
+{
+	struct J1939_TP_Session* s = SESSION(tp, n);
+	unsigned count = s->packets - s->next + 1;
+	if (count > s->max_cts) count = s->max_cts;
+	s->window = s->next + count - 1;
+	_send_cm(tp, s->sa, J1939_TP_CTS, count, s->next, 0xFF, 0xFF, s->PGN);
+	_timer(tp, n, TP_CTS, now);
+}
+/*! \brief начало сеанса по TP.CM_BAM или TP.CM_RTS */
+static void _session_open(struct J1939_TP* tp, const uint8_t* d, uint8_t sa, uint8_t da, uint32_t now)
+{
+	const uint8_t control = d[0];
+	const uint16_t size = d[1] | d[2]<<8;
+	const uint8_t packets = d[3];
+	const uint8_t active = control==J1939_TP_RTS && da==tp->addr;
+	if (control==J1939_TP_RTS && !active && !tp->monitor) return;
+	uint16_t n = _session_find(tp, sa, da);
+	if (n) {// новый запрос отменяет незавершенный сеанс
+		_session_free(tp, n);
+		tp->aborted++;
+	}
+	if (size < 9 || size > J1939_TP_MAX_SIZE || packets != (size+6)/7) {
+		if (active) _send_cm(tp, sa, J1939_TP_ABORT, 0xFF, 0xFF, 0xFF, 0xFF, d[5] | d[6]<<8 | (uint32_t)d[7]<<16);
+		return;
+	}
+	n = _session_alloc(tp, sa, da);
+	if (n==0) {
+		if (active) _send_cm(tp, sa, J1939_TP_ABORT, J1939_TP_ABORT_BUSY, 0xFF, 0xFF, 0xFF, d[5] | d[6]<<8 | (uint32_t)d[7]<<16);
+		tp->dropped++;
+		return;
+	}
+	struct J1939_TP_Session* s = SESSION(tp, n);
+	s->PGN = d[5] | d[6]<<8 | (uint32_t)d[7]<<16;
+	s->size = size;
+	s->packets = packets;
+	s->next = 1;
+	s->active = active;
+	s->max_cts = (control==J1939_TP_RTS && d[4]!=0)? d[4]: 0xFF;
+	s->window = packets;
+	if (control==J1939_TP_BAM)
+		_timer(tp, n, TP_BAM, now);
+	else if (active)
+		_send_cts(tp, n, now);
+	else
+		_timer(tp, n, TP_WAIT, now);
+}
+/*! \brief пакет TP.DT: данные копируются на место в буфере сеанса */
+static void _session_data(struct J1939_TP* tp, const uint8_t* d, uint8_t sa, uint8_t da, uint32_t now)
+{
+	uint16_t n = _session_find(tp, sa, da);
+	if (n==0) return;
+	struct J1939_TP_Session* s = SESSION(tp, n);
+	const uint8_t seq = d[0];
+	if (seq != s->next || s->state==TP_WAIT || s->state==TP_HOLD) {
+		if (s->state!=TP_BAM && seq < s->next) return;// повтор пакета
+		_abort(tp, n, J1939_TP_ABORT_SEQUENCE);
+		tp->aborted++;
+		return;
+	}
+	memcpy(s->data + (seq-1)*7, d+1, 7);
+	if (seq == s->packets) {
+		if (s->active) _send_cm(tp, sa, J1939_TP_EOMA, s->size, s->size>>8, s->packets, 0xFF, s->PGN);
+		if (tp->deliver) tp->deliver(tp->user, s->PGN, sa, da, s->data, s->size);
+		_session_free(tp, n);
+		tp->completed++;
+		return;
+	}
+	s->next++;
+	if (s->state==TP_BAM)
+		_timer(tp, n, TP_BAM, now);
+	else if (seq != s->window)
+		_timer(tp, n, TP_DATA, now);
+	else if (s->active)
+		_send_cts(tp, n, now);
+	else
+		_timer(tp, n, TP_WAIT, now);
+}
+/*! \brief кадр TP.CM_CTS получателя в режиме монитора: окно пакетов или удержание соединения */
+static void _session_cts(struct J1939_TP* tp, const uint8_t* d, uint8_t sa, uint8_t da, uint32_t now)
+{
+	uint16_t n = _session_find(tp, da, sa);// CTS передает получатель сообщения
+	if (n==0 || SESSION(tp, n)->active) return;
+	struct J1939_TP_Session* s = SESSION(tp, n);
+	if (d[1]==0) {
+		_timer(tp, n, TP_HOLD, now);
+		return;
+	}
+	if (d[2]==0 || d[2] > s->packets) {
+		_abort(tp, n, J1939_TP_ABORT_SEQUENCE);
+		tp->aborted++;
+		return;
+	}
+	s->next = d[2];
+	s->window = (d[2] + d[1] - 1 < s->packets)? d[2] + d[1] - 1: s->packets;
+	_timer(tp, n, TP_CTS, now);
+}
+/*! \brief обработка принятого кадра
+	\param now - время приема, мс
+	\return 1 -- кадр транспортного протокола, 0 -- другой кадр
+ */
+int j1939_tp_recv(struct J1939_TP* tp, const struct can_frame* frame, uint32_t now)
+{
+	const canid_t can_id = frame->can_id;
+	if ((can_id & (CAN_EFF_FLAG|CAN_RTR_FLAG|CAN_ERR_FLAG))!=CAN_EFF_FLAG) return 0;
+	const uint32_t pf = (can_id & (J1939_EDP_Msk|J1939_DP_Msk|J1939_PF_Msk))>>J1939_PF_Pos;
+	if (pf != (J1939_TP_CM_PGN>>8) && pf != (J1939_TP_DT_PGN>>8)) return 0;
+	if (frame->len < 8) return 1;
+	const uint8_t sa = can_id & J1939_SA_Msk;
+	const uint8_t da = (can_id & J1939_PS_Msk)>>J1939_PS_Pos;
+	const uint8_t* d = frame->data;
+	if (pf == (J1939_TP_DT_PGN>>8)) {
+		_session_data(tp, d, sa, da, now);
+		return 1;
+	}
+	uint16_t n;
+	switch (d[0]) {
+	case J1939_TP_BAM:
+		if (da==J1939_DA_BROADCAST) _session_open(tp, d, sa, da, now);
+		break;
+	case J1939_TP_RTS:
+		if (da!=J1939_DA_BROADCAST) _session_open(tp, d, sa, da, now);
+		break;
+	case J1939_TP_CTS:
+		_session_cts(tp, d, sa, da, now);
+		break;
+	case J1939_TP_ABORT:
+		n = _session_find(tp, sa, da);
+		if (n==0) n = _session_find(tp, da, sa);
+		if (n) {
+			_session_free(tp, n);
+			tp->aborted++;
+		}
+		break;
+	default:// EndOfMsgAck -- сеанс завершен по последнему пакету
+		break;
+	}
+	return 1;
+}
+/*! \brief проверка таймаутов, просматривается только начало очередей
+	\param now - текущее время, мс
+ */
+void j1939_tp_poll(struct J1939_TP* tp, uint32_t now)
+{
+	int i;
+	for (i=0; i<4; i++) {
+		struct J1939_TP_Queue* q = &tp->queue[i];
+		while (q->head && (int32_t)(now - SESSION(tp, q->head)->deadline) >= 0) {
+			_abort(tp, q->head, J1939_TP_ABORT_TIMEOUT);
+			tp->timeouts++;
+		}
+	}
+}
+
+#ifdef TEST_J1939_TP
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#define N_SESSIONS 512
+static struct J1939_TP_Session pool[N_SESSIONS];
+static uint32_t delivered, delivered_ok;
+static struct can_frame sent[16];
+static int n_sent;
+static void deliver(void* user, uint32_t pgn, uint8_t sa, uint8_t da, const uint8_t* data, uint16_t size)
+{
+	(void)user;
+	(void)da;
+	int i, ok = 1;
+	for (i=0; i<size; i++) if (data[i] != (uint8_t)(sa + i)) ok = 0;
+	delivered++;
+	delivered_ok += ok && pgn==0xFECA;
+}
+static void send(void* user, const struct can_frame* frame)
+{
+	(void)user;
+	if (n_sent<16) sent[n_sent] = *frame;
+	n_sent++;
+}
+static struct can_frame tp_frame(uint32_t pgn, uint8_t da, uint8_t sa, const uint8_t d[8])
+{
+	struct can_frame f = {.can_id = j1939_can_id(7, pgn, da, sa), .len = 8};
+	memcpy(f.data, d, 8);
+	return f;
+}
+static struct can_frame dt_frame(uint8_t da, uint8_t sa, uint8_t seq, uint16_t size)
+{
+	uint8_t d[8] = {seq};
+	int i;
+	for (i=0; i<7; i++) {
+		int pos = (seq-1)*7 + i;
+		d[1+i] = pos < size? (uint8_t)(sa + pos): 0xFF;
+	}
+	return tp_frame(J1939_TP_DT_PGN, da, sa, d);
+}
+static double seconds(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+int main(){
+	struct J1939_TP tp;
+	j1939_tp_init(&tp, pool, N_SESSIONS, 0x20, deliver, send, NULL);
+	// 250 одновременных сеансов BAM DM1 по 100 байт, пакеты чередуются
+	const uint16_t size = 100;
+	const uint8_t packets = (size+6)/7;
+	uint32_t now = 0;
+	int sa, seq;
+	for (sa=0; sa<250; sa++) {
+		uint8_t bam[8] = {J1939_TP_BAM, size, size>>8, packets, 0xFF, 0xCA, 0xFE, 0x00};
+		struct can_frame f = tp_frame(J1939_TP_CM_PGN, 0xFF, sa, bam);
+		j1939_tp_recv(&tp, &f, now);
+	}
+	for (seq=1; seq<=packets; seq++, now+=50)
+		for (sa=0; sa<250; sa++) {
+			struct can_frame f = dt_frame(0xFF, sa, seq, size);
+			j1939_tp_recv(&tp, &f, now);
+		}
+	printf("BAM: %u delivered ..%s\n", delivered, (delivered==250 && delivered_ok==250)?"ok":"fail");
+	// CMDT к узлу 0x20: CTS окнами по 4 пакета и EndOfMsgAck
+	delivered = delivered_ok = 0;
+	n_sent = 0;
+	uint8_t rts[8] = {J1939_TP_RTS, size, size>>8, packets, 4, 0xCA, 0xFE, 0x00};
+	struct can_frame f = tp_frame(J1939_TP_CM_PGN, 0x20, 0x31, rts);
+	j1939_tp_recv(&tp, &f, now);
+	for (seq=1; seq<=packets; seq++) {
+		f = dt_frame(0x20, 0x31, seq, size);
+		j1939_tp_recv(&tp, &f, now);
+	}
+	int ok = delivered_ok==1 && n_sent==5 && sent[0].data[0]==J1939_TP_CTS && sent[0].data[1]==4
+		&& sent[3].data[2]==13 && sent[3].data[1]==3 && sent[4].data[0]==J1939_TP_EOMA
+		&& sent[4].can_id==j1939_can_id(7, J1939_TP_CM_PGN, 0x31, 0x20);
+	printf("CMDT: %d frames sent ..%s\n", n_sent, ok?"ok":"fail");
+	// таймауты T1 и T2: пакеты прекратились
+	n_sent = 0;
+	f = tp_frame(J1939_TP_CM_PGN, 0x20, 0x32, rts);
+	j1939_tp_recv(&tp, &f, now);
+	uint8_t bam[8] = {J1939_TP_BAM, size, size>>8, packets, 0xFF, 0xCA, 0xFE, 0x00};
+	f = tp_frame(J1939_TP_CM_PGN, 0xFF, 0x33, bam);
+	j1939_tp_recv(&tp, &f, now);
+	f = dt_frame(0xFF, 0x33, 1, size);
+	j1939_tp_recv(&tp, &f, now + 100);
+	j1939_tp_poll(&tp, now + 849);
+	int t1 = tp.timeouts;
+	j1939_tp_poll(&tp, now + 850);
+	int t2 = tp.timeouts;
+	j1939_tp_poll(&tp, now + J1939_TP_T2);
+	printf("timeouts: T1 %d T2 %d ..%s\n", t2, tp.timeouts, (t1==0 && t2==1 && tp.timeouts==2
+		&& sent[1].data[0]==J1939_TP_ABORT && sent[1].data[1]==J1939_TP_ABORT_TIMEOUT
+		&& tp.free!=0)?"ok":"fail");
+	// монитор: CMDT 0x40 -> 0x50 окнами по 6 пакетов и CTS удержания соединения, без ответа
+	static struct J1939_TP_Session mon_pool[4];
+	struct J1939_TP mon;
+	j1939_tp_init(&mon, mon_pool, 4, J1939_NULL_ADDR, deliver, send, NULL);
+	delivered = delivered_ok = 0;
+	n_sent = 0;
+	rts[4] = 6;
+	f = tp_frame(J1939_TP_CM_PGN, 0x50, 0x40, rts);
+	j1939_tp_recv(&mon, &f, now);
+	uint8_t hold[8] = {J1939_TP_CTS, 0, 0xFF, 0xFF, 0xFF, 0xCA, 0xFE, 0x00};
+	f = tp_frame(J1939_TP_CM_PGN, 0x40, 0x50, hold);
+	j1939_tp_recv(&mon, &f, now);
+	for (seq=1; seq<=packets; seq++) {
+		if (seq % 6==1) {
+			uint8_t cts[8] = {J1939_TP_CTS, 6, seq, 0xFF, 0xFF, 0xCA, 0xFE, 0x00};
+			f = tp_frame(J1939_TP_CM_PGN, 0x40, 0x50, cts);
+			j1939_tp_recv(&mon, &f, now);
+		}
+		f = dt_frame(0x50, 0x40, seq, size);
+		j1939_tp_recv(&mon, &f, now);
+	}
+	printf("monitor: %u delivered, %d frames sent ..%s\n", delivered, n_sent, 
+		(mon.monitor && delivered==1 && delivered_ok==1 && n_sent==0 && mon.aborted==0)?"ok":"fail");
+	// пропускная способность: 250 сеансов BAM по 1785 байт
+	const uint16_t big = J1939_TP_MAX_SIZE;
+	const int n_bam = 250;
+	struct can_frame* frames = malloc(sizeof(struct can_frame)*n_bam*256);
+	int n = 0;
+	for (sa=0; sa<n_bam; sa++) {
+		uint8_t cm[8] = {J1939_TP_BAM, (uint8_t)big, big>>8, 255, 0xFF, 0xCA, 0xFE, 0x00};
+		frames[n++] = tp_frame(J1939_TP_CM_PGN, 0xFF, sa, cm);
+	}
+	for (seq=1; seq<=255; seq++)
+		for (sa=0; sa<n_bam; sa++)
+			frames[n++] = dt_frame(0xFF, sa, seq, big);
+	delivered = delivered_ok = 0;
+	double t = seconds();
+	int i;
+	for (i=0; i<n; i++) j1939_tp_recv(&tp, &frames[i], now);
+	t = seconds() - t;
+	printf("throughput: %d frames %.1f Mframes/s, %u delivered ..%s\n", n, n/t*1e-6, delivered,
+		(delivered==n_bam && delivered_ok==n_bam)?"ok":"fail");
+	free(frames);
+	return 0;
+}
+#endif//TEST_J1939_TP
@@ -0,0 +1,210 @@
+/*! \file can_timer.c
+
+	\brief Иерархическое колесо таймеров
+
+	Таймер со сроком delta = expires - now попадает на уровень L, если
+	64^L <= delta < 64^(L+1), в ячейку (expires >> 6L) & 63. Когда младшие 6L бит
+	времени обнуляются, ячейка уровня L с текущим индексом переносится на уровни ниже.
+	Просроченные таймеры ставятся в ячейку текущего тика. Функция таймера может
+	запускать и снимать таймеры, в том числе повторно запускать свой.
+
+	Продвижение времени: пустые ячейки нулевого уровня пропускаются по битовой карте,
+	при пустом нулевом уровне -- целые обороты по карте первого уровня, поэтому
+	стоимость продвижения определяется числом событий, а не числом тиков.
+
+Тестирование:
+$ gcc -O2 -DTEST_CAN_TIMER can_timer.c -o timer.exe
+$ ./timer.exe
+ */
+#include <string.h>
+#include "can_timer.h"
+
+#define SLOT_MASK	(CAN_TIMER_SLOTS-1)
+#define RANGE(L)	(1u<<(CAN_TIMER_BITS*((L)+1)))
+
+void can_timer_wheel_init(can_timer_wheel_t* wheel, uint32_t now, void* user)
+{
+	memset(wheel, 0, sizeof(can_timer_wheel_t));
+	wheel->now  = now + 1;
+	wheel->user = user;
+}
+static void _insert(can_timer_wheel_t* wheel, can_timer_t* timer)
+{
+	uint32_t key = timer->expires;
+	uint32_t delta = key - wheel->now;
+	unsigned level = 0;
+	if ((int32_t)delta < 0) {// просрочен
+		key = wheel->now;
+	} else if (delta >= RANGE(CAN_TIMER_LEVELS-1)) {// переносится повторно
+		key = wheel->now + RANGE(CAN_TIMER_LEVELS-1) - 1;
+		level = CAN_TIMER_LEVELS-1;
+	} else {
+		while (delta >= RANGE(level)) level++;
+	}
+	unsigned i = (key >> (CAN_TIMER_BITS*level)) & SLOT_MASK;
+	can_timer_t** head = &wheel->slot[level][i];
+	timer->index = level*CAN_TIMER_SLOTS + i;
+	timer->next  = *head;
+	timer->pprev = head;
+	if (*head) (*head)->pprev = &timer->next;
+	*head = timer;
+	wheel->map[level] |= 1ULL<<i;
+}
+static can_timer_t* _detach(can_timer_wheel_t* wheel, unsigned level, unsigned i)
+{
+	can_timer_t* list = wheel->slot[level][i];
+	wheel->slot[level][i] = NULL;
+	wheel->map[level] &= ~(1ULL<<i);
+	return list;
+}
+/*! \brief перенос ячейки текущего индекса уровня на уровни ниже
+	\return индекс ячейки, 0 -- оборот уровня завершен, переносится следующий уровень
+ */
+static unsigned _cascade(can_timer_wheel_t* wheel, unsigned level)
+{
+	unsigned i = (wheel->now >> (CAN_TIMER_BITS*level)) & SLOT_MASK;
+	can_timer_t* timer = _detach(wheel, level, i);
+	while (timer) {
+		can_timer_t* next = timer->next;
+		_insert(wheel, timer);
+		timer = next;
+	}
+	return i;
+}
+/*! \brief запуск таймера, запущенный таймер перезапускается */
+void can_timer_add(can_timer_wheel_t* wheel, can_timer_t* timer, uint32_t expires)
+{
+	if (timer->pprev) can_timer_del(wheel, timer);
+	timer->expires = expires;
+	_insert(wheel, timer);
+	wheel->count++;
+}
+void can_timer_del(can_timer_wheel_t* wheel, can_timer_t* timer)
+{
+	if (timer->pprev==NULL) return;
+	*timer->pprev = timer->next;
+	if (timer->next) timer->next->pprev = timer->pprev;
+	timer->pprev = NULL;
+	unsigned level = timer->index / CAN_TIMER_SLOTS, i = timer->index % CAN_TIMER_SLOTS;
+	if (wheel->slot[level][i]==NULL) wheel->map[level] &= ~(1ULL<<i);
+	wheel->count--;
+}
+/*! \brief продвижение времени до тика now включительно, вызов функций сработавших таймеров */
+void can_timer_wheel_advance(can_timer_wheel_t* wheel, uint32_t now)
+{
+	while ((int32_t)(now - wheel->now) >= 0) {
+		uint32_t left = now - wheel->now + 1;
+		unsigned i = wheel->now & SLOT_MASK;
+		if (i==0) {
+			unsigned level = 1;
+			while (level<CAN_TIMER_LEVELS && _cascade(wheel, level)==0) level++;
+		}
+		if (wheel->count==0) {
+			wheel->now += left;
+			break;
+		}
+		if (wheel->map[0]==0 && i==0) {// оборотами нулевого уровня
+			unsigned i1 = (wheel->now >> CAN_TIMER_BITS) & SLOT_MASK;
+			uint64_t m1 = wheel->map[1] >> i1;
+			uint32_t step = (m1? (uint32_t)__builtin_ctzll(m1): CAN_TIMER_SLOTS - i1)<<CAN_TIMER_BITS;
+			if (step > 0) {
+				wheel->now += step<left? step: left;
+				continue;
+			}
+		}
+		uint64_t m = wheel->map[0] >> i;
+		if ((m & 1)==0) {
+			uint32_t step = m? (uint32_t)__builtin_ctzll(m): CAN_TIMER_SLOTS - i;
+			wheel->now += step<left? step: left;
+			continue;
+		}
+		can_timer_t* list = _detach(wheel, 0, i);
+		list->pprev = &list;
+		wheel->now++;
+		while (list) {// функция таймера может снять следующие таймеры списка
+			can_timer_t* timer = list;
+			list = timer->next;
+			if (list) list->pprev = &list;
+			timer->pprev = NULL;
+			wheel->count--;
+			timer->fn(timer, wheel->user);
+		}
+	}
+}
+
+#ifdef TEST_CAN_TIMER
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#define N_TIMERS 100000
+typedef struct {
+	can_timer_t timer;
+	uint32_t period;
+	uint32_t fired;
+	uint32_t late;
+} Periodic_t;
+static uint32_t clock_now;
+static void periodic(can_timer_t* timer, void* user)
+{
+	Periodic_t* p = (Periodic_t*)timer;
+	can_timer_wheel_t* wheel = user;
+	if (timer->expires != clock_now) p->late++;
+	p->fired++;
+	can_timer_add(wheel, timer, timer->expires + p->period);
+}
+static double seconds(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+int main(){
+	static can_timer_wheel_t wheel;
+	static Periodic_t timers[N_TIMERS];
+	uint32_t i, start = 0xFFFFF000u;// переход через 0
+	can_timer_wheel_init(&wheel, start, &wheel);
+	for (i=0; i<N_TIMERS; i++) {
+		timers[i].period = 1 + rand()%(i<16? 1u<<25: 5000);
+		timers[i].timer.fn = periodic;
+		can_timer_add(&wheel, &timers[i].timer, start + 1 + rand()%timers[i].period);
+	}
+	// снятие и повторный запуск
+	can_timer_del(&wheel, &timers[1].timer);
+	can_timer_del(&wheel, &timers[1].timer);
+	can_timer_add(&wheel, &timers[1].timer, start + timers[1].period);
+	const uint32_t ticks = 100000;
+	double t = seconds();
+	for (clock_now = start+1; clock_now != start+ticks+1; clock_now++)
+		can_timer_wheel_advance(&wheel, clock_now);
+	t = seconds() - t;
+	uint64_t fired = 0, late = 0, fail = 0;
+	for (i=0; i<N_TIMERS; i++) {
+		fired += timers[i].fired;
+		late  += timers[i].late;
+		uint32_t first = timers[i].timer.expires - (timers[i].fired)*timers[i].period;
+		uint32_t expect = (uint32_t)(start + ticks - first) / timers[i].period + 1;
+		if ((int32_t)(start + ticks - first) < 0) expect = 0;
+		if (timers[i].fired != expect) fail++;
+	}
+	printf("periodic: %u timers, %llu events, late %llu ..%s\n", N_TIMERS,
+		(unsigned long long)fired, (unsigned long long)late, (late==0 && fail==0)? "ok": "fail");
+	printf("advance: %.1f ns/tick, %.1f ns/event\n", t/ticks*1e9, t/fired*1e9);
+	// редкие таймеры: продвижение большими шагами
+	can_timer_wheel_init(&wheel, 0, &wheel);
+	for (i=0; i<16; i++) {
+		memset(&timers[i], 0, sizeof(Periodic_t));
+		timers[i].period = 1000000 + i*77777;
+		timers[i].timer.fn = periodic;
+		can_timer_add(&wheel, &timers[i].timer, timers[i].period);
+	}
+	t = seconds();
+	for (i=0; i<100; i++) {// шаг 1 000 000 тиков
+		clock_now = (i+1)*1000000;
+		can_timer_wheel_advance(&wheel, clock_now);
+	}
+	t = seconds() - t;
+	for (fired=0, i=0; i<16; i++) fired += timers[i].fired;
+	printf("sparse: 1e8 ticks %llu events %.3f ms ..%s\n", (unsigned long long)fired, t*1e3,
+		fired>=1000 && wheel.count==16? "ok": "fail");
+	return 0;
+}
+#endif//TEST_CAN_TIMER
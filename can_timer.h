@@ -0,0 +1,52 @@
+#ifndef CAN_TIMER_H
+#define CAN_TIMER_H
+/*! \file can_timer.h
+
+	\brief Иерархическое колесо таймеров
+
+	Время измеряется в тиках, разрядность 32 бита с переполнением. Колесо состоит из
+	CAN_TIMER_LEVELS уровней по 64 ячейки: уровень L принимает таймеры со сроком
+	до 64^(L+1) тиков. Таймер нулевого уровня срабатывает в своей ячейке, таймеры верхних
+	уровней переносятся на уровень ниже при обороте младшего уровня. Постановка и снятие
+	таймера -- O(1), продвижение времени пропускает пустые ячейки по битовой карте.
+	Таймеры размещает вызывающая сторона, колесо память не выделяет.
+ */
+#include <stdint.h>
+
+#define CAN_TIMER_BITS		6
+#define CAN_TIMER_SLOTS		(1u<<CAN_TIMER_BITS)
+#define CAN_TIMER_LEVELS	4	//!< 2^24 тиков, более длинные сроки переносятся повторно
+
+typedef struct _can_timer can_timer_t;
+typedef void (*can_timer_fn)(can_timer_t* timer, void* user);
+struct _can_timer {
+	can_timer_t* next;
+	can_timer_t** pprev;	//!< NULL -- таймер не запущен
+	uint32_t expires;		//!< тик срабатывания
+	uint16_t index;			//!< уровень и ячейка колеса
+	can_timer_fn fn;
+};
+typedef struct _can_timer_wheel can_timer_wheel_t;
+struct _can_timer_wheel {
+	uint32_t now;		//!< следующий обрабатываемый тик
+	uint32_t count;		//!< число запущенных таймеров
+	void* user;			//!< аргумент функций таймеров
+	uint64_t map[CAN_TIMER_LEVELS];	//!< занятые ячейки
+	can_timer_t* slot[CAN_TIMER_LEVELS][CAN_TIMER_SLOTS];
+};
+
+void can_timer_wheel_init(can_timer_wheel_t* wheel, uint32_t now, void* user);
+void can_timer_add(can_timer_wheel_t* wheel, can_timer_t* timer, uint32_t expires);
+void can_timer_del(can_timer_wheel_t* wheel, can_timer_t* timer);
+void can_timer_wheel_advance(can_timer_wheel_t* wheel, uint32_t now);
+
+static inline int can_timer_pending(const can_timer_t* timer)
+{
+	return timer->pprev != NULL;
+}
+/*! \brief текущее время колеса: последний обработанный тик */
+static inline uint32_t can_timer_wheel_time(const can_timer_wheel_t* wheel)
+{
+	return wheel->now - 1;
+}
+#endif//CAN_TIMER_H
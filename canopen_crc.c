@@ -1,6 +1,9 @@
+#include <stddef.h>
 #include <stdint.h>
+#include "can_crc.h"
 #define CRC16_POLY 0x1021
 #define CRC16_XMODEM_CHECK 0x31c3
+#define CRC16_XMODEM_INIT 0x0000
 
 #if 0 // Альтернативная реализация, авторская 
 uint16_t canopen_crc1(unsigned char* data, size_t len){
@@ -14,17 +17,27 @@ uint16_t canopen_crc1(unsigned char* data, size_t len){
 	return crc;
 }
 #endif
-static uint16_t	CRC16_update_8(uint16_t x, uint8_t *data)
-{
-	x = *data;
-	x = x ^ x>>4;
-	return x <<12 ^ x <<5 ^ x;
+/*! \brief Потоковый расчет CRC-16/XMODEM по частям
+
+	Данные передаются частями произвольной длины, результат не зависит от разбиения:
+\code
+	uint16_t crc = canopen_crc_init();
+	crc = canopen_crc_update(crc, seg1, len1);
+	crc = canopen_crc_update(crc, seg2, len2);
+	crc = canopen_crc_final(crc);
+\endcode
+	Используется при блочной загрузке SDO, CRC накапливается по мере приема сегментов.
+	Расчет выполняет вариант can_crc16_xmodem каталога can_crc.c: slicing-by-8,
+	для длинных буферов на x86 -- свертка PCLMULQDQ.
+ */
+uint16_t canopen_crc_init(void){
+	return can_crc_init(&can_crc16_xmodem);
+}
+uint16_t canopen_crc_update(uint16_t crc, const void* data, size_t len){
+	return can_crc_update(&can_crc16_xmodem, crc, data, len);
 }
-static uint16_t	CRC16_update_16(uint16_t x, uint8_t *data)
-{
-	x = x ^ __builtin_bswap16(*(uint16_t*)data);
-	x = x ^ x>>4 ^ x>>8 ^ x>>11 ^ x>>12;
-	return x<<12 ^ x<<5 ^ x;
+uint16_t canopen_crc_final(uint16_t crc){
+	return can_crc_final(&can_crc16_xmodem, crc);
 }
 /*! \brief Алгоритм расчета контрольной суммы кадра CRC-16/XMODEM
 	\param 
@@ -37,22 +50,46 @@ CRC-16/XMODEM
 	\see CANopen application layer and communication profile
 */ 
 uint16_t canopen_crc(unsigned char* data, size_t len){
-	uint16_t crc = 0;
-	int i=0;
-	if (len&1) {
-		crc = CRC16_update_8(crc, data);
-		i++;
-	}
-	for (; i<len; i+=2){
-		crc = CRC16_update_16(crc, data+i);
-	}
-	return crc;
+	return canopen_crc_final(canopen_crc_update(canopen_crc_init(), data, len));
 }
 #ifdef TEST_CRC16
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+static double seconds(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
 int main(){
 	unsigned char test[] = "123456789";
 	uint16_t crc = canopen_crc(test, 9);
 	printf ("CRC = %04X ..%s\n", crc, crc==CRC16_XMODEM_CHECK?"ok":"fail");
+	// расчет по частям совпадает с побитовым расчетом целиком при любом разбиении
+	const size_t size = 1<<22;
+	unsigned char* buf = malloc(size+1);
+	size_t i, len;
+	int fail = 0;
+	for (i=0; i<size+1; i++) buf[i] = rand();
+	for (len=0; len<2048; len++) {
+		uint16_t ref = canopen_crc_init();
+		for (i=0; i<len*8; i++)
+			ref = ((ref>>15) ^ (buf[1+i/8]>>(7-i%8) & 1))? (ref<<1)^CRC16_POLY: ref<<1;
+		size_t split = rand()%(len+1);
+		crc = canopen_crc_update(canopen_crc_init(), buf+1, split);
+		crc = canopen_crc_final(canopen_crc_update(crc, buf+1+split, len-split));
+		if (crc!=ref || canopen_crc(buf+1, len)!=ref) fail++;
+	}
+	printf ("stream ..%s\n", fail? "fail": "ok");
+	double t = seconds();
+	for (i=0; i<20; i++) buf[0] = can_crc16_xmodem.update(&can_crc16_xmodem, buf[0], buf, size);
+	t = seconds() - t;
+	printf ("slicing-by-8: %.2f GB/s\n", 20*size/t*1e-9);
+	t = seconds();
+	for (i=0; i<20; i++) buf[0] = canopen_crc_update(buf[0], buf, size);
+	t = seconds() - t;
+	printf ("canopen_crc_update: %.2f GB/s\n", 20*size/t*1e-9);
+	free(buf);
+	return 0;
 }
 #endif
\ No newline at end of file
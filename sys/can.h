@@ -10,6 +10,13 @@
 #define CAN_SFF_MASK 0x000007FFU /* standard frame format (SFF) */
 #define CAN_EFF_MASK 0x1FFFFFFFU /* extended frame format (EFF) */
 
+#define CAN_MAX_DLEN	8
+#define CANFD_MAX_DLEN	64
+
+#define CANFD_BRS	0x01	//!< переключение скорости
+#define CANFD_ESI	0x02
+#define CANFD_FDF	0x04	//!< кадр CAN FD
+
 typedef uint32_t canid_t;
 // \see in include/linux/can.h: SocketCAN
 struct can_frame {